@@ -0,0 +1,201 @@
+/*
+Title: Blur Optimization VR
+File Name: cullCompute.glsl
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#version 430 core
+
+// Culls every copy in DrawBatcher's multi-draw indirect frame, one copy per thread.
+// See gpuCuller.h
+layout(local_size_x = 64) in;
+
+// Matches IndirectDraw in drawBatcher.h and vertexIndirect.glsl
+struct IndirectDraw
+{
+	vec4 positionScale;
+	vec4 positionOffset;
+	vec4 boundsMin;
+	vec4 boundsMax;
+	ivec4 info;
+};
+
+// Matches DrawElementsIndirectCommand in drawBatcher.h
+struct DrawCommand
+{
+	uint count;
+	uint instanceCount;
+	uint firstIndex;
+	int baseVertex;
+	uint baseInstance;
+};
+
+layout(std430, binding = 1) readonly buffer DrawBlock
+{
+	IndirectDraw draws[];
+};
+
+// Every copy's world matrix, and the draw each copy belongs to
+layout(std430, binding = 2) readonly buffer MatrixBlock
+{
+	mat4 worldMatrices[];
+};
+
+layout(std430, binding = 3) readonly buffer CopyBlock
+{
+	uint copyDraws[];
+};
+
+// The copies that survive, packed at the start of their draw's matrices
+layout(std430, binding = 4) writeonly buffer VisibleBlock
+{
+	mat4 visibleMatrices[];
+};
+
+// instanceCount starts at 0, every survivor adds its two eyes
+layout(std430, binding = 5) buffer CommandBlock
+{
+	DrawCommand commands[];
+};
+
+// Matches GpuCullStats in gpuCuller.h
+layout(std430, binding = 6) buffer CounterBlock
+{
+	uint visible;
+	uint frustumCulled;
+	uint occlusionCulled;
+};
+
+uniform uint copyCount;
+
+// This frame's cameras, for the frustums
+uniform mat4 cameraView1;
+uniform mat4 cameraView2;
+
+// The cameras and viewports the pyramid was made with (last frame)
+uniform mat4 hizView1;
+uniform mat4 hizView2;
+uniform vec4 hizViewport1;
+uniform vec4 hizViewport2;
+
+layout(binding = 0) uniform sampler2D hiz;
+uniform int hizLevels;
+uniform bool useHiZ;
+
+// True if any of the box is inside the frustum of viewProjection.
+// The box is outside if all 8 corners are outside the same plane
+bool InFrustum(mat4 viewProjection, mat4 world, vec3 boxMin, vec3 boxMax)
+{
+	bvec3 allLow = bvec3(true);
+	bvec3 allHigh = bvec3(true);
+	for (int i = 0; i < 8; i++)
+	{
+		vec3 corner = vec3((i & 1) != 0 ? boxMax.x : boxMin.x, (i & 2) != 0 ? boxMax.y : boxMin.y, (i & 4) != 0 ? boxMax.z : boxMin.z);
+		vec4 clip = viewProjection * world * vec4(corner, 1);
+		allLow = allLow && lessThan(clip.xyz, vec3(-clip.w));
+		allHigh = allHigh && greaterThan(clip.xyz, vec3(clip.w));
+	}
+	return !any(allLow) && !any(allHigh);
+}
+
+// True if the box is behind the depth the pyramid holds, where the box is on screen
+bool Occluded(mat4 viewProjection, vec4 viewport, mat4 world, vec3 boxMin, vec3 boxMax)
+{
+	vec2 screenMin = vec2(1);
+	vec2 screenMax = vec2(-1);
+	float nearest = 1;
+	for (int i = 0; i < 8; i++)
+	{
+		vec3 corner = vec3((i & 1) != 0 ? boxMax.x : boxMin.x, (i & 2) != 0 ? boxMax.y : boxMin.y, (i & 4) != 0 ? boxMax.z : boxMin.z);
+		vec4 clip = viewProjection * world * vec4(corner, 1);
+
+		// Part of the box is behind the camera, it can't be behind anything
+		if (clip.w <= 0.0001)
+			return false;
+
+		vec3 ndc = clip.xyz / clip.w;
+		screenMin = min(screenMin, ndc.xy);
+		screenMax = max(screenMax, ndc.xy);
+		nearest = min(nearest, ndc.z * 0.5 + 0.5);
+	}
+
+	// From -1 to 1 in the eye, to texels of the depth buffer
+	screenMin = clamp(screenMin, -1, 1);
+	screenMax = clamp(screenMax, -1, 1);
+	vec2 texelMin = viewport.xy + (screenMin * 0.5 + 0.5) * viewport.zw;
+	vec2 texelMax = viewport.xy + (screenMax * 0.5 + 0.5) * viewport.zw;
+
+	// The level where the box is at most 2 texels across, so 2x2 texels cover all of it
+	vec2 size = texelMax - texelMin;
+	int level = int(ceil(log2(max(max(size.x, size.y), 1))));
+	level = clamp(level, 0, hizLevels - 1);
+
+	ivec2 levelSize = textureSize(hiz, level);
+	ivec2 first = clamp(ivec2(texelMin) >> level, ivec2(0), levelSize - 1);
+	ivec2 last = clamp(ivec2(texelMax) >> level, ivec2(0), levelSize - 1);
+
+	float farthest = 0;
+	for (int y = first.y; y <= last.y; y++)
+	{
+		for (int x = first.x; x <= last.x; x++)
+		{
+			farthest = max(farthest, texelFetch(hiz, ivec2(x, y), level).r);
+		}
+	}
+
+	return nearest > farthest;
+}
+
+void main(void)
+{
+	uint copy = gl_GlobalInvocationID.x;
+	if (copy >= copyCount)
+		return;
+
+	uint drawIndex = copyDraws[copy];
+	IndirectDraw draw = draws[drawIndex];
+	mat4 world = worldMatrices[copy];
+	vec3 boxMin = draw.boundsMin.xyz;
+	vec3 boxMax = draw.boundsMax.xyz;
+
+	bool inFrustum1 = InFrustum(cameraView1, world, boxMin, boxMax);
+	bool inFrustum2 = InFrustum(cameraView2, world, boxMin, boxMax);
+	if (!inFrustum1 && !inFrustum2)
+	{
+		atomicAdd(frustumCulled, 1u);
+		return;
+	}
+
+	// Visible if either eye sees it, both eyes are drawn together
+	bool seen = !useHiZ ||
+		(inFrustum1 && !Occluded(hizView1, hizViewport1, world, boxMin, boxMax)) ||
+		(inFrustum2 && !Occluded(hizView2, hizViewport2, world, boxMin, boxMax));
+	if (!seen)
+	{
+		atomicAdd(occlusionCulled, 1u);
+		return;
+	}
+
+	atomicAdd(visible, 1u);
+	uint slot = atomicAdd(commands[drawIndex].instanceCount, 2u) / 2u;
+	visibleMatrices[draw.info.x + slot] = world;
+}
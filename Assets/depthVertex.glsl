@@ -0,0 +1,68 @@
+/*
+Title: Blur Optimization VR
+File Name: depthVertex.glsl
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#version 400 core
+#extension GL_NV_viewport_array2 : enable
+#extension GL_ARB_shader_viewport_layer_array : enable
+
+// The same as vertex.glsl, with everything but the position taken out.
+// Used with Mesh::DrawDepth, which only gives the gpu positions to read.
+layout(location = 0) in vec3 in_position;
+
+// See vertex.glsl, these undo the packing of positions
+layout(location = 4) in vec3 in_positionScale;
+layout(location = 5) in vec3 in_positionOffset;
+
+// See vertex.glsl, one world matrix per copy of the mesh
+#define MaxInstances 256
+layout(std140) uniform InstanceBlock
+{
+	mat4 instanceWorld[MaxInstances];
+};
+
+uniform mat4 cameraView1;
+uniform mat4 cameraView2;
+
+// Has to match vertex.glsl exactly, shading after a depth prepass only draws where the depths are equal
+invariant gl_Position;
+
+void main(void)
+{
+	// two instances per copy, one per eye, one viewport per eye
+	int eye = gl_InstanceID % 2;
+	gl_ViewportIndex = eye;
+
+	vec3 position = in_positionOffset + in_position * in_positionScale;
+	vec4 worldPosition = instanceWorld[gl_InstanceID / 2] * vec4(position, 1);
+
+	if(eye == 0)
+	{
+		gl_Position = cameraView1 * worldPosition;
+	}
+	else
+	{
+		gl_Position = cameraView2 * worldPosition;
+	}
+}
@@ -0,0 +1,66 @@
+/*
+Title: Blur Optimization VR
+File Name: fragmentIndirect.glsl
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#version 430 core
+#extension GL_ARB_fragment_layer_viewport : enable
+
+// The same as fragment.glsl, but the textures are picked out of an array.
+// Every texture the frame uses is bound to its own unit, see DrawBatcher
+
+in vec2 uv;
+in vec3 normal;
+in vec3 tangent;
+in vec3 bitangent;
+
+// These don't change within a draw, which makes them fine for indexing samplers
+flat in int colorTexture;
+flat in int normalTexture;
+
+// MaxTextures has to match DrawBatchMaxTextures
+#define MaxTextures 16
+uniform sampler2D textures[MaxTextures];
+
+out vec4 fragColor;
+
+
+void main(void)
+{
+	vec4 ambientLight = vec4(.1, .1, .3, 1);
+	vec4 lightColor = vec4(1, .8, .3, 1);
+	vec3 lightDir = vec3(-1, -1, -2);
+
+	vec4 color = texture(textures[colorTexture], uv);
+	vec4 normalFromTex = texture(textures[normalTexture], uv);
+
+	// Same normal mapping and lighting as fragment.glsl
+	vec3 decompNormalFromTex = normalize(vec3(normalFromTex) * 2.0 - 1.0);
+	mat3 tbn = mat3(tangent, bitangent, normal);
+	vec3 finalPerPixelNormal = tbn * decompNormalFromTex;
+
+	float ndotl = clamp(-dot(normalize(lightDir), normalize(finalPerPixelNormal)), 0, 1);
+	vec4 lightValue = clamp(lightColor * ndotl + ambientLight, 0, 1);
+
+	fragColor = color * lightValue;
+}
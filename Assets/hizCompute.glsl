@@ -0,0 +1,76 @@
+/*
+Title: Blur Optimization VR
+File Name: hizCompute.glsl
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#version 430 core
+
+// Builds one level of the hierarchical-Z pyramid, see gpuCuller.h.
+// Every texel is the farthest depth of the texels under it in the level above,
+// so if something is behind a texel, it's behind everything that texel covers
+layout(local_size_x = 8, local_size_y = 8) in;
+
+// Level 0 copies this
+layout(binding = 0) uniform sampler2D depthTexture;
+
+// Every other level reads the level above it
+layout(binding = 0, r32f) readonly uniform image2D sourceLevel;
+layout(binding = 1, r32f) writeonly uniform image2D destinationLevel;
+
+uniform int level;
+
+void main(void)
+{
+	ivec2 destination = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 destinationSize = imageSize(destinationLevel);
+	if (destination.x >= destinationSize.x || destination.y >= destinationSize.y)
+		return;
+
+	if (level == 0)
+	{
+		imageStore(destinationLevel, destination, vec4(texelFetch(depthTexture, destination, 0).r));
+		return;
+	}
+
+	// Each texel covers 2x2 texels of the level above. When the level above has an odd size,
+	// the last row and column cover 3, so the extra texels aren't left out
+	ivec2 sourceSize = imageSize(sourceLevel);
+	ivec2 first = destination * 2;
+	ivec2 last = first + 1;
+	if (destination.x == destinationSize.x - 1 && (sourceSize.x & 1) == 1)
+		last.x++;
+	if (destination.y == destinationSize.y - 1 && (sourceSize.y & 1) == 1)
+		last.y++;
+	last = min(last, sourceSize - 1);
+
+	float depth = 0;
+	for (int y = first.y; y <= last.y; y++)
+	{
+		for (int x = first.x; x <= last.x; x++)
+		{
+			depth = max(depth, imageLoad(sourceLevel, ivec2(x, y)).r);
+		}
+	}
+
+	imageStore(destinationLevel, destination, vec4(depth));
+}
@@ -33,9 +33,20 @@ layout(location = 1) in vec2 in_uv;
 layout(location = 2) in vec3 in_normal;
 layout(location = 3) in vec3 in_tangent;
 
-// uniform will contain the world matrix.
+// Packed meshes store positions from 0 to 1 across their bounding box,
+// these scale them back to model space. Mesh::Draw sets them once per draw,
+// meshes that aren't packed get a scale of 1 and an offset of 0
+layout(location = 4) in vec3 in_positionScale;
+layout(location = 5) in vec3 in_positionOffset;
+
+// World matrices of every copy of the mesh in this draw, see drawBatcher.h.
+// MaxInstances has to match DrawBatchMaxInstances
+#define MaxInstances 256
+layout(std140) uniform InstanceBlock
+{
+	mat4 instanceWorld[MaxInstances];
+};
 
-uniform mat4 worldMatrix;
 uniform mat4 cameraView1;
 uniform mat4 cameraView2;
 
@@ -44,15 +55,22 @@ out vec3 normal;
 out vec3 tangent;
 out vec3 bitangent;
 
+// The depth prepass draws the same positions with depthVertex.glsl, then this draws
+// with the depth test set to EQUAL, so both have to get exactly the same gl_Position
+invariant gl_Position;
+
 void main(void)
 {
-	// first instance goes to first viewport
-	// second instance goes to second viewport
-	gl_ViewportIndex = gl_InstanceID;
+	// Every copy of the mesh is drawn twice, once for each eye.
+	// even instances go to the first viewport, odd instances go to the second
+	int eye = gl_InstanceID % 2;
+	mat4 worldMatrix = instanceWorld[gl_InstanceID / 2];
+	gl_ViewportIndex = eye;
 
 	// Transform position from model-space to world-space.
 	// In other words, move model to where it should be in the world
-	vec4 worldPosition = worldMatrix * vec4(in_position, 1);
+	vec3 position = in_positionOffset + in_position * in_positionScale;
+	vec4 worldPosition = worldMatrix * vec4(position, 1);
 
 	// convert world-space to screen-space
 	// In other words, where on the screen should each polygon be?
@@ -60,7 +78,7 @@ void main(void)
 	vec4 screenPosition;
 	
 	// left eye
-	if(gl_InstanceID == 0)
+	if(eye == 0)
 	{
 		screenPosition = cameraView1 * worldPosition;
 	}
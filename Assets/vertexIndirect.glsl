@@ -0,0 +1,112 @@
+/*
+Title: Blur Optimization VR
+File Name: vertexIndirect.glsl
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#version 430 core
+#extension GL_ARB_shader_draw_parameters : require
+#extension GL_NV_viewport_array2 : enable
+#extension GL_ARB_shader_viewport_layer_array : enable
+
+// The same as vertex.glsl, for DrawBatcher's multi-draw indirect path.
+// Every draw in the glMultiDrawElementsIndirect call is a different mesh,
+// so everything that used to be set between draws comes from buffers instead
+
+layout(location = 0) in vec3 in_position;
+layout(location = 1) in vec2 in_uv;
+layout(location = 2) in vec3 in_normal;
+layout(location = 3) in vec3 in_tangent;
+
+// One per draw, indexed by gl_DrawIDARB. Matches IndirectDraw in drawBatcher.h
+struct IndirectDraw
+{
+	// Undo the packing of positions, what attributes 4 and 5 do in vertex.glsl
+	vec4 positionScale;
+	vec4 positionOffset;
+
+	// Model space box around the mesh, only read by cullCompute.glsl
+	vec4 boundsMin;
+	vec4 boundsMax;
+
+	// x: first world matrix of this draw's copies
+	// y: texture unit of the color texture
+	// z: texture unit of the normal map
+	ivec4 info;
+};
+
+layout(std430, binding = 1) readonly buffer DrawBlock
+{
+	IndirectDraw draws[];
+};
+
+// World matrices of every copy of every draw
+layout(std430, binding = 2) readonly buffer MatrixBlock
+{
+	mat4 worldMatrices[];
+};
+
+// gl_DrawIDARB starts at 0 for every glMultiDrawElementsIndirect,
+// this is where the current one starts in DrawBlock
+uniform int firstDraw;
+
+uniform mat4 cameraView1;
+uniform mat4 cameraView2;
+
+out vec2 uv;
+out vec3 normal;
+out vec3 tangent;
+out vec3 bitangent;
+
+// The same for every vertex in a draw, so the fragment shader can use them to pick textures
+flat out int colorTexture;
+flat out int normalTexture;
+
+void main(void)
+{
+	IndirectDraw draw = draws[firstDraw + gl_DrawIDARB];
+
+	// two instances per copy, one per eye, one viewport per eye
+	int eye = gl_InstanceID % 2;
+	mat4 worldMatrix = worldMatrices[draw.info.x + gl_InstanceID / 2];
+	gl_ViewportIndex = eye;
+
+	vec3 position = draw.positionOffset.xyz + in_position * draw.positionScale.xyz;
+	vec4 worldPosition = worldMatrix * vec4(position, 1);
+
+	if(eye == 0)
+	{
+		gl_Position = cameraView1 * worldPosition;
+	}
+	else
+	{
+		gl_Position = cameraView2 * worldPosition;
+	}
+
+	normal = mat3(worldMatrix) * in_normal;
+	tangent = mat3(worldMatrix) * in_tangent;
+	bitangent = normalize(cross(tangent, normal));
+	uv = in_uv;
+
+	colorTexture = draw.info.y;
+	normalTexture = draw.info.z;
+}
@@ -0,0 +1,628 @@
+/*
+Title: Blur Optimization VR
+File Name: drawBatcher.cpp
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "drawBatcher.h"
+#include "mesh.h"
+#include "material.h"
+#include "renderState.h"
+#include "gpuCuller.h"
+#include "GLFW/glfw3.h"
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+#include <cstring>
+
+// Bytes the shaders read for one instance block, the whole array
+static const size_t instanceBlockSize = DrawBatchMaxInstances * sizeof(glm::mat4);
+
+DrawBatcher::DrawBatcher()
+{
+    glGenBuffers(1, &m_instanceBuffer);
+    glGenBuffers(1, &m_commandBuffer);
+    glGenBuffers(1, &m_drawBuffer);
+    glGenBuffers(1, &m_matrixBuffer);
+    glGenBuffers(1, &m_copyBuffer);
+    for (int i = 0; i < DrawBatchTimerFrames; i++)
+        glGenQueries(3, m_timers[i].queries);
+
+    // Ranges of a uniform buffer have to start on the gpu's alignment (usually 256 bytes)
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    m_alignment = alignment > (GLint)sizeof(glm::mat4) ? (size_t)alignment : sizeof(glm::mat4);
+}
+
+DrawBatcher::~DrawBatcher()
+{
+    glDeleteBuffers(1, &m_instanceBuffer);
+    glDeleteBuffers(1, &m_commandBuffer);
+    glDeleteBuffers(1, &m_drawBuffer);
+    glDeleteBuffers(1, &m_matrixBuffer);
+    glDeleteBuffers(1, &m_copyBuffer);
+    for (int i = 0; i < DrawBatchTimerFrames; i++)
+        glDeleteQueries(3, m_timers[i].queries);
+}
+
+DrawBatch& DrawBatcher::FindBatch(Mesh* mesh, Material* material, int lod)
+{
+    const std::vector<Texture*>& textures = material->GetTextures();
+
+    // Scenes only have a few dozen batches, so just look through all of them
+    for (size_t i = 0; i < m_batches.size(); i++)
+    {
+        DrawBatch& batch = m_batches[i];
+        if (batch.mesh == mesh && batch.material == material && batch.lod == lod &&
+            batch.textures == textures && batch.worldMatrices.size() < DrawBatchMaxInstances)
+            return batch;
+    }
+
+    DrawBatch batch;
+    batch.mesh = mesh;
+    batch.material = material;
+    batch.textures = textures;
+    batch.lod = lod;
+    batch.offset = 0;
+    m_batches.push_back(batch);
+    return m_batches.back();
+}
+
+unsigned int DrawBatcher::SetupProgram(GLuint program)
+{
+    for (unsigned int i = 0; i < m_programs.size(); i++)
+    {
+        if (m_programs[i] == program)
+            return i;
+    }
+
+    GLuint block = glGetUniformBlockIndex(program, "InstanceBlock");
+    if (block != GL_INVALID_INDEX)
+        glUniformBlockBinding(program, block, DrawBatchBinding);
+    else
+        printf("Uniform block: InstanceBlock not found in shader program.\n");
+
+    m_programs.push_back(program);
+    return (unsigned int)m_programs.size() - 1;
+}
+
+unsigned int DrawBatcher::FindTextureSet(const std::vector<Texture*>& textures)
+{
+    for (unsigned int i = 0; i < m_textureSets.size(); i++)
+    {
+        if (m_textureSets[i] == textures)
+            return i;
+    }
+
+    m_textureSets.push_back(textures);
+    return (unsigned int)m_textureSets.size() - 1;
+}
+
+unsigned int DrawBatcher::FindMesh(Mesh* mesh)
+{
+    for (unsigned int i = 0; i < m_meshes.size(); i++)
+    {
+        if (m_meshes[i] == mesh)
+            return i;
+    }
+
+    m_meshes.push_back(mesh);
+    return (unsigned int)m_meshes.size() - 1;
+}
+
+void DrawBatcher::SortBatches()
+{
+    // Everything in one Flush goes to the same render target
+    m_drawList.Clear();
+    for (unsigned int b = 0; b < m_batches.size(); b++)
+    {
+        DrawBatch& batch = m_batches[b];
+        unsigned int program = SetupProgram(batch.material->GetShaderProgram()->GetGLShaderProgram());
+
+        // How far the closest copy is, clip space w is the distance along the view
+        float depth = FLT_MAX;
+        glm::vec4 wRow = glm::vec4(m_sortView[0][3], m_sortView[1][3], m_sortView[2][3], m_sortView[3][3]);
+        for (size_t i = 0; i < batch.worldMatrices.size(); i++)
+            depth = glm::min(depth, glm::dot(wRow, batch.worldMatrices[i][3]));
+
+        m_drawList.Add(MakeDrawKey(0, program, FindTextureSet(batch.textures), FindMesh(batch.mesh), depth), b);
+    }
+
+    m_unsortedChanges = m_drawList.CountStateChanges();
+    m_drawList.Sort();
+    m_stateChanges = m_drawList.CountStateChanges();
+
+    std::vector<DrawBatch> sorted;
+    sorted.reserve(m_batches.size());
+    for (const DrawListItem& item : m_drawList.GetItems())
+        sorted.push_back(std::move(m_batches[item.index]));
+    m_batches.swap(sorted);
+}
+
+void DrawBatcher::Add(Mesh* mesh, Material* material, const glm::mat4& worldMatrix)
+{
+    DrawBatch& batch = FindBatch(mesh, material, mesh->SelectLod(worldMatrix));
+    batch.worldMatrices.push_back(worldMatrix);
+
+    if (m_cpuCulling)
+    {
+        glm::vec3 center, boundsMin, boundsMax;
+        float radius;
+        mesh->GetBoundingSphere(center, radius);
+        mesh->GetBounds(boundsMin, boundsMax);
+        m_bounds.AddTransformed(worldMatrix, center, radius, boundsMin, boundsMax);
+        m_objectBatches.push_back((unsigned int)(&batch - m_batches.data()));
+    }
+}
+
+void DrawBatcher::CullBatches()
+{
+    // Culling has to have been on since the first Add this frame
+    unsigned int count = m_bounds.GetCount();
+    size_t added = 0;
+    for (unsigned int b = 0; b < m_batches.size(); b++)
+        added += m_batches[b].worldMatrices.size();
+    if (count != added)
+    {
+        m_bounds.Clear();
+        m_objectBatches.clear();
+        return;
+    }
+
+    m_visible.resize(count);
+    unsigned int visibleCount = CullObjects(m_cullFrustum, m_bounds, m_visible.data());
+    m_cpuCulledCount = count - visibleCount;
+
+    if (m_cpuCulledCount > 0)
+    {
+        // Objects were added to each batch in order, so walking through them
+        // in order visits each batch's matrices in order too
+        std::vector<unsigned int> read(m_batches.size(), 0);
+        std::vector<unsigned int> write(m_batches.size(), 0);
+        for (unsigned int i = 0; i < count; i++)
+        {
+            unsigned int b = m_objectBatches[i];
+            std::vector<glm::mat4>& worldMatrices = m_batches[b].worldMatrices;
+            if (m_visible[i])
+                worldMatrices[write[b]++] = worldMatrices[read[b]];
+            read[b]++;
+        }
+
+        std::vector<DrawBatch> kept;
+        for (unsigned int b = 0; b < m_batches.size(); b++)
+        {
+            m_batches[b].worldMatrices.resize(write[b]);
+            if (write[b] > 0)
+                kept.push_back(m_batches[b]);
+        }
+        m_batches.swap(kept);
+    }
+
+    m_bounds.Clear();
+    m_objectBatches.clear();
+}
+
+void DrawBatcher::Flush()
+{
+    double start = glfwGetTime();
+
+    m_cpuCulledCount = 0;
+    if (m_cpuCulling)
+        CullBatches();
+
+    m_objectCount = 0;
+    for (size_t i = 0; i < m_batches.size(); i++)
+        m_objectCount += (unsigned int)m_batches[i].worldMatrices.size();
+
+    SortBatches();
+
+    m_lastIndirect = m_indirectMaterial != nullptr && FlushIndirect();
+    if (!m_lastIndirect)
+        FlushInstanced();
+
+    m_batches.clear();
+    m_flushTime = (glfwGetTime() - start) * 1000.0;
+}
+
+void DrawBatcher::FlushInstanced()
+{
+    m_drawCount = (unsigned int)m_batches.size();
+
+    // Lay the batches out one after another. The shaders read a whole
+    // block from each one, so the last one gets the full block size
+    size_t size = 0;
+    for (size_t i = 0; i < m_batches.size(); i++)
+    {
+        m_batches[i].offset = size;
+        size += (m_batches[i].worldMatrices.size() * sizeof(glm::mat4) + m_alignment - 1) / m_alignment * m_alignment;
+    }
+    if (!m_batches.empty())
+        size = m_batches.back().offset + instanceBlockSize;
+
+    // Upload every world matrix at once. glBufferData gives us new memory every
+    // frame, so we never wait for the gpu to finish with last frame's matrices
+    std::vector<unsigned char> data(size);
+    for (size_t i = 0; i < m_batches.size(); i++)
+    {
+        std::vector<glm::mat4>& worldMatrices = m_batches[i].worldMatrices;
+        memcpy(&data[m_batches[i].offset], worldMatrices.data(), worldMatrices.size() * sizeof(glm::mat4));
+    }
+
+    if (size > m_instanceBufferSize)
+        m_instanceBufferSize = size;
+
+    glBindBuffer(GL_UNIFORM_BUFFER, m_instanceBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, m_instanceBufferSize, nullptr, GL_STREAM_DRAW);
+    if (size > 0)
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data.data());
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    // Time the scene pass on the gpu. If every timer is still
+    // waiting on the gpu, this frame just doesn't get timed
+    PollTimers();
+    DrawBatchTimer* timer = m_timers[m_nextTimer].pending ? nullptr : &m_timers[m_nextTimer];
+    bool prepass = m_depthMaterial != nullptr;
+    if (timer != nullptr)
+        glQueryCounter(timer->queries[0], GL_TIMESTAMP);
+
+    if (prepass)
+    {
+        // Only depth, every batch with the same program and only positions to read
+        m_depthMaterial->Bind();
+        SetupProgram(m_depthMaterial->GetShaderProgram()->GetGLShaderProgram());
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        for (size_t i = 0; i < m_batches.size(); i++)
+        {
+            DrawBatch& batch = m_batches[i];
+            glBindBufferRange(GL_UNIFORM_BUFFER, DrawBatchBinding, m_instanceBuffer, batch.offset, instanceBlockSize);
+            batch.mesh->DrawDepthInstanced(batch.lod, (unsigned int)batch.worldMatrices.size());
+        }
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+        // Depth is final now, so only the fragments that made it get shaded.
+        // Both vertex shaders declare gl_Position invariant, so their depths match exactly
+        glDepthFunc(GL_EQUAL);
+        glDepthMask(GL_FALSE);
+    }
+
+    if (timer != nullptr)
+        glQueryCounter(timer->queries[1], GL_TIMESTAMP);
+
+    // The batches are in key order now, so only bind what the key (or the material) says changed
+    const std::vector<DrawListItem>& items = m_drawList.GetItems();
+    for (size_t i = 0; i < m_batches.size(); i++)
+    {
+        DrawBatch& batch = m_batches[i];
+        uint64_t key = items[i].key;
+        uint64_t lastKey = i > 0 ? items[i - 1].key : ~key;
+        bool newTextures = GetDrawKeyTextureSet(key) != GetDrawKeyTextureSet(lastKey);
+        bool newMaterial = i == 0 || batch.material != m_batches[i - 1].material ||
+                           GetDrawKeyProgram(key) != GetDrawKeyProgram(lastKey);
+
+        // Put the material back the way it was when these were added
+        if (newTextures || newMaterial)
+        {
+            batch.material->SetTextures(batch.textures);
+            batch.material->Bind();
+        }
+
+        glBindBufferRange(GL_UNIFORM_BUFFER, DrawBatchBinding, m_instanceBuffer, batch.offset, instanceBlockSize);
+        batch.mesh->DrawInstanced(batch.lod, (unsigned int)batch.worldMatrices.size());
+    }
+
+    if (prepass)
+    {
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+    }
+
+    if (timer != nullptr)
+    {
+        glQueryCounter(timer->queries[2], GL_TIMESTAMP);
+        timer->pending = true;
+        timer->prepass = prepass;
+        m_nextTimer = (m_nextTimer + 1) % DrawBatchTimerFrames;
+    }
+}
+
+// Moves average a tenth of the way to time, or all the way on the first frame
+static void AverageTime(double& average, double time, unsigned int frames)
+{
+    average = frames == 0 ? time : average + (time - average) * 0.1;
+}
+
+void DrawBatcher::PollTimers()
+{
+    for (int i = 0; i < DrawBatchTimerFrames; i++)
+    {
+        DrawBatchTimer& timer = m_timers[i];
+        if (!timer.pending)
+            continue;
+
+        // The last timestamp is the last one the gpu gets to, this only asks, it never waits
+        GLint available = 0;
+        glGetQueryObjectiv(timer.queries[2], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            continue;
+
+        GLuint64 times[3];
+        for (int j = 0; j < 3; j++)
+            glGetQueryObjectui64v(timer.queries[j], GL_QUERY_RESULT, &times[j]);
+        timer.pending = false;
+
+        double prepassTime = (times[1] - times[0]) / 1000000.0;
+        double shadingTime = (times[2] - times[1]) / 1000000.0;
+        if (timer.prepass)
+        {
+            AverageTime(m_prepassTime, prepassTime, m_prepassFrames);
+            AverageTime(m_shadingTime, shadingTime, m_prepassFrames);
+            m_prepassFrames++;
+        }
+        else
+        {
+            AverageTime(m_plainTime, shadingTime, m_plainFrames);
+            m_plainFrames++;
+        }
+    }
+}
+
+void DrawBatcher::SetDepthMaterial(Material* material)
+{
+    m_depthMaterial = material;
+}
+
+bool DrawBatcher::IsDepthPrepass()
+{
+    return m_depthMaterial != nullptr;
+}
+
+// Fills buffer with size bytes of data. glBufferData gives us new memory every
+// frame, so we never wait for the gpu to finish with last frame's draws
+static void UploadBuffer(GLenum target, GLuint buffer, const void* data, size_t size)
+{
+    glBindBuffer(target, buffer);
+    glBufferData(target, size, data, GL_STREAM_DRAW);
+    glBindBuffer(target, 0);
+}
+
+// Draws can only share a multi-draw call if they have the same vertex format, index type
+// and primitive (see indexPacking.h). Sorting by this puts the ones that can next to each other
+static unsigned int IndirectCall(Mesh* mesh)
+{
+    return (unsigned int)mesh->GetVertexFormat() << 16 | (mesh->GetIndexType() - GL_UNSIGNED_BYTE) << 8 |
+           (mesh->GetPrimitive() == GL_TRIANGLE_STRIP ? 1 : 0);
+}
+
+bool DrawBatcher::FlushIndirect()
+{
+    RenderState& state = GetRenderState();
+
+    // Every texture in the frame gets its own unit, draws say which units they read
+    m_textures.clear();
+    for (size_t i = 0; i < m_batches.size(); i++)
+    {
+        const std::vector<Texture*>& textures = m_batches[i].textures;
+        for (size_t j = 0; j < textures.size(); j++)
+        {
+            if (std::find(m_textures.begin(), m_textures.end(), textures[j]) == m_textures.end())
+                m_textures.push_back(textures[j]);
+        }
+    }
+
+    if (m_textures.size() > DrawBatchMaxTextures)
+    {
+        printf("Multi-draw indirect: %d textures is more than %d, drawing batches instead\n",
+            (int)m_textures.size(), DrawBatchMaxTextures);
+        return false;
+    }
+
+    // Draws that can share a call go next to each other, so each kind is one call
+    std::vector<int> order(m_batches.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = (int)i;
+    std::stable_sort(order.begin(), order.end(), [this](int a, int b)
+        { return IndirectCall(m_batches[a].mesh) < IndirectCall(m_batches[b].mesh); });
+
+    m_commands.clear();
+    m_draws.clear();
+    m_matrices.clear();
+    m_copyDraws.clear();
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        DrawBatch& batch = m_batches[order[i]];
+        unsigned int count = (unsigned int)batch.worldMatrices.size();
+
+        DrawElementsIndirectCommand command;
+        command.count = batch.mesh->GetIndexCount(batch.lod);
+        // With culling, the gpu counts up the copies that are visible
+        command.instanceCount = m_culler != nullptr ? 0 : 2 * count;
+        command.firstIndex = batch.mesh->GetFirstIndex(batch.lod);
+        command.baseVertex = batch.mesh->GetBaseVertex();
+        command.baseInstance = 0;
+        m_commands.push_back(command);
+
+        glm::vec3 scale;
+        glm::vec3 offset;
+        batch.mesh->GetPositionTransform(scale, offset);
+
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+        batch.mesh->GetBounds(boundsMin, boundsMax);
+
+        // Materials in this scene have a color texture and a normal map, in that order
+        IndirectDraw draw;
+        draw.positionScale = glm::vec4(scale, 0);
+        draw.positionOffset = glm::vec4(offset, 0);
+        draw.boundsMin = glm::vec4(boundsMin, 1);
+        draw.boundsMax = glm::vec4(boundsMax, 1);
+        draw.firstMatrix = (GLint)m_matrices.size();
+        draw.colorTexture = batch.textures.size() > 0 ? (GLint)(std::find(m_textures.begin(), m_textures.end(), batch.textures[0]) - m_textures.begin()) : 0;
+        draw.normalTexture = batch.textures.size() > 1 ? (GLint)(std::find(m_textures.begin(), m_textures.end(), batch.textures[1]) - m_textures.begin()) : 0;
+        draw.padding = 0;
+        m_draws.push_back(draw);
+
+        m_matrices.insert(m_matrices.end(), batch.worldMatrices.begin(), batch.worldMatrices.end());
+        m_copyDraws.insert(m_copyDraws.end(), count, (GLuint)i);
+        batch.mesh->AddLodStats(batch.lod, count);
+    }
+
+    UploadBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer, m_commands.data(), m_commands.size() * sizeof(DrawElementsIndirectCommand));
+    UploadBuffer(GL_SHADER_STORAGE_BUFFER, m_drawBuffer, m_draws.data(), m_draws.size() * sizeof(IndirectDraw));
+    UploadBuffer(GL_SHADER_STORAGE_BUFFER, m_matrixBuffer, m_matrices.data(), m_matrices.size() * sizeof(glm::mat4));
+
+    // The culled copies are packed into another buffer, the shaders read that one instead
+    GLuint matrixBuffer = m_matrixBuffer;
+    if (m_culler != nullptr)
+    {
+        UploadBuffer(GL_SHADER_STORAGE_BUFFER, m_copyBuffer, m_copyDraws.data(), m_copyDraws.size() * sizeof(GLuint));
+        matrixBuffer = m_culler->Cull(m_commandBuffer, m_drawBuffer, m_matrixBuffer, m_copyBuffer, (unsigned int)m_copyDraws.size());
+    }
+
+    m_indirectMaterial->Bind();
+    GLuint program = m_indirectMaterial->GetShaderProgram()->GetGLShaderProgram();
+    for (unsigned int i = 0; i < m_textures.size(); i++)
+        state.BindTexture(i, GL_TEXTURE_2D, m_textures[i]->GetGLTexture());
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DrawBatchDrawBinding, m_drawBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DrawBatchMatrixBinding, matrixBuffer);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+
+    GLint firstDrawUniform = glGetUniformLocation(program, "firstDraw");
+
+    m_drawCount = 0;
+    size_t first = 0;
+    while (first < m_commands.size())
+    {
+        Mesh* mesh = m_batches[order[first]].mesh;
+        size_t last = first;
+        while (last < m_commands.size() && IndirectCall(m_batches[order[last]].mesh) == IndirectCall(mesh))
+            last++;
+
+        state.BindVertexFormat(mesh->GetVertexFormat());
+        glUniform1i(firstDrawUniform, (GLint)first);
+        state.Count(StateUniform, true);
+
+        glMultiDrawElementsIndirect(mesh->GetPrimitive(), mesh->GetIndexType(),
+            (void*)(first * sizeof(DrawElementsIndirectCommand)), (GLsizei)(last - first), 0);
+        m_drawCount++;
+
+        first = last;
+    }
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    return true;
+}
+
+void DrawBatcher::SetIndirectMaterial(Material* material)
+{
+    if (material != nullptr && !IndirectSupported())
+    {
+        printf("Multi-draw indirect needs OpenGL 4.3 and ARB_shader_draw_parameters\n");
+        return;
+    }
+
+    if (material != nullptr && material != m_indirectMaterial)
+    {
+        // Unit i holds texture i, this never changes so it only has to be set once
+        material->GetShaderProgram()->Bind();
+        GLuint program = material->GetShaderProgram()->GetGLShaderProgram();
+        GLint units[DrawBatchMaxTextures];
+        for (int i = 0; i < DrawBatchMaxTextures; i++)
+            units[i] = i;
+        glUniform1iv(glGetUniformLocation(program, "textures"), DrawBatchMaxTextures, units);
+    }
+
+    m_indirectMaterial = material;
+}
+
+bool DrawBatcher::IsIndirect()
+{
+    return m_indirectMaterial != nullptr;
+}
+
+void DrawBatcher::SetCuller(GpuCuller* culler)
+{
+    m_culler = culler;
+}
+
+bool DrawBatcher::IsCulling()
+{
+    return m_culler != nullptr && m_indirectMaterial != nullptr;
+}
+
+void DrawBatcher::SetCpuCulling(bool enabled)
+{
+    if (enabled != m_cpuCulling)
+    {
+        m_bounds.Clear();
+        m_objectBatches.clear();
+    }
+    m_cpuCulling = enabled;
+}
+
+bool DrawBatcher::IsCpuCulling()
+{
+    return m_cpuCulling;
+}
+
+void DrawBatcher::SetCullViews(const glm::mat4& viewProjection1, const glm::mat4& viewProjection2)
+{
+    m_cullFrustum = MakeStereoFrustum(viewProjection1, viewProjection2);
+    m_sortView = viewProjection1;
+}
+
+bool DrawBatcher::IndirectSupported()
+{
+    return GLEW_VERSION_4_3 && GLEW_ARB_shader_draw_parameters;
+}
+
+unsigned int DrawBatcher::GetObjectCount()
+{
+    return m_objectCount;
+}
+
+unsigned int DrawBatcher::GetDrawCount()
+{
+    return m_drawCount;
+}
+
+void DrawBatcher::PrintStats()
+{
+    printf("Draw calls: %u for %u objects (%u without batching), %s, submitted in %.3f ms\n", m_drawCount, m_objectCount,
+        m_objectCount, m_lastIndirect ? "multi-draw indirect" : "instanced", m_flushTime);
+    if (m_cpuCulling)
+        printf("CPU culling: %u objects outside both eyes were never drawn\n", m_cpuCulledCount);
+    printf("Draw order: %u program and %u texture switches (%u and %u in the order they were added)\n",
+        m_stateChanges.programs, m_stateChanges.textureSets, m_unsortedChanges.programs, m_unsortedChanges.textureSets);
+
+    // Both eyes are drawn by the same draw calls (see vertex.glsl),
+    // so they can't be timed apart, per eye is half of the pass
+    if (m_plainFrames > 0)
+        printf("Scene pass without depth prepass: %.3f ms shading (%.3f ms per eye)\n", m_plainTime, m_plainTime / 2);
+    if (m_prepassFrames > 0)
+        printf("Scene pass with depth prepass: %.3f ms depth + %.3f ms shading (%.3f ms + %.3f ms per eye)\n",
+            m_prepassTime, m_shadingTime, m_prepassTime / 2, m_shadingTime / 2);
+    if (m_plainFrames > 0 && m_prepassFrames > 0)
+    {
+        double saved = (m_plainTime - m_prepassTime - m_shadingTime) / 2;
+        printf("Depth prepass %s %.3f ms per eye\n", saved >= 0 ? "saves" : "costs", saved >= 0 ? saved : -saved);
+    }
+}
@@ -0,0 +1,266 @@
+/*
+Title: Blur Optimization VR
+File Name: drawBatcher.h
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "GL/glew.h"
+#include "glm/glm.hpp"
+#include "frustumCulling.h"
+#include "drawList.h"
+#include <vector>
+
+class Mesh;
+class Material;
+class Texture;
+class GpuCuller;
+
+// Copies in one batch, this has to match MaxInstances in vertex.glsl and depthVertex.glsl
+#define DrawBatchMaxInstances 256
+
+// The uniform buffer binding the instance block is read from
+#define DrawBatchBinding 0
+
+// Textures one multi-draw indirect frame can use, this has to match MaxTextures in fragmentIndirect.glsl
+#define DrawBatchMaxTextures 16
+
+// Shader storage buffer bindings of DrawBlock and MatrixBlock in vertexIndirect.glsl
+#define DrawBatchDrawBinding 1
+#define DrawBatchMatrixBinding 2
+
+// Frames of gpu timestamps that can be waiting to be read back at once
+#define DrawBatchTimerFrames 3
+
+// The layout glMultiDrawElementsIndirect reads its draws in
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// What vertexIndirect.glsl reads for each draw, indexed by gl_DrawIDARB (std430 layout)
+struct IndirectDraw
+{
+    glm::vec4 positionScale;
+    glm::vec4 positionOffset;
+
+    // Model space box around the mesh, for GpuCuller
+    glm::vec4 boundsMin;
+    glm::vec4 boundsMax;
+
+    GLint firstMatrix;
+    GLint colorTexture;
+    GLint normalTexture;
+    GLint padding;
+};
+
+// Timestamps around one frame's scene pass: before the depth prepass, between
+// the prepass and shading (the same time as the first without a prepass), and after shading
+struct DrawBatchTimer
+{
+    GLuint queries[3];
+    bool pending;
+    bool prepass;
+};
+
+// Draws of one mesh, at one level of detail, with one material and the same textures
+struct DrawBatch
+{
+    Mesh* mesh;
+    Material* material;
+    std::vector<Texture*> textures;
+    int lod;
+
+    // World matrix of every copy
+    std::vector<glm::mat4> worldMatrices;
+
+    // Where worldMatrices goes in the instance buffer
+    size_t offset;
+};
+
+// Collects draws for a frame, and turns every group of draws that only differ by their
+// world matrix into one instanced draw call. Every batch's world matrices go into one
+// uniform buffer, uploaded once, and each batch draws 2 * N instances, which the vertex
+// shader splits back into a copy (gl_InstanceID / 2) and an eye (gl_InstanceID % 2).
+//
+// Batches are sorted by a 64 bit key before they're drawn (see drawList.h): program,
+// then textures, then mesh, then how close the nearest copy is, so each program and
+// each set of textures is only switched to once a frame, and the rest draws front to back.
+// Drawing walks the sorted batches and only binds what changed since the last one.
+//
+// With an indirect material set, the whole frame is one glMultiDrawElementsIndirect
+// instead (one per vertex format and index type, if meshes differ). Each batch becomes a
+// DrawElementsIndirectCommand, and everything that changed between batches, the world
+// matrices, position scale and offset, and textures, is read by the shaders from buffers.
+// A GpuCuller can then cull those draws on the gpu, before they're drawn.
+//
+// With a depth material set, the per-batch path draws the scene twice: first only
+// positions, into depth (see Mesh::DrawDepth), then shaded with the depth test set to
+// EQUAL and depth writes off. Only the closest surface of each pixel runs fragment.glsl,
+// the price is drawing every triangle twice. Timestamps around both passes say which wins.
+class DrawBatcher
+{
+
+private:
+    std::vector<DrawBatch> m_batches;
+
+    // Holds the instance blocks of every batch, one after another
+    GLuint m_instanceBuffer = 0;
+    size_t m_instanceBufferSize = 0;
+
+    // Instance blocks have to start on a multiple of this
+    size_t m_alignment = 0;
+
+    // Programs that already read their instance block from DrawBatchBinding.
+    // Their place in the list is their id in draw keys, same for texture sets and meshes
+    std::vector<GLuint> m_programs;
+    std::vector<std::vector<Texture*>> m_textureSets;
+    std::vector<Mesh*> m_meshes;
+
+    // This frame's batches by key, the camera their depth is measured from,
+    // and the state changes drawing them took, sorted and as they were added
+    DrawList m_drawList;
+    glm::mat4 m_sortView = glm::mat4(1.0f);
+    DrawStateChanges m_stateChanges;
+    DrawStateChanges m_unsortedChanges;
+
+    // The multi-draw indirect path: its material (with vertexIndirect.glsl and fragmentIndirect.glsl),
+    // the buffers it reads, and the staging copies they're filled from
+    Material* m_indirectMaterial = nullptr;
+    GLuint m_commandBuffer = 0;
+    GLuint m_drawBuffer = 0;
+    GLuint m_matrixBuffer = 0;
+    std::vector<DrawElementsIndirectCommand> m_commands;
+    std::vector<IndirectDraw> m_draws;
+    std::vector<glm::mat4> m_matrices;
+    std::vector<Texture*> m_textures;
+
+    // With CPU culling, the world space bounds of everything added this frame, the batch each one
+    // went into, and which ones the stereo frustum kept
+    bool m_cpuCulling = false;
+    CullFrustum m_cullFrustum;
+    CullBounds m_bounds;
+    std::vector<unsigned int> m_objectBatches;
+    std::vector<unsigned char> m_visible;
+    unsigned int m_cpuCulledCount = 0;
+
+    // Draws the depth prepass, if it's set, and the timestamps around the scene pass.
+    // How long the passes took on the gpu, averaged over the last few frames that used each mode
+    Material* m_depthMaterial = nullptr;
+    DrawBatchTimer m_timers[DrawBatchTimerFrames] = {};
+    unsigned int m_nextTimer = 0;
+    double m_prepassTime = 0;
+    double m_shadingTime = 0;
+    double m_plainTime = 0;
+    unsigned int m_prepassFrames = 0;
+    unsigned int m_plainFrames = 0;
+
+    // Culls the multi-draw indirect draws, if it's set. It needs to know
+    // which draw each copy belongs to
+    GpuCuller* m_culler = nullptr;
+    GLuint m_copyBuffer = 0;
+    std::vector<GLuint> m_copyDraws;
+
+    // Draws that were asked for, and draw calls made, in the last Flush
+    unsigned int m_objectCount = 0;
+    unsigned int m_drawCount = 0;
+    bool m_lastIndirect = false;
+
+    // CPU time the last Flush took, in milliseconds
+    double m_flushTime = 0;
+
+    // Finds the batch for these, or starts a new one
+    DrawBatch& FindBatch(Mesh* mesh, Material* material, int lod);
+
+    // Points program's instance block at DrawBatchBinding, the first time it's seen.
+    // Returns its id for draw keys
+    unsigned int SetupProgram(GLuint program);
+
+    // Ids for draw keys, handed out the first time each one is seen
+    unsigned int FindTextureSet(const std::vector<Texture*>& textures);
+    unsigned int FindMesh(Mesh* mesh);
+
+    // Puts the batches in draw key order
+    void SortBatches();
+
+    // Takes everything outside the stereo frustum out of the batches, and drops empty batches
+    void CullBatches();
+
+    // One instanced draw call per batch, after a depth only one per batch with a depth material
+    void FlushInstanced();
+
+    // Reads back the timestamps the gpu has gotten to, without waiting for the rest
+    void PollTimers();
+
+    // One multi-draw indirect call per vertex format, index type and primitive. Returns false, without
+    // drawing anything, if the frame uses more than DrawBatchMaxTextures textures
+    bool FlushIndirect();
+
+public:
+    DrawBatcher();
+    ~DrawBatcher();
+
+    // Adds a draw of mesh with material (and the textures it has right now) at worldMatrix.
+    // The level of detail is picked now, see Mesh::SetLodViews
+    void Add(Mesh* mesh, Material* material, const glm::mat4& worldMatrix);
+
+    // Uploads every world matrix, draws every batch, and starts over
+    void Flush();
+
+    // Draws with multi-draw indirect through material's program from now on,
+    // or with one draw per batch if material is nullptr. Materials added with Add
+    // still pick the textures, material only needs its camera matrices set
+    void SetIndirectMaterial(Material* material);
+    bool IsIndirect();
+
+    // Skips objects outside both eyes before they're batched, see frustumCulling.h.
+    // SetCullViews has to be called every frame, before anything is added.
+    // The first view is also the one batches are sorted front to back for
+    void SetCpuCulling(bool enabled);
+    bool IsCpuCulling();
+    void SetCullViews(const glm::mat4& viewProjection1, const glm::mat4& viewProjection2);
+
+    // Draws a depth prepass with material (depthVertex.glsl and depthFragment.glsl, it only needs
+    // its camera matrices set) before shading, or doesn't if it's nullptr. Multi-draw indirect
+    // frames skip it, the prepass and shading have to use the same vertex shader math
+    void SetDepthMaterial(Material* material);
+    bool IsDepthPrepass();
+
+    // Culls multi-draw indirect frames on the gpu with culler, or doesn't if it's nullptr
+    void SetCuller(GpuCuller* culler);
+    bool IsCulling();
+
+    // True if the gpu can do the multi-draw indirect path (OpenGL 4.3 and ARB_shader_draw_parameters)
+    static bool IndirectSupported();
+
+    // Draws asked for with Add (that weren't culled on the CPU), and the draw calls they were made with, in the last Flush
+    unsigned int GetObjectCount();
+    unsigned int GetDrawCount();
+
+    // Prints the draw calls made in the last Flush, compared to one per Add, how long
+    // it took the CPU to submit them, and the program and texture switches it took.
+    // Then the gpu time of the scene pass with and without the depth prepass, and the difference
+    void PrintStats();
+};
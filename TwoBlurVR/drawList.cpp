@@ -0,0 +1,207 @@
+/*
+Title: Blur Optimization VR
+File Name: drawList.cpp
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "drawList.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+static uint64_t KeyField(unsigned int value, int bits, int shift)
+{
+    return ((uint64_t)value & ((1ull << bits) - 1)) << shift;
+}
+
+uint64_t MakeDrawKey(unsigned int renderTarget, unsigned int program, unsigned int textureSet, unsigned int mesh, float depth)
+{
+    // A positive float's bits sort the same way the float does, so
+    // the top bits of it are a depth that works at any distance
+    uint32_t depthBits = 0;
+    if (depth > 0)
+        memcpy(&depthBits, &depth, sizeof(depthBits));
+
+    return KeyField(renderTarget, DrawKeyTargetBits, DrawKeyTargetShift) |
+           KeyField(program, DrawKeyProgramBits, DrawKeyProgramShift) |
+           KeyField(textureSet, DrawKeyTextureBits, DrawKeyTextureShift) |
+           KeyField(mesh, DrawKeyMeshBits, DrawKeyMeshShift) |
+           KeyField(depthBits >> (31 - DrawKeyDepthBits), DrawKeyDepthBits, DrawKeyDepthShift);
+}
+
+unsigned int GetDrawKeyTarget(uint64_t key)
+{
+    return (unsigned int)((key >> DrawKeyTargetShift) & ((1ull << DrawKeyTargetBits) - 1));
+}
+
+unsigned int GetDrawKeyProgram(uint64_t key)
+{
+    return (unsigned int)((key >> DrawKeyProgramShift) & ((1ull << DrawKeyProgramBits) - 1));
+}
+
+unsigned int GetDrawKeyTextureSet(uint64_t key)
+{
+    return (unsigned int)((key >> DrawKeyTextureShift) & ((1ull << DrawKeyTextureBits) - 1));
+}
+
+unsigned int GetDrawKeyMesh(uint64_t key)
+{
+    return (unsigned int)((key >> DrawKeyMeshShift) & ((1ull << DrawKeyMeshBits) - 1));
+}
+
+void DrawList::Clear()
+{
+    m_items.clear();
+}
+
+void DrawList::Add(uint64_t key, unsigned int index)
+{
+    DrawListItem item = { key, index };
+    m_items.push_back(item);
+}
+
+void DrawList::Sort()
+{
+    size_t count = m_items.size();
+    if (count < 2)
+        return;
+
+    // Count every byte of every key in one pass, so each
+    // sorting pass already knows where its buckets start
+    unsigned int histograms[8][256];
+    memset(histograms, 0, sizeof(histograms));
+    for (size_t i = 0; i < count; i++)
+    {
+        uint64_t key = m_items[i].key;
+        for (int pass = 0; pass < 8; pass++)
+            histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+    }
+
+    m_scratch.resize(count);
+    DrawListItem* from = m_items.data();
+    DrawListItem* to = m_scratch.data();
+    for (int pass = 0; pass < 8; pass++)
+    {
+        // All the keys have the same byte here, so this pass wouldn't move anything
+        unsigned int* histogram = histograms[pass];
+        if (histogram[(from[0].key >> (pass * 8)) & 0xFF] == count)
+            continue;
+
+        unsigned int offsets[256];
+        unsigned int offset = 0;
+        for (int b = 0; b < 256; b++)
+        {
+            offsets[b] = offset;
+            offset += histogram[b];
+        }
+
+        // Going through in order keeps equal bytes in the order the last pass left them
+        for (size_t i = 0; i < count; i++)
+            to[offsets[(from[i].key >> (pass * 8)) & 0xFF]++] = from[i];
+        std::swap(from, to);
+    }
+
+    if (from != m_items.data())
+        m_items.swap(m_scratch);
+}
+
+unsigned int DrawList::GetCount() const
+{
+    return (unsigned int)m_items.size();
+}
+
+const std::vector<DrawListItem>& DrawList::GetItems() const
+{
+    return m_items;
+}
+
+DrawStateChanges DrawList::CountStateChanges() const
+{
+    DrawStateChanges changes;
+    for (size_t i = 0; i < m_items.size(); i++)
+    {
+        uint64_t key = m_items[i].key;
+        uint64_t last = i > 0 ? m_items[i - 1].key : ~key;
+        changes.renderTargets += GetDrawKeyTarget(key) != GetDrawKeyTarget(last);
+        changes.programs += GetDrawKeyProgram(key) != GetDrawKeyProgram(last);
+        changes.textureSets += GetDrawKeyTextureSet(key) != GetDrawKeyTextureSet(last);
+        changes.meshes += GetDrawKeyMesh(key) != GetDrawKeyMesh(last);
+    }
+    return changes;
+}
+
+void BenchmarkDrawList()
+{
+    const unsigned int drawCount = 10000;
+    const int repeats = 20;
+
+    // Each draw is one of a few hundred kinds of object, each with its own program, textures and
+    // mesh, some in a shadow map and some on screen, at any distance, added in no particular order
+    std::mt19937 random(12345);
+    std::uniform_int_distribution<unsigned int> kind(0, 511);
+    std::uniform_int_distribution<unsigned int> target(0, 1);
+    std::uniform_real_distribution<float> depth(0.1f, 100.0f);
+
+    DrawList list;
+    for (unsigned int i = 0; i < drawCount; i++)
+    {
+        unsigned int k = kind(random);
+        list.Add(MakeDrawKey(target(random), k % 4, k % 64, k % 128, depth(random)), i);
+    }
+    DrawStateChanges unsorted = list.CountStateChanges();
+    std::vector<DrawListItem> items = list.GetItems();
+
+    double radixMs = 1e30, stdMs = 1e30;
+    for (int r = 0; r < repeats; r++)
+    {
+        DrawList copy;
+        for (const DrawListItem& item : items)
+            copy.Add(item.key, item.index);
+        auto start = std::chrono::high_resolution_clock::now();
+        copy.Sort();
+        radixMs = std::min(radixMs, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+        list = copy;
+
+        std::vector<DrawListItem> sorted = items;
+        start = std::chrono::high_resolution_clock::now();
+        std::stable_sort(sorted.begin(), sorted.end(), [](const DrawListItem& a, const DrawListItem& b) { return a.key < b.key; });
+        stdMs = std::min(stdMs, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+
+        // Both sorts have to agree, including the order of equal keys
+        for (unsigned int i = 0; i < drawCount; i++)
+        {
+            if (sorted[i].index != list.GetItems()[i].index)
+            {
+                printf("Draw list: radix sort and std::stable_sort disagree at %u\n", i);
+                break;
+            }
+        }
+    }
+    DrawStateChanges sorted = list.CountStateChanges();
+
+    printf("\nDraw list benchmark (%u draws, best of %d)\n", drawCount, repeats);
+    printf("%-24s %10s %10s %10s %10s\n", "", "targets", "programs", "textures", "meshes");
+    printf("%-24s %10u %10u %10u %10u\n", "in the order added", unsorted.renderTargets, unsorted.programs, unsorted.textureSets, unsorted.meshes);
+    printf("%-24s %10u %10u %10u %10u\n", "sorted by key", sorted.renderTargets, sorted.programs, sorted.textureSets, sorted.meshes);
+    printf("radix sort %.3f ms, std::stable_sort %.3f ms (%.2fx)\n", radixMs, stdMs, stdMs / radixMs);
+}
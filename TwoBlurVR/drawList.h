@@ -0,0 +1,101 @@
+/*
+Title: Blur Optimization VR
+File Name: drawList.h
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// How many bits each part of a draw key gets, from the most significant down.
+// Draws sort by render target first, then program, texture set, mesh, and finally
+// depth, so the expensive switches happen least and draws of one mesh go front to back
+#define DrawKeyTargetBits 4
+#define DrawKeyProgramBits 8
+#define DrawKeyTextureBits 16
+#define DrawKeyMeshBits 12
+#define DrawKeyDepthBits 24
+
+#define DrawKeyDepthShift 0
+#define DrawKeyMeshShift (DrawKeyDepthShift + DrawKeyDepthBits)
+#define DrawKeyTextureShift (DrawKeyMeshShift + DrawKeyMeshBits)
+#define DrawKeyProgramShift (DrawKeyTextureShift + DrawKeyTextureBits)
+#define DrawKeyTargetShift (DrawKeyProgramShift + DrawKeyProgramBits)
+
+// Packs one draw's state into a key. The ids are small numbers handed out by whoever builds
+// the list, and are cut down to their bits. depth is how far away the draw is (view space,
+// or clip w), anything from 0 up, and keeps its order without needing a far plane
+uint64_t MakeDrawKey(unsigned int renderTarget, unsigned int program, unsigned int textureSet, unsigned int mesh, float depth);
+
+// The parts of a key, for an executor to compare against what it drew last
+unsigned int GetDrawKeyTarget(uint64_t key);
+unsigned int GetDrawKeyProgram(uint64_t key);
+unsigned int GetDrawKeyTextureSet(uint64_t key);
+unsigned int GetDrawKeyMesh(uint64_t key);
+
+// One submission: its key, and which draw it is in whatever the caller keeps them in
+struct DrawListItem
+{
+    uint64_t key;
+    unsigned int index;
+};
+
+// How many times each kind of state changes, drawing a list in order.
+// The first draw counts as a change of everything
+struct DrawStateChanges
+{
+    unsigned int renderTargets = 0;
+    unsigned int programs = 0;
+    unsigned int textureSets = 0;
+    unsigned int meshes = 0;
+};
+
+// A frame's draws, sorted by their keys with a radix sort. The sort goes 8 bits at a time
+// from the bottom, and skips any 8 bits that every key has the same, which in a real scene
+// is most of the top half. Draws with the same key stay in the order they were added.
+//
+// The list only orders draws. Replaying it is up to the caller: walk GetItems, and only
+// change the state a key says is different from the last one (see CountStateChanges).
+class DrawList
+{
+
+private:
+    std::vector<DrawListItem> m_items;
+    std::vector<DrawListItem> m_scratch;
+
+public:
+    void Clear();
+    void Add(uint64_t key, unsigned int index);
+
+    // Sorts by key, lowest first
+    void Sort();
+
+    unsigned int GetCount() const;
+    const std::vector<DrawListItem>& GetItems() const;
+
+    // State changes drawing the list in its current order
+    DrawStateChanges CountStateChanges() const;
+};
+
+// Sorts 10k made up draws (2 render targets, 4 programs, 64 texture sets, 128 meshes),
+// and prints the state changes before and after, and how long the radix sort takes against std::sort
+void BenchmarkDrawList();
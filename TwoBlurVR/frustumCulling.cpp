@@ -0,0 +1,398 @@
+/*
+Title: Blur Optimization VR
+File Name: frustumCulling.cpp
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "frustumCulling.h"
+#include "glm/gtc/matrix_transform.hpp"
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define CullUseSSE 1
+#else
+#define CullUseSSE 0
+#endif
+
+// MSVC defines __AVX__ with /arch:AVX or /arch:AVX2
+#if defined(__AVX__)
+#include <immintrin.h>
+#define CullUseAVX 1
+#else
+#define CullUseAVX 0
+#endif
+
+void CullBounds::Clear()
+{
+    centerX.clear();
+    centerY.clear();
+    centerZ.clear();
+    radius.clear();
+    minX.clear();
+    minY.clear();
+    minZ.clear();
+    maxX.clear();
+    maxY.clear();
+    maxZ.clear();
+}
+
+unsigned int CullBounds::GetCount() const
+{
+    return (unsigned int)radius.size();
+}
+
+unsigned int CullBounds::Add(const glm::vec3& center, float sphereRadius, const glm::vec3& boxMin, const glm::vec3& boxMax)
+{
+    centerX.push_back(center.x);
+    centerY.push_back(center.y);
+    centerZ.push_back(center.z);
+    radius.push_back(sphereRadius);
+    minX.push_back(boxMin.x);
+    minY.push_back(boxMin.y);
+    minZ.push_back(boxMin.z);
+    maxX.push_back(boxMax.x);
+    maxY.push_back(boxMax.y);
+    maxZ.push_back(boxMax.z);
+    return GetCount() - 1;
+}
+
+unsigned int CullBounds::AddTransformed(const glm::mat4& worldMatrix, const glm::vec3& center, float sphereRadius,
+                                        const glm::vec3& boxMin, const glm::vec3& boxMax)
+{
+    glm::vec3 worldCenter = glm::vec3(worldMatrix * glm::vec4(center, 1));
+    float scale = glm::max(glm::length(glm::vec3(worldMatrix[0])), glm::max(glm::length(glm::vec3(worldMatrix[1])), glm::length(glm::vec3(worldMatrix[2]))));
+
+    glm::vec3 worldMin, worldMax;
+    TransformBox(worldMatrix, boxMin, boxMax, worldMin, worldMax);
+
+    return Add(worldCenter, sphereRadius * scale, worldMin, worldMax);
+}
+
+void TransformBox(const glm::mat4& worldMatrix, const glm::vec3& boxMin, const glm::vec3& boxMax,
+                  glm::vec3& worldMin, glm::vec3& worldMax)
+{
+    // Each world axis of the box is the translation, plus the smallest and biggest
+    // each model axis can add to it (Arvo, "Transforming Axis-Aligned Bounding Boxes")
+    worldMin = glm::vec3(worldMatrix[3]);
+    worldMax = worldMin;
+    for (int column = 0; column < 3; column++)
+    {
+        for (int row = 0; row < 3; row++)
+        {
+            float a = worldMatrix[column][row] * boxMin[column];
+            float b = worldMatrix[column][row] * boxMax[column];
+            worldMin[row] += glm::min(a, b);
+            worldMax[row] += glm::max(a, b);
+        }
+    }
+}
+
+CullFrustum MakeFrustum(const glm::mat4& viewProjection)
+{
+    // Each plane is the last row of the matrix plus or minus one of the others
+    // (Gribb and Hartmann, "Fast Extraction of Viewing Frustum Planes"). glm stores columns
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++)
+        rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+    CullFrustum frustum;
+    frustum.planes[0] = rows[3] + rows[0];
+    frustum.planes[1] = rows[3] - rows[0];
+    frustum.planes[2] = rows[3] + rows[1];
+    frustum.planes[3] = rows[3] - rows[1];
+    frustum.planes[4] = rows[3] + rows[2];
+    frustum.planes[5] = rows[3] - rows[2];
+
+    // Unit normals, so plane distances are real distances and can be compared to sphere radii
+    for (int i = 0; i < 6; i++)
+        frustum.planes[i] /= glm::length(glm::vec3(frustum.planes[i]));
+
+    return frustum;
+}
+
+// The 8 corners of a camera's frustum, in world space
+static void FrustumCorners(const glm::mat4& viewProjection, glm::vec3* corners)
+{
+    glm::mat4 inverse = glm::inverse(viewProjection);
+    for (int i = 0; i < 8; i++)
+    {
+        glm::vec4 ndc = glm::vec4((i & 1) ? 1 : -1, (i & 2) ? 1 : -1, (i & 4) ? 1 : -1, 1);
+        glm::vec4 world = inverse * ndc;
+        corners[i] = glm::vec3(world) / world.w;
+    }
+}
+
+CullFrustum MakeStereoFrustum(const glm::mat4& viewProjection1, const glm::mat4& viewProjection2)
+{
+    CullFrustum frustum1 = MakeFrustum(viewProjection1);
+    CullFrustum frustum2 = MakeFrustum(viewProjection2);
+
+    glm::vec3 corners[16];
+    FrustumCorners(viewProjection1, corners);
+    FrustumCorners(viewProjection2, corners + 8);
+
+    CullFrustum stereo;
+    for (int i = 0; i < 6; i++)
+    {
+        glm::vec3 normal = glm::normalize(glm::vec3(frustum1.planes[i]) + glm::vec3(frustum2.planes[i]));
+
+        // Far enough out that every corner of both frustums is inside
+        float distance = -glm::dot(normal, corners[0]);
+        for (int j = 1; j < 16; j++)
+            distance = glm::max(distance, -glm::dot(normal, corners[j]));
+
+        stereo.planes[i] = glm::vec4(normal, distance);
+    }
+
+    return stereo;
+}
+
+// For each plane, the box corner furthest along its normal comes from the max array
+// where the normal is positive and the min array where it's negative. The normal is
+// the same for every object, so this is picked once per plane instead of per object
+struct PlaneCorners
+{
+    const float* x;
+    const float* y;
+    const float* z;
+};
+
+static void PickPlaneCorners(const CullFrustum& frustum, const CullBounds& bounds, PlaneCorners* corners)
+{
+    for (int p = 0; p < 6; p++)
+    {
+        const glm::vec4& plane = frustum.planes[p];
+        corners[p].x = plane.x > 0 ? bounds.maxX.data() : bounds.minX.data();
+        corners[p].y = plane.y > 0 ? bounds.maxY.data() : bounds.minY.data();
+        corners[p].z = plane.z > 0 ? bounds.maxZ.data() : bounds.minZ.data();
+    }
+}
+
+static bool CullOne(const CullFrustum& frustum, const CullBounds& bounds, const PlaneCorners* corners, unsigned int i)
+{
+    for (int p = 0; p < 6; p++)
+    {
+        const glm::vec4& plane = frustum.planes[p];
+
+        // The whole sphere is behind the plane
+        float sphere = plane.x * bounds.centerX[i] + plane.y * bounds.centerY[i] + plane.z * bounds.centerZ[i] + plane.w;
+        if (sphere < -bounds.radius[i])
+            return false;
+
+        // Even the box's furthest corner is behind the plane
+        float box = plane.x * corners[p].x[i] + plane.y * corners[p].y[i] + plane.z * corners[p].z[i] + plane.w;
+        if (box < 0)
+            return false;
+    }
+    return true;
+}
+
+unsigned int CullObjectsScalar(const CullFrustum& frustum, const CullBounds& bounds, unsigned char* visible)
+{
+    PlaneCorners corners[6];
+    PickPlaneCorners(frustum, bounds, corners);
+
+    unsigned int visibleCount = 0;
+    unsigned int count = bounds.GetCount();
+    for (unsigned int i = 0; i < count; i++)
+    {
+        visible[i] = CullOne(frustum, bounds, corners, i) ? 1 : 0;
+        visibleCount += visible[i];
+    }
+    return visibleCount;
+}
+
+unsigned int CullObjects(const CullFrustum& frustum, const CullBounds& bounds, unsigned char* visible)
+{
+    PlaneCorners corners[6];
+    PickPlaneCorners(frustum, bounds, corners);
+
+    unsigned int visibleCount = 0;
+    unsigned int count = bounds.GetCount();
+    unsigned int i = 0;
+
+#if CullUseAVX
+    {
+        __m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+        for (int p = 0; p < 6; p++)
+        {
+            planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+            planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+            planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+            planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+        }
+
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256 centerX = _mm256_loadu_ps(&bounds.centerX[i]);
+            __m256 centerY = _mm256_loadu_ps(&bounds.centerY[i]);
+            __m256 centerZ = _mm256_loadu_ps(&bounds.centerZ[i]);
+            __m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&bounds.radius[i]));
+
+            // All bits set in a lane while that object is still inside every plane so far
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (int p = 0; p < 6; p++)
+            {
+                __m256 sphere = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planeX[p], centerX), _mm256_mul_ps(planeY[p], centerY)),
+                    _mm256_add_ps(_mm256_mul_ps(planeZ[p], centerZ), planeW[p]));
+                __m256 box = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planeX[p], _mm256_loadu_ps(corners[p].x + i)), _mm256_mul_ps(planeY[p], _mm256_loadu_ps(corners[p].y + i))),
+                    _mm256_add_ps(_mm256_mul_ps(planeZ[p], _mm256_loadu_ps(corners[p].z + i)), planeW[p]));
+
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(sphere, negativeRadius, _CMP_GE_OQ));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(box, _mm256_setzero_ps(), _CMP_GE_OQ));
+            }
+
+            int mask = _mm256_movemask_ps(inside);
+            for (int lane = 0; lane < 8; lane++)
+            {
+                visible[i + lane] = (mask >> lane) & 1;
+                visibleCount += visible[i + lane];
+            }
+        }
+    }
+#endif
+
+#if CullUseSSE
+    {
+        __m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+        for (int p = 0; p < 6; p++)
+        {
+            planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+            planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+            planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+            planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+        }
+
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 centerX = _mm_loadu_ps(&bounds.centerX[i]);
+            __m128 centerY = _mm_loadu_ps(&bounds.centerY[i]);
+            __m128 centerZ = _mm_loadu_ps(&bounds.centerZ[i]);
+            __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&bounds.radius[i]));
+
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int p = 0; p < 6; p++)
+            {
+                __m128 sphere = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], centerX), _mm_mul_ps(planeY[p], centerY)),
+                    _mm_add_ps(_mm_mul_ps(planeZ[p], centerZ), planeW[p]));
+                __m128 box = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], _mm_loadu_ps(corners[p].x + i)), _mm_mul_ps(planeY[p], _mm_loadu_ps(corners[p].y + i))),
+                    _mm_add_ps(_mm_mul_ps(planeZ[p], _mm_loadu_ps(corners[p].z + i)), planeW[p]));
+
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(sphere, negativeRadius));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(box, _mm_setzero_ps()));
+            }
+
+            int mask = _mm_movemask_ps(inside);
+            for (int lane = 0; lane < 4; lane++)
+            {
+                visible[i + lane] = (mask >> lane) & 1;
+                visibleCount += visible[i + lane];
+            }
+        }
+    }
+#endif
+
+    // Whatever doesn't fill a whole register
+    for (; i < count; i++)
+    {
+        visible[i] = CullOne(frustum, bounds, corners, i) ? 1 : 0;
+        visibleCount += visible[i];
+    }
+
+    return visibleCount;
+}
+
+// Best time of repeats runs of cull, in milliseconds
+template <typename F>
+static double TimeCulling(int repeats, F cull)
+{
+    double best = 1e30;
+    for (int r = 0; r < repeats; r++)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        cull();
+        best = glm::min(best, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+    }
+    return best;
+}
+
+void BenchmarkFrustumCulling()
+{
+    const unsigned int objectCount = 100000;
+    const int repeats = 20;
+
+    // Two eyes like main.cpp's, a little apart and turned slightly toward each other
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 0.9f, 0.1f, 100.0f);
+    glm::mat4 view1 = glm::lookAt(glm::vec3(-0.03f, 0, 0), glm::vec3(0, 0, -10), glm::vec3(0, 1, 0));
+    glm::mat4 view2 = glm::lookAt(glm::vec3(0.03f, 0, 0), glm::vec3(0, 0, -10), glm::vec3(0, 1, 0));
+    glm::mat4 viewProjection1 = projection * view1;
+    glm::mat4 viewProjection2 = projection * view2;
+
+    // Objects scattered all around the cameras, a box inside every sphere
+    std::mt19937 random(12345);
+    std::uniform_real_distribution<float> position(-120.0f, 120.0f);
+    std::uniform_real_distribution<float> size(0.2f, 4.0f);
+    std::uniform_real_distribution<float> fraction(0.2f, 0.57f);
+
+    CullBounds bounds;
+    for (unsigned int i = 0; i < objectCount; i++)
+    {
+        glm::vec3 center = glm::vec3(position(random), position(random), position(random));
+        float radius = size(random);
+        glm::vec3 extent = glm::vec3(fraction(random), fraction(random), fraction(random)) * radius;
+        bounds.Add(center, radius, center - extent, center + extent);
+    }
+
+    CullFrustum stereo = MakeStereoFrustum(viewProjection1, viewProjection2);
+    CullFrustum eye1 = MakeFrustum(viewProjection1);
+    CullFrustum eye2 = MakeFrustum(viewProjection2);
+
+    std::vector<unsigned char> scalarVisible(objectCount), simdVisible(objectCount);
+    std::vector<unsigned char> visible1(objectCount), visible2(objectCount);
+    unsigned int scalarCount = 0, simdCount = 0;
+
+    double eyesMs = TimeCulling(repeats, [&]() { CullObjectsScalar(eye1, bounds, visible1.data()); CullObjectsScalar(eye2, bounds, visible2.data()); });
+    double scalarMs = TimeCulling(repeats, [&]() { scalarCount = CullObjectsScalar(stereo, bounds, scalarVisible.data()); });
+    double simdMs = TimeCulling(repeats, [&]() { simdCount = CullObjects(stereo, bounds, simdVisible.data()); });
+
+    // The stereo frustum must keep everything either eye keeps
+    unsigned int mismatches = 0, missed = 0, eitherEye = 0;
+    for (unsigned int i = 0; i < objectCount; i++)
+    {
+        mismatches += scalarVisible[i] != simdVisible[i];
+        bool seen = visible1[i] || visible2[i];
+        eitherEye += seen;
+        missed += seen && !simdVisible[i];
+    }
+
+    const char* simdName = CullUseAVX ? "AVX, 8 at a time" : (CullUseSSE ? "SSE, 4 at a time" : "no SIMD");
+    printf("\nFrustum culling benchmark (%u objects, best of %d)\n", objectCount, repeats);
+    printf("%-32s %10s %14s %10s\n", "", "ms", "objects/ms", "visible");
+    printf("%-32s %10.3f %14.0f %10u\n", "each eye, one at a time", eyesMs, objectCount / eyesMs, eitherEye);
+    printf("%-32s %10.3f %14.0f %10u\n", "stereo frustum, one at a time", scalarMs, objectCount / scalarMs, scalarCount);
+    printf("%-32s %10.3f %14.0f %10u\n", simdName, simdMs, objectCount / simdMs, simdCount);
+    printf("SIMD speedup %.2fx over scalar, %.2fx over testing each eye\n", scalarMs / simdMs, eyesMs / simdMs);
+    printf("SIMD and scalar disagree on %u, stereo frustum culled %u that an eye can see, kept %u that no eye can\n",
+        mismatches, missed, simdCount - (eitherEye - missed));
+}
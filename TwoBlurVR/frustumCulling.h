@@ -0,0 +1,89 @@
+/*
+Title: Blur Optimization VR
+File Name: frustumCulling.h
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "glm/glm.hpp"
+#include <vector>
+
+// Six planes, left right bottom top near far. Each one is (normal, distance),
+// and a point p is on the inside when dot(normal, p) + distance >= 0
+struct CullFrustum
+{
+    glm::vec4 planes[6];
+};
+
+// World space bounds of many objects, with each value in its own array (structure of arrays),
+// so 4 or 8 objects' worth of one value load straight into one SSE or AVX register
+struct CullBounds
+{
+    // Bounding spheres
+    std::vector<float> centerX;
+    std::vector<float> centerY;
+    std::vector<float> centerZ;
+    std::vector<float> radius;
+
+    // Bounding boxes
+    std::vector<float> minX;
+    std::vector<float> minY;
+    std::vector<float> minZ;
+    std::vector<float> maxX;
+    std::vector<float> maxY;
+    std::vector<float> maxZ;
+
+    void Clear();
+    unsigned int GetCount() const;
+
+    // Adds an object that's already in world space, returns its index
+    unsigned int Add(const glm::vec3& center, float sphereRadius, const glm::vec3& boxMin, const glm::vec3& boxMax);
+
+    // Adds an object from its model space bounds. The sphere grows by the biggest scale in
+    // worldMatrix, and the box is the world space box around the transformed model box
+    unsigned int AddTransformed(const glm::mat4& worldMatrix, const glm::vec3& center, float sphereRadius,
+                                const glm::vec3& boxMin, const glm::vec3& boxMax);
+};
+
+// The world space box around a model space box, after worldMatrix moves, turns and scales it
+void TransformBox(const glm::mat4& worldMatrix, const glm::vec3& boxMin, const glm::vec3& boxMax,
+                  glm::vec3& worldMin, glm::vec3& worldMax);
+
+// The frustum of one camera (projection * view)
+CullFrustum MakeFrustum(const glm::mat4& viewProjection);
+
+// One frustum that holds the frustums of both eyes, so an object only has to be tested once.
+// Each plane points halfway between the two eyes' matching planes, and is pushed out
+// until the corners of both frustums are inside it. That's never tighter than either
+// eye, so nothing either eye could see is ever culled
+CullFrustum MakeStereoFrustum(const glm::mat4& viewProjection1, const glm::mat4& viewProjection2);
+
+// Tests every object's sphere and box against frustum, visible[i] becomes 1 if object i
+// might be inside, 0 if it's definitely outside. Returns how many are visible.
+// Runs 8 objects at a time with AVX (if the compiler targets it), otherwise 4 at a time with SSE
+unsigned int CullObjects(const CullFrustum& frustum, const CullBounds& bounds, unsigned char* visible);
+
+// Same result, one object at a time, to compare against
+unsigned int CullObjectsScalar(const CullFrustum& frustum, const CullBounds& bounds, unsigned char* visible);
+
+// Times both on 100k random objects, checks they agree, and that
+// the stereo frustum never culls anything either eye can see
+void BenchmarkFrustumCulling();
@@ -0,0 +1,411 @@
+/*
+Title: Blur Optimization VR
+File Name: geometryArena.cpp
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "geometryArena.h"
+#include <algorithm>
+#include <cstdio>
+
+// What the shared arena starts with, enough for every model in Assets
+#define ArenaVertexCapacity (16 * 1024 * 1024)
+#define ArenaIndexCapacity (8 * 1024 * 1024)
+
+// The smallest staging buffer, it grows for meshes that don't fit
+#define ArenaStagingCapacity (4 * 1024 * 1024)
+
+// ========== RangeAllocator ==========
+
+RangeAllocator::RangeAllocator(size_t capacity)
+{
+    m_capacity = capacity;
+    if (capacity > 0)
+        m_free[0] = capacity;
+}
+
+bool RangeAllocator::Allocate(size_t size, size_t alignment, ArenaAllocation& allocation)
+{
+    if (size == 0)
+    {
+        allocation = ArenaAllocation();
+        return true;
+    }
+
+    // First fit, lowest offsets first, which keeps the used space packed at the start
+    for (auto it = m_free.begin(); it != m_free.end(); ++it)
+    {
+        size_t start = it->first;
+        size_t end = it->first + it->second;
+        size_t aligned = (start + alignment - 1) / alignment * alignment;
+        if (aligned + size > end)
+            continue;
+
+        // Whatever is left before and after the new range stays free
+        m_free.erase(it);
+        if (aligned > start)
+            m_free[start] = aligned - start;
+        if (aligned + size < end)
+            m_free[aligned + size] = end - (aligned + size);
+
+        allocation.offset = aligned;
+        allocation.size = size;
+        m_used += size;
+        m_allocationCount++;
+        return true;
+    }
+
+    return false;
+}
+
+void RangeAllocator::Free(const ArenaAllocation& allocation)
+{
+    if (allocation.size == 0)
+        return;
+
+    size_t start = allocation.offset;
+    size_t size = allocation.size;
+    m_used -= size;
+    m_allocationCount--;
+
+    // Merge with the free range after this one
+    auto next = m_free.find(start + size);
+    if (next != m_free.end())
+    {
+        size += next->second;
+        m_free.erase(next);
+    }
+
+    // And the one before
+    auto after = m_free.lower_bound(start);
+    if (after != m_free.begin())
+    {
+        auto previous = std::prev(after);
+        if (previous->first + previous->second == start)
+        {
+            previous->second += size;
+            return;
+        }
+    }
+
+    m_free[start] = size;
+}
+
+void RangeAllocator::Grow(size_t capacity)
+{
+    if (capacity <= m_capacity)
+        return;
+
+    ArenaAllocation added;
+    added.offset = m_capacity;
+    added.size = capacity - m_capacity;
+    m_capacity = capacity;
+
+    // Freeing the new space merges it with any free space at the old end
+    m_used += added.size;
+    m_allocationCount++;
+    Free(added);
+}
+
+size_t RangeAllocator::GetCapacity()
+{
+    return m_capacity;
+}
+
+ArenaStats RangeAllocator::GetStats()
+{
+    ArenaStats stats;
+    stats.capacity = m_capacity;
+    stats.used = m_used;
+    stats.allocationCount = m_allocationCount;
+    stats.freeBlockCount = (unsigned int)m_free.size();
+    stats.largestFreeBlock = 0;
+
+    size_t totalFree = 0;
+    for (auto& range : m_free)
+    {
+        stats.largestFreeBlock = std::max(stats.largestFreeBlock, range.second);
+        totalFree += range.second;
+    }
+
+    stats.fragmentation = totalFree > 0 ? 1.0f - (float)stats.largestFreeBlock / totalFree : 0.0f;
+    return stats;
+}
+
+// ========== GeometryArena ==========
+
+GeometryArena::GeometryArena(size_t vertexCapacity, size_t indexCapacity) :
+    m_vertexRanges(0), m_indexRanges(0)
+{
+    GrowBuffer(m_vertexBuffer, m_vertexRanges, vertexCapacity);
+    GrowBuffer(m_indexBuffer, m_indexRanges, indexCapacity);
+}
+
+GeometryArena::~GeometryArena()
+{
+    Release();
+}
+
+void GeometryArena::Release()
+{
+    if (m_released)
+        return;
+    m_released = true;
+
+    // Deleting the staging buffer also unmaps it
+    glDeleteBuffers(1, &m_vertexBuffer);
+    glDeleteBuffers(1, &m_indexBuffer);
+    glDeleteBuffers(1, &m_stagingBuffer);
+    if (m_stagingFence != 0)
+        glDeleteSync(m_stagingFence);
+
+    m_vertexBuffer = 0;
+    m_indexBuffer = 0;
+    m_stagingBuffer = 0;
+    m_stagingMapping = nullptr;
+    m_stagingFence = 0;
+}
+
+void GeometryArena::GrowBuffer(GLuint& buffer, RangeAllocator& ranges, size_t capacity)
+{
+    GLuint bigger;
+    glGenBuffers(1, &bigger);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, bigger);
+    glBufferData(GL_COPY_WRITE_BUFFER, capacity, NULL, GL_STATIC_DRAW);
+
+    // Copy everything over on the gpu. Offsets don't change, so every mesh's range is still good
+    if (buffer != 0)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, ranges.GetCapacity());
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glDeleteBuffers(1, &buffer);
+
+        printf("Geometry arena grew from %.1f MB to %.1f MB\n", ranges.GetCapacity() / (1024.0 * 1024.0), capacity / (1024.0 * 1024.0));
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    buffer = bigger;
+    ranges.Grow(capacity);
+}
+
+ArenaAllocation GeometryArena::AllocateVertices(size_t count, size_t stride)
+{
+    ArenaAllocation allocation;
+    size_t size = count * stride;
+
+    // Double until it fits. The alignment can waste up to one vertex at the start
+    while (!m_vertexRanges.Allocate(size, stride, allocation))
+        GrowBuffer(m_vertexBuffer, m_vertexRanges, std::max(m_vertexRanges.GetCapacity() * 2, m_vertexRanges.GetCapacity() + size + stride));
+
+    return allocation;
+}
+
+ArenaAllocation GeometryArena::AllocateIndices(size_t count, size_t indexSize)
+{
+    ArenaAllocation allocation;
+    size_t size = count * indexSize;
+
+    while (!m_indexRanges.Allocate(size, sizeof(unsigned int), allocation))
+        GrowBuffer(m_indexBuffer, m_indexRanges, std::max(m_indexRanges.GetCapacity() * 2, m_indexRanges.GetCapacity() + size));
+
+    return allocation;
+}
+
+// In a staging write, the indices start after the vertices, on a multiple of 4 so any index size lines up
+static size_t StagingIndexOffset(const ArenaAllocation& vertexRange)
+{
+    return (vertexRange.size + 3) / 4 * 4;
+}
+
+bool GeometryArena::PersistentStagingSupported()
+{
+    return GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+}
+
+void GeometryArena::WaitForStaging()
+{
+    if (m_stagingFence == 0)
+        return;
+
+    // The first wait flushes, so the fence is on its way to the gpu and the wait can end
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    while (true)
+    {
+        GLenum status = glClientWaitSync(m_stagingFence, flags, 1000000000);
+        if (status != GL_TIMEOUT_EXPIRED)
+            break;
+        flags = 0;
+    }
+
+    glDeleteSync(m_stagingFence);
+    m_stagingFence = 0;
+}
+
+void GeometryArena::BeginStaging(const ArenaAllocation& vertexRange, const ArenaAllocation& indexRange, void*& vertices, void*& indices)
+{
+    vertices = nullptr;
+    indices = nullptr;
+    size_t size = StagingIndexOffset(vertexRange) + indexRange.size;
+    if (size == 0)
+        return;
+
+    // No room left at the end of the ring, start over at the front once the gpu copied everything out
+    if (m_stagingHead + size > m_stagingCapacity)
+    {
+        WaitForStaging();
+        m_stagingHead = 0;
+    }
+
+    // Bigger than the whole buffer, make a bigger one. Deleting the old one unmaps it
+    if (size > m_stagingCapacity)
+    {
+        glDeleteBuffers(1, &m_stagingBuffer);
+        m_stagingCapacity = std::max(size, std::max(m_stagingCapacity * 2, (size_t)ArenaStagingCapacity));
+        m_stagingPersistent = PersistentStagingSupported();
+        m_stagingMapping = nullptr;
+
+        glGenBuffers(1, &m_stagingBuffer);
+        glBindBuffer(GL_COPY_READ_BUFFER, m_stagingBuffer);
+        if (m_stagingPersistent)
+        {
+            // Coherent, so what the cpu writes is seen by the copies without flushing
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_COPY_READ_BUFFER, m_stagingCapacity, nullptr, flags);
+            m_stagingMapping = (unsigned char*)glMapBufferRange(GL_COPY_READ_BUFFER, 0, m_stagingCapacity, flags);
+            m_stagingPersistent = m_stagingMapping != nullptr;
+        }
+        else
+        {
+            glBufferData(GL_COPY_READ_BUFFER, m_stagingCapacity, nullptr, GL_STREAM_DRAW);
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+
+    unsigned char* base = nullptr;
+    if (m_stagingPersistent)
+    {
+        m_stagingOffset = m_stagingHead;
+        base = m_stagingMapping + m_stagingOffset;
+    }
+    else
+    {
+        // Invalidating the whole buffer lets the driver hand out new
+        // memory if the gpu is still copying out of the old one
+        m_stagingOffset = 0;
+        glBindBuffer(GL_COPY_READ_BUFFER, m_stagingBuffer);
+        base = (unsigned char*)glMapBufferRange(GL_COPY_READ_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+
+    // The next write starts 16 byte aligned, like the start of the buffer
+    m_stagingHead = (m_stagingOffset + size + 15) / 16 * 16;
+
+    if (base != nullptr)
+    {
+        vertices = base;
+        indices = base + StagingIndexOffset(vertexRange);
+    }
+}
+
+bool GeometryArena::EndStaging(const ArenaAllocation& vertexRange, const ArenaAllocation& indexRange)
+{
+    if (StagingIndexOffset(vertexRange) + indexRange.size == 0)
+        return true;
+
+    glBindBuffer(GL_COPY_READ_BUFFER, m_stagingBuffer);
+
+    // Unmapping can fail if the driver lost the memory (a display mode change, for example)
+    if (!m_stagingPersistent && !glUnmapBuffer(GL_COPY_READ_BUFFER))
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        return false;
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_vertexBuffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, m_stagingOffset, vertexRange.offset, vertexRange.size);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_indexBuffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, m_stagingOffset + StagingIndexOffset(vertexRange), indexRange.offset, indexRange.size);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    // The ring can't come back around to this part until the copies are done.
+    // Copies finish in order, so only the newest fence has to be kept
+    if (m_stagingPersistent)
+    {
+        if (m_stagingFence != 0)
+            glDeleteSync(m_stagingFence);
+        m_stagingFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    return true;
+}
+
+void GeometryArena::FreeVertices(const ArenaAllocation& allocation)
+{
+    m_vertexRanges.Free(allocation);
+}
+
+void GeometryArena::FreeIndices(const ArenaAllocation& allocation)
+{
+    m_indexRanges.Free(allocation);
+}
+
+GLuint GeometryArena::GetVertexBuffer()
+{
+    return m_vertexBuffer;
+}
+
+GLuint GeometryArena::GetIndexBuffer()
+{
+    return m_indexBuffer;
+}
+
+ArenaStats GeometryArena::GetVertexStats()
+{
+    return m_vertexRanges.GetStats();
+}
+
+ArenaStats GeometryArena::GetIndexStats()
+{
+    return m_indexRanges.GetStats();
+}
+
+void GeometryArena::PrintStats()
+{
+    const char* names[2] = { "vertex", "index" };
+    ArenaStats stats[2] = { GetVertexStats(), GetIndexStats() };
+
+    for (int i = 0; i < 2; i++)
+    {
+        printf("Geometry arena %s buffer: %.2f of %.2f MB used (%.1f%%), %u allocations, %u free blocks, largest free %.2f MB, fragmentation %.1f%%\n",
+            names[i], stats[i].used / (1024.0 * 1024.0), stats[i].capacity / (1024.0 * 1024.0),
+            stats[i].capacity > 0 ? 100.0 * stats[i].used / stats[i].capacity : 0.0,
+            stats[i].allocationCount, stats[i].freeBlockCount, stats[i].largestFreeBlock / (1024.0 * 1024.0), stats[i].fragmentation * 100);
+    }
+}
+
+GeometryArena& GetGeometryArena()
+{
+    // C++11 makes sure this is only created once, the first mesh to load creates it
+    static GeometryArena arena(ArenaVertexCapacity, ArenaIndexCapacity);
+    return arena;
+}
@@ -0,0 +1,167 @@
+/*
+Title: Blur Optimization VR
+File Name: geometryArena.h
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "GL/glew.h"
+#include <map>
+
+// A range of bytes in one of the arena's buffers. size 0 means nothing was allocated
+struct ArenaAllocation
+{
+    size_t offset = 0;
+    size_t size = 0;
+};
+
+// How full one of the arena's buffers is
+struct ArenaStats
+{
+    size_t capacity;
+    size_t used;
+    unsigned int allocationCount;
+
+    // Free space between allocations, and the biggest single piece of it
+    unsigned int freeBlockCount;
+    size_t largestFreeBlock;
+
+    // 0 when all the free space is in one piece, close to 1 when it's
+    // split into lots of small pieces that big meshes won't fit in
+    float fragmentation;
+};
+
+// Hands out ranges of a block of memory, and takes them back, using a list of the free ranges.
+// A new range goes in the first free range it fits, and freed ranges merge with free neighbours.
+// This only does the bookkeeping, it never touches the memory itself.
+class RangeAllocator
+{
+
+private:
+    // Free ranges, offset -> size, sorted by offset so neighbours are easy to find
+    std::map<size_t, size_t> m_free;
+    size_t m_capacity;
+    size_t m_used = 0;
+    unsigned int m_allocationCount = 0;
+
+public:
+    RangeAllocator(size_t capacity);
+
+    // Finds size bytes starting on a multiple of alignment (which doesn't have to be a power of 2).
+    // Returns false if there isn't a free range big enough
+    bool Allocate(size_t size, size_t alignment, ArenaAllocation& allocation);
+
+    // Gives a range from Allocate back
+    void Free(const ArenaAllocation& allocation);
+
+    // Adds free space to the end
+    void Grow(size_t capacity);
+
+    size_t GetCapacity();
+    ArenaStats GetStats();
+};
+
+// Every mesh's vertices and indices, in one big vertex buffer and one big index buffer.
+// Meshes draw from their own range with a base vertex and first index, so switching
+// meshes doesn't mean switching buffers. The vertex array objects in renderState.h
+// point at both buffers, and draws of different meshes can be batched together.
+//
+// Vertices of any size can share the vertex buffer: every mesh's range starts on
+// a multiple of its own vertex size, so the base vertex is just offset / stride.
+//
+// Meshes made on the cpu (see proceduralMesh.h) can be written straight into a staging
+// buffer and copied into the arena on the gpu, so the cpu writes every byte once.
+// With OpenGL 4.4 (or ARB_buffer_storage) the staging buffer is mapped once, persistently,
+// and used as a ring, with a fence so nothing gets written over before the gpu copied it.
+// Without it, the staging buffer is mapped for each write instead. The arena buffers
+// themselves are never mapped persistently, drivers can move those into slower memory.
+class GeometryArena
+{
+
+private:
+    GLuint m_vertexBuffer = 0;
+    GLuint m_indexBuffer = 0;
+    RangeAllocator m_vertexRanges;
+    RangeAllocator m_indexRanges;
+
+    // The staging buffer, where the next write goes in it, and a fence
+    // after the last copy out of it. The mapping is only kept when persistent
+    GLuint m_stagingBuffer = 0;
+    size_t m_stagingCapacity = 0;
+    size_t m_stagingHead = 0;
+    size_t m_stagingOffset = 0;
+    unsigned char* m_stagingMapping = nullptr;
+    GLsync m_stagingFence = 0;
+    bool m_stagingPersistent = false;
+
+    // True once Release has deleted the buffers
+    bool m_released = false;
+
+    // Waits until the gpu copied everything out of the staging buffer
+    void WaitForStaging();
+
+    // Makes buffer (on target) at least capacity bytes, keeping everything in it
+    void GrowBuffer(GLuint& buffer, RangeAllocator& ranges, size_t capacity);
+
+public:
+    // Sizes in bytes to start with, the buffers grow when they run out
+    GeometryArena(size_t vertexCapacity, size_t indexCapacity);
+    ~GeometryArena();
+
+    // Deletes the gl buffers while there's still a context to delete them in. The shared arena
+    // is destroyed after main returns, once glfwTerminate is long gone, so call this before it.
+    // The destructor skips the gl calls if this already ran
+    void Release();
+
+    // Space for count vertices of stride bytes. The offset is a multiple of stride
+    ArenaAllocation AllocateVertices(size_t count, size_t stride);
+
+    // Space for count indices of indexSize bytes (1, 2 or 4). The offset is always
+    // a multiple of 4, so it's a whole number of indices of any size
+    ArenaAllocation AllocateIndices(size_t count, size_t indexSize);
+
+    // Memory to write a mesh into, from as many threads as you like: vertexRange.size bytes at vertices,
+    // indexRange.size bytes at indices. EndStaging then copies both into their ranges on the gpu.
+    // Allocate both ranges first, and only have one staging write going at a time
+    void BeginStaging(const ArenaAllocation& vertexRange, const ArenaAllocation& indexRange, void*& vertices, void*& indices);
+
+    // Copies what was written since BeginStaging into the arena. Every thread has to be done writing.
+    // Returns false, without copying, if the driver lost the memory (only without persistent mapping)
+    bool EndStaging(const ArenaAllocation& vertexRange, const ArenaAllocation& indexRange);
+
+    // True if the staging buffer stays mapped (OpenGL 4.4 or ARB_buffer_storage)
+    static bool PersistentStagingSupported();
+
+    void FreeVertices(const ArenaAllocation& allocation);
+    void FreeIndices(const ArenaAllocation& allocation);
+
+    GLuint GetVertexBuffer();
+    GLuint GetIndexBuffer();
+
+    ArenaStats GetVertexStats();
+    ArenaStats GetIndexStats();
+
+    // Prints how full and fragmented both buffers are
+    void PrintStats();
+};
+
+// One arena that every Mesh shares, created the first time it is asked for (after glewInit)
+GeometryArena& GetGeometryArena();
@@ -0,0 +1,252 @@
+/*
+Title: Blur Optimization VR
+File Name: gpuCuller.cpp
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gpuCuller.h"
+#include "shaderProgram.h"
+#include "renderState.h"
+#include <cstdio>
+
+// Threads per work group, these match local_size in the compute shaders
+#define CullGroupSize 64
+#define HiZGroupSize 8
+
+GpuCuller::GpuCuller(int width, int height)
+{
+    Shader* cullShader = new Shader("../Assets/cullCompute.glsl", GL_COMPUTE_SHADER);
+    m_cullProgram = new ShaderProgram();
+    m_cullProgram->AttachShader(cullShader);
+    m_cullProgram->IncRefCount();
+
+    Shader* hizShader = new Shader("../Assets/hizCompute.glsl", GL_COMPUTE_SHADER);
+    m_hizProgram = new ShaderProgram();
+    m_hizProgram->AttachShader(hizShader);
+    m_hizProgram->IncRefCount();
+
+    // Every level down to 1x1
+    m_hizWidth = width;
+    m_hizHeight = height;
+    m_hizLevels = 1;
+    while ((width >> m_hizLevels) > 0 || (height >> m_hizLevels) > 0)
+        m_hizLevels++;
+
+    glGenTextures(1, &m_hizTexture);
+    GetRenderState().BindTexture(0, GL_TEXTURE_2D, m_hizTexture);
+    glTexStorage2D(GL_TEXTURE_2D, m_hizLevels, GL_R32F, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    GetRenderState().BindTexture(0, GL_TEXTURE_2D, 0);
+
+    glGenBuffers(1, &m_visibleBuffer);
+
+    glGenBuffers(1, &m_counterBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_counterBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GpuCullStats), nullptr, GL_DYNAMIC_DRAW);
+
+    glGenBuffers(GpuCullReadbacks, m_readbackBuffers);
+    for (int i = 0; i < GpuCullReadbacks; i++)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_readbackBuffers[i]);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GpuCullStats), nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+GpuCuller::~GpuCuller()
+{
+    for (int i = 0; i < GpuCullReadbacks; i++)
+    {
+        if (m_readbackFences[i] != 0)
+            glDeleteSync(m_readbackFences[i]);
+    }
+
+    glDeleteBuffers(GpuCullReadbacks, m_readbackBuffers);
+    glDeleteBuffers(1, &m_counterBuffer);
+    glDeleteBuffers(1, &m_visibleBuffer);
+    glDeleteTextures(1, &m_hizTexture);
+    GetRenderState().Invalidate();
+
+    m_cullProgram->DecRefCount();
+    m_hizProgram->DecRefCount();
+}
+
+bool GpuCuller::Supported()
+{
+    return GLEW_VERSION_4_3;
+}
+
+void GpuCuller::SetViews(const glm::mat4& viewProjection1, const glm::mat4& viewProjection2,
+                         const glm::vec4& viewport1, const glm::vec4& viewport2)
+{
+    m_viewProjection[0] = viewProjection1;
+    m_viewProjection[1] = viewProjection2;
+    m_viewports[0] = viewport1;
+    m_viewports[1] = viewport2;
+}
+
+GLuint GpuCuller::Cull(GLuint commandBuffer, GLuint drawBuffer, GLuint matrixBuffer, GLuint copyBuffer, unsigned int copyCount)
+{
+    RenderState& state = GetRenderState();
+    PollReadbacks();
+    m_frame++;
+
+    // Room for every copy, in case nothing gets culled
+    size_t visibleSize = copyCount * sizeof(glm::mat4);
+    if (visibleSize > m_visibleBufferSize)
+    {
+        m_visibleBufferSize = visibleSize;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_visibleBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, m_visibleBufferSize, nullptr, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    GpuCullStats zero = {};
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_counterBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GpuCullStats), &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    m_cullProgram->Bind();
+    GLuint program = m_cullProgram->GetGLShaderProgram();
+    glUniform1ui(glGetUniformLocation(program, "copyCount"), copyCount);
+    glUniformMatrix4fv(glGetUniformLocation(program, "cameraView1"), 1, GL_FALSE, &m_viewProjection[0][0][0]);
+    glUniformMatrix4fv(glGetUniformLocation(program, "cameraView2"), 1, GL_FALSE, &m_viewProjection[1][0][0]);
+    glUniformMatrix4fv(glGetUniformLocation(program, "hizView1"), 1, GL_FALSE, &m_hizViewProjection[0][0][0]);
+    glUniformMatrix4fv(glGetUniformLocation(program, "hizView2"), 1, GL_FALSE, &m_hizViewProjection[1][0][0]);
+    glUniform4fv(glGetUniformLocation(program, "hizViewport1"), 1, &m_hizViewports[0][0]);
+    glUniform4fv(glGetUniformLocation(program, "hizViewport2"), 1, &m_hizViewports[1][0]);
+    glUniform1i(glGetUniformLocation(program, "hizLevels"), m_hizLevels);
+    glUniform1i(glGetUniformLocation(program, "useHiZ"), m_hizValid ? 1 : 0);
+    state.Count(StateUniform, true);
+
+    // The pyramid is read with texelFetch from unit 0
+    state.BindTexture(0, GL_TEXTURE_2D, m_hizTexture);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, drawBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, matrixBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GpuCullCopyBinding, copyBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GpuCullVisibleBinding, m_visibleBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GpuCullCommandBinding, commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GpuCullCounterBinding, m_counterBuffer);
+
+    glDispatchCompute((copyCount + CullGroupSize - 1) / CullGroupSize, 1, 1);
+
+    // The draw reads the commands as indirect arguments, and the matrices from a shader storage buffer
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // Copy the counts where the cpu can read them later. If the gpu is so far behind
+    // that this readback is still waiting, skip this frame's counts instead of waiting
+    if (m_readbackFences[m_nextReadback] == 0)
+    {
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        glBindBuffer(GL_COPY_READ_BUFFER, m_counterBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_readbackBuffers[m_nextReadback]);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(GpuCullStats));
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        m_readbackFences[m_nextReadback] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        m_readbackFrames[m_nextReadback] = m_frame;
+        m_nextReadback = (m_nextReadback + 1) % GpuCullReadbacks;
+    }
+
+    return m_visibleBuffer;
+}
+
+void GpuCuller::PollReadbacks()
+{
+    for (int i = 0; i < GpuCullReadbacks; i++)
+    {
+        if (m_readbackFences[i] == 0)
+            continue;
+
+        // A timeout of 0 only asks, it never waits
+        GLenum status = glClientWaitSync(m_readbackFences[i], 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            continue;
+
+        glDeleteSync(m_readbackFences[i]);
+        m_readbackFences[i] = 0;
+
+        // Readbacks finish in order, so newer ones overwrite older ones
+        glBindBuffer(GL_COPY_READ_BUFFER, m_readbackBuffers[i]);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(GpuCullStats), &m_stats);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        m_statsLatency = m_frame - m_readbackFrames[i];
+    }
+}
+
+void GpuCuller::BuildHiZ(GLuint depthTexture)
+{
+    // The depth texture can't be read while it's still attached to the bound framebuffer
+    RenderState& state = GetRenderState();
+
+    m_hizProgram->Bind();
+    GLuint program = m_hizProgram->GetGLShaderProgram();
+    GLint levelUniform = glGetUniformLocation(program, "level");
+    state.BindTexture(0, GL_TEXTURE_2D, depthTexture);
+
+    for (int level = 0; level < m_hizLevels; level++)
+    {
+        int width = m_hizWidth >> level;
+        int height = m_hizHeight >> level;
+        if (width < 1) width = 1;
+        if (height < 1) height = 1;
+
+        // Level 0 copies the depth texture, every other level reads the one above it
+        glUniform1i(levelUniform, level);
+        state.Count(StateUniform, true);
+        if (level > 0)
+            glBindImageTexture(0, m_hizTexture, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+        glBindImageTexture(1, m_hizTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+        glDispatchCompute((width + HiZGroupSize - 1) / HiZGroupSize, (height + HiZGroupSize - 1) / HiZGroupSize, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    }
+
+    // Cull reads it with texelFetch
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    m_hizViewProjection[0] = m_viewProjection[0];
+    m_hizViewProjection[1] = m_viewProjection[1];
+    m_hizViewports[0] = m_viewports[0];
+    m_hizViewports[1] = m_viewports[1];
+    m_hizValid = true;
+}
+
+void GpuCuller::InvalidateHiZ()
+{
+    m_hizValid = false;
+}
+
+GpuCullStats GpuCuller::GetStats()
+{
+    return m_stats;
+}
+
+void GpuCuller::PrintStats()
+{
+    unsigned int total = m_stats.visible + m_stats.frustumCulled + m_stats.occlusionCulled;
+    printf("GPU culling: %u of %u copies visible, %u outside both eyes, %u hidden (counts from %u frames ago)%s\n",
+        m_stats.visible, total, m_stats.frustumCulled, m_stats.occlusionCulled, m_statsLatency,
+        m_hizValid ? "" : ", no depth pyramid");
+}
@@ -0,0 +1,128 @@
+/*
+Title: Blur Optimization VR
+File Name: gpuCuller.h
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "GL/glew.h"
+#include "glm/glm.hpp"
+
+class ShaderProgram;
+
+// Frames of culling counts waiting to come back from the gpu
+#define GpuCullReadbacks 3
+
+// Shader storage buffer bindings in cullCompute.glsl, 1 and 2 are DrawBatcher's draws and matrices
+#define GpuCullCopyBinding 3
+#define GpuCullVisibleBinding 4
+#define GpuCullCommandBinding 5
+#define GpuCullCounterBinding 6
+
+// Visible and culled copies, counted on the gpu
+struct GpuCullStats
+{
+    unsigned int visible;
+    unsigned int frustumCulled;
+    unsigned int occlusionCulled;
+};
+
+// Culls DrawBatcher's multi-draw indirect draws on the gpu, one copy of a mesh per thread.
+//
+// Each copy's box is tested against the frustums of both eyes, and against a hierarchical-Z
+// pyramid: mip levels of the depth buffer, where every texel holds the farthest depth of the
+// texels under it. A few texels of the right level cover the whole box on screen, and if the
+// box is behind all of them, it's hidden. The pyramid comes from last frame's depth buffer,
+// and boxes are tested with last frame's cameras, since that's what the depth buffer saw.
+//
+// Copies that either eye can see are packed together, and the instance counts of the indirect
+// commands are counted up on the gpu, so the cpu never knows (or waits to find out) what's drawn.
+// The visible and culled counts come back a few frames later, when the gpu is done with them.
+class GpuCuller
+{
+
+private:
+    ShaderProgram* m_cullProgram = nullptr;
+    ShaderProgram* m_hizProgram = nullptr;
+
+    // The pyramid, level 0 is the size of the depth buffer
+    GLuint m_hizTexture = 0;
+    int m_hizWidth;
+    int m_hizHeight;
+    int m_hizLevels;
+
+    // False until the pyramid holds a depth buffer, or when last frame's depth wasn't kept
+    bool m_hizValid = false;
+
+    // This frame's cameras and eye viewports, and the ones the pyramid was made with
+    glm::mat4 m_viewProjection[2];
+    glm::vec4 m_viewports[2];
+    glm::mat4 m_hizViewProjection[2];
+    glm::vec4 m_hizViewports[2];
+
+    // World matrices of the copies that survived, packed per draw
+    GLuint m_visibleBuffer = 0;
+    size_t m_visibleBufferSize = 0;
+
+    // GpuCullStats on the gpu, and copies of it the cpu reads once their fence is done
+    GLuint m_counterBuffer = 0;
+    GLuint m_readbackBuffers[GpuCullReadbacks] = {};
+    GLsync m_readbackFences[GpuCullReadbacks] = {};
+    int m_nextReadback = 0;
+
+    // The newest counts that came back, and how many frames old they were when they did
+    GpuCullStats m_stats = {};
+    unsigned int m_statsLatency = 0;
+    unsigned int m_frame = 0;
+    unsigned int m_readbackFrames[GpuCullReadbacks] = {};
+
+    // Reads back any counts the gpu has finished, without waiting for the others
+    void PollReadbacks();
+
+public:
+    // width and height are the size of the depth buffer the pyramid is made from
+    GpuCuller(int width, int height);
+    ~GpuCuller();
+
+    // True if the gpu has compute shaders and shader storage buffers (OpenGL 4.3)
+    static bool Supported();
+
+    // This frame's cameras (projection * view), and each eye's viewport (x, y, width, height)
+    void SetViews(const glm::mat4& viewProjection1, const glm::mat4& viewProjection2,
+                  const glm::vec4& viewport1, const glm::vec4& viewport2);
+
+    // Culls copyCount copies. The buffers are DrawBatcher's: drawBuffer holds an IndirectDraw per
+    // command, matrixBuffer every copy's world matrix, copyBuffer the draw each copy belongs to.
+    // The instance counts in commandBuffer have to start at 0, the survivors are counted into them.
+    // Returns the buffer the survivors' world matrices are in, laid out like matrixBuffer
+    GLuint Cull(GLuint commandBuffer, GLuint drawBuffer, GLuint matrixBuffer, GLuint copyBuffer, unsigned int copyCount);
+
+    // Makes the pyramid from depthTexture, once the frame is drawn, for next frame's Cull
+    void BuildHiZ(GLuint depthTexture);
+
+    // Next frame can't use the pyramid, because this frame's depth wasn't kept
+    void InvalidateHiZ();
+
+    GpuCullStats GetStats();
+
+    // Prints the newest counts that came back from the gpu
+    void PrintStats();
+};
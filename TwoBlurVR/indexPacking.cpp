@@ -0,0 +1,363 @@
+/*
+Title: Blur Optimization VR
+File Name: indexPacking.cpp
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "indexPacking.h"
+#include "mesh.h"
+#include "objLoader.h"
+#include "meshOptimizer.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+unsigned int ChooseIndexSize(size_t vertexCount)
+{
+    // Indices go from 0 to vertexCount - 1, and 0xFF or 0xFFFF is the restart index
+    if (vertexCount <= 0xFF)
+        return 1;
+    if (vertexCount <= 0xFFFF)
+        return 2;
+    return 4;
+}
+
+void StripifyTriangles(const unsigned int* indices, size_t indexCount, size_t vertexCount, std::vector<unsigned int>& strips)
+{
+    size_t triangleCount = indexCount / 3;
+    strips.clear();
+    strips.reserve(indexCount);
+
+    // Every triangle that uses each vertex, all in one array: vertex v's
+    // triangles go from firstTriangle[v] to firstTriangle[v + 1]
+    std::vector<unsigned int> firstTriangle(vertexCount + 1, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        firstTriangle[indices[i] + 1]++;
+    for (size_t v = 0; v < vertexCount; v++)
+        firstTriangle[v + 1] += firstTriangle[v];
+
+    std::vector<unsigned int> vertexTriangles(triangleCount * 3);
+    std::vector<unsigned int> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        vertexTriangles[fill[indices[i]]++] = (unsigned int)(i / 3);
+
+    std::vector<bool> used(triangleCount, false);
+
+    // Finds a triangle that isn't in a strip yet and goes from a to b (in its own winding),
+    // and its third corner. Returns -1 if there isn't one
+    auto findNext = [&](unsigned int a, unsigned int b, unsigned int& c) -> int
+    {
+        for (unsigned int j = firstTriangle[a]; j < firstTriangle[a + 1]; j++)
+        {
+            unsigned int t = vertexTriangles[j];
+            if (used[t])
+                continue;
+
+            const unsigned int* triangle = &indices[t * 3];
+            for (int k = 0; k < 3; k++)
+            {
+                if (triangle[k] == a && triangle[(k + 1) % 3] == b)
+                {
+                    c = triangle[(k + 2) % 3];
+                    return (int)t;
+                }
+            }
+        }
+        return -1;
+    };
+
+    // Strips start on the first triangle of the list that isn't in one yet,
+    // so they follow the list's order
+    for (size_t start = 0; start < triangleCount; start++)
+    {
+        if (used[start])
+            continue;
+        used[start] = true;
+
+        // The second triangle of a strip is flipped, it has to go from the third corner
+        // back to the second. Start on whichever corner has a triangle on that edge
+        const unsigned int* triangle = &indices[start * 3];
+        int rotation = 0;
+        for (int r = 0; r < 3; r++)
+        {
+            unsigned int c;
+            if (findNext(triangle[(r + 2) % 3], triangle[(r + 1) % 3], c) >= 0)
+            {
+                rotation = r;
+                break;
+            }
+        }
+
+        if (!strips.empty())
+            strips.push_back(IndexRestart);
+        size_t first = strips.size();
+        for (int k = 0; k < 3; k++)
+            strips.push_back(triangle[(rotation + k) % 3]);
+
+        // Triangle i of a strip is (i, i + 1, i + 2), with the first two swapped when i is odd.
+        // Keep adding the triangle across the last edge while there is one
+        while (true)
+        {
+            size_t length = strips.size() - first;
+            unsigned int a = strips[strips.size() - 2];
+            unsigned int b = strips.back();
+            unsigned int c;
+            int next = length % 2 == 0 ? findNext(a, b, c) : findNext(b, a, c);
+            if (next < 0)
+                break;
+
+            used[next] = true;
+            strips.push_back(c);
+        }
+    }
+}
+
+void UnstripTriangles(const unsigned int* strips, size_t count, std::vector<unsigned int>& triangles)
+{
+    triangles.clear();
+
+    size_t first = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (strips[i] == IndexRestart)
+        {
+            first = i + 1;
+            continue;
+        }
+
+        // Triangle n of the strip ends on its index n + 2
+        size_t n = i - first;
+        if (n < 2)
+            continue;
+
+        unsigned int a = strips[i - 2];
+        unsigned int b = strips[i - 1];
+        unsigned int c = strips[i];
+        if (n % 2 == 1)
+            std::swap(a, b);
+        if (a == b || b == c || a == c)
+            continue;
+
+        triangles.push_back(a);
+        triangles.push_back(b);
+        triangles.push_back(c);
+    }
+}
+
+// Copies indices into data at indexSize bytes each. Cutting IndexRestart
+// down to 1 or 2 bytes leaves 0xFF or 0xFFFF, the restart index of that size
+static void NarrowIndices(const std::vector<unsigned int>& indices, unsigned int indexSize, std::vector<unsigned char>& data)
+{
+    data.resize(indices.size() * indexSize);
+    if (indexSize == 4)
+    {
+        if (!indices.empty())
+            memcpy(data.data(), indices.data(), data.size());
+    }
+    else if (indexSize == 2)
+    {
+        unsigned short* destination = (unsigned short*)data.data();
+        for (size_t i = 0; i < indices.size(); i++)
+            destination[i] = (unsigned short)indices[i];
+    }
+    else
+    {
+        for (size_t i = 0; i < indices.size(); i++)
+            data[i] = (unsigned char)indices[i];
+    }
+}
+
+void PackIndices(const unsigned int* indices, const MeshLod* lods, size_t lodCount, size_t vertexCount, bool makeStrips,
+                 std::vector<unsigned char>& data, IndexLayout& layout)
+{
+    layout.indexSize = ChooseIndexSize(vertexCount);
+    layout.strips = false;
+    layout.ranges.clear();
+
+    // Every level one after another, as a list
+    size_t listCount = 0;
+    std::vector<unsigned int> packed;
+    for (size_t l = 0; l < lodCount; l++)
+    {
+        IndexRange range = { (unsigned int)packed.size(), lods[l].indexCount };
+        packed.insert(packed.end(), indices + lods[l].firstIndex, indices + lods[l].firstIndex + lods[l].indexCount);
+        layout.ranges.push_back(range);
+        listCount += lods[l].indexCount;
+    }
+
+    // And as strips, kept if they're smaller
+    if (makeStrips)
+    {
+        std::vector<unsigned int> strips;
+        std::vector<unsigned int> levelStrips;
+        std::vector<IndexRange> stripRanges;
+        for (size_t l = 0; l < lodCount; l++)
+        {
+            StripifyTriangles(indices + lods[l].firstIndex, lods[l].indexCount, vertexCount, levelStrips);
+            IndexRange range = { (unsigned int)strips.size(), (unsigned int)levelStrips.size() };
+            strips.insert(strips.end(), levelStrips.begin(), levelStrips.end());
+            stripRanges.push_back(range);
+        }
+
+        if (strips.size() < listCount)
+        {
+            packed.swap(strips);
+            layout.ranges.swap(stripRanges);
+            layout.strips = true;
+        }
+    }
+
+    NarrowIndices(packed, layout.indexSize, data);
+}
+
+void RemapPackedIndices(const std::vector<unsigned char>& data, const IndexLayout& layout, const std::vector<unsigned int>& remap,
+                        size_t vertexCount, std::vector<unsigned char>& remapped, IndexLayout& remappedLayout)
+{
+    std::vector<unsigned int> indices;
+    UnpackIndices(data.data(), data.size() / layout.indexSize, layout.indexSize, indices);
+    for (unsigned int& index : indices)
+    {
+        if (index != IndexRestart)
+            index = remap[index];
+    }
+
+    // Same ranges, the remap doesn't change how many indices there are
+    remappedLayout = layout;
+    remappedLayout.indexSize = ChooseIndexSize(vertexCount);
+    NarrowIndices(indices, remappedLayout.indexSize, remapped);
+}
+
+void UnpackIndices(const void* data, size_t count, unsigned int indexSize, std::vector<unsigned int>& indices)
+{
+    indices.resize(count);
+    if (indexSize == 4)
+    {
+        if (count > 0)
+            memcpy(indices.data(), data, count * sizeof(unsigned int));
+    }
+    else if (indexSize == 2)
+    {
+        const unsigned short* source = (const unsigned short*)data;
+        for (size_t i = 0; i < count; i++)
+            indices[i] = source[i] == 0xFFFF ? IndexRestart : source[i];
+    }
+    else
+    {
+        const unsigned char* source = (const unsigned char*)data;
+        for (size_t i = 0; i < count; i++)
+            indices[i] = source[i] == 0xFF ? IndexRestart : source[i];
+    }
+}
+
+// Every triangle turned to start on its smallest index (which keeps its winding), then sorted,
+// so two index buffers with the same triangles in a different order come out equal
+static std::vector<std::array<unsigned int, 3>> SortedTriangles(const std::vector<unsigned int>& indices)
+{
+    std::vector<std::array<unsigned int, 3>> triangles;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        unsigned int a = indices[i], b = indices[i + 1], c = indices[i + 2];
+        if (a == b || b == c || a == c)
+            continue;
+
+        if (b < a && b < c)
+            triangles.push_back({ b, c, a });
+        else if (c < a && c < b)
+            triangles.push_back({ c, a, b });
+        else
+            triangles.push_back({ a, b, c });
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+void BenchmarkIndexPacking()
+{
+    const char* files[] =
+    {
+        "../Assets/Skybox.3Dobj",   "../Assets/bridge.3Dobj",   "../Assets/car.3Dobj",
+        "../Assets/cone.3Dobj",     "../Assets/cube.3Dobj",     "../Assets/cylinder.3Dobj",
+        "../Assets/dog.3Dobj",      "../Assets/dragon.3Dobj",   "../Assets/gun.3Dobj",
+        "../Assets/helix.3Dobj",    "../Assets/kitten.3Dobj",   "../Assets/sphere.3Dobj",
+        "../Assets/torus.3Dobj",    "../Assets/wheel.3Dobj",
+    };
+
+    printf("\nIndex packing benchmark (sizes of the full mesh, bytes read per draw)\n");
+    printf("%-26s %8s %9s %10s %6s %10s %6s %10s %8s %6s %9s\n",
+        "file", "vertices", "triangles", "32 bit KB", "size", "list KB", "ratio", "strips KB", "idx/tri", "ratio", "strip ms");
+
+    for (const char* file : files)
+    {
+        std::vector<Vertex3dUVNormal> vertices;
+        std::vector<unsigned int> indices;
+        if (!LoadObjMapped(file, vertices, indices, true, nullptr))
+            continue;
+
+        // The same order a Mesh draws in, strips are only as good as the list they follow
+        OptimizeVertexCache(indices, vertices.size());
+        OptimizeVertexFetch(vertices, indices);
+
+        MeshLod full = { 0, (unsigned int)indices.size(), 0 };
+        std::vector<std::array<unsigned int, 3>> expected = SortedTriangles(indices);
+
+        // Once as a list, once as strips (even if they don't come out smaller)
+        size_t bytes[2];
+        bool ok = true;
+        std::vector<unsigned int> strips;
+        double stripSeconds = 0;
+        for (int pass = 0; pass < 2; pass++)
+        {
+            std::vector<unsigned char> data;
+            IndexLayout layout;
+            if (pass == 0)
+            {
+                PackIndices(indices.data(), &full, 1, vertices.size(), false, data, layout);
+            }
+            else
+            {
+                auto start = std::chrono::high_resolution_clock::now();
+                StripifyTriangles(indices.data(), indices.size(), vertices.size(), strips);
+                stripSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+                layout.indexSize = ChooseIndexSize(vertices.size());
+                layout.strips = true;
+                NarrowIndices(strips, layout.indexSize, data);
+            }
+            bytes[pass] = data.size();
+
+            std::vector<unsigned int> unpacked, triangles;
+            UnpackIndices(data.data(), data.size() / layout.indexSize, layout.indexSize, unpacked);
+            if (layout.strips)
+                UnstripTriangles(unpacked.data(), unpacked.size(), triangles);
+            else
+                triangles = unpacked;
+            ok = ok && SortedTriangles(triangles) == expected;
+        }
+
+        size_t fullBytes = indices.size() * sizeof(unsigned int);
+        printf("%-26s %8d %9d %10.1f %6d %10.1f %5.2fx %10.1f %8.2f %5.2fx %9.2f%s\n",
+            file, (int)vertices.size(), (int)(indices.size() / 3), fullBytes / 1024.0, (int)ChooseIndexSize(vertices.size()),
+            bytes[0] / 1024.0, (double)fullBytes / bytes[0], bytes[1] / 1024.0, indices.empty() ? 0.0 : (double)strips.size() / (indices.size() / 3),
+            (double)fullBytes / bytes[1], stripSeconds * 1000.0, ok ? "" : "  MISMATCH");
+    }
+}
@@ -0,0 +1,91 @@
+/*
+Title: Blur Optimization VR
+File Name: indexPacking.h
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <cstddef>
+#include <vector>
+
+struct MeshLod;
+
+// Ends one strip and starts the next, in 32 bit indices. Packed indices use the largest
+// value of their own size instead, which is what GL_PRIMITIVE_RESTART_FIXED_INDEX expects
+#define IndexRestart 0xFFFFFFFFu
+
+// Where one level of detail ended up in a packed index buffer, counted in indices
+struct IndexRange
+{
+    unsigned int firstIndex;
+    unsigned int indexCount;
+};
+
+// How one index buffer was packed. Every mesh starts out as a 32 bit triangle list,
+// but most of them have far fewer than 65536 vertices, and the small ones fewer than 256,
+// so each index fits in 2 bytes, or 1. The largest value of each size is never used as
+// an index, it's the restart index, so strips and lists can share the same gl state.
+//
+// Strips (GL_TRIANGLE_STRIP) add one index per triangle instead of three, plus a restart
+// at the end of each strip. That only wins when the strips come out long, so a buffer
+// only uses them if they're smaller than the list.
+//
+// Some gpus turn 1 byte indices into 2 byte ones in the driver. That costs a copy at
+// load time, not every frame, and the memory is still saved in the arena.
+struct IndexLayout
+{
+    unsigned int indexSize = sizeof(unsigned int);
+    bool strips = false;
+
+    // One per level of detail
+    std::vector<IndexRange> ranges;
+};
+
+// The smallest index size (1, 2 or 4 bytes) that holds every index of a mesh with vertexCount
+// vertices, and still has the largest value left over for the restart index
+unsigned int ChooseIndexSize(size_t vertexCount);
+
+// Turns a triangle list into strips, split by IndexRestart. Every triangle keeps its
+// winding, and strips follow the list's order, so a vertex cache optimized list
+// gives vertex cache friendly strips
+void StripifyTriangles(const unsigned int* indices, size_t indexCount, size_t vertexCount, std::vector<unsigned int>& strips);
+
+// Turns strips back into a triangle list, with the same winding. Triangles
+// with two of the same index (which draw nothing) are left out
+void UnstripTriangles(const unsigned int* strips, size_t count, std::vector<unsigned int>& triangles);
+
+// Packs a 32 bit triangle list made of levels of detail (ranges of the list, see MeshLod) into data,
+// one level after another. With makeStrips, each level becomes strips if all of them come out smaller
+void PackIndices(const unsigned int* indices, const MeshLod* lods, size_t lodCount, size_t vertexCount, bool makeStrips,
+                 std::vector<unsigned char>& data, IndexLayout& layout);
+
+// Packs the same primitives as data and layout (from PackIndices), with every index i swapped for remap[i],
+// for a buffer of vertexCount vertices. Strips stay strips, and every triangle keeps its first vertex,
+// so a second stream of the same mesh (like a position stream) draws exactly the same way
+void RemapPackedIndices(const std::vector<unsigned char>& data, const IndexLayout& layout, const std::vector<unsigned int>& remap,
+                        size_t vertexCount, std::vector<unsigned char>& remapped, IndexLayout& remappedLayout);
+
+// Reads count packed indices of indexSize bytes back into 32 bit ones, restarts become IndexRestart
+void UnpackIndices(const void* data, size_t count, unsigned int indexSize, std::vector<unsigned int>& indices);
+
+// Packs every model in Assets, as lists and as strips, checks they unpack to the
+// same triangles, and prints how much index memory each one takes
+void BenchmarkIndexPacking();
@@ -34,6 +34,19 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "transform3d.h"
 #include "material.h"
 #include "texture.h"
+#include "objLoader.h"
+#include "tangents.h"
+#include "meshCodec.h"
+#include "renderState.h"
+#include "drawBatcher.h"
+#include "gpuCuller.h"
+#include "frustumCulling.h"
+#include "sceneBvh.h"
+#include "occlusionCulling.h"
+#include "drawList.h"
+#include "indexPacking.h"
+#include "proceduralMesh.h"
+#include "threadPool.h"
 #include <iostream>
 
 
@@ -46,7 +59,7 @@ glm::vec2 mousePosition = glm::vec2();
 // and one for horizontal blur
 GLuint frameBuffer[2];
 GLuint screenTexture[2];
-GLuint renderBuffer[2];
+GLuint depthTexture[2];
 
 // Window resize callback
 void resizeCallback(GLFWwindow* window, int width, int height)
@@ -83,12 +96,12 @@ void MakeRT(int i)
 
     // Create and bind the framebuffer. This is done exactly the same as it's done for everything else in OpenGL.
     glGenFramebuffers(1, &frameBuffer[i]);
-    glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer[i]); // The bind location form framebuffers is simply named GL_FRAMEBUFFER.
+    GetRenderState().BindFramebuffer(frameBuffer[i]); // The bind location form framebuffers is simply named GL_FRAMEBUFFER.
 
     // The framebuffer actually consists of a few smaller objects.
     // These are primarily textures and renderbuffers, each which have different uses.
     glGenTextures(1, &screenTexture[i]);
-    glBindTexture(GL_TEXTURE_2D, screenTexture[i]);
+    GetRenderState().BindTexture(0, GL_TEXTURE_2D, screenTexture[i]);
     // Here we're going to create a texture that matches the size of our viewport. (this also gets resized in the viewport resizing code)
     // Instead of passing in data for the texture, we pass in null, which leaves the texture empty.
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, viewportDimensions.x, viewportDimensions.y, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
@@ -102,29 +115,102 @@ void MakeRT(int i)
     // When we read from the texture, it will be 1 to 1 with the screen, so we shouldnt have any filtering.
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glBindTexture(GL_TEXTURE_2D, 0);
-
-    // We also need to create a render buffer.
-    // A render buffer is similar to a texture, but with less features.
-    // When rendering to a texture, we can later use that texture in another draw call, and draw it onto a surface.
-    // A render buffer can't do that. The pixel data is temporary, and gets thrown away by the gpu when it's done.
-
-    // We're going to create one here for the depth stencil buffer.
-    // This isn't actually required for this example, because we only render one object, but if we were rendering with depth, this would be very important.
-    glGenRenderbuffers(1, &renderBuffer[i]);
-    glBindRenderbuffer(GL_RENDERBUFFER, renderBuffer[i]);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, viewportDimensions.x, viewportDimensions.y);
-    glBindRenderbuffer(GL_RENDERBUFFER, 0);
-
-    // Finally, we attach both the texture and render buffer to our frame buffer.
-    // The texture is attached as a "color attachment". This is where our fragment shader outputs.
+    GetRenderState().BindTexture(0, GL_TEXTURE_2D, 0);
+
+    // We also need a depth stencil buffer.
+    // This could be a render buffer, which is similar to a texture, but with less features:
+    // its pixel data is temporary, and can't be read by another draw call.
+    // We use a texture instead, so the GPU culling pass (see gpuCuller.h) can read
+    // last frame's depth, to find objects that are hidden behind others.
+    glGenTextures(1, &depthTexture[i]);
+    GetRenderState().BindTexture(0, GL_TEXTURE_2D, depthTexture[i]);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, viewportDimensions.x, viewportDimensions.y, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+
+    // Depth is read one texel at a time with texelFetch, never filtered or compared
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+    GetRenderState().BindTexture(0, GL_TEXTURE_2D, 0);
+
+    // Finally, we attach both textures to our frame buffer.
+    // The color texture is attached as a "color attachment". This is where our fragment shader outputs.
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, screenTexture[i], 0);
-    // The render buffer is attached to the depth stencil attachment.
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderBuffer[i]);
+    // The depth texture is attached to the depth stencil attachment.
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTexture[i], 0);
+}
+
+// One thing in the scene, and what it's drawn with
+struct SceneObject
+{
+    Mesh* mesh;
+    Texture* colorTexture;
+    Texture* normalTexture;
+    Transform3D transform;
+
+    // The transform's version when the bvh last got this object's box
+    unsigned int bvhVersion;
+
+    // Which of the occlusion culler's meshes stands in for it, -1 if it doesn't hide anything
+    int occluder;
+};
+
+void AddSceneObject(std::vector<SceneObject>& objects, Mesh* mesh, Texture* colorTexture, Texture* normalTexture,
+                    glm::vec3 position, glm::vec3 rotation, float scale)
+{
+    // A mesh that couldn't be loaded has nothing to draw, cull or hide things with
+    if (!mesh->IsLoaded())
+        return;
+
+    SceneObject object;
+    object.mesh = mesh;
+    object.colorTexture = colorTexture;
+    object.normalTexture = normalTexture;
+    object.transform.SetPosition(position);
+    object.transform.SetRotation(rotation);
+    object.transform.SetScale(scale);
+    object.bvhVersion = object.transform.GetVersion();
+    object.occluder = -1;
+    objects.push_back(object);
 }
 
 #define NikoIphone6 true
 
+// Change this to true to time the old and new
+// obj loaders on every model in Assets at startup
+#define BenchmarkObjLoading false
+
+// Change this to true to time the old and new
+// tangent calculations on every model in Assets at startup
+#define BenchmarkTangentGeneration false
+
+// Change this to true to check that every model in Assets
+// survives the mesh codec, and see how small and fast it is
+#define BenchmarkMeshCompression false
+
+// Change this to true to time culling 100k objects
+// against the stereo frustum, with and without SIMD
+#define BenchmarkCpuCulling false
+
+// Change this to true to time building, refitting and
+// querying a bvh of 100k objects, some of them moving
+#define BenchmarkSceneHierarchy false
+
+// Change this to true to check the cpu occlusion rasterizer
+// against a high resolution one, and time it
+#define BenchmarkOcclusion false
+
+// Change this to true to count the state changes a sorted draw list
+// saves on 10k synthetic draws, and time its radix sort
+#define BenchmarkDrawSorting false
+
+// Change this to true to see how small every model's indices get
+// with 8 and 16 bit indices, as a triangle list and as strips
+#define BenchmarkIndexSizes false
+
+// Change this to true to time making the primitive shapes in code,
+// on one thread and across the pool, against loading their obj files
+#define BenchmarkProceduralShapes false
+
 int main(int argc, char **argv)
 {
 	// Initialize GLFW
@@ -156,20 +242,69 @@ int main(int argc, char **argv)
     printf("\Extension supported?: %d\n\n", IsExtensionSupported("GL_ARB_shader_viewport_layer_array"));
     printf("\Extension supported?: %d\n\n", IsExtensionSupported("GL_ARB_fragment_layer_viewport"));
 
+#if BenchmarkObjLoading
+    BenchmarkObjLoaders();
+#endif
+
+#if BenchmarkTangentGeneration
+    BenchmarkTangents();
+#endif
+
+#if BenchmarkMeshCompression
+    BenchmarkMeshCodec();
+#endif
+
+#if BenchmarkCpuCulling
+    BenchmarkFrustumCulling();
+#endif
+
+#if BenchmarkSceneHierarchy
+    BenchmarkSceneBvh();
+#endif
+
+#if BenchmarkOcclusion
+    BenchmarkOcclusionCulling();
+#endif
+
+#if BenchmarkDrawSorting
+    BenchmarkDrawList();
+#endif
+
+#if BenchmarkIndexSizes
+    BenchmarkIndexPacking();
+#endif
+
+#if BenchmarkProceduralShapes
+    BenchmarkProceduralMeshes();
+#endif
+
+    // Time how long the whole scene takes to load. The first launch parses every
+    // obj file (a cold start), after that they come from .meshbin files (a warm start).
+    // Delete the .meshbin files in Assets to get a cold start again.
+    double loadStart = glfwGetTime();
+
     // The mesh loading code has changed slightly, we now have to do some extra math to take advantage of our normal maps.
     // Here we pass in true to calculate tangents.
-    Mesh* model = new Mesh("../Assets/plane.obj", true);
-    Mesh* car = new Mesh("../Assets/car.3Dobj", true);
-    Mesh* dog = new Mesh("../Assets/dog.3Dobj", true);
-    Mesh* kitten = new Mesh("../Assets/kitten.3Dobj", true);
-    Mesh* crate = new Mesh("../Assets/cube.3Dobj", true);
-    Mesh* helix = new Mesh("../Assets/helix.3Dobj", true);
-    Mesh* torus = new Mesh("../Assets/torus.3Dobj", true);
-    Mesh* wheel = new Mesh("../Assets/wheel.3Dobj", true);
-    Mesh* bear = new Mesh("../Assets/bear5.obj", true);
-
-    // The transform being used to draw our second shape.
-    Transform3D transform;
+    // Every mesh also gets its triangles reordered for the gpu's vertex cache,
+    // and the big closed models get sorted for less overdraw, since they are drawn once per eye.
+    // Their .meshbin caches are compressed, and decoded straight into the gpu buffers.
+    // They also keep a position only copy, for passes that only draw depth.
+    // Indices go to the gpu in 8 or 16 bits when they fit, as strips when that's smaller.
+    unsigned int sceneOptions = MeshPackVertices | MeshBuildMeshlets | MeshCompressCache | MeshPositionStream | MeshTriangleStrips;
+    Mesh* model = new Mesh("../Assets/plane.obj", true, MeshOptimizeVertexCache | sceneOptions);
+    Mesh* car = new Mesh("../Assets/car.3Dobj", true, MeshOptimizeOverdraw | MeshGenerateLods | sceneOptions);
+    Mesh* dog = new Mesh("../Assets/dog.3Dobj", true, MeshOptimizeOverdraw | MeshGenerateLods | sceneOptions);
+    Mesh* kitten = new Mesh("../Assets/kitten.3Dobj", true, MeshOptimizeOverdraw | MeshGenerateLods | sceneOptions);
+    // The crate is made in code, straight into the gpu buffers, see proceduralMesh.h
+    Mesh* crate = new Mesh(MakeCube(1.0f, 1), MeshPackVertices);
+    Mesh* helix = new Mesh("../Assets/helix.3Dobj", true, MeshOptimizeVertexCache | MeshGenerateLods | sceneOptions);
+    Mesh* torus = new Mesh("../Assets/torus.3Dobj", true, MeshOptimizeVertexCache | MeshGenerateLods | sceneOptions);
+    Mesh* wheel = new Mesh("../Assets/wheel.3Dobj", true, MeshOptimizeVertexCache | sceneOptions);
+    Mesh* bear = new Mesh("../Assets/bear5.obj", true, MeshOptimizeVertexCache | MeshGenerateLods | sceneOptions);
+
+    printf("\nScene meshes loaded in %.2f ms\n", (glfwGetTime() - loadStart) * 1000.0);
+    Mesh::PrintLoadTimes();
+    GetGeometryArena().PrintStats();
 
     // Make a first person controller for the camera.
     FPSController controller = FPSController();
@@ -181,6 +316,13 @@ int main(int argc, char **argv)
     shaderProgram1->AttachShader(vertexShader1);
     shaderProgram1->AttachShader(fragmentShader1);
 
+    // Drawing only the depth of all 3D objects, for the depth prepass
+    Shader* vertexShaderDepth = new Shader("../Assets/depthVertex.glsl", GL_VERTEX_SHADER);
+    Shader* fragmentShaderDepth = new Shader("../Assets/depthFragment.glsl", GL_FRAGMENT_SHADER);
+    ShaderProgram* shaderProgramDepth = new ShaderProgram();
+    shaderProgramDepth->AttachShader(vertexShaderDepth);
+    shaderProgramDepth->AttachShader(fragmentShaderDepth);
+
     // Drawing blur with one render pass
     Shader* vertexShader2 = new Shader("../Assets/BlurOnePassVS.glsl", GL_VERTEX_SHADER);
     Shader* fragmentShader2 = new Shader("../Assets/BlurOnePassFS.glsl", GL_FRAGMENT_SHADER);
@@ -202,10 +344,20 @@ int main(int argc, char **argv)
     programBlurTwoPart2->AttachShader(vertexShader4);
     programBlurTwoPart2->AttachShader(fragmentShader4);
 
+    // Drawing all 3D objects with one multi-draw indirect call, if the gpu can
+    ShaderProgram* shaderProgramIndirect = nullptr;
+    if (DrawBatcher::IndirectSupported())
+    {
+        Shader* vertexShader5 = new Shader("../Assets/vertexIndirect.glsl", GL_VERTEX_SHADER);
+        Shader* fragmentShader5 = new Shader("../Assets/fragmentIndirect.glsl", GL_FRAGMENT_SHADER);
+        shaderProgramIndirect = new ShaderProgram();
+        shaderProgramIndirect->AttachShader(vertexShader5);
+        shaderProgramIndirect->AttachShader(fragmentShader5);
+    }
+
 	// fields that are used in the shader, on the graphics card
 	char cameraView1VS[] = "cameraView1";
     char cameraView2VS[] = "cameraView2";
-	char worldMatrixVS[] = "worldMatrix";
 
 	char colorTexFS[] = "tex";
 	char normalTexFS[] = "tex2";
@@ -225,6 +377,21 @@ int main(int argc, char **argv)
     // Create a material using a texture for our model
     Material* material1 = new Material(shaderProgram1);
 
+    // Groups draws of the same mesh and textures into instanced draws.
+    // Its own CPU culling starts off, the scene bvh below already skips anything
+    // neither eye can see (press C to turn it on anyway, X to turn it off)
+    DrawBatcher* batcher = new DrawBatcher();
+    batcher->SetCpuCulling(false);
+
+    // Only needs the cameras. With the depth prepass on (press Z, V turns it off),
+    // the batcher draws every batch's depth with it before shading anything
+    Material* materialDepth = new Material(shaderProgramDepth);
+
+    // Only needs the cameras, the textures come from material1 when things are added to the batcher
+    Material* materialIndirect = nullptr;
+    if (shaderProgramIndirect != nullptr)
+        materialIndirect = new Material(shaderProgramIndirect);
+
     Texture* colPlaneTex = new Texture(colorTexFile);
     Texture* normPlaneTex = new Texture(normalTexFile);
 
@@ -236,8 +403,69 @@ int main(int argc, char **argv)
     Texture* crateTex = new Texture(colCrate);
     Texture* rustyTex = new Texture(colRusty);
 
+    // Everything in the scene, placed once. Anything that moves
+    // only has to change its transform, the bvh catches up each frame
+    std::vector<SceneObject> sceneObjects;
+    AddSceneObject(sceneObjects, bear, blankNormTex, blankNormTex, glm::vec3(-1, 0.2, -8), glm::vec3(0, -1.2, 0), 0.3f);
+    AddSceneObject(sceneObjects, kitten, blankNormTex, blankNormTex, glm::vec3(-1, -1, -12), glm::vec3(0, 3.5 / 2, 0), 1.0f);
+    AddSceneObject(sceneObjects, dog, dogTex, blankNormTex, glm::vec3(0, -1, -12), glm::vec3(0, 3.5 / 2, 0), 1.0f);
+    AddSceneObject(sceneObjects, crate, crateTex, blankNormTex, glm::vec3(7.5, -0.5, -10), glm::vec3(2, 0, 0), 1.0f);
+    AddSceneObject(sceneObjects, crate, crateTex, blankNormTex, glm::vec3(6, -0.5, -10), glm::vec3(1, 0, 0), 1.0f);
+    AddSceneObject(sceneObjects, crate, crateTex, blankNormTex, glm::vec3(-4, -0.5, -10), glm::vec3(0, 1, 0), 1.0f);
+    AddSceneObject(sceneObjects, helix, blankNormTex, blankNormTex, glm::vec3(2.5, -0.5, -10), glm::vec3(3.14 / 2, 0, 0), 1.0f);
+    AddSceneObject(sceneObjects, car, colCarTex, blankNormTex, glm::vec3(2.5, -1, -15), glm::vec3(0, 2, 0), 1.0f);
+    AddSceneObject(sceneObjects, car, colCarTex, blankNormTex, glm::vec3(-2.5, -1, -15), glm::vec3(0, 0.75, 0), 1.0f);
+
+    unsigned int firstTorus = (unsigned int)sceneObjects.size();
+    for (int i = 0; i < 10; i++)
+        AddSceneObject(sceneObjects, torus, rustyTex, blankNormTex, glm::vec3(i * 2 - 10, 0, -20), glm::vec3(i, i * 2, i * 3), 1.0f);
+    unsigned int torusCount = (unsigned int)sceneObjects.size() - firstTorus;
+
+    AddSceneObject(sceneObjects, model, colPlaneTex, normPlaneTex, glm::vec3(0, 0, -10), glm::vec3(0, 0, 0), 10.0f);
+
+    // A bvh over the world space box of every scene object, so each
+    // frame only looks at the objects either eye might see
+    std::vector<glm::vec3> sceneBoxMins, sceneBoxMaxs;
+    for (SceneObject& object : sceneObjects)
+    {
+        glm::vec3 boundsMin, boundsMax, worldMin, worldMax;
+        object.mesh->GetBounds(boundsMin, boundsMax);
+        TransformBox(object.transform.GetMatrix(), boundsMin, boundsMax, worldMin, worldMax);
+        sceneBoxMins.push_back(worldMin);
+        sceneBoxMaxs.push_back(worldMax);
+    }
+    SceneBvh* sceneBvh = new SceneBvh();
+    sceneBvh->Build(sceneBoxMins, sceneBoxMaxs);
+    std::vector<unsigned int> visibleObjects;
+
+    // The floor, the cars and the dog hide a lot of the scene. They are rasterized on the cpu
+    // each frame, and anything they hide from both eyes isn't drawn. Their full meshes are used,
+    // the car's simplest level is off by about 6% of its size, which would hide things that show
+    // under and around it (the conservative one pixel shrink only covers rounding)
+    // The depth buffers are about a fifth of each eye's size
+    OcclusionCuller* occlusion = new OcclusionCuller(128, 144);
+    bool occlusionCulling = true;
+    Mesh* occluderMeshes[] = { model, car, dog };
+    for (Mesh* mesh : occluderMeshes)
+    {
+        if (!mesh->IsLoaded())
+            continue;
+
+        OccluderMesh occluder;
+        mesh->GetOccluder(occluder.positions, occluder.indices, 0.0f);
+        unsigned int id = occlusion->AddOccluderMesh(occluder);
+        for (SceneObject& object : sceneObjects)
+        {
+            if (object.mesh == mesh)
+                object.occluder = (int)id;
+        }
+    }
+
     glm::mat4 view;
-    glm::mat4 viewProjection;
+
+    // Each eye's camera, also used to pick levels of detail
+    glm::mat4 viewProjection1;
+    glm::mat4 viewProjection2;
 
     // Print instructions to the console.
     std::cout << "Use WASD to move, and the mouse to look around." << std::endl;
@@ -251,6 +479,11 @@ int main(int argc, char **argv)
     MakeRT(0);
     MakeRT(1);
 
+    // Culls the multi-draw indirect draws on the gpu, with the depth of the first render target
+    GpuCuller* culler = nullptr;
+    if (materialIndirect != nullptr && GpuCuller::Supported())
+        culler = new GpuCuller(viewportDimensions.x, viewportDimensions.y);
+
     // Here we prepare to put three timestamps,
     // one before the frame starts, one after 
     // the first eye finishes, one when the
@@ -293,6 +526,45 @@ int main(int argc, char **argv)
         if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS)
             numBlur = 2;
 
+        // K draws each batch with its own draw call, L draws the whole scene with multi-draw indirect
+        if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS)
+            batcher->SetIndirectMaterial(nullptr);
+
+        if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS && materialIndirect != nullptr)
+            batcher->SetIndirectMaterial(materialIndirect);
+
+        // G culls the multi-draw indirect draws on the gpu, H stops
+        if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS && culler != nullptr)
+        {
+            batcher->SetIndirectMaterial(materialIndirect);
+            batcher->SetCuller(culler);
+        }
+
+        if (glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS)
+            batcher->SetCuller(nullptr);
+
+        // C culls against both eyes on the CPU before batching, X stops
+        if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS)
+            batcher->SetCpuCulling(true);
+
+        if (glfwGetKey(window, GLFW_KEY_X) == GLFW_PRESS)
+            batcher->SetCpuCulling(false);
+
+        // Occlusion culling on the cpu on with N, off with M
+        if (glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS)
+            occlusionCulling = true;
+
+        if (glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS)
+            occlusionCulling = false;
+
+        // Z draws depth first and only shades what's in front, V shades everything as it's drawn.
+        // Benchmark with both to see which is faster here
+        if (glfwGetKey(window, GLFW_KEY_Z) == GLFW_PRESS)
+            batcher->SetDepthMaterial(materialDepth);
+
+        if (glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS)
+            batcher->SetDepthMaterial(nullptr);
+
         // dont need to print for now
 #if 0
         printf("%f\n", rotY);
@@ -332,7 +604,7 @@ int main(int argc, char **argv)
         if (numBlur > 0)
         {
             // set up the first render target
-            glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer[0]);
+            GetRenderState().BindFramebuffer(frameBuffer[0]);
         }
 
         
@@ -360,134 +632,100 @@ int main(int argc, char **argv)
         int v2startX = screenW / 2; // 50%
 #endif
 
-        glViewportIndexedf(0,   0,        0, sizeX, viewportDimensions.y);
-        glViewportIndexedf(1, v2startX,   0, sizeX, viewportDimensions.y);
+        GetRenderState().SetViewportIndexed(0,   0,        0, sizeX, viewportDimensions.y);
+        GetRenderState().SetViewportIndexed(1, v2startX,   0, sizeX, viewportDimensions.y);
 
 		// camera
         view = controller.GetTransform().GetInverseMatrix();
-        viewProjection = projection * view;
-        material1->SetMatrix(cameraView1VS, viewProjection);
+        viewProjection1 = projection * view;
+        material1->SetMatrix(cameraView1VS, viewProjection1);
+        materialDepth->SetMatrix(cameraView1VS, viewProjection1);
+        if (materialIndirect != nullptr)
+            materialIndirect->SetMatrix(cameraView1VS, viewProjection1);
 
         // camera
         temp = controller.GetTransform();
         temp.RotateY(rotY);
         view = temp.GetInverseMatrix();
         view = glm::translate(view, glm::vec3(moveX, 0, 0));
-        viewProjection = projection * view;
-        material1->SetMatrix(cameraView2VS, viewProjection);
-
-        // bear
-        transform.SetPosition(glm::vec3(-1, 0.2, -8));
-        transform.SetRotation(glm::vec3(0, -1.2, 0));
-        transform.SetScale(0.3f);
-        material1->SetMatrix(worldMatrixVS, transform.GetMatrix());
-        material1->SetTexture(colorTexFS, blankNormTex);
-        material1->SetTexture(normalTexFS, blankNormTex);
-        material1->Bind();
-        bear->Draw();
-
-        // kitten
-        transform.SetPosition(glm::vec3(-1, -1, -12));
-        transform.SetRotation(glm::vec3(0, 3.5 / 2, 0));
-        transform.SetScale(1.0f);
-        material1->SetMatrix(worldMatrixVS, transform.GetMatrix());
-        material1->SetTexture(colorTexFS, blankNormTex);
-        material1->SetTexture(normalTexFS, blankNormTex);
-        material1->Bind();
-        kitten->Draw();
-
-        // dog
-        transform.SetPosition(glm::vec3(0, -1, -12));
-        transform.SetRotation(glm::vec3(0, 3.5 / 2, 0));
-        transform.SetScale(1.0f);
-        material1->SetMatrix(worldMatrixVS, transform.GetMatrix());
-        material1->SetTexture(colorTexFS, dogTex);
-        material1->SetTexture(normalTexFS, blankNormTex);
-        material1->Bind();
-        dog->Draw();
-
-        // cube
-        transform.SetPosition(glm::vec3(7.5, -0.5, -10));
-        transform.SetRotation(glm::vec3(2, 0, 0));
-        transform.SetScale(1.0f);
-        material1->SetMatrix(worldMatrixVS, transform.GetMatrix());
-        material1->SetTexture(colorTexFS, crateTex);
-        material1->SetTexture(normalTexFS, blankNormTex);
-        material1->Bind();
-        crate->Draw();
-
-        // cube
-        transform.SetPosition(glm::vec3(6, -0.5, -10));
-        transform.SetRotation(glm::vec3(1, 0, 0));
-        transform.SetScale(1.0f);
-        material1->SetMatrix(worldMatrixVS, transform.GetMatrix());
-        material1->SetTexture(colorTexFS, crateTex);
-        material1->SetTexture(normalTexFS, blankNormTex);
-        material1->Bind();
-        crate->Draw();
-
-        // cube
-        transform.SetPosition(glm::vec3(-4, -0.5, -10));
-        transform.SetRotation(glm::vec3(0, 1, 0));
-        transform.SetScale(1.0f);
-        material1->SetMatrix(worldMatrixVS, transform.GetMatrix());
-        material1->SetTexture(colorTexFS, crateTex);
-        material1->SetTexture(normalTexFS, blankNormTex);
-        material1->Bind();
-        crate->Draw();
-
-        // cone
-        transform.SetPosition(glm::vec3(2.5, -0.5, -10));
-        transform.SetRotation(glm::vec3(3.14 / 2, 0, 0));
-        transform.SetScale(1.0f);
-        material1->SetMatrix(worldMatrixVS, transform.GetMatrix());
-        material1->SetTexture(colorTexFS, blankNormTex);
-        material1->SetTexture(normalTexFS, blankNormTex);
-        material1->Bind();
-        helix->Draw();
-
-        // car (again)
-        transform.SetPosition(glm::vec3(2.5, -1, -15));
-        transform.SetRotation(glm::vec3(0, 2, 0));
-        transform.SetScale(1.0f);
-        material1->SetMatrix(worldMatrixVS, transform.GetMatrix());
-        material1->SetTexture(colorTexFS, colCarTex);
-        material1->SetTexture(normalTexFS, blankNormTex);
-        material1->Bind();
-        car->Draw();
-
-        // car
-        transform.SetPosition(glm::vec3(-2.5, -1, -15));
-        transform.SetRotation(glm::vec3(0, 0.75, 0));
-        transform.SetScale(1.0f);
-        material1->SetMatrix(worldMatrixVS, transform.GetMatrix());
-        material1->SetTexture(colorTexFS, colCarTex);
-        material1->SetTexture(normalTexFS, blankNormTex);
-        material1->Bind();
-        car->Draw();
-
-        for (int i = 0; i < 10; i++)
+        viewProjection2 = projection * view;
+        material1->SetMatrix(cameraView2VS, viewProjection2);
+        materialDepth->SetMatrix(cameraView2VS, viewProjection2);
+        if (materialIndirect != nullptr)
+            materialIndirect->SetMatrix(cameraView2VS, viewProjection2);
+
+        // The toruses spin, so their boxes in the bvh have to keep up
+        for (unsigned int i = firstTorus; i < firstTorus + torusCount; i++)
+            sceneObjects[i].transform.RotateY(dt * 0.5f);
+
+        // Give the bvh a new box for everything that moved, then find
+        // everything either eye might see, in one walk of the tree
+        for (unsigned int i = 0; i < sceneObjects.size(); i++)
+        {
+            SceneObject& object = sceneObjects[i];
+            if (object.transform.GetVersion() == object.bvhVersion)
+                continue;
+
+            glm::vec3 boundsMin, boundsMax;
+            object.mesh->GetBounds(boundsMin, boundsMax);
+            sceneBvh->UpdateObject(i, object.transform.GetMatrix(), boundsMin, boundsMax);
+            object.bvhVersion = object.transform.GetVersion();
+        }
+        sceneBvh->Refit();
+        sceneBvh->Query(MakeFrustum(viewProjection1), MakeFrustum(viewProjection2), visibleObjects);
+
+        // Rasterize the occluders the bvh found, and test everything else it found against
+        // them, on a worker thread. This thread carries on with the frame until it needs the answer
+        if (occlusionCulling)
+        {
+            occlusion->BeginFrame(viewProjection1, viewProjection2);
+            for (unsigned int i : visibleObjects)
+            {
+                SceneObject& object = sceneObjects[i];
+                if (object.occluder >= 0)
+                    occlusion->AddOccluder(object.occluder, object.transform.GetMatrix());
+
+                glm::vec3 boundsMin, boundsMax, worldMin, worldMax;
+                object.mesh->GetBounds(boundsMin, boundsMax);
+                TransformBox(object.transform.GetMatrix(), boundsMin, boundsMax, worldMin, worldMax);
+                occlusion->AddObject(worldMin, worldMax);
+            }
+            occlusion->StartCulling(GetSharedThreadPool());
+        }
+
+        // Meshes far enough away from both eyes get drawn with fewer triangles
+        Mesh::SetLodViews(viewProjection1, viewProjection2, viewportDimensions.y);
+
+        // One frustum around both eyes, for CPU culling, and the view batches are sorted front to back in
+        batcher->SetCullViews(viewProjection1, viewProjection2);
+
+        if (culler != nullptr)
         {
-            // torus
-            transform.SetPosition(glm::vec3(i * 2 - 10, 0, -20));
-            transform.SetRotation(glm::vec3(i, i * 2, i * 3));
-            transform.SetScale(1.0f);
-            material1->SetMatrix(worldMatrixVS, transform.GetMatrix());
-            material1->SetTexture(colorTexFS, rustyTex);
-            material1->SetTexture(normalTexFS, blankNormTex);
-            material1->Bind();
-            torus->Draw();
+            culler->SetViews(viewProjection1, viewProjection2,
+                glm::vec4(0, 0, sizeX, viewportDimensions.y), glm::vec4(v2startX, 0, sizeX, viewportDimensions.y));
         }
 
-        // plane
-        transform.SetPosition(glm::vec3(0, 0, -10));
-        transform.SetRotation(glm::vec3(0, 0, 0));
-        transform.SetScale(10.0f);
-        material1->SetMatrix(worldMatrixVS, transform.GetMatrix());
-        material1->SetTexture(colorTexFS, colPlaneTex);
-        material1->SetTexture(normalTexFS, normPlaneTex);
-        material1->Bind();
-        model->Draw();
+        // Count the gl state calls made this frame, and the ones that got skipped
+        GetRenderState().BeginFrame();
+
+        // Objects were added to the occlusion culler in the order the bvh found them
+        if (occlusionCulling)
+            occlusion->FinishCulling();
+
+        for (unsigned int v = 0; v < visibleObjects.size(); v++)
+        {
+            if (occlusionCulling && !occlusion->GetVisible()[v])
+                continue;
+
+            SceneObject& object = sceneObjects[visibleObjects[v]];
+            material1->SetTexture(colorTexFS, object.colorTexture);
+            material1->SetTexture(normalTexFS, object.normalTexture);
+            batcher->Add(object.mesh, material1, object.transform.GetMatrix());
+        }
+
+        // Draw everything added above. Copies of the same mesh with the same
+        // textures (the crates, the cars, the toruses) are drawn with one draw call
+        batcher->Flush();
 
         if (benchmarkThisFrame)
         {
@@ -497,7 +735,17 @@ int main(int argc, char **argv)
             lastQuery = 2;
         }
 
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        GetRenderState().BindFramebuffer(0);
+
+        // Keep this frame's depth for culling next frame. Without blur,
+        // the frame was drawn to the screen, and there's no depth texture to keep
+        if (culler != nullptr)
+        {
+            if (numBlur > 0 && batcher->IsCulling())
+                culler->BuildHiZ(depthTexture[0]);
+            else
+                culler->InvalidateHiZ();
+        }
 
         // if you are blurring with one pass
         if (numBlur == 1)
@@ -506,13 +754,12 @@ int main(int argc, char **argv)
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
             glClearColor(0.0, 0.0, 0.0, 0.0);
 
-            glViewport(0, 0, viewportDimensions.x, viewportDimensions.y);
+            GetRenderState().SetViewport(0, 0, viewportDimensions.x, viewportDimensions.y);
             programBlurOne->Bind();
 
             int loc = glGetUniformLocation(programBlurOne->GetGLShaderProgram(), "tex");
             
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, screenTexture[0]);
+            GetRenderState().BindTexture(0, GL_TEXTURE_2D, screenTexture[0]);
             glUniform1i(loc, 0);
 
             glDrawArrays(GL_TRIANGLES, 0, 3);
@@ -530,19 +777,18 @@ int main(int argc, char **argv)
             // Part 1 horizontal blur 
             {
                 // set up the second render target
-                glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer[1]);
+                GetRenderState().BindFramebuffer(frameBuffer[1]);
 
                 // Clear screen
                 glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
                 glClearColor(0.0, 0.0, 0.0, 0.0);
 
-                glViewport(0, 0, viewportDimensions.x, viewportDimensions.y);
+                GetRenderState().SetViewport(0, 0, viewportDimensions.x, viewportDimensions.y);
                 programBlurTwoPart1->Bind();
                 
                 int loc = glGetUniformLocation(programBlurOne->GetGLShaderProgram(), "tex");
 
-                glActiveTexture(GL_TEXTURE0);
-                glBindTexture(GL_TEXTURE_2D, screenTexture[0]);
+                GetRenderState().BindTexture(0, GL_TEXTURE_2D, screenTexture[0]);
                 glUniform1i(loc, 0);
 
                 glDrawArrays(GL_TRIANGLES, 0, 3);
@@ -554,7 +800,7 @@ int main(int argc, char **argv)
                 }
 
                 // unbind
-                glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                GetRenderState().BindFramebuffer(0);
             }
 
             // Part 2 vertical blur
@@ -563,13 +809,12 @@ int main(int argc, char **argv)
                 glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
                 glClearColor(0.0, 0.0, 0.0, 0.0);
 
-                glViewport(0, 0, viewportDimensions.x, viewportDimensions.y);
+                GetRenderState().SetViewport(0, 0, viewportDimensions.x, viewportDimensions.y);
                 programBlurTwoPart2->Bind();
 
                 int loc = glGetUniformLocation(programBlurOne->GetGLShaderProgram(), "tex");
 
-                glActiveTexture(GL_TEXTURE0);
-                glBindTexture(GL_TEXTURE_2D, screenTexture[0]);
+                GetRenderState().BindTexture(0, GL_TEXTURE_2D, screenTexture[0]);
                 glUniform1i(loc, 0);
 
                 glDrawArrays(GL_TRIANGLES, 0, 3);
@@ -606,6 +851,15 @@ int main(int argc, char **argv)
 
             system("cls");
             printf("Both eyes: %f ms\n", (endEye1 - startEye1) / 1000000.0);
+            Mesh::PrintLodStats();
+            GetGeometryArena().PrintStats();
+            GetRenderState().PrintStats();
+            batcher->PrintStats();
+            sceneBvh->PrintStats();
+            if (occlusionCulling)
+                occlusion->PrintStats();
+            if (batcher->IsCulling())
+                culler->PrintStats();
             
             if (numBlur == 0)
             {
@@ -639,6 +893,15 @@ int main(int argc, char **argv)
 
     // Free material should free all objects used by material
     delete material1;
+    delete materialIndirect;
+    delete materialDepth;
+    delete batcher;
+    delete culler;
+    delete sceneBvh;
+    delete occlusion;
+
+    // The shared vertex and index buffers have to go while the context is still here
+    GetGeometryArena().Release();
 
 	// Free GLFW memory.
 	glfwTerminate();
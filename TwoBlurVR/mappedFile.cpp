@@ -0,0 +1,134 @@
+/*
+Title: Blur Optimization VR
+File Name: mappedFile.cpp
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(std::string filePath)
+{
+#ifdef _WIN32
+    // Open the file for reading, and tell windows we will read it front to back
+    HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+    if (file == INVALID_HANDLE_VALUE)
+        return;
+
+    m_fileHandle = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size))
+        return;
+
+    m_size = (size_t)size.QuadPart;
+
+    // windows can't map an empty file, but an empty file is still a valid file
+    if (m_size == 0)
+    {
+        m_open = true;
+        return;
+    }
+
+    // A mapping object describes the file, a view is the actual pointer we read from
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL)
+        return;
+
+    m_mappingHandle = mapping;
+
+    m_data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    m_open = (m_data != nullptr);
+#else
+    m_fileDescriptor = open(filePath.c_str(), O_RDONLY);
+    if (m_fileDescriptor < 0)
+        return;
+
+    struct stat info;
+    if (fstat(m_fileDescriptor, &info) != 0)
+        return;
+
+    m_size = (size_t)info.st_size;
+
+    if (m_size == 0)
+    {
+        m_open = true;
+        return;
+    }
+
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fileDescriptor, 0);
+    if (data == MAP_FAILED)
+        return;
+
+    // we read the file front to back, so let the kernel read ahead
+    madvise(data, m_size, MADV_SEQUENTIAL);
+
+    m_data = (const char*)data;
+    m_open = true;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+    if (m_data != nullptr)
+        UnmapViewOfFile(m_data);
+
+    if (m_mappingHandle != nullptr)
+        CloseHandle(m_mappingHandle);
+
+    if (m_fileHandle != nullptr)
+        CloseHandle(m_fileHandle);
+#else
+    if (m_data != nullptr)
+        munmap((void*)m_data, m_size);
+
+    if (m_fileDescriptor >= 0)
+        close(m_fileDescriptor);
+#endif
+}
+
+bool MappedFile::IsOpen()
+{
+    return m_open;
+}
+
+const char* MappedFile::GetData()
+{
+    return m_data;
+}
+
+size_t MappedFile::GetSize()
+{
+    return m_size;
+}
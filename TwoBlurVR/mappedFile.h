@@ -0,0 +1,69 @@
+/*
+Title: Blur Optimization VR
+File Name: mappedFile.h
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <string>
+#include <cstddef>
+
+// Wraps a read-only memory mapping of a whole file.
+// Instead of copying the file into our own buffers with ifstream,
+// the operating system maps the file straight into our address space,
+// and pages it in from the disk cache as we touch it.
+class MappedFile
+{
+
+private:
+    // Pointer to the first byte of the file, and how many bytes there are
+    const char* m_data = nullptr;
+    size_t m_size = 0;
+    bool m_open = false;
+
+    // Operating system handles, these are void* on
+    // windows so that we do not have to include windows.h here
+#ifdef _WIN32
+    void* m_fileHandle = nullptr;
+    void* m_mappingHandle = nullptr;
+#else
+    int m_fileDescriptor = -1;
+#endif
+
+public:
+    // Maps the file, check IsOpen to see if it worked
+    MappedFile(std::string filePath);
+
+    // Unmaps the file and closes the handles
+    ~MappedFile();
+
+    // Returns true if the file was mapped (empty files count as open)
+    bool IsOpen();
+
+    // The mapping is only valid for as long as this object lives
+    const char* GetData();
+    size_t GetSize();
+
+private:
+    // Mappings can't be shared, so don't allow copies
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+};
@@ -23,6 +23,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "material.h"
+#include "renderState.h"
 
 Material::Material(ShaderProgram * shaderProgram)
 {
@@ -35,7 +36,12 @@ Material::~Material()
 {
     // Free shader program
     if (m_shaderProgram != nullptr)
+    {
+        // A new material could end up at this address, it shouldn't think its uniforms are uploaded
+        if (m_shaderProgram->GetUniformOwner() == this)
+            m_shaderProgram->SetUniformOwner(nullptr);
         m_shaderProgram->DecRefCount();
+    }
 
     // Free textures
     for (int i = 0; i < m_textures.size(); i++)
@@ -76,6 +82,11 @@ void Material::SetTexture(char* name, Texture* texture)
     // There is no match, add the new texture.
     m_textureUniforms.push_back(uniform);
     m_textures.push_back(texture);
+
+    // Use the the texture from GL_TEXTURE0 + i at the given texture uniform location.
+    // The unit never changes, so this only has to be set once
+    glUniform1i(uniform, (GLint)m_textureUniforms.size() - 1);
+    GetRenderState().Count(StateUniform, true);
 }
 
 void Material::SetMatrix(char* name, glm::mat4 matrix)
@@ -99,7 +110,12 @@ void Material::SetMatrix(char* name, glm::mat4 matrix)
         // If there's a match replace the matrix.
         if (m_matrixUniforms[i] == uniform)
         {
-            m_matrices[i] = matrix;
+            // Only upload it again if it's different
+            if (m_matrices[i] != matrix)
+            {
+                m_matrices[i] = matrix;
+                m_matricesDirty[i] = true;
+            }
             return;
         }
     }
@@ -107,30 +123,61 @@ void Material::SetMatrix(char* name, glm::mat4 matrix)
     // There is no match, add the new matrix.
     m_matrixUniforms.push_back(uniform);
     m_matrices.push_back(matrix);
+    m_matricesDirty.push_back(true);
 }
 
 
 void Material::Bind()
 {
+    RenderState& state = GetRenderState();
     m_shaderProgram->Bind();
 
-    // Bind all textures
+    // Bind all textures, each to the unit its uniform was given in SetTexture.
+    // Textures that are already bound there are skipped
     for (int i = 0; i < m_textureUniforms.size(); i++)
     {
-        // This enum value can be incremented to bind to different texture locations
-        glActiveTexture(GL_TEXTURE0 + i);
+        state.BindTexture(i, GL_TEXTURE_2D, m_textures[i]->GetGLTexture());
+    }
 
-        // Bind the texture
-        glBindTexture(GL_TEXTURE_2D, m_textures[i]->GetGLTexture());
+    // If another material used this program since we last did, the program
+    // has its matrices now, so all of ours need to go up again
+    bool uploadAll = m_shaderProgram->GetUniformOwner() != this;
+    m_shaderProgram->SetUniformOwner(this);
 
-        // Use the the texture from GL_TEXTURE0 + i at the given texture uniform location.
-        glUniform1i(m_textureUniforms[i], i);
+    // Set matrix data that changed
+    for (int i = 0; i < m_matrixUniforms.size(); i++)
+    {
+        bool upload = uploadAll || m_matricesDirty[i];
+        if (upload)
+        {
+            glUniformMatrix4fv(m_matrixUniforms[i], 1, GL_FALSE, &(m_matrices[i][0][0]));
+            m_matricesDirty[i] = false;
+        }
+        state.Count(StateUniform, upload);
     }
+}
 
-    // Set all matrix data
-    for (int i = 0; i < m_matrixUniforms.size(); i++)
+ShaderProgram* Material::GetShaderProgram()
+{
+    return m_shaderProgram;
+}
+
+const std::vector<Texture*>& Material::GetTextures()
+{
+    return m_textures;
+}
+
+void Material::SetTextures(const std::vector<Texture*>& textures)
+{
+    // Units stay the same, so the sampler uniforms don't change
+    for (size_t i = 0; i < m_textures.size() && i < textures.size(); i++)
     {
-        glUniformMatrix4fv(m_matrixUniforms[i], 1, GL_FALSE, &(m_matrices[i][0][0]));
+        if (m_textures[i] == textures[i])
+            continue;
+
+        textures[i]->IncRefCount();
+        m_textures[i]->DecRefCount();
+        m_textures[i] = textures[i];
     }
 }
 
@@ -139,8 +186,7 @@ void Material::Unbind()
     // Unbind all owned objects.
     for (int i = 0; i < m_textureUniforms.size(); i++)
     {
-        glActiveTexture(GL_TEXTURE0 + i);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        GetRenderState().BindTexture(i, GL_TEXTURE_2D, 0);
     }
 
     m_shaderProgram->Unbind();
@@ -43,6 +43,8 @@ private:
     std::vector<GLuint> m_matrixUniforms;
     // Matrices to bind with material.
     std::vector<glm::mat4> m_matrices;
+    // Matrices that changed since they were last uploaded.
+    std::vector<bool> m_matricesDirty;
 
 
 public:
@@ -55,4 +57,13 @@ public:
 
     void Bind();
     void Unbind();
+
+    ShaderProgram* GetShaderProgram();
+
+    // The textures, in the order of the units they're bound to
+    const std::vector<Texture*>& GetTextures();
+
+    // Replaces the textures with ones from GetTextures, so a material can be set back
+    // to how it was when it was used to draw something
+    void SetTextures(const std::vector<Texture*>& textures);
 };
\ No newline at end of file
@@ -23,304 +23,932 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "mesh.h"
-
-
+#include "objLoader.h"
+#include "meshCache.h"
+#include "meshCodec.h"
+#include "geometryArena.h"
+#include "renderState.h"
+#include "meshOptimizer.h"
+#include "vertexPacking.h"
+#include "simplifier.h"
+#include "tangents.h"
+#include "proceduralMesh.h"
+#include <chrono>
+
+
+
+// Time spent loading meshes, split by where they came from,
+// so a cold start (parsing obj files) can be compared to a warm one (.meshbin)
+static double objLoadSeconds = 0;
+static int objLoadCount = 0;
+static double cacheLoadSeconds = 0;
+static int cacheLoadCount = 0;
+static double proceduralLoadSeconds = 0;
+static int proceduralLoadCount = 0;
+
+// A level of detail is used when its error would be smaller than this many pixels on screen
+#define MeshLodPixelError 1.0f
+
+// The cameras levels of detail are picked for, see Mesh::SetLodViews.
+// With no screen height, every mesh draws in full.
+static glm::mat4 lodViewProjection[2];
+static float lodViewportHeight = 0;
+
+// Triangles drawn this frame, and how many there would have been without levels of detail
+static unsigned long long lodTrianglesDrawn = 0;
+static unsigned long long lodTrianglesFull = 0;
+static unsigned int lodDraws[MeshMaxLods] = {};
 
 Mesh::Mesh(std::vector<Vertex3dUVNormal> vertices, std::vector<unsigned int> indices)
 {
-	m_vertices = vertices;
-	m_indices = indices;
-	// Create the shape by setting up buffers
-
-	// Set up vertex buffer
-	glGenBuffers(1, &m_vertexBuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
-	glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(Vertex3dUVNormal), &m_vertices[0], GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	// Taken by value, so moving leaves the caller's copy (or temporary) as the only one made
+	m_vertices = std::move(vertices);
+	m_indices = std::move(indices);
 
-	// Set up index buffer
-	glGenBuffers(1, &m_indexBuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, m_indexBuffer);
-	glBufferData(GL_ARRAY_BUFFER, m_indices.size() * sizeof(unsigned int), &m_indices[0], GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	// Create the shape by setting up buffers
+	CalculateBounds();
+	CreateBuffers(m_vertices.data(), m_vertices.size(), sizeof(Vertex3dUVNormal), m_indices.data(), m_indices.size());
 }
 
-Mesh::Mesh(std::string filePath, bool calcTangents)
+Mesh::Mesh(const ProceduralMesh& shape, unsigned int options)
 {
+	auto start = std::chrono::high_resolution_clock::now();
+	m_packed = (options & MeshPackVertices) != 0;
+	size_t vertexStride = m_packed ? sizeof(PackedVertex) : sizeof(Vertex3dUVNormal);
+	size_t vertexCount = shape.GetVertexCount();
+	size_t indexCount = shape.GetIndexCount();
+
+	// The box is known up front, the sphere comes out of making the vertices.
+	// Always one level, a triangle list in the smallest index size
+	m_boundsMin = shape.boundsMin;
+	m_boundsMax = shape.boundsMax;
+	m_sphereCenter = (m_boundsMin + m_boundsMax) * 0.5f;
+	m_lods.push_back({ 0, (unsigned int)indexCount, 0 });
+	m_indexLayout.indexSize = ChooseIndexSize(vertexCount);
+	m_indexLayout.strips = false;
+	m_indexLayout.ranges.push_back({ 0, (unsigned int)indexCount });
+
+	GeometryArena& arena = GetGeometryArena();
+	m_vertexRange = arena.AllocateVertices(vertexCount, vertexStride);
+	m_indexRange = arena.AllocateIndices(indexCount, m_indexLayout.indexSize);
+
+	void* vertices;
+	void* indices;
+	arena.BeginStaging(m_vertexRange, m_indexRange, vertices, indices);
+	if (vertices == nullptr)
+	{
+		printf("Can't map the staging buffer for a %d vertex procedural mesh\n", (int)vertexCount);
+		MakeEmpty();
+		return;
+	}
+
+	m_sphereRadius = GenerateMesh(shape, m_packed, vertices, indices, m_indexLayout.indexSize, &GetSharedThreadPool());
+	if (!arena.EndStaging(m_vertexRange, m_indexRange))
+	{
+		printf("Lost the staging buffer for a %d vertex procedural mesh\n", (int)vertexCount);
+		MakeEmpty();
+		return;
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	printf("procedural mesh: %d vertices x %d bytes, %d triangles, %d byte indices in %.2f ms\n",
+		(int)vertexCount, (int)vertexStride, (int)(indexCount / 3), (int)m_indexLayout.indexSize, seconds * 1000.0);
+	proceduralLoadSeconds += seconds;
+	proceduralLoadCount++;
+}
 
-    // before we do anything, lets first check if the file even exists:
-    std::ifstream file(filePath);
+Mesh::Mesh(std::string filePath, bool calcTangents) : Mesh(filePath, calcTangents, 0)
+{
+}
 
-    if (!file.good())
+Mesh::Mesh(std::string filePath, bool calcTangents, unsigned int options)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // The options that change the finished mesh, the cache has to match them.
+    // Strips are made on the way to the gpu, the cache always has the triangle list
+    unsigned int cacheFlags = MeshCacheWelded | (calcTangents ? MeshCacheTangents : 0) | ((options & ~MeshTriangleStrips) << 8);
+    if (options & MeshCompressCache)
+        cacheFlags |= MeshCacheCompressed;
+    std::string cachePath = filePath + ".meshbin";
+    m_packed = (options & MeshPackVertices) != 0;
+    unsigned int vertexStride = m_packed ? sizeof(PackedVertex) : sizeof(Vertex3dUVNormal);
+
+    m_makeStrips = (options & MeshTriangleStrips) != 0;
+    if (m_makeStrips && !RenderState::PrimitiveRestartSupported())
     {
-        // If we encounter an error, print a message and return.
-        std::cout << "Can't read file: " << filePath << std::endl;
-        return;
+        printf("%s: strips need GL_PRIMITIVE_RESTART_FIXED_INDEX, drawing a triangle list\n", filePath.c_str());
+        m_makeStrips = false;
     }
 
-    // These are temporary, and will contain our vertex data while we read from the file
-    std::vector<glm::vec3> vertices;
-    std::vector<glm::vec2> uvs;
-    std::vector<glm::vec3> normals;
-
-
-    // Now we have to process the string . . .
-    std::string line;
-
-    // Loop over every line in the file, storing it in the string 'line'
-    while (std::getline(file, line))
+    // If this obj was loaded before, the finished mesh is waiting in a .meshbin file.
+    // The file is mapped, so the pointers go straight to the gpu without any copies.
+    // A compressed cache is decoded straight into the gpu buffers instead.
+    bool loadedFromCache = false;
+    bool sourceTimeStale = false;
     {
-        /*
-
-        obj files have a ton of features, but we'll only be using the core set here
-
-        =================================================
-        Lines starting with just 'v' are vertex positions. They might look like this:
-        v 1.0 -2.5345 3.141
-        The positions are stored as floating point values seperated by spaces
-        =================================================
-        vt is for uvs aka texture coordinates:
-        vt 0.12 0.87
-        Remember they only have an x and y value
-        =================================================
-        vn is for our normals:
-        vn -0.473 0.1201 0.7778
-        =================================================
-        f indicates faces, they are the most complex and look something like this:
-        f 100/1/1 101/1/1 102/3/2 103/3/2
-
-        each set of values  here ex 100/1/1, is a vertex
-        the first (100) is the index of the vertex position in the list of vertices as they appear in the file
-        the second (1) is the index of the uv coordinates in the list of uvs the same way
-        and the third (1) is the index of our normals in the corresponding list of normals
-        
-        You'll notice that there are 4 of these groupings.
-        That is because those 4 vertices form a quad.
-        Some of them will also appear in groups of 3, as tris, so we'll have to account for both cases.
-
-        Also, since obj files are ordered differently than how we use them, we have to reorganize them.
-        */
-
-        
-        // Let's get started:
-
-
-        // check if it's a vertex position
-        // strncmp checks if the first n characters of these strings match (n is 2 here)
-        if (strncmp("v ", &line[0], 2) == 0) 
-        {
-            // strtok takes in a string and a delimiter, storing the string internally.
-            // it also returns a pointer to the first character of the first word (split by the character given, " ").
-            strtok(&line[0], " "); 
-            // every time after the first, strtok returns the next word (splitting with the given character) until it runs out of words.
-            float x = std::stof(strtok(NULL, " "));
-            float y = std::stof(strtok(NULL, " "));
-            float z = std::stof(strtok(NULL, " "));
-            vertices.push_back(glm::vec3(x, y, z)); // make a vector from the given values and store it.
-        }
-        // texture coordinates
-        else if (strncmp("vt", &line[0], 2) == 0)
-        {
-            // same as above, but only 2 floats per value
-            strtok(&line[0], " ");
-            float u = std::stof(strtok(NULL, " "));
-            float v = std::stof(strtok(NULL, " "));
-            uvs.push_back(glm::vec2(u, v));
-        }
-        // vertex normals
-        else if (strncmp("vn", &line[0], 2) == 0)
+        MeshCache cache(cachePath);
+        if (cache.IsValidFor(filePath, cacheFlags, vertexStride))
         {
-            // one more time for normals!
-            strtok(&line[0], " ");
-            float x = std::stof(strtok(NULL, " "));
-            float y = std::stof(strtok(NULL, " "));
-            float z = std::stof(strtok(NULL, " "));
-            normals.push_back(glm::vec3(x, y, z));
-        }
-        // faces (these should be last in the file, so we can just interpret them immediately)
-        else if (strncmp("f", &line[0], 1) == 0)
-        {
-            // keep track of the indices from our vector/uv/normal buffer for this face
-            std::vector<unsigned int> faceIndices;
-
-            // this will store the vertices as we read over them.
-            char* token = strtok(&line[0], " ");
-
-            // loop over the vertices until we get NULL (what strtok returns at the end of the line)
-            while ((token = strtok(0, "/")) != NULL)
+            m_boundsMin = cache.GetBoundsMin();
+            m_boundsMax = cache.GetBoundsMax();
+            m_sphereCenter = glm::vec3(cache.GetBoundingSphere());
+            m_sphereRadius = cache.GetBoundingSphere().w;
+            m_meshlets.assign(cache.GetMeshlets(), cache.GetMeshlets() + cache.GetMeshletCount());
+            m_lods.assign(cache.GetLods(), cache.GetLods() + cache.GetLodCount());
+
+            bool loaded = true;
+            if (cache.IsCompressed())
+                loaded = CreateBuffers(cache, vertexStride, filePath);
+            else
             {
-                // split up index data (important, obj file indexing starts at 1, so we have to subtract 1 here or bad things will happen)
-                int i = std::stoi(token) - 1;
-                glm::vec3 vp = vertices[i];
-
-                token = strtok(0, "/");
-                int j = std::stoi(token) - 1;
-                glm::vec2 vt = uvs[j];
-
-                token = strtok(0, " ");
-                int k = std::stoi(token) - 1;
-                glm::vec3 vn = normals[k];
-
-                // Unfortunately obj files store vertex data in seperate groups.
-                // We could use the data that way, but we would repeat tons of vertices, and be unable to use an index buffer.
-                // Instead we're going to compare vertices to avoid redundant values.
-
-                // does this vertex exist already?
-                bool newVertex = false;
-
-#if 0
-                // loop over all existing vertices
-                for (int i = 0; i < m_vertices.size(); i++)
-                {
-                    Vertex3dUVNormal other = m_vertices[i];
-                    // if match found...
-                    if (vp == other.m_position &&
-                        vt == other.m_texCoord &&
-                        vn == other.m_normal)
-                    {
-                        //...reuse the index for this face and stop iterating
-                        faceIndices.push_back(i);
-                        newVertex = true;
-                        break;
-                    }
-                }
-#endif
-
-                // if a new vertex, create and add it to the collection
-                if (!newVertex)
-                {
-                    // the index for this vertex will be at the end of the collection
-                    faceIndices.push_back(m_vertices.size());
-                    m_vertices.push_back(Vertex3dUVNormal(vp, vt, vn, glm::vec3()));
-                }
+                CreateBuffers(cache.GetVertices(), cache.GetVertexCount(), vertexStride, cache.GetIndices(), cache.GetIndexCount());
+                if (cache.GetPositionCount() > 0)
+                    CreatePositionBuffers(cache.GetPositions(), cache.GetPositionCount(), cache.GetPositionIndices(),
+                                          cache.GetIndices(), cache.GetVertexCount());
             }
 
-            // now that our face is using the final indices, we need to add it to our index buffer
-
-            // add the first 3 indices of the face to our index collection to form a triangle
-            for (int i = 0; i < 3; i++)
+            if (loaded)
             {
-                m_indices.push_back(faceIndices[i]);
+                PrintIndexStats(filePath);
+                cacheLoadSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+                cacheLoadCount++;
+                loadedFromCache = true;
+                sourceTimeStale = cache.IsSourceTimeStale();
             }
-            // the face is a quad, add 3 more vertices to form a triangle
-            if (faceIndices.size() == 4)
+            else
             {
-                m_indices.push_back(faceIndices[0]);
-                m_indices.push_back(faceIndices[2]);
-                m_indices.push_back(faceIndices[3]);
+                // The cache is broken, parse the obj and write a new one
+                std::cout << "Can't decode mesh cache: " << cachePath << std::endl;
+                FreeBuffers();
+                m_meshlets.clear();
+                m_lods.clear();
             }
-
-
-            // we're done here
-        }
-        // other line, just print it out for debug purposes
-        else 
-        {
-            std::cout << line << std::endl;
         }
     }
 
+    // The obj only has a new time (a git checkout or a copy), and the cache is closed now,
+    // so store the new time. Otherwise every launch would hash the whole obj again
+    if (loadedFromCache)
+    {
+        if (sourceTimeStale && !MeshCache::UpdateSourceTime(cachePath, filePath))
+            std::cout << "Can't update mesh cache: " << cachePath << std::endl;
+        return;
+    }
 
-    // After all of that nonsense close the file
-    file.close();
+    // Read the obj file straight into our vertex and index collections.
+    // The obj format, and how the file gets read, is explained in objLoader.cpp
+    // Big files are split into pieces and read by every core at once.
+    // Corners that share a position, uv and normal are welded into one vertex,
+    // so the index buffer actually gets to reuse vertices.
+    ObjLoadStats stats;
+    if (!LoadObjParallel(filePath, m_vertices, m_indices, GetSharedThreadPool(), true, &stats))
+    {
+        // The loader already printed what went wrong
+        MakeEmpty();
+        return;
+    }
+
+    printf("%s: welded %d corners into %d vertices\n", filePath.c_str(), (int)stats.cornerCount, (int)stats.vertexCount);
 
     // If we said to calculate tangents, do that now
     if (calcTangents)
     {
         CalculateTangents();
     }
+
+    // Anything optional that was asked for
+    Optimize(filePath, options);
+
+    // The packed positions are stored relative to this box
+    CalculateBounds();
+
+    // What actually goes to the gpu, and into the cache
+    const void* gpuVertices = m_vertices.data();
+    std::vector<PackedVertex> packed;
+    if (m_packed)
+    {
+        PackVertices(m_vertices, m_boundsMin, m_boundsMax, packed);
+        gpuVertices = packed.data();
+
+        // Show how much precision the smaller vertices cost
+        PackingError error = MeasurePackingError(m_vertices, packed, m_boundsMin, m_boundsMax);
+        printf("%s: packed %d -> %d bytes per vertex, position error max %f avg %f, uv error max %f, normal error max %.3f deg, tangent error max %.3f deg\n",
+            filePath.c_str(), (int)sizeof(Vertex3dUVNormal), (int)sizeof(PackedVertex),
+            error.maxPositionError, error.averagePositionError, error.maxUVError, error.maxNormalDegrees, error.maxTangentDegrees);
+    }
+
+    // Depth only passes get their own smaller copy of the positions
+    std::vector<unsigned char> positions;
+    std::vector<unsigned int> positionIndices;
+    if (options & MeshPositionStream)
+    {
+        MakePositionStream(gpuVertices, vertexStride, positions, positionIndices, filePath);
+    }
+
     // create buffers for opengl just like normal
+    CreateBuffers(gpuVertices, m_vertices.size(), vertexStride, m_indices.data(), m_indices.size());
+    if (!positions.empty())
+        CreatePositionBuffers(positions.data(), positions.size() / GetPositionStride(), positionIndices.data(), m_indices.data(), m_vertices.size());
+    PrintIndexStats(filePath);
+
+    objLoadSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    objLoadCount++;
+
+    // Save the finished mesh for next time. If it can't be written
+    // (read only folder, for example) we just parse again next launch.
+    if (!MeshCache::Write(cachePath, filePath, cacheFlags, gpuVertices, vertexStride, (unsigned int)m_vertices.size(), m_indices, m_meshlets, m_lods,
+        positions.data(), (unsigned int)GetPositionStride(), (unsigned int)(positions.size() / GetPositionStride()), positionIndices,
+        m_boundsMin, m_boundsMax, glm::vec4(m_sphereCenter, m_sphereRadius)))
+    {
+        std::cout << "Can't write mesh cache: " << cachePath << std::endl;
+    }
+}
 
-	// Set up vertex buffer
-    glGenBuffers(1, &m_vertexBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(Vertex3dUVNormal), &m_vertices[0], GL_STATIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+// Copies vertices into a new range of the geometry arena
+static void UploadVertices(const void* vertices, size_t vertexCount, size_t vertexStride, ArenaAllocation& vertexRange)
+{
+	GeometryArena& arena = GetGeometryArena();
+	vertexRange = arena.AllocateVertices(vertexCount, vertexStride);
 
-    // Set up index buffer
-    glGenBuffers(1, &m_indexBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, m_indexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, m_indices.size() * sizeof(unsigned int), &m_indices[0], GL_STATIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+	// GL_COPY_WRITE_BUFFER doesn't change any draw state, the arena stays bound for drawing
+	glBindBuffer(GL_COPY_WRITE_BUFFER, arena.GetVertexBuffer());
+	glBufferSubData(GL_COPY_WRITE_BUFFER, vertexRange.offset, vertexRange.size, vertices);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
 }
 
-Mesh::~Mesh()
+void Mesh::UploadIndices(const unsigned int* indices, size_t vertexCount, ArenaAllocation& indexRange, IndexLayout& layout)
 {
-	// Clear buffers for the shape object when done using them.
-	glDeleteBuffers(1, &m_vertexBuffer);
-	glDeleteBuffers(1, &m_indexBuffer);
+	// Every level of detail, one after another, in the smallest index size that fits
+	std::vector<unsigned char> packed;
+	PackIndices(indices, m_lods.data(), m_lods.size(), vertexCount, m_makeStrips, packed, layout);
+
+	GeometryArena& arena = GetGeometryArena();
+	indexRange = arena.AllocateIndices(packed.size() / layout.indexSize, layout.indexSize);
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, arena.GetIndexBuffer());
+	glBufferSubData(GL_COPY_WRITE_BUFFER, indexRange.offset, indexRange.size, packed.data());
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
 }
 
-// This macro will help us make the attribute pointers
-// position, size, type, struct, element
-#define SetupAttribute(index, size, type, structure, element) \
-	glVertexAttribPointer(index, size, type, 0, sizeof(structure), (void*)offsetof(structure, element)); \
+void Mesh::UploadPositionIndices(const unsigned int* positionIndices, size_t positionCount, const unsigned int* indices, size_t vertexCount)
+{
+	// Which position each vertex uses. Both lists have the same triangles in the same order
+	size_t listCount = 0;
+	for (const MeshLod& lod : m_lods)
+		if (lod.firstIndex + lod.indexCount > listCount)
+			listCount = lod.firstIndex + lod.indexCount;
+
+	std::vector<unsigned int> remap(vertexCount, 0);
+	for (size_t i = 0; i < listCount; i++)
+		remap[indices[i]] = positionIndices[i];
+
+	// Pack the full stream again (the same input makes the same strips), and swap its vertices for positions.
+	// Stripifying the welded positions on their own would find different strips
+	std::vector<unsigned char> packed;
+	IndexLayout layout;
+	PackIndices(indices, m_lods.data(), m_lods.size(), vertexCount, m_indexLayout.strips, packed, layout);
+
+	std::vector<unsigned char> remapped;
+	RemapPackedIndices(packed, layout, remap, positionCount, remapped, m_positionIndexLayout);
+
+	GeometryArena& arena = GetGeometryArena();
+	m_positionIndexRange = arena.AllocateIndices(remapped.size() / m_positionIndexLayout.indexSize, m_positionIndexLayout.indexSize);
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, arena.GetIndexBuffer());
+	glBufferSubData(GL_COPY_WRITE_BUFFER, m_positionIndexRange.offset, m_positionIndexRange.size, remapped.data());
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
 
-void Mesh::Draw()
+void Mesh::CreateBuffers(const void* vertices, size_t vertexCount, size_t vertexStride, const unsigned int* indices, size_t indexCount)
 {
-	// Previously, we multiplied each vertex one by one, but now we just have to send the world matrix to the gpu.
+	// Meshes without levels of detail just have the one
+	if (m_lods.empty())
+	{
+		MeshLod full = { 0, (unsigned int)indexCount, 0 };
+		m_lods.push_back(full);
+	}
+
+	// Every mesh lives in the shared vertex and index buffers, see geometryArena.h
+	UploadVertices(vertices, vertexCount, vertexStride, m_vertexRange);
+	UploadIndices(indices, vertexCount, m_indexRange, m_indexLayout);
+}
 
-	// Bind Vertex Buffer and Index Buffer
-	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+// Makes room in the geometry arena, and decodes compressed blobs (see meshCodec.h): the vertices
+// straight into the arena, the indices into indices, since they still have to be packed.
+// Returns false, with nothing allocated, if either blob can't be decoded
+static bool DecodeToArena(const void* vertexBlob, size_t vertexBytes, size_t vertexCount, size_t vertexStride,
+                          const void* indexBlob, size_t indexBytes, size_t indexCount,
+                          ArenaAllocation& vertexRange, std::vector<unsigned int>& indices)
+{
+	GeometryArena& arena = GetGeometryArena();
+	vertexRange = arena.AllocateVertices(vertexCount, vertexStride);
+	indices.resize(indexCount);
+
+	// Map the range. The copy target doesn't change any draw state.
+	// Invalidating tells the driver we don't need what was there before.
+	// Meshes load before anything draws, so the gpu isn't using the buffer and mapping doesn't wait
+	glBindBuffer(GL_COPY_READ_BUFFER, arena.GetVertexBuffer());
+	void* vertices = vertexRange.size == 0 ? nullptr :
+		glMapBufferRange(GL_COPY_READ_BUFFER, vertexRange.offset, vertexRange.size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+
+	// Vertices and indices decode at the same time, each split further into blocks across the pool.
+	// The decoder only ever writes the mapped memory, in order, which is what write combined memory wants
+	bool decoded = vertices != nullptr;
+	if (decoded)
+	{
+		ThreadPool& pool = GetSharedThreadPool();
+		bool results[2] = {};
+		pool.ParallelFor(2, [&](int i)
+		{
+			if (i == 0)
+				results[0] = DecodeVertices((const unsigned char*)vertexBlob, vertexBytes, vertices, vertexCount, vertexStride, &pool);
+			else
+				results[1] = DecodeIndices((const unsigned char*)indexBlob, indexBytes, indices.data(), indexCount, vertexCount, &pool);
+		});
+		decoded = results[0] && results[1];
+	}
+
+	// Unmapping can fail if the driver lost the memory (a display mode change, for example)
+	if (vertices != nullptr && !glUnmapBuffer(GL_COPY_READ_BUFFER))
+		decoded = false;
+
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+	if (!decoded)
+	{
+		arena.FreeVertices(vertexRange);
+		vertexRange = ArenaAllocation();
+		return false;
+	}
+
+	return true;
+}
 
-	// Setup Vertex Attributes
-	SetupAttribute(0, 3, GL_FLOAT, Vertex3dUVNormal, m_position);
-	SetupAttribute(1, 2, GL_FLOAT, Vertex3dUVNormal, m_texCoord);
-	SetupAttribute(2, 3, GL_FLOAT, Vertex3dUVNormal, m_normal);
-	SetupAttribute(3, 3, GL_FLOAT, Vertex3dUVNormal, m_tangent);
+bool Mesh::CreateBuffers(MeshCache& cache, size_t vertexStride, std::string& name)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	size_t vertexCount = cache.GetVertexCount();
+	size_t indexCount = cache.GetIndexCount();
+
+	if (m_lods.empty())
+	{
+		MeshLod full = { 0, (unsigned int)indexCount, 0 };
+		m_lods.push_back(full);
+	}
+
+	std::vector<unsigned int> indices;
+	if (!DecodeToArena(cache.GetVertices(), (size_t)cache.GetVertexBytes(), vertexCount, vertexStride,
+	                   cache.GetIndices(), (size_t)cache.GetIndexBytes(), indexCount, m_vertexRange, indices))
+		return false;
+	UploadIndices(indices.data(), vertexCount, m_indexRange, m_indexLayout);
+
+	double rawBytes = (double)vertexCount * vertexStride + (double)indexCount * sizeof(unsigned int);
+	double compressedBytes = (double)cache.GetVertexBytes() + (double)cache.GetIndexBytes();
+
+	if (cache.GetPositionCount() > 0)
+	{
+		std::vector<unsigned int> positionIndices;
+		if (!DecodeToArena(cache.GetPositions(), (size_t)cache.GetPositionBytes(), cache.GetPositionCount(), GetPositionStride(),
+		                   cache.GetPositionIndices(), (size_t)cache.GetPositionIndexBytes(), cache.GetPositionIndexCount(),
+		                   m_positionRange, positionIndices))
+			return false;
+		UploadPositionIndices(positionIndices.data(), cache.GetPositionCount(), indices.data(), vertexCount);
+
+		rawBytes += (double)cache.GetPositionCount() * GetPositionStride() + (double)cache.GetPositionIndexCount() * sizeof(unsigned int);
+		compressedBytes += (double)cache.GetPositionBytes() + (double)cache.GetPositionIndexBytes();
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	printf("%s: decoded %.1f KB -> %.1f KB (%.2fx) at %.0f MB/s\n",
+		name.c_str(), compressedBytes / 1024, rawBytes / 1024, rawBytes / compressedBytes, seconds > 0 ? rawBytes / seconds / 1e6 : 0.0);
+
+	return true;
+}
 
-	// Enable all attrubutes
-	for (int i = 0; i < 4; i++)
-		glEnableVertexAttribArray(i);
+void Mesh::CreatePositionBuffers(const void* positions, size_t positionCount, const unsigned int* positionIndices,
+                                 const unsigned int* indices, size_t vertexCount)
+{
+	UploadVertices(positions, positionCount, GetPositionStride(), m_positionRange);
+	UploadPositionIndices(positionIndices, positionCount, indices, vertexCount);
+}
 
-	// Draw Everything twice, one for the left eye and one for the right eye
-	glDrawElementsInstanced(GL_TRIANGLES, m_indices.size(), GL_UNSIGNED_INT, (void*)0, 2);
+void Mesh::FreeBuffers()
+{
+	GeometryArena& arena = GetGeometryArena();
+	arena.FreeVertices(m_vertexRange);
+	arena.FreeIndices(m_indexRange);
+	arena.FreeVertices(m_positionRange);
+	arena.FreeIndices(m_positionIndexRange);
+
+	m_vertexRange = ArenaAllocation();
+	m_indexRange = ArenaAllocation();
+	m_positionRange = ArenaAllocation();
+	m_positionIndexRange = ArenaAllocation();
+}
 
-	// Unbind Vertex Buffer and Index Buffer
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+void Mesh::MakeEmpty()
+{
+	FreeBuffers();
+	m_vertices.clear();
+	m_indices.clear();
+	m_meshlets.clear();
+
+	MeshLod empty = { 0, 0, 0 };
+	m_lods.assign(1, empty);
+	m_indexLayout = IndexLayout();
+	m_indexLayout.ranges.push_back({ 0, 0 });
+	m_positionIndexLayout = m_indexLayout;
+}
 
-	// Disable all attributes (enabled in the macro)
-	for (int i = 0; i < 4; i++)
-		glDisableVertexAttribArray(i);
+bool Mesh::IsLoaded()
+{
+	return m_indexRange.size > 0;
 }
 
+size_t Mesh::GetVertexStride()
+{
+	return m_packed ? sizeof(PackedVertex) : sizeof(Vertex3dUVNormal);
+}
 
-void Mesh::CalculateTangents()
+GLint Mesh::GetBaseVertex()
 {
-    // Tangents are calculated per face, so we loop over our vertices one face at a time...
-    for (unsigned int i = 0; i < m_indices.size(); i += 3)
-    {
-        Vertex3dUVNormal& v0 = m_vertices[m_indices[i]];
-        Vertex3dUVNormal& v1 = m_vertices[m_indices[i + 1]];
-        Vertex3dUVNormal& v2 = m_vertices[m_indices[i + 2]];
+	return (GLint)(m_vertexRange.offset / GetVertexStride());
+}
+
+unsigned int Mesh::GetFirstIndex(int lod)
+{
+	return (unsigned int)(m_indexRange.offset / m_indexLayout.indexSize) + m_indexLayout.ranges[lod].firstIndex;
+}
+
+unsigned int Mesh::GetIndexCount(int lod)
+{
+	return m_indexLayout.ranges[lod].indexCount;
+}
+
+// The gl index type and primitive an index buffer draws with
+static GLenum IndexType(const IndexLayout& layout)
+{
+	if (layout.indexSize == 1)
+		return GL_UNSIGNED_BYTE;
+	if (layout.indexSize == 2)
+		return GL_UNSIGNED_SHORT;
+	return GL_UNSIGNED_INT;
+}
+
+static GLenum IndexPrimitive(const IndexLayout& layout)
+{
+	return layout.strips ? GL_TRIANGLE_STRIP : GL_TRIANGLES;
+}
 
-        // Subtract to get the vector between our first vertex, and the other two
-        glm::vec3 edge1 = v1.m_position - v0.m_position;
-        glm::vec3 edge2 = v2.m_position - v0.m_position;
+GLenum Mesh::GetIndexType()
+{
+	return IndexType(m_indexLayout);
+}
 
-        // calculate corresponding vectors in texture space
-        glm::vec2 tex1 = glm::vec2(v1.m_texCoord.x - v0.m_texCoord.x, v2.m_texCoord.x - v0.m_texCoord.x);
-        glm::vec2 tex2 = glm::vec2(v1.m_texCoord.y - v0.m_texCoord.y, v2.m_texCoord.y - v0.m_texCoord.y);
+GLenum Mesh::GetPrimitive()
+{
+	return IndexPrimitive(m_indexLayout);
+}
+
+// One line for one index buffer: its size and shape, its size against a 32 bit
+// list of the same levels, and what one draw of the full mesh reads
+static void PrintIndexLayout(std::string& name, const char* label, const IndexLayout& layout, const std::vector<MeshLod>& lods)
+{
+	size_t listBytes = 0;
+	size_t packedBytes = 0;
+	for (size_t l = 0; l < lods.size(); l++)
+	{
+		listBytes += lods[l].indexCount * sizeof(unsigned int);
+		packedBytes += layout.ranges[l].indexCount * layout.indexSize;
+	}
+
+	printf("%s: %s %d byte %s, %.1f KB -> %.1f KB (%.2fx less), %.1f KB -> %.1f KB read per full draw\n",
+		name.c_str(), label, (int)layout.indexSize, layout.strips ? "strips" : "triangle list",
+		listBytes / 1024.0, packedBytes / 1024.0, packedBytes > 0 ? (double)listBytes / packedBytes : 0.0,
+		lods[0].indexCount * sizeof(unsigned int) / 1024.0, layout.ranges[0].indexCount * layout.indexSize / 1024.0);
+}
 
-        // calculate the inverse of the determinant of those two vectors as a matrix?
-        float f = 1.0f / (tex1.x * tex2.y - tex1.y * tex2.x);
+void Mesh::PrintIndexStats(std::string& name)
+{
+	if (m_indexRange.size > 0)
+		PrintIndexLayout(name, "indices", m_indexLayout, m_lods);
+	if (m_positionIndexRange.size > 0)
+		PrintIndexLayout(name, "position indices", m_positionIndexLayout, m_lods);
+}
 
-        glm::vec3 tangent;
+size_t Mesh::GetPositionStride()
+{
+	// The first member of both vertex types is the position, PackedVertex's has a 4th unused value
+	return m_packed ? sizeof(PackedVertex::m_position) : sizeof(glm::vec3);
+}
 
-        // scale the components of our vectors to get a tangent vector
-        tangent.x = f * (tex2.y * edge1.x - tex2.x * edge2.x);
-        tangent.y = f * (tex2.y * edge1.y - tex2.x * edge2.y);
-        tangent.z = f * (tex2.y * edge1.z - tex2.x * edge2.z);
+void Mesh::MakePositionStream(const void* gpuVertices, size_t vertexStride, std::vector<unsigned char>& positions,
+                              std::vector<unsigned int>& positionIndices, std::string& name)
+{
+	std::vector<unsigned int> sourceVertex;
+	BuildPositionStream(m_vertices, m_indices, sourceVertex, positionIndices);
+
+	// Copy just the position out of each vertex that's going to the gpu, packed or not
+	size_t positionStride = GetPositionStride();
+	positions.resize(sourceVertex.size() * positionStride);
+	for (size_t i = 0; i < sourceVertex.size(); i++)
+		memcpy(&positions[i * positionStride], (const unsigned char*)gpuVertices + sourceVertex[i] * vertexStride, positionStride);
+
+	// How much less a depth pass has to read
+	double fullBytes = (double)m_vertices.size() * vertexStride;
+	printf("%s: position stream %d vertices x %d bytes = %.1f KB, full stream %d x %d bytes = %.1f KB (%.1fx less to fetch)\n",
+		name.c_str(), (int)sourceVertex.size(), (int)positionStride, positions.size() / 1024.0,
+		(int)m_vertices.size(), (int)vertexStride, fullBytes / 1024, positions.empty() ? 0.0 : fullBytes / positions.size());
+}
 
-        v0.m_tangent += tangent;
-        v1.m_tangent += tangent;
-        v2.m_tangent += tangent;
+void Mesh::CalculateBounds()
+{
+    if (m_vertices.empty())
+        return;
+
+    m_boundsMin = m_vertices[0].m_position;
+    m_boundsMax = m_vertices[0].m_position;
+
+    for (unsigned int i = 1; i < m_vertices.size(); i++)
+    {
+        m_boundsMin = glm::min(m_boundsMin, m_vertices[i].m_position);
+        m_boundsMax = glm::max(m_boundsMax, m_vertices[i].m_position);
     }
 
+    // The furthest vertex from the middle of the box
+    m_sphereCenter = (m_boundsMin + m_boundsMax) * 0.5f;
+    float radiusSquared = 0;
     for (unsigned int i = 0; i < m_vertices.size(); i++)
     {
-        m_vertices[i].m_tangent = glm::normalize(m_vertices[i].m_tangent);
+        glm::vec3 offset = m_vertices[i].m_position - m_sphereCenter;
+        radiusSquared = glm::max(radiusSquared, glm::dot(offset, offset));
     }
-}
\ No newline at end of file
+    m_sphereRadius = glm::sqrt(radiusSquared);
+}
+
+void Mesh::Optimize(std::string& name, unsigned int options)
+{
+    bool optimize = (options & (MeshOptimizeVertexCache | MeshOptimizeOverdraw)) != 0;
+
+    // gpus have somewhere around 16 to 32 cache entries, 16 is the safer guess
+    VertexCacheStats before;
+    if (optimize)
+    {
+        before = AnalyzeVertexCache(m_indices, m_vertices.size(), 16);
+
+        OptimizeVertexCache(m_indices, m_vertices.size());
+
+        // The overdraw pass needs the cache optimized order to find its clusters
+        if (options & MeshOptimizeOverdraw)
+        {
+            // 8 views at 256x256 is enough to see the difference, without slowing down loading too much
+            float overdrawBefore = EstimateOverdraw(m_indices, m_vertices, 8, 256);
+
+            // let the ACMR get up to 5% worse
+            OptimizeOverdraw(m_indices, m_vertices, 1.05f);
+
+            float overdrawAfter = EstimateOverdraw(m_indices, m_vertices, 8, 256);
+            printf("%s: overdraw %.3f -> %.3f\n", name.c_str(), overdrawBefore, overdrawAfter);
+        }
+    }
+
+    // Meshlets move triangles around, so this goes after the triangle
+    // order is decided, but before the vertices are sorted to match it
+    if (options & MeshBuildMeshlets)
+    {
+        BuildMeshlets(m_indices, m_vertices, m_meshlets);
+
+        CalculateBounds();
+        MeshletStats stats = AnalyzeMeshlets(m_meshlets, m_boundsMin, m_boundsMax);
+        printf("%s: %d meshlets, %.0f%% vertex fill, %.0f%% triangle fill, %.0f%% with cones (avg %.1f deg), %.0f%% backfacing from outside\n",
+            name.c_str(), stats.meshletCount, stats.vertexFill * 100, stats.triangleFill * 100,
+            stats.coneFraction * 100, stats.coneDegrees, stats.culledFraction * 100);
+    }
+
+    if (optimize)
+    {
+        OptimizeVertexFetch(m_vertices, m_indices);
+
+        VertexCacheStats after = AnalyzeVertexCache(m_indices, m_vertices.size(), 16);
+        printf("%s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", name.c_str(), before.acmr, after.acmr, before.atvr, after.atvr);
+    }
+
+    // Last, so the simpler levels come after the full mesh in the index buffer,
+    // and the meshlets (which point into the full mesh) stay where they are
+    if (options & MeshGenerateLods)
+    {
+        GenerateLods(name);
+    }
+}
+
+void Mesh::GenerateLods(std::string& name)
+{
+    CalculateBounds();
+    float size = glm::length(m_boundsMax - m_boundsMin);
+
+    m_lods.clear();
+    MeshLod full = { 0, (unsigned int)m_indices.size(), 0 };
+    m_lods.push_back(full);
+
+    // Each level is made from the one before it
+    std::vector<unsigned int> previous = m_indices;
+    std::vector<unsigned int> simplified;
+    float error = 0;
+
+    while (m_lods.size() < MeshMaxLods)
+    {
+        // Half the triangles
+        size_t target = previous.size() / 6 * 3;
+        float levelError = SimplifyMesh(m_vertices, previous, target, simplified);
+
+        // The seams and edges are stopping the simplifier,
+        // another level would look the same and cost memory
+        if (simplified.empty() || simplified.size() > previous.size() * 9 / 10)
+            break;
+
+        OptimizeVertexCache(simplified, m_vertices.size());
+
+        // The errors add up, since each level is made from the last one
+        error += levelError;
+
+        MeshLod lod = { (unsigned int)m_indices.size(), (unsigned int)simplified.size(), error };
+        m_lods.push_back(lod);
+        m_indices.insert(m_indices.end(), simplified.begin(), simplified.end());
+
+        printf("%s: LOD%d %d triangles (%.0f%% of full), error %f (%.3f%% of size)\n",
+            name.c_str(), (int)m_lods.size() - 1, (int)(simplified.size() / 3),
+            100.0 * simplified.size() / full.indexCount, error, size > 0 ? 100 * error / size : 0);
+
+        previous.swap(simplified);
+    }
+}
+
+int Mesh::SelectLod(const glm::mat4& worldMatrix)
+{
+    if (m_lods.size() < 2 || lodViewportHeight <= 0)
+        return 0;
+
+    // A sphere around the mesh, in world space
+    glm::vec3 center = glm::vec3(worldMatrix * glm::vec4(m_sphereCenter, 1));
+    float scale = glm::max(glm::length(glm::vec3(worldMatrix[0])), glm::max(glm::length(glm::vec3(worldMatrix[1])), glm::length(glm::vec3(worldMatrix[2]))));
+    float radius = m_sphereRadius * scale;
+
+    // How many pixels one unit of model space covers, at the closest point
+    // of the sphere. Both eyes are checked, and the bigger one wins.
+    float pixelsPerUnit = 0;
+    for (int eye = 0; eye < 2; eye++)
+    {
+        const glm::mat4& viewProjection = lodViewProjection[eye];
+
+        // w is the distance in front of the camera
+        float distance = (viewProjection * glm::vec4(center, 1)).w - radius;
+
+        // The camera is inside the sphere, or nearly
+        if (distance <= 0.1f)
+            return 0;
+
+        // The projection's y scale. The view matrix only rotates,
+        // so the length of the matrix's second row is the same thing
+        float focalLength = glm::length(glm::vec3(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1]));
+
+        pixelsPerUnit = glm::max(pixelsPerUnit, focalLength / distance * lodViewportHeight * 0.5f * scale);
+    }
+
+    int lod = 0;
+    while (lod + 1 < (int)m_lods.size() && m_lods[lod + 1].error * pixelsPerUnit <= MeshLodPixelError)
+        lod++;
+    return lod;
+}
+
+void Mesh::SetLodViews(const glm::mat4& viewProjection1, const glm::mat4& viewProjection2, float viewportHeight)
+{
+    lodViewProjection[0] = viewProjection1;
+    lodViewProjection[1] = viewProjection2;
+    lodViewportHeight = viewportHeight;
+
+    // A new frame, start counting again
+    lodTrianglesDrawn = 0;
+    lodTrianglesFull = 0;
+    for (int i = 0; i < MeshMaxLods; i++)
+        lodDraws[i] = 0;
+}
+
+void Mesh::PrintLodStats()
+{
+    printf("Triangles: %llu of %llu (%.0f%%), draws per LOD: %u %u %u %u\n",
+        lodTrianglesDrawn, lodTrianglesFull, lodTrianglesFull > 0 ? 100.0 * lodTrianglesDrawn / lodTrianglesFull : 0.0,
+        lodDraws[0], lodDraws[1], lodDraws[2], lodDraws[3]);
+}
+
+const std::vector<Meshlet>& Mesh::GetMeshlets()
+{
+    return m_meshlets;
+}
+
+void Mesh::PrintLoadTimes()
+{
+    printf("Meshes parsed from obj: %d in %.2f ms\n", objLoadCount, objLoadSeconds * 1000.0);
+    printf("Meshes mapped from .meshbin: %d in %.2f ms\n", cacheLoadCount, cacheLoadSeconds * 1000.0);
+    printf("Meshes made procedurally: %d in %.2f ms\n", proceduralLoadCount, proceduralLoadSeconds * 1000.0);
+}
+
+Mesh::~Mesh()
+{
+	// Clear buffers for the shape object when done using them.
+	FreeBuffers();
+}
+
+void Mesh::Draw()
+{
+	DrawLod(0, 1);
+}
+
+void Mesh::Draw(const glm::mat4& worldMatrix)
+{
+	DrawLod(SelectLod(worldMatrix), 1);
+}
+
+void Mesh::DrawDepth(const glm::mat4& worldMatrix)
+{
+	DrawDepthLod(SelectLod(worldMatrix), 1);
+}
+
+void Mesh::DrawInstanced(int lod, unsigned int count)
+{
+	DrawLod(lod, count);
+}
+
+void Mesh::DrawDepthInstanced(int lod, unsigned int count)
+{
+	DrawDepthLod(lod, count);
+}
+
+void Mesh::DrawLod(int lod, unsigned int count)
+{
+	// Previously, we multiplied each vertex one by one, but now we just have to send the world matrix to the gpu.
+	RenderState& state = GetRenderState();
+
+	// Every mesh is in the geometry arena, and every vertex layout has its own vertex array object
+	// pointing at it, so there are no buffers or attribute pointers to set, only the format
+	state.BindVertexFormat(GetVertexFormat());
+	SetPositionTransform();
+
+	// Draw Everything twice, one for the left eye and one for the right eye, for every copy.
+	// The attributes point at the start of the arena, the base vertex moves them to this mesh's vertices
+	glDrawElementsInstancedBaseVertex(GetPrimitive(), GetIndexCount(lod), GetIndexType(),
+		(void*)((size_t)GetFirstIndex(lod) * m_indexLayout.indexSize), 2 * count, GetBaseVertex());
+
+	AddLodStats(lod, count);
+}
+
+void Mesh::AddLodStats(int lod, unsigned int count)
+{
+	lodTrianglesDrawn += m_lods[lod].indexCount / 3 * 2 * count;
+	lodTrianglesFull += m_lods[0].indexCount / 3 * 2 * count;
+	lodDraws[lod] += count;
+}
+
+void Mesh::DrawDepthLod(int lod, unsigned int count)
+{
+	RenderState& state = GetRenderState();
+
+	// Only attribute 0, so the gpu doesn't fetch anything else.
+	// Without a position stream, read the positions out of the full vertices
+	bool positionStream = m_positionRange.size > 0;
+	const ArenaAllocation& vertexRange = positionStream ? m_positionRange : m_vertexRange;
+	const ArenaAllocation& indexRange = positionStream ? m_positionIndexRange : m_indexRange;
+	const IndexLayout& layout = positionStream ? m_positionIndexLayout : m_indexLayout;
+	size_t stride = positionStream ? GetPositionStride() : GetVertexStride();
+
+	if (positionStream)
+		state.BindVertexFormat(m_packed ? VertexFormatPackedPositionStream : VertexFormatPositionStream);
+	else
+		state.BindVertexFormat(m_packed ? VertexFormatPackedPositions : VertexFormatFullPositions);
+	SetPositionTransform();
+
+	// Both index buffers have every level of detail, each one where its own layout says
+	const IndexRange& range = layout.ranges[lod];
+	glDrawElementsInstancedBaseVertex(IndexPrimitive(layout), range.indexCount, IndexType(layout),
+		(void*)(indexRange.offset + range.firstIndex * layout.indexSize), 2 * count, (GLint)(vertexRange.offset / stride));
+}
+
+void Mesh::SetPositionTransform()
+{
+	RenderState& state = GetRenderState();
+
+	// Attributes 4 and 5 aren't arrays, every vertex gets the same value.
+	// The vertex shader uses them to scale packed positions back out of the box
+	glm::vec3 scale;
+	glm::vec3 offset;
+	GetPositionTransform(scale, offset);
+	state.SetConstantAttribute(4, scale);
+	state.SetConstantAttribute(5, offset);
+}
+
+void Mesh::GetPositionTransform(glm::vec3& scale, glm::vec3& offset)
+{
+	if (m_packed)
+	{
+		scale = m_boundsMax - m_boundsMin;
+		offset = m_boundsMin;
+	}
+	else
+	{
+		// Positions are already in model space
+		scale = glm::vec3(1);
+		offset = glm::vec3(0);
+	}
+}
+
+void Mesh::GetBounds(glm::vec3& boundsMin, glm::vec3& boundsMax)
+{
+	boundsMin = m_boundsMin;
+	boundsMax = m_boundsMax;
+}
+
+void Mesh::GetBoundingSphere(glm::vec3& center, float& radius)
+{
+	center = m_sphereCenter;
+	radius = m_sphereRadius;
+}
+
+void Mesh::GetOccluder(std::vector<glm::vec3>& positions, std::vector<unsigned int>& indices, float maxError)
+{
+	// Level 0 has no error, so there's always one that fits
+	size_t level = m_lods.size() - 1;
+	while (level > 0 && m_lods[level].error > maxError)
+		level--;
+
+	// Meshes from a .meshbin cache never had their vertices on the cpu, so read the
+	// level back out of the arena, from the position stream if there is one
+	bool positionStream = m_positionRange.size > 0;
+	const ArenaAllocation& vertexRange = positionStream ? m_positionRange : m_vertexRange;
+	const ArenaAllocation& indexRange = positionStream ? m_positionIndexRange : m_indexRange;
+	const IndexLayout& layout = positionStream ? m_positionIndexLayout : m_indexLayout;
+	size_t stride = positionStream ? GetPositionStride() : GetVertexStride();
+	const IndexRange& lod = layout.ranges[level];
+
+	positions.clear();
+	indices.clear();
+	if (lod.indexCount == 0)
+		return;
+
+	std::vector<unsigned char> packedIndices(lod.indexCount * layout.indexSize);
+	std::vector<unsigned char> vertices(vertexRange.size);
+
+	GeometryArena& arena = GetGeometryArena();
+	glBindBuffer(GL_COPY_READ_BUFFER, arena.GetIndexBuffer());
+	glGetBufferSubData(GL_COPY_READ_BUFFER, indexRange.offset + lod.firstIndex * layout.indexSize,
+		packedIndices.size(), packedIndices.data());
+	glBindBuffer(GL_COPY_READ_BUFFER, arena.GetVertexBuffer());
+	glGetBufferSubData(GL_COPY_READ_BUFFER, vertexRange.offset, vertexRange.size, vertices.data());
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+	// Back to a 32 bit triangle list
+	std::vector<unsigned int> lodIndices;
+	UnpackIndices(packedIndices.data(), lod.indexCount, layout.indexSize, lodIndices);
+	if (layout.strips)
+	{
+		std::vector<unsigned int> strips;
+		strips.swap(lodIndices);
+		UnstripTriangles(strips.data(), strips.size(), lodIndices);
+	}
+
+	// Only keep the vertices this level uses, unpacked back into model space
+	std::vector<unsigned int> remap(vertexRange.size / stride, 0xFFFFFFFFu);
+	for (unsigned int index : lodIndices)
+	{
+		if (remap[index] == 0xFFFFFFFFu)
+		{
+			remap[index] = (unsigned int)positions.size();
+			const unsigned char* vertex = &vertices[index * stride];
+
+			glm::vec3 position;
+			if (m_packed)
+			{
+				PackedVertex packed = {};
+				memcpy(packed.m_position, vertex, sizeof(packed.m_position));
+				position = UnpackVertex(packed, m_boundsMin, m_boundsMax).m_position;
+			}
+			else
+			{
+				memcpy(&position, vertex, sizeof(glm::vec3));
+			}
+			positions.push_back(position);
+		}
+		indices.push_back(remap[index]);
+	}
+}
+
+VertexFormat Mesh::GetVertexFormat()
+{
+	return m_packed ? VertexFormatPacked : VertexFormatFull;
+}
+
+void Mesh::CalculateTangents()
+{
+    // The math is explained in tangents.h, big meshes are split across every core
+    CalculateTangentsParallel(m_vertices, m_indices, GetSharedThreadPool());
+}
@@ -27,6 +27,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "GLFW/glfw3.h"
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
+#include "meshlet.h"
+#include "geometryArena.h"
+#include "renderState.h"
+#include "indexPacking.h"
 #include <vector>
 #include <string>
 #include <iostream>
@@ -42,6 +46,9 @@ struct Vertex3dUVNormal
     glm::vec3 m_normal;
     glm::vec3 m_tangent;
 
+    // Makes an empty vertex, so that vectors of vertices can be resized
+    Vertex3dUVNormal() {}
+
     // Makes a 2d vertex with uc and color data.
     Vertex3dUVNormal(glm::vec3 position, glm::vec2 texCoord, glm::vec3 normal, glm::vec3 tangent) {
         m_position = position;
@@ -51,6 +58,45 @@ struct Vertex3dUVNormal
     }
 };
 
+// Optional steps that can run when a mesh is loaded, combine them with |
+// Reorders triangles for the vertex cache, and vertices for fetching, see meshOptimizer.h
+#define MeshOptimizeVertexCache 1
+// Sorts clusters of triangles so outward facing ones draw first, for less overdraw.
+// This also does everything MeshOptimizeVertexCache does.
+#define MeshOptimizeOverdraw 2
+// Stores vertices as PackedVertex (20 bytes) instead of Vertex3dUVNormal (44 bytes) on the gpu, see vertexPacking.h
+#define MeshPackVertices 4
+// Splits the mesh into small clusters of triangles with bounds, so whole clusters can be culled, see meshlet.h
+#define MeshBuildMeshlets 8
+// Makes simpler versions of the mesh for drawing far away, see simplifier.h
+#define MeshGenerateLods 16
+// Compresses the vertices and indices in the .meshbin cache, see meshCodec.h
+#define MeshCompressCache 32
+// Keeps a second copy of the mesh with only positions (8 bytes each packed, 12 if not),
+// welded so seams and hard edges share vertices again. See Mesh::DrawDepth
+#define MeshPositionStream 64
+// Draws with triangle strips joined by primitive restart, if they take fewer indices
+// than the triangle list. Indices are always stored in the smallest size that fits,
+// this only changes the shape. See indexPacking.h
+#define MeshTriangleStrips 128
+
+// The full mesh, plus up to 3 simpler ones
+#define MeshMaxLods 4
+
+// One level of detail, a range of the index buffer.
+// Level 0 is the full mesh, every level after it has about half the triangles.
+struct MeshLod
+{
+    unsigned int firstIndex;
+    unsigned int indexCount;
+
+    // How far (in model space) this level's surface is from the full mesh
+    float error;
+};
+
+class MeshCache;
+struct ProceduralMesh;
+
 class Mesh
 {
 
@@ -58,23 +104,194 @@ public:
     // Constructor for a shape, takes a vector for vertices and indices
     Mesh(std::vector<Vertex3dUVNormal> vertices, std::vector<unsigned int> indices);
 
+    // Constructor for a shape made on the cpu (see proceduralMesh.h). The vertices and indices
+    // are made across the thread pool straight into the geometry arena's staging buffer,
+    // nothing is kept on the cpu. Of the options, only MeshPackVertices does anything
+    Mesh(const ProceduralMesh& shape, unsigned int options);
+
     // Constructor for a mesh. reads in an obj file.
     Mesh(std::string filePath, bool calcTangents);
 
+    // Same as above, with any of the optional Mesh steps turned on
+    Mesh(std::string filePath, bool calcTangents, unsigned int options);
+
     // Shape destructor to clean up buffers
     ~Mesh();
 
-    // Draws the shape using a given world matrix
+    // Draws the shape. The shaders read the world matrix from the first
+    // slot of the instance block, see drawBatcher.h
     void Draw();
 
+    // Draws the simplest level of detail that looks the same as the full mesh
+    // from both eyes, using the views from SetLodViews
+    void Draw(const glm::mat4& worldMatrix);
+
+    // Draws positions only, for passes that just want depth (depth prepass, shadows, occlusion).
+    // Uses the position stream if the mesh was loaded with MeshPositionStream.
+    // The shader only gets attribute 0, and the scale and offset in 4 and 5
+    void DrawDepth(const glm::mat4& worldMatrix);
+
+    // Draws count copies of level lod in one draw call, 2 * count instances in all.
+    // Instance i is copy i / 2, seen by eye i % 2, and the shader picks that copy's
+    // world matrix out of the instance block
+    void DrawInstanced(int lod, unsigned int count);
+    void DrawDepthInstanced(int lod, unsigned int count);
+
+    // False if the obj file couldn't be read. The mesh then has one empty level
+    // of detail, so it can still be drawn and asked about, it just has no triangles
+    bool IsLoaded();
+
+    // Picks the level of detail to draw with worldMatrix, see SetLodViews
+    int SelectLod(const glm::mat4& worldMatrix);
+
+    // The two eye cameras (projection * view) that levels of detail are picked for,
+    // and the height of the screen in pixels. Call this once per frame, before drawing
+    static void SetLodViews(const glm::mat4& viewProjection1, const glm::mat4& viewProjection2, float viewportHeight);
+
+    // Triangles drawn since SetLodViews, compared to drawing every mesh in full
+    static void PrintLodStats();
+
+    // Prints how long meshes took to load from obj files, and from .meshbin caches
+    static void PrintLoadTimes();
+
+    // Where this mesh is in the geometry arena (see geometryArena.h), for drawing
+    // it yourself, or batching it with other meshes. With the arena bound, level lod
+    // is GetIndexCount(lod) indices starting at GetFirstIndex(lod), with GetBaseVertex.
+    // Indices are GetIndexType (GL_UNSIGNED_BYTE, SHORT or INT), drawn as GetPrimitive
+    // (GL_TRIANGLES, or GL_TRIANGLE_STRIP with primitive restart)
+    GLint GetBaseVertex();
+    unsigned int GetFirstIndex(int lod);
+    unsigned int GetIndexCount(int lod);
+    GLenum GetIndexType();
+    GLenum GetPrimitive();
+
+    // Bytes per vertex, PackedVertex or Vertex3dUVNormal
+    size_t GetVertexStride();
+
+    // The vertex array object this mesh draws with, VertexFormatPacked or VertexFormatFull
+    VertexFormat GetVertexFormat();
+
+    // The scale and offset that turn positions back into model space, see vertex.glsl
+    void GetPositionTransform(glm::vec3& scale, glm::vec3& offset);
+
+    // Box around every vertex position, in model space
+    void GetBounds(glm::vec3& boundsMin, glm::vec3& boundsMax);
+
+    // Sphere around every vertex position, in model space
+    void GetBoundingSphere(glm::vec3& center, float& radius);
+
+    // The simplest level of detail with an error of at most maxError (in model units) as plain
+    // triangles, in model space, for the cpu to rasterize as an occluder (see occlusionCulling.h).
+    // Simplified levels can fill in concave parts and end up bigger than the mesh, which an
+    // occluder must never be, so 0 (the full mesh) is the only choice that's always safe.
+    // Reads the arena back from the gpu, so it's meant for load time
+    void GetOccluder(std::vector<glm::vec3>& positions, std::vector<unsigned int>& indices, float maxError);
+
+    // Adds a draw of count copies of level lod to PrintLodStats,
+    // for draws that don't go through Mesh (like multi-draw indirect)
+    void AddLodStats(int lod, unsigned int count);
+
+    // Clusters of triangles, empty unless the mesh was loaded with MeshBuildMeshlets.
+    // Each one is a range of the 32 bit triangle list the mesh was made from, before its indices were packed
+    const std::vector<Meshlet>& GetMeshlets();
+
 private:
-	// Vectors of shape information
+	// Vectors of shape information.
+	// These stay empty when the mesh comes from a .meshbin cache,
+	// that data goes straight from the file to the gpu.
 	std::vector<Vertex3dUVNormal> m_vertices;
 	std::vector<unsigned int> m_indices;
+	std::vector<Meshlet> m_meshlets;
+
+	// Box around every vertex position, in model space
+	glm::vec3 m_boundsMin;
+	glm::vec3 m_boundsMax;
+
+	// Sphere around every vertex position, centered on the box.
+	// Tighter than the sphere around the box for round meshes
+	glm::vec3 m_sphereCenter;
+	float m_sphereRadius = 0;
+
+	// Where the vertices and indices are in the geometry arena
+	ArenaAllocation m_vertexRange;
+	ArenaAllocation m_indexRange;
+
+	// Positions only, and indices into them, for DrawDepth. Empty if the mesh doesn't have a position stream
+	ArenaAllocation m_positionRange;
+	ArenaAllocation m_positionIndexRange;
+
+	// Ranges of the 32 bit triangle list, level 0 is the full mesh. The position
+	// stream's list has the same ranges. Both lists are packed on the way to the gpu
+	std::vector<MeshLod> m_lods;
+
+	// How the index buffers were packed, and where each level ended up in them.
+	// The position stream can have a smaller index size, it has fewer vertices
+	IndexLayout m_indexLayout;
+	IndexLayout m_positionIndexLayout;
+
+	// True if the mesh was loaded with MeshTriangleStrips, and the gpu can restart strips
+	bool m_makeStrips = false;
+
+	// True if the vertex buffer holds PackedVertex instead of Vertex3dUVNormal
+	bool m_packed = false;
+
+    // Copies vertices and indices into the geometry arena, vertexStride is the size of one vertex
+    void CreateBuffers(const void* vertices, size_t vertexCount, size_t vertexStride, const unsigned int* indices, size_t indexCount);
+
+    // Same as above, but decodes a compressed cache, the vertices straight into the geometry arena.
+    // Returns false if the cache can't be decoded
+    bool CreateBuffers(MeshCache& cache, size_t vertexStride, std::string& name);
+
+    // Copies the position stream into the arena, positionCount positions of GetPositionStride bytes each.
+    // positionIndices has the same levels of detail as the full stream, so m_lods says how many there are,
+    // and the full stream's indices (for vertexCount vertices) are needed to pack it the same way
+    void CreatePositionBuffers(const void* positions, size_t positionCount, const unsigned int* positionIndices,
+                               const unsigned int* indices, size_t vertexCount);
+
+    // Packs every level of the triangle list indices (see indexPacking.h), for a buffer
+    // of vertexCount vertices, and copies them into a new range of the arena
+    void UploadIndices(const unsigned int* indices, size_t vertexCount, ArenaAllocation& indexRange, IndexLayout& layout);
+
+    // Uploads the position stream's indices in exactly the shape the full stream got: the same strips
+    // or list, with the same first vertex in every triangle. The depth prepass tests the shading pass
+    // with GL_EQUAL, which only holds if both passes draw every triangle the same way
+    void UploadPositionIndices(const unsigned int* positionIndices, size_t positionCount, const unsigned int* indices, size_t vertexCount);
+
+    // Prints the index size and shape each index buffer got, and how much smaller it is than a 32 bit list
+    void PrintIndexStats(std::string& name);
+
+    // Gives all four ranges back to the geometry arena
+    void FreeBuffers();
+
+    // Frees everything and leaves one empty level of detail, in both index layouts,
+    // so a mesh that failed to load draws nothing instead of reading past empty vectors
+    void MakeEmpty();
+
+    // Bytes per vertex in the position stream
+    size_t GetPositionStride();
+
+    // Copies the positions out of gpuVertices (the vertices going to the gpu, packed or not),
+    // with one vertex per position, and indices to match m_indices
+    void MakePositionStream(const void* gpuVertices, size_t vertexStride, std::vector<unsigned char>& positions,
+                            std::vector<unsigned int>& positionIndices, std::string& name);
+
+    // Finds the box and sphere around m_vertices
+    void CalculateBounds();
+
+    // Runs the optional steps on m_vertices and m_indices
+    void Optimize(std::string& name, unsigned int options);
+
+    // Simplifies m_indices into m_lods, and adds each level to the end of m_indices
+    void GenerateLods(std::string& name);
+
+    // Draws one level of detail, count times for each eye
+    void DrawLod(int lod, unsigned int count);
+
+    // Draws one level of detail with only positions, count times for each eye
+    void DrawDepthLod(int lod, unsigned int count);
 
-	// Buffered shape info
-	GLuint m_vertexBuffer;
-	GLuint m_indexBuffer;
+    // Sets the scale and offset (attributes 4 and 5) that turn positions back into model space
+    void SetPositionTransform();
 
     void CalculateTangents();
 
@@ -0,0 +1,438 @@
+/*
+Title: Blur Optimization VR
+File Name: meshCache.cpp
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "meshCache.h"
+#include "meshCodec.h"
+#include <sys/stat.h>
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+
+#define MeshCacheVersion 6
+
+// Every blob starts on a multiple of this
+#define MeshCacheAlignment 64
+
+static const char meshCacheMagic[8] = { 'M', 'E', 'S', 'H', 'B', 'I', 'N', 0 };
+
+// True if each of the count indices is below vertexCount
+static bool IndicesInRange(const unsigned int* indices, unsigned long long count, unsigned long long vertexCount)
+{
+    for (unsigned long long i = 0; i < count; i++)
+    {
+        if (indices[i] >= vertexCount)
+            return false;
+    }
+    return true;
+}
+
+// Gets the size and last modified time of a file, returns false if it doesn't exist
+static bool GetFileInfo(std::string path, unsigned long long& size, long long& modifiedTime)
+{
+#ifdef _WIN32
+    struct _stat64 info;
+    if (_stat64(path.c_str(), &info) != 0)
+        return false;
+#else
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+        return false;
+#endif
+    size = (unsigned long long)info.st_size;
+    modifiedTime = (long long)info.st_mtime;
+    return true;
+}
+
+// FNV-1a, a simple hash that is good enough to notice a file has changed
+static unsigned long long HashBytes(const char* data, size_t size)
+{
+    unsigned long long hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static unsigned long long AlignUp(unsigned long long value)
+{
+    return (value + MeshCacheAlignment - 1) / MeshCacheAlignment * MeshCacheAlignment;
+}
+
+// Pads the file out to offset, then writes size bytes of data. Empty blobs write nothing,
+// not even padding, so the file can end right after the last blob with anything in it
+static bool WriteBlob(FILE* file, unsigned long long& written, unsigned long long offset, const void* data, unsigned long long size)
+{
+    if (size == 0)
+        return true;
+
+    char padding[MeshCacheAlignment] = {};
+    size_t paddingSize = (size_t)(offset - written);
+    if (fwrite(padding, 1, paddingSize, file) != paddingSize || fwrite(data, 1, (size_t)size, file) != size)
+        return false;
+
+    written = offset + size;
+    return true;
+}
+
+MeshCache::MeshCache(std::string cachePath) : m_file(cachePath)
+{
+    if (m_file.IsOpen() && m_file.GetSize() >= sizeof(MeshCacheHeader))
+        m_header = (const MeshCacheHeader*)m_file.GetData();
+}
+
+bool MeshCache::IsValidFor(std::string sourcePath, unsigned int flags, unsigned int vertexStride)
+{
+    if (m_header == nullptr)
+        return false;
+
+    // Is this even a mesh cache, and is it one that we know how to read?
+    if (memcmp(m_header->magic, meshCacheMagic, sizeof(meshCacheMagic)) != 0 ||
+        m_header->version != MeshCacheVersion ||
+        m_header->flags != flags ||
+        m_header->vertexStride != vertexStride ||
+        m_header->indexSize != sizeof(unsigned int) ||
+        m_header->meshletStride != sizeof(Meshlet) ||
+        m_header->lodCount > MeshMaxLods)
+        return false;
+
+    for (unsigned int i = 0; i < m_header->lodCount; i++)
+    {
+        if ((unsigned long long)m_header->lods[i].firstIndex + m_header->lods[i].indexCount > m_header->indexCount)
+            return false;
+    }
+
+    // Uncompressed blobs are exactly as big as their contents
+    if (!IsCompressed() &&
+        (m_header->vertexBytes != (unsigned long long)m_header->vertexCount * m_header->vertexStride ||
+         m_header->indexBytes != (unsigned long long)m_header->indexCount * m_header->indexSize ||
+         m_header->positionBytes != (unsigned long long)m_header->positionCount * m_header->positionStride ||
+         m_header->positionIndexBytes != (unsigned long long)m_header->positionIndexCount * m_header->indexSize))
+        return false;
+
+    // A position stream has the same index ranges as the full one
+    if (m_header->positionCount > 0 && m_header->positionIndexCount != m_header->indexCount)
+        return false;
+
+    // Make sure the file isn't cut short, a crash while writing could do that.
+    // Empty blobs aren't written at all, so only the others have to fit
+    if (!BlobFits(m_header->vertexOffset, m_header->vertexBytes) ||
+        !BlobFits(m_header->indexOffset, m_header->indexBytes) ||
+        !BlobFits(m_header->meshletOffset, (unsigned long long)m_header->meshletCount * m_header->meshletStride) ||
+        !BlobFits(m_header->positionOffset, m_header->positionBytes) ||
+        !BlobFits(m_header->positionIndexOffset, m_header->positionIndexBytes))
+        return false;
+
+    // Indices past the end of the vertices would read (or, while packing, write) outside them.
+    // Compressed ones are checked as they're decoded, see DecodeIndices
+    if (!IsCompressed() &&
+        (!IndicesInRange(GetIndices(), m_header->indexCount, m_header->vertexCount) ||
+         !IndicesInRange(GetPositionIndices(), m_header->positionIndexCount, m_header->positionCount)))
+        return false;
+
+    unsigned long long sourceSize;
+    long long sourceModifiedTime;
+    if (!GetFileInfo(sourcePath, sourceSize, sourceModifiedTime))
+    {
+        // The obj is gone, but the cache is still a good mesh, so use it
+        return true;
+    }
+
+    if (sourceSize != m_header->sourceSize)
+        return false;
+
+    // Same size and time, the obj hasn't changed
+    if (sourceModifiedTime == m_header->sourceModifiedTime)
+        return true;
+
+    // The time changed but the size didn't. Things like copying
+    // the folder or checking out with git do this without changing
+    // the file, so check the contents before throwing the cache away.
+    MappedFile source(sourcePath);
+    m_sourceTimeStale = source.IsOpen() && HashBytes(source.GetData(), source.GetSize()) == m_header->sourceHash;
+    return m_sourceTimeStale;
+}
+
+bool MeshCache::IsSourceTimeStale()
+{
+    return m_sourceTimeStale;
+}
+
+bool MeshCache::UpdateSourceTime(std::string cachePath, std::string sourcePath)
+{
+    unsigned long long sourceSize;
+    long long sourceModifiedTime;
+    if (!GetFileInfo(sourcePath, sourceSize, sourceModifiedTime))
+        return false;
+
+    FILE* file = fopen(cachePath.c_str(), "r+b");
+    if (file == nullptr)
+        return false;
+
+    // Only the time changes, and only if this is still the cache that was checked.
+    // If the write gets cut short the time just won't match, and the hash is checked again
+    MeshCacheHeader header;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+              memcmp(header.magic, meshCacheMagic, sizeof(meshCacheMagic)) == 0 &&
+              header.version == MeshCacheVersion &&
+              header.sourceSize == sourceSize;
+
+    ok = ok && fseek(file, (long)offsetof(MeshCacheHeader, sourceModifiedTime), SEEK_SET) == 0;
+    ok = ok && fwrite(&sourceModifiedTime, sizeof(sourceModifiedTime), 1, file) == 1;
+    ok = (fclose(file) == 0) && ok;
+    return ok;
+}
+
+bool MeshCache::BlobFits(unsigned long long offset, unsigned long long size)
+{
+    return size == 0 || offset + size <= m_file.GetSize();
+}
+
+bool MeshCache::IsCompressed()
+{
+    return (m_header->flags & MeshCacheCompressed) != 0;
+}
+
+const void* MeshCache::GetVertices()
+{
+    return m_file.GetData() + m_header->vertexOffset;
+}
+
+unsigned long long MeshCache::GetVertexBytes()
+{
+    return m_header->vertexBytes;
+}
+
+unsigned int MeshCache::GetVertexCount()
+{
+    return m_header->vertexCount;
+}
+
+const unsigned int* MeshCache::GetIndices()
+{
+    return (const unsigned int*)(m_file.GetData() + m_header->indexOffset);
+}
+
+unsigned long long MeshCache::GetIndexBytes()
+{
+    return m_header->indexBytes;
+}
+
+unsigned int MeshCache::GetIndexCount()
+{
+    return m_header->indexCount;
+}
+
+const Meshlet* MeshCache::GetMeshlets()
+{
+    return (const Meshlet*)(m_file.GetData() + m_header->meshletOffset);
+}
+
+unsigned int MeshCache::GetMeshletCount()
+{
+    return m_header->meshletCount;
+}
+
+const void* MeshCache::GetPositions()
+{
+    return m_file.GetData() + m_header->positionOffset;
+}
+
+unsigned long long MeshCache::GetPositionBytes()
+{
+    return m_header->positionBytes;
+}
+
+unsigned int MeshCache::GetPositionCount()
+{
+    return m_header->positionCount;
+}
+
+const unsigned int* MeshCache::GetPositionIndices()
+{
+    return (const unsigned int*)(m_file.GetData() + m_header->positionIndexOffset);
+}
+
+unsigned long long MeshCache::GetPositionIndexBytes()
+{
+    return m_header->positionIndexBytes;
+}
+
+unsigned int MeshCache::GetPositionIndexCount()
+{
+    return m_header->positionIndexCount;
+}
+
+const MeshLod* MeshCache::GetLods()
+{
+    return m_header->lods;
+}
+
+unsigned int MeshCache::GetLodCount()
+{
+    return m_header->lodCount;
+}
+
+glm::vec3 MeshCache::GetBoundsMin()
+{
+    return glm::vec3(m_header->boundsMin[0], m_header->boundsMin[1], m_header->boundsMin[2]);
+}
+
+glm::vec3 MeshCache::GetBoundsMax()
+{
+    return glm::vec3(m_header->boundsMax[0], m_header->boundsMax[1], m_header->boundsMax[2]);
+}
+
+glm::vec4 MeshCache::GetBoundingSphere()
+{
+    return glm::vec4(m_header->boundingSphere[0], m_header->boundingSphere[1], m_header->boundingSphere[2], m_header->boundingSphere[3]);
+}
+
+bool MeshCache::Write(std::string cachePath, std::string sourcePath, unsigned int flags,
+                      const void* vertices, unsigned int vertexStride, unsigned int vertexCount,
+                      std::vector<unsigned int>& indices, std::vector<Meshlet>& meshlets, std::vector<MeshLod>& lods,
+                      const void* positions, unsigned int positionStride, unsigned int positionCount,
+                      std::vector<unsigned int>& positionIndices,
+                      glm::vec3 boundsMin, glm::vec3 boundsMax, glm::vec4 boundingSphere)
+{
+    MeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, meshCacheMagic, sizeof(meshCacheMagic));
+    header.version = MeshCacheVersion;
+    header.flags = flags;
+
+    if (!GetFileInfo(sourcePath, header.sourceSize, header.sourceModifiedTime))
+        return false;
+
+    {
+        MappedFile source(sourcePath);
+        if (!source.IsOpen())
+            return false;
+        header.sourceHash = HashBytes(source.GetData(), source.GetSize());
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        header.boundsMin[i] = boundsMin[i];
+        header.boundsMax[i] = boundsMax[i];
+    }
+    for (int i = 0; i < 4; i++)
+        header.boundingSphere[i] = boundingSphere[i];
+
+    if (positionCount == 0)
+        positionIndices.clear();
+
+    // The blobs that get written, either the data as it is, or compressed
+    const void* vertexBlob = vertices;
+    const void* indexBlob = indices.data();
+    const void* positionBlob = positions;
+    const void* positionIndexBlob = positionIndices.data();
+    header.vertexBytes = (unsigned long long)vertexCount * vertexStride;
+    header.indexBytes = (unsigned long long)indices.size() * sizeof(unsigned int);
+    header.positionBytes = (unsigned long long)positionCount * positionStride;
+    header.positionIndexBytes = (unsigned long long)positionIndices.size() * sizeof(unsigned int);
+
+    std::vector<unsigned char> compressedVertices;
+    std::vector<unsigned char> compressedIndices;
+    std::vector<unsigned char> compressedPositions;
+    std::vector<unsigned char> compressedPositionIndices;
+    if (flags & MeshCacheCompressed)
+    {
+        EncodeVertices(vertices, vertexCount, vertexStride, compressedVertices);
+        EncodeIndices(indices.data(), indices.size(), compressedIndices);
+        vertexBlob = compressedVertices.data();
+        indexBlob = compressedIndices.data();
+        header.vertexBytes = compressedVertices.size();
+        header.indexBytes = compressedIndices.size();
+
+        if (positionCount > 0)
+        {
+            EncodeVertices(positions, positionCount, positionStride, compressedPositions);
+            EncodeIndices(positionIndices.data(), positionIndices.size(), compressedPositionIndices);
+            positionBlob = compressedPositions.data();
+            positionIndexBlob = compressedPositionIndices.data();
+            header.positionBytes = compressedPositions.size();
+            header.positionIndexBytes = compressedPositionIndices.size();
+        }
+    }
+
+    header.vertexStride = vertexStride;
+    header.vertexCount = vertexCount;
+    header.vertexOffset = AlignUp(sizeof(MeshCacheHeader));
+    header.indexSize = sizeof(unsigned int);
+    header.indexCount = (unsigned int)indices.size();
+    header.indexOffset = AlignUp(header.vertexOffset + header.vertexBytes);
+    header.lodCount = (unsigned int)std::min(lods.size(), (size_t)MeshMaxLods);
+    for (unsigned int i = 0; i < header.lodCount; i++)
+        header.lods[i] = lods[i];
+
+    header.meshletStride = sizeof(Meshlet);
+    header.meshletCount = (unsigned int)meshlets.size();
+    header.meshletOffset = AlignUp(header.indexOffset + header.indexBytes);
+
+    header.positionStride = positionStride;
+    header.positionCount = positionCount;
+    header.positionOffset = AlignUp(header.meshletOffset + (unsigned long long)header.meshletCount * header.meshletStride);
+    header.positionIndexCount = (unsigned int)positionIndices.size();
+    header.positionIndexOffset = AlignUp(header.positionOffset + header.positionBytes);
+
+    // Write to a temporary file first, and only rename it once everything
+    // is written, so a half written cache never has the real name
+    std::string tempPath = cachePath + ".tmp";
+    FILE* file = fopen(tempPath.c_str(), "wb");
+    if (file == nullptr)
+        return false;
+
+    unsigned long long written = 0;
+    bool ok = true;
+
+    ok = ok && fwrite(&header, sizeof(header), 1, file) == 1;
+    written += sizeof(header);
+
+    ok = ok && WriteBlob(file, written, header.vertexOffset, vertexBlob, header.vertexBytes);
+    ok = ok && WriteBlob(file, written, header.indexOffset, indexBlob, header.indexBytes);
+    ok = ok && WriteBlob(file, written, header.meshletOffset, meshlets.data(), (unsigned long long)header.meshletCount * header.meshletStride);
+    ok = ok && WriteBlob(file, written, header.positionOffset, positionBlob, header.positionBytes);
+    ok = ok && WriteBlob(file, written, header.positionIndexOffset, positionIndexBlob, header.positionIndexBytes);
+
+    ok = (fclose(file) == 0) && ok;
+
+    if (!ok)
+    {
+        remove(tempPath.c_str());
+        return false;
+    }
+
+    // rename won't replace a file on windows, so remove the old one first
+    remove(cachePath.c_str());
+    if (rename(tempPath.c_str(), cachePath.c_str()) != 0)
+    {
+        remove(tempPath.c_str());
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,161 @@
+/*
+Title: Blur Optimization VR
+File Name: meshCache.h
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "mesh.h"
+#include "mappedFile.h"
+#include <string>
+#include <vector>
+
+// Options that change what ends up in the cache. If a mesh is loaded
+// with different options than the cache was made with, it gets rebuilt.
+// The Mesh options (MeshOptimizeVertexCache and friends) are stored from bit 8 up.
+#define MeshCacheTangents 1
+#define MeshCacheWelded 2
+// The vertex and index blobs are compressed with meshCodec.h, instead of stored as they are
+#define MeshCacheCompressed 4
+
+// Text obj files never change, but we were parsing them on every launch.
+// After the first parse, the finished vertex and index data are written
+// to a .meshbin file next to the obj. The next launch maps that file,
+// and the pointers go straight into glBufferData, with no parsing at all.
+//
+// Layout of a .meshbin file:
+//   MeshCacheHeader, padded to 64 bytes
+//   vertex blob, starts on a 64 byte boundary
+//   index blob, starts on a 64 byte boundary
+//   (vertex, index and position blobs are meshCodec.h streams if the cache is compressed)
+//   meshlet blob (if the mesh has meshlets), starts on a 64 byte boundary
+//   position blob and position index blob (if the mesh has a position stream), each on a 64 byte boundary
+struct MeshCacheHeader
+{
+    // "MESHBIN" and a version, bump the version whenever the layout changes
+    char magic[8];
+    unsigned int version;
+    unsigned int flags;
+
+    // What the source obj looked like when this cache was written
+    unsigned long long sourceSize;
+    long long sourceModifiedTime;
+    unsigned long long sourceHash;
+
+    // Box around every vertex position, and a sphere (center, radius)
+    float boundsMin[3];
+    float boundsMax[3];
+    float boundingSphere[4];
+
+    // Where the data is, counted in bytes from the start of the file
+    unsigned int vertexStride;
+    unsigned int vertexCount;
+    unsigned long long vertexOffset;
+    unsigned int indexSize;
+    unsigned int indexCount;
+    unsigned long long indexOffset;
+    unsigned int meshletStride;
+    unsigned int meshletCount;
+    unsigned long long meshletOffset;
+
+    // How many bytes the vertex and index blobs take in the file.
+    // Unless the cache is compressed, that's just count * stride
+    unsigned long long vertexBytes;
+    unsigned long long indexBytes;
+
+    // The position only stream, see MeshPositionStream. Counts are 0 if there isn't one
+    unsigned int positionStride;
+    unsigned int positionCount;
+    unsigned long long positionOffset;
+    unsigned long long positionBytes;
+    unsigned int positionIndexCount;
+    unsigned long long positionIndexOffset;
+    unsigned long long positionIndexBytes;
+
+    // Ranges of the index blob, level 0 is the full mesh
+    unsigned int lodCount;
+    MeshLod lods[MeshMaxLods];
+};
+
+class MeshCache
+{
+
+private:
+    MappedFile m_file;
+    const MeshCacheHeader* m_header = nullptr;
+
+    // Set by IsValidFor when the obj's time changed but its contents didn't
+    bool m_sourceTimeStale = false;
+
+    // True if a blob is inside the file
+    bool BlobFits(unsigned long long offset, unsigned long long size);
+
+public:
+    // Maps a .meshbin file, check IsValidFor before using anything in it
+    MeshCache(std::string cachePath);
+
+    // True if the cache exists, is complete, and was made from this obj with these options.
+    // vertexStride is the size of the vertex we expect, Vertex3dUVNormal or PackedVertex
+    bool IsValidFor(std::string sourcePath, unsigned int flags, unsigned int vertexStride);
+
+    // True if IsValidFor had to hash the obj to accept the cache, because its modified time changed.
+    // Call UpdateSourceTime once this is destroyed, so the next launch doesn't hash it again
+    bool IsSourceTimeStale();
+
+    // True if GetVertices and GetIndices point to compressed blobs, see meshCodec.h
+    bool IsCompressed();
+
+    // These point into the mapped file, and are only valid while this object lives
+    const void* GetVertices();
+    unsigned long long GetVertexBytes();
+    unsigned int GetVertexCount();
+    const unsigned int* GetIndices();
+    unsigned long long GetIndexBytes();
+    unsigned int GetIndexCount();
+    const Meshlet* GetMeshlets();
+    unsigned int GetMeshletCount();
+    const void* GetPositions();
+    unsigned long long GetPositionBytes();
+    unsigned int GetPositionCount();
+    const unsigned int* GetPositionIndices();
+    unsigned long long GetPositionIndexBytes();
+    unsigned int GetPositionIndexCount();
+    const MeshLod* GetLods();
+    unsigned int GetLodCount();
+    glm::vec3 GetBoundsMin();
+    glm::vec3 GetBoundsMax();
+    glm::vec4 GetBoundingSphere();
+
+    // Writes a new cache for a source obj, returns false if it could not be written.
+    // With MeshCacheCompressed in flags, the vertices and indices are compressed first.
+    // positionCount is 0 for meshes without a position stream
+    static bool Write(std::string cachePath, std::string sourcePath, unsigned int flags,
+                      const void* vertices, unsigned int vertexStride, unsigned int vertexCount,
+                      std::vector<unsigned int>& indices, std::vector<Meshlet>& meshlets, std::vector<MeshLod>& lods,
+                      const void* positions, unsigned int positionStride, unsigned int positionCount,
+                      std::vector<unsigned int>& positionIndices,
+                      glm::vec3 boundsMin, glm::vec3 boundsMax, glm::vec4 boundingSphere);
+
+    // Stores the obj's current modified time in the cache's header, after IsSourceTimeStale.
+    // The cache can't be open at the time, a mapped file can't be written on windows.
+    // Returns false if it could not be written, which only means the next launch hashes again
+    static bool UpdateSourceTime(std::string cachePath, std::string sourcePath);
+};
@@ -0,0 +1,736 @@
+/*
+Title: Blur Optimization VR
+File Name: meshCodec.cpp
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "meshCodec.h"
+#include "objLoader.h"
+#include "tangents.h"
+#include "meshOptimizer.h"
+#include "vertexPacking.h"
+#include "mappedFile.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <queue>
+
+// Vertices and indices per block. Blocks are compressed on their own,
+// so they can be decoded on different threads
+#define CodecVertexBlock 16384
+#define CodecIndexBlock (16384 * 3)
+
+// How each byte stream is stored
+#define EntropyConstant 0   // every byte is the same, just store it once
+#define EntropyRaw 1        // Huffman wouldn't make it smaller
+#define EntropyHuffman 2
+
+// Longest Huffman code. The decoder looks codes up in a table this many bits wide
+#define HuffmanMaxBits 12
+#define HuffmanTableSize (1 << HuffmanMaxBits)
+
+// The bit reader reads 8 bytes at a time, and runs up to 7 bytes ahead of the bits it has used,
+// so every bit stream ends with this many spare bytes
+#define HuffmanPadding 16
+
+// Index codes
+#define IndexNext 0        // the next vertex that hasn't been used yet
+#define IndexCorner0 1     // a corner of the triangle before this one
+#define IndexCorner1 2
+#define IndexCorner2 3
+#define IndexDelta 4       // anything else, stored as a difference from the index before it
+
+// ========== Helpers ==========
+
+static void PutU32(std::vector<unsigned char>& out, unsigned int value)
+{
+    for (int i = 0; i < 4; i++)
+        out.push_back((unsigned char)(value >> (i * 8)));
+}
+
+static void SetU32(std::vector<unsigned char>& out, size_t at, unsigned int value)
+{
+    for (int i = 0; i < 4; i++)
+        out[at + i] = (unsigned char)(value >> (i * 8));
+}
+
+static unsigned int GetU32(const unsigned char* data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((unsigned int)data[3] << 24);
+}
+
+// Zigzag turns small negative numbers into small positive ones: 0, -1, 1, -2, 2... become 0, 1, 2, 3, 4...
+static unsigned int Zigzag(unsigned int value)
+{
+    return (value << 1) ^ (unsigned int)((int)value >> 31);
+}
+
+static unsigned int Unzigzag(unsigned int value)
+{
+    return (value >> 1) ^ (0u - (value & 1));
+}
+
+// ========== Huffman ==========
+
+// Finds how many bits each byte value's code gets, no longer than HuffmanMaxBits
+static void BuildCodeLengths(const unsigned int* frequencies, unsigned char* lengths)
+{
+    std::vector<unsigned int> weights(frequencies, frequencies + 256);
+
+    while (true)
+    {
+        // Leaves are 0 to 255, the nodes joining them come after
+        typedef std::pair<unsigned long long, int> Node;
+        std::priority_queue<Node, std::vector<Node>, std::greater<Node>> queue;
+        int parents[512];
+
+        for (int s = 0; s < 256; s++)
+        {
+            if (weights[s] > 0)
+                queue.push(Node(weights[s], s));
+        }
+
+        int next = 256;
+        while (queue.size() > 1)
+        {
+            Node a = queue.top(); queue.pop();
+            Node b = queue.top(); queue.pop();
+            parents[a.second] = next;
+            parents[b.second] = next;
+            queue.push(Node(a.first + b.first, next));
+            next++;
+        }
+        int root = queue.top().second;
+
+        int longest = 0;
+        for (int s = 0; s < 256; s++)
+        {
+            lengths[s] = 0;
+            if (weights[s] == 0)
+                continue;
+
+            int depth = 0;
+            for (int node = s; node != root; node = parents[node])
+                depth++;
+            lengths[s] = (unsigned char)depth;
+            longest = std::max(longest, depth);
+        }
+
+        if (longest <= HuffmanMaxBits)
+            return;
+
+        // Too long. Flatten the counts, which evens out the tree, and try again
+        for (int s = 0; s < 256; s++)
+            weights[s] = weights[s] > 0 ? (weights[s] + 1) / 2 : 0;
+    }
+}
+
+// Canonical Huffman codes, so only the lengths need to be stored.
+// The bits are reversed, since the bit stream is read from the lowest bit up.
+static void BuildCodes(const unsigned char* lengths, unsigned int* codes)
+{
+    int lengthCounts[HuffmanMaxBits + 1] = {};
+    for (int s = 0; s < 256; s++)
+        lengthCounts[lengths[s]]++;
+    lengthCounts[0] = 0;
+
+    unsigned int nextCode[HuffmanMaxBits + 1] = {};
+    unsigned int code = 0;
+    for (int length = 1; length <= HuffmanMaxBits; length++)
+    {
+        code = (code + lengthCounts[length - 1]) << 1;
+        nextCode[length] = code;
+    }
+
+    for (int s = 0; s < 256; s++)
+    {
+        int length = lengths[s];
+        codes[s] = 0;
+        if (length == 0)
+            continue;
+
+        unsigned int forward = nextCode[length]++;
+        unsigned int reversed = 0;
+        for (int i = 0; i < length; i++, forward >>= 1)
+            reversed = (reversed << 1) | (forward & 1);
+        codes[s] = reversed;
+    }
+}
+
+// Compresses count bytes, and adds them to out
+static void EncodeBytes(const unsigned char* data, size_t count, std::vector<unsigned char>& out)
+{
+    unsigned int frequencies[256] = {};
+    for (size_t i = 0; i < count; i++)
+        frequencies[data[i]]++;
+
+    int used = 0;
+    for (int s = 0; s < 256; s++)
+        used += frequencies[s] > 0;
+
+    if (used <= 1)
+    {
+        out.push_back(EntropyConstant);
+        out.push_back(count > 0 ? data[0] : 0);
+        return;
+    }
+
+    unsigned char lengths[256];
+    unsigned int codes[256];
+    BuildCodeLengths(frequencies, lengths);
+    BuildCodes(lengths, codes);
+
+    unsigned long long bitCount = 0;
+    for (int s = 0; s < 256; s++)
+        bitCount += (unsigned long long)frequencies[s] * lengths[s];
+    size_t huffmanSize = 1 + 128 + 4 + (size_t)((bitCount + 7) / 8) + HuffmanPadding;
+
+    if (huffmanSize >= count + 1)
+    {
+        out.push_back(EntropyRaw);
+        out.insert(out.end(), data, data + count);
+        return;
+    }
+
+    out.push_back(EntropyHuffman);
+
+    // Two 4 bit lengths per byte
+    for (int s = 0; s < 256; s += 2)
+        out.push_back((unsigned char)(lengths[s] | (lengths[s + 1] << 4)));
+
+    size_t sizeAt = out.size();
+    PutU32(out, 0);
+    size_t start = out.size();
+
+    unsigned long long buffer = 0;
+    int bits = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        buffer |= (unsigned long long)codes[data[i]] << bits;
+        bits += lengths[data[i]];
+        while (bits >= 8)
+        {
+            out.push_back((unsigned char)buffer);
+            buffer >>= 8;
+            bits -= 8;
+        }
+    }
+    if (bits > 0)
+        out.push_back((unsigned char)buffer);
+
+    SetU32(out, sizeAt, (unsigned int)(out.size() - start));
+    out.insert(out.end(), HuffmanPadding, 0);
+}
+
+// Decompresses count bytes into destination. Returns where the stream ends, or nullptr if it's broken
+static const unsigned char* DecodeBytes(const unsigned char* data, const unsigned char* end, unsigned char* destination, size_t count)
+{
+    if (data >= end)
+        return nullptr;
+
+    unsigned char mode = *data++;
+
+    if (mode == EntropyConstant)
+    {
+        if (data >= end)
+            return nullptr;
+        memset(destination, *data, count);
+        return data + 1;
+    }
+
+    if (mode == EntropyRaw)
+    {
+        if ((size_t)(end - data) < count)
+            return nullptr;
+        memcpy(destination, data, count);
+        return data + count;
+    }
+
+    if (mode != EntropyHuffman || end - data < 128 + 4)
+        return nullptr;
+
+    unsigned char lengths[256];
+    for (int s = 0; s < 256; s += 2)
+    {
+        lengths[s] = data[s / 2] & 15;
+        lengths[s + 1] = data[s / 2] >> 4;
+    }
+    data += 128;
+
+    size_t streamSize = GetU32(data);
+    data += 4;
+    if ((size_t)(end - data) < streamSize + HuffmanPadding)
+        return nullptr;
+
+    // Every HuffmanMaxBits bit pattern maps to the symbol whose code it starts with, and that code's length.
+    // A Huffman code always fills the whole table, if this one doesn't the stream is broken.
+    unsigned int codes[256];
+    BuildCodes(lengths, codes);
+
+    unsigned short table[HuffmanTableSize];
+    unsigned int filled = 0;
+    for (int s = 0; s < 256; s++)
+    {
+        int length = lengths[s];
+        if (length == 0 || length > HuffmanMaxBits)
+            continue;
+
+        filled += HuffmanTableSize >> length;
+        if (filled > HuffmanTableSize)
+            return nullptr;
+
+        for (unsigned int pattern = codes[s]; pattern < HuffmanTableSize; pattern += 1u << length)
+            table[pattern] = (unsigned short)(s | (length << 8));
+    }
+    if (filled != HuffmanTableSize)
+        return nullptr;
+
+    const unsigned char* bitsEnd = data + streamSize;
+    const unsigned char* readEnd = bitsEnd + HuffmanPadding - 8;
+    const unsigned char* read = data;
+    unsigned long long buffer = 0;
+    int bits = 0;
+    size_t i = 0;
+
+    while (i < count)
+    {
+        // Top the buffer up to at least 56 bits, a whole number of bytes at a time
+        if (read > readEnd)
+            return nullptr;
+        unsigned long long next;
+        memcpy(&next, read, 8);
+        buffer |= next << bits;
+        read += (63 - bits) >> 3;
+        bits |= 56;
+
+        // 56 bits is enough for 4 codes
+        if (i + 4 <= count)
+        {
+            for (int k = 0; k < 4; k++)
+            {
+                unsigned short entry = table[buffer & (HuffmanTableSize - 1)];
+                destination[i++] = (unsigned char)entry;
+                buffer >>= entry >> 8;
+                bits -= entry >> 8;
+            }
+        }
+        else
+        {
+            while (i < count)
+            {
+                unsigned short entry = table[buffer & (HuffmanTableSize - 1)];
+                destination[i++] = (unsigned char)entry;
+                buffer >>= entry >> 8;
+            }
+        }
+    }
+
+    return bitsEnd + HuffmanPadding;
+}
+
+// ========== Blocks ==========
+
+// Both kinds of stream start with the number of blocks, and where each one starts
+static size_t BeginBlocks(std::vector<unsigned char>& out, unsigned int blockCount)
+{
+    size_t start = out.size();
+    PutU32(out, blockCount);
+    for (unsigned int i = 0; i <= blockCount; i++)
+        PutU32(out, 0);
+    return start;
+}
+
+// Finds where block i is, returns false if the stream is broken
+static bool FindBlock(const unsigned char* data, size_t size, unsigned int blockCount, unsigned int i,
+                      const unsigned char*& blockStart, const unsigned char*& blockEnd)
+{
+    if (size < 4 + 4 * (blockCount + 1) || GetU32(data) != blockCount)
+        return false;
+
+    size_t start = GetU32(data + 4 + 4 * i);
+    size_t end = GetU32(data + 4 + 4 * (i + 1));
+    if (start > end || end > size)
+        return false;
+
+    blockStart = data + start;
+    blockEnd = data + end;
+    return true;
+}
+
+// Runs job(0) to job(count - 1), on the pool if there is one, and returns true if all of them did
+static bool RunBlocks(unsigned int count, ThreadPool* pool, std::function<bool(unsigned int)> job)
+{
+    std::vector<char> results(count, 0);
+
+    if (pool != nullptr && count > 1)
+        pool->ParallelFor((int)count, [&](int i) { results[i] = job(i); });
+    else
+        for (unsigned int i = 0; i < count; i++)
+            results[i] = job(i);
+
+    return std::find(results.begin(), results.end(), 0) == results.end();
+}
+
+// ========== Vertices ==========
+
+void EncodeVertices(const void* vertices, size_t count, size_t stride, std::vector<unsigned char>& out)
+{
+    const unsigned char* bytes = (const unsigned char*)vertices;
+    size_t words = stride / 4;
+    unsigned int blockCount = (unsigned int)((count + CodecVertexBlock - 1) / CodecVertexBlock);
+
+    size_t start = BeginBlocks(out, blockCount);
+    std::vector<unsigned char> planes(CodecVertexBlock * stride);
+    std::vector<unsigned int> previous(words);
+
+    for (unsigned int block = 0; block < blockCount; block++)
+    {
+        SetU32(out, start + 4 + 4 * block, (unsigned int)(out.size() - start));
+
+        size_t first = (size_t)block * CodecVertexBlock;
+        size_t blockSize = std::min((size_t)CodecVertexBlock, count - first);
+
+        // Every block starts from zero, so it doesn't need the block before it
+        std::fill(previous.begin(), previous.end(), 0);
+
+        for (size_t i = 0; i < blockSize; i++)
+        {
+            const unsigned char* vertex = bytes + (first + i) * stride;
+            for (size_t w = 0; w < words; w++)
+            {
+                unsigned int word;
+                memcpy(&word, vertex + w * 4, 4);
+                unsigned int delta = Zigzag(word - previous[w]);
+                previous[w] = word;
+
+                // Byte k of word w goes in plane w * 4 + k
+                for (int k = 0; k < 4; k++)
+                    planes[(w * 4 + k) * blockSize + i] = (unsigned char)(delta >> (k * 8));
+            }
+        }
+
+        for (size_t plane = 0; plane < stride; plane++)
+            EncodeBytes(&planes[plane * blockSize], blockSize, out);
+    }
+
+    SetU32(out, start + 4 + 4 * blockCount, (unsigned int)(out.size() - start));
+}
+
+bool DecodeVertices(const unsigned char* data, size_t size, void* destination, size_t count, size_t stride, ThreadPool* pool)
+{
+    if (stride % 4 != 0 || size < 4)
+        return false;
+
+    size_t words = stride / 4;
+    unsigned int blockCount = (unsigned int)((count + CodecVertexBlock - 1) / CodecVertexBlock);
+
+    return RunBlocks(blockCount, pool, [&](unsigned int block)
+    {
+        const unsigned char* read;
+        const unsigned char* end;
+        if (!FindBlock(data, size, blockCount, block, read, end))
+            return false;
+
+        size_t first = (size_t)block * CodecVertexBlock;
+        size_t blockSize = std::min((size_t)CodecVertexBlock, count - first);
+
+        std::unique_ptr<unsigned char[]> planes(new unsigned char[blockSize * stride]);
+        for (size_t plane = 0; plane < stride; plane++)
+        {
+            read = DecodeBytes(read, end, &planes[plane * blockSize], blockSize);
+            if (read == nullptr)
+                return false;
+        }
+
+        // Put the bytes back together, and add the differences back up.
+        // The destination might be a mapped gpu buffer, so it is only written,
+        // in order, never read.
+        unsigned int previous[64] = {};
+        if (words > 64)
+            return false;
+
+        unsigned char* write = (unsigned char*)destination + first * stride;
+        for (size_t i = 0; i < blockSize; i++)
+        {
+            for (size_t w = 0; w < words; w++)
+            {
+                const unsigned char* plane = &planes[w * 4 * blockSize + i];
+                unsigned int delta = plane[0] | (plane[blockSize] << 8) | (plane[blockSize * 2] << 16) | ((unsigned int)plane[blockSize * 3] << 24);
+                previous[w] += Unzigzag(delta);
+            }
+            memcpy(write, previous, stride);
+            write += stride;
+        }
+        return true;
+    });
+}
+
+// ========== Indices ==========
+
+// Adds value to out, 7 bits per byte, the top bit says if there are more bytes
+static void PutVarint(std::vector<unsigned char>& out, unsigned int value)
+{
+    while (value >= 128)
+    {
+        out.push_back((unsigned char)(value | 128));
+        value >>= 7;
+    }
+    out.push_back((unsigned char)value);
+}
+
+void EncodeIndices(const unsigned int* indices, size_t count, std::vector<unsigned char>& out)
+{
+    unsigned int blockCount = (unsigned int)((count + CodecIndexBlock - 1) / CodecIndexBlock);
+    size_t start = BeginBlocks(out, blockCount);
+
+    std::vector<unsigned char> codes;
+    std::vector<unsigned char> deltas;
+
+    // These carry on across blocks, each block stores where they were
+    unsigned int next = 0;
+    unsigned int last = 0;
+
+    for (unsigned int block = 0; block < blockCount; block++)
+    {
+        SetU32(out, start + 4 + 4 * block, (unsigned int)(out.size() - start));
+
+        size_t first = (size_t)block * CodecIndexBlock;
+        size_t blockSize = std::min((size_t)CodecIndexBlock, count - first);
+
+        codes.clear();
+        deltas.clear();
+
+        // The triangle before this one, nothing to match at the start of a block
+        unsigned int corners[3] = { 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF };
+        unsigned int triangle[3];
+
+        PutU32(out, next);
+        PutU32(out, last);
+
+        for (size_t i = 0; i < blockSize; i++)
+        {
+            unsigned int index = indices[first + i];
+
+            if (index == next)
+                codes.push_back(IndexNext);
+            else if (index == corners[0])
+                codes.push_back(IndexCorner0);
+            else if (index == corners[1])
+                codes.push_back(IndexCorner1);
+            else if (index == corners[2])
+                codes.push_back(IndexCorner2);
+            else
+            {
+                codes.push_back(IndexDelta);
+                PutVarint(deltas, Zigzag(index - last));
+            }
+
+            last = index;
+            if (index >= next)
+                next = index + 1;
+
+            triangle[i % 3] = index;
+            if (i % 3 == 2)
+                memcpy(corners, triangle, sizeof(corners));
+        }
+
+        PutU32(out, (unsigned int)deltas.size());
+        EncodeBytes(codes.data(), codes.size(), out);
+        EncodeBytes(deltas.data(), deltas.size(), out);
+    }
+
+    SetU32(out, start + 4 + 4 * blockCount, (unsigned int)(out.size() - start));
+}
+
+bool DecodeIndices(const unsigned char* data, size_t size, unsigned int* destination, size_t count, size_t vertexCount, ThreadPool* pool)
+{
+    unsigned int blockCount = (unsigned int)((count + CodecIndexBlock - 1) / CodecIndexBlock);
+
+    return RunBlocks(blockCount, pool, [&](unsigned int block)
+    {
+        const unsigned char* read;
+        const unsigned char* end;
+        if (!FindBlock(data, size, blockCount, block, read, end) || end - read < 12)
+            return false;
+
+        size_t first = (size_t)block * CodecIndexBlock;
+        size_t blockSize = std::min((size_t)CodecIndexBlock, count - first);
+
+        unsigned int next = GetU32(read);
+        unsigned int last = GetU32(read + 4);
+        size_t deltaSize = GetU32(read + 8);
+        read += 12;
+
+        std::unique_ptr<unsigned char[]> codes(new unsigned char[blockSize]);
+        std::unique_ptr<unsigned char[]> deltas(new unsigned char[deltaSize + 1]);
+        read = DecodeBytes(read, end, codes.get(), blockSize);
+        if (read == nullptr || DecodeBytes(read, end, deltas.get(), deltaSize) == nullptr)
+            return false;
+
+        const unsigned char* delta = deltas.get();
+        const unsigned char* deltaEnd = delta + deltaSize;
+        unsigned int corners[3] = { 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF };
+        unsigned int triangle[3];
+        unsigned int* write = destination + first;
+
+        for (size_t i = 0; i < blockSize; i++)
+        {
+            unsigned int index;
+            switch (codes[i])
+            {
+            case IndexNext:
+                index = next;
+                break;
+            case IndexCorner0:
+            case IndexCorner1:
+            case IndexCorner2:
+                index = corners[codes[i] - IndexCorner0];
+                break;
+            case IndexDelta:
+            {
+                unsigned int value = 0;
+                for (int shift = 0; ; shift += 7)
+                {
+                    if (delta >= deltaEnd || shift > 28)
+                        return false;
+                    value |= (unsigned int)(*delta & 127) << shift;
+                    if ((*delta++ & 128) == 0)
+                        break;
+                }
+                index = last + Unzigzag(value);
+                break;
+            }
+            default:
+                return false;
+            }
+
+            if (index >= vertexCount)
+                return false;
+
+            write[i] = index;
+            last = index;
+            if (index >= next)
+                next = index + 1;
+
+            triangle[i % 3] = index;
+            if (i % 3 == 2)
+                memcpy(corners, triangle, sizeof(corners));
+        }
+        return true;
+    });
+}
+
+// ========== Benchmark ==========
+
+// Best time of a few runs of job, in seconds
+template <typename Function>
+static double BestTime(int repeats, Function job)
+{
+    double best = 1e30;
+    for (int i = 0; i < repeats; i++)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        job();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count());
+    }
+    return best;
+}
+
+void BenchmarkMeshCodec()
+{
+    const char* files[] =
+    {
+        "../Assets/Skybox.3Dobj",   "../Assets/bridge.3Dobj",   "../Assets/car.3Dobj",
+        "../Assets/cone.3Dobj",     "../Assets/cube.3Dobj",     "../Assets/cylinder.3Dobj",
+        "../Assets/dog.3Dobj",      "../Assets/dragon.3Dobj",   "../Assets/gun.3Dobj",
+        "../Assets/helix.3Dobj",    "../Assets/kitten.3Dobj",   "../Assets/sphere.3Dobj",
+        "../Assets/torus.3Dobj",    "../Assets/wheel.3Dobj",
+    };
+
+    ThreadPool& pool = GetSharedThreadPool();
+    const int repeats = 20;
+
+    printf("\nMesh codec benchmark (best of %d decodes, %d threads)\n", repeats, pool.GetThreadCount());
+    printf("%-26s %8s %10s %10s %10s %10s %7s %7s %10s\n",
+        "file", "obj KB", "format", "stride", "raw KB", "codec KB", "ratio", "vs obj", "decode MB/s");
+
+    for (const char* file : files)
+    {
+        std::vector<Vertex3dUVNormal> vertices;
+        std::vector<unsigned int> indices;
+        if (!LoadObjMapped(file, vertices, indices, true, nullptr))
+            continue;
+
+        size_t objSize = 0;
+        {
+            MappedFile obj(file);
+            objSize = obj.GetSize();
+        }
+
+        // The same steps a Mesh goes through, since the order matters a lot to the codec
+        CalculateTangentsParallel(vertices, indices, pool);
+        OptimizeVertexCache(indices, vertices.size());
+        OptimizeVertexFetch(vertices, indices);
+
+        glm::vec3 boundsMin = vertices[0].m_position;
+        glm::vec3 boundsMax = vertices[0].m_position;
+        for (const Vertex3dUVNormal& v : vertices)
+        {
+            boundsMin = glm::min(boundsMin, v.m_position);
+            boundsMax = glm::max(boundsMax, v.m_position);
+        }
+        std::vector<PackedVertex> packed;
+        PackVertices(vertices, boundsMin, boundsMax, packed);
+
+        // Once with full vertices, once with packed ones
+        for (int format = 0; format < 2; format++)
+        {
+            const void* vertexData = format == 0 ? (const void*)vertices.data() : (const void*)packed.data();
+            size_t stride = format == 0 ? sizeof(Vertex3dUVNormal) : sizeof(PackedVertex);
+            size_t rawSize = vertices.size() * stride + indices.size() * sizeof(unsigned int);
+
+            std::vector<unsigned char> vertexStream, indexStream;
+            EncodeVertices(vertexData, vertices.size(), stride, vertexStream);
+            EncodeIndices(indices.data(), indices.size(), indexStream);
+            size_t codecSize = vertexStream.size() + indexStream.size();
+
+            std::vector<unsigned char> decodedVertices(vertices.size() * stride);
+            std::vector<unsigned int> decodedIndices(indices.size());
+            bool ok = true;
+
+            double seconds = BestTime(repeats, [&]()
+            {
+                ok = DecodeVertices(vertexStream.data(), vertexStream.size(), decodedVertices.data(), vertices.size(), stride, &pool) && ok;
+                ok = DecodeIndices(indexStream.data(), indexStream.size(), decodedIndices.data(), indices.size(), vertices.size(), &pool) && ok;
+            });
+
+            ok = ok && memcmp(decodedVertices.data(), vertexData, decodedVertices.size()) == 0 && decodedIndices == indices;
+
+            printf("%-26s %8.1f %10s %10d %10.1f %10.1f %6.2fx %6.2fx %10.0f%s\n",
+                format == 0 ? file : "", objSize / 1024.0, format == 0 ? "full" : "packed", (int)stride,
+                rawSize / 1024.0, codecSize / 1024.0, (double)rawSize / codecSize, (double)objSize / codecSize,
+                rawSize / seconds / 1e6, ok ? "" : "  MISMATCH");
+        }
+    }
+}
@@ -0,0 +1,66 @@
+/*
+Title: Blur Optimization VR
+File Name: meshCodec.h
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "threadPool.h"
+#include <vector>
+
+// Lossless compression for vertex and index buffers, built to decode fast.
+//
+// Vertices: each vertex is read as 32 bit words. Every word is stored as the
+// difference from the same word in the vertex before it, and zigzagged, so small
+// changes either way become small numbers. Vertices next to each other in the buffer
+// are usually close in the mesh, so the differences are mostly small, and their top
+// bytes are mostly zero. Then the bytes are shuffled into planes: all the first bytes,
+// then all the second bytes, and so on, which puts those zeros next to each other.
+//
+// Indices: after OptimizeVertexCache and OptimizeVertexFetch, an index is usually
+// either the next vertex that hasn't been used yet, or one of the corners of the
+// triangle before it (triangles in a strip or fan share an edge with the one before).
+// Each index becomes a small code saying which, and the rare ones that are neither
+// are stored as a difference from the index before them.
+//
+// Every plane and code stream then goes through a Huffman coder, which gives
+// common bytes short codes. Huffman decodes with one table lookup per byte.
+//
+// Both are split into blocks that can be decoded at the same time.
+// Decoding only ever writes the destination front to back, and never reads it,
+// so it can point straight into a mapped OpenGL buffer.
+
+// Compresses count vertices of stride bytes each (stride has to be a multiple of 4), adds them to the end of out
+void EncodeVertices(const void* vertices, size_t count, size_t stride, std::vector<unsigned char>& out);
+
+// Decompresses into destination, which has room for count vertices of stride bytes.
+// Blocks are split across the pool if there is one. Returns false if the data is broken.
+bool DecodeVertices(const unsigned char* data, size_t size, void* destination, size_t count, size_t stride, ThreadPool* pool);
+
+// Compresses count indices, adds them to the end of out
+void EncodeIndices(const unsigned int* indices, size_t count, std::vector<unsigned char>& out);
+
+// Decompresses into destination, which has room for count indices. Returns false if the data is broken,
+// which includes any index that isn't below vertexCount, so a corrupt cache can't index past the vertices.
+bool DecodeIndices(const unsigned char* data, size_t size, unsigned int* destination, size_t count, size_t vertexCount, ThreadPool* pool);
+
+// Compresses every model in Assets, and prints how small they get and how fast they decode
+void BenchmarkMeshCodec();
@@ -0,0 +1,602 @@
+/*
+Title: Blur Optimization VR
+File Name: meshOptimizer.cpp
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "meshOptimizer.h"
+#include <cmath>
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <unordered_map>
+
+VertexCacheStats AnalyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, int cacheSize)
+{
+    VertexCacheStats stats;
+    if (indices.empty() || vertexCount == 0)
+        return stats;
+
+    // For every vertex, the "time" it was put in the cache. A FIFO cache
+    // pushes one entry out for every miss, so a vertex is still in the cache
+    // if fewer than cacheSize misses happened since it went in.
+    std::vector<unsigned int> timeAdded(vertexCount, 0);
+    std::vector<bool> everUsed(vertexCount, false);
+    unsigned int misses = 0;
+    unsigned int usedVertices = 0;
+
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        unsigned int v = indices[i];
+
+        if (!everUsed[v])
+        {
+            everUsed[v] = true;
+            usedVertices++;
+        }
+
+        if (timeAdded[v] == 0 || misses - timeAdded[v] >= (unsigned int)cacheSize)
+        {
+            misses++;
+            timeAdded[v] = misses;
+        }
+    }
+
+    stats.acmr = (float)misses / (indices.size() / 3);
+    stats.atvr = (float)misses / usedVertices;
+    return stats;
+}
+
+// ============================================================
+// Forsyth's algorithm.
+//
+// Every vertex gets a score. It is higher if the vertex is near the front
+// of a pretend LRU cache (it will be a cache hit), and higher if it has
+// only a few triangles left to draw (finish it off so it can leave the cache).
+// A triangle's score is the sum of its three vertex scores. We keep drawing
+// the best scoring triangle, and only the vertices in the cache change score,
+// so each step only looks at a handful of triangles.
+// ============================================================
+
+#define ForsythCacheSize 32
+#define ForsythMaxValence 32
+
+static float cacheScores[ForsythCacheSize];
+static float valenceScores[ForsythMaxValence + 1];
+static bool scoresReady = false;
+
+static void BuildScoreTables()
+{
+    if (scoresReady)
+        return;
+
+    for (int i = 0; i < ForsythCacheSize; i++)
+    {
+        // The last triangle's three vertices get a fixed score, so that we
+        // don't just keep drawing triangles that all use the same vertices
+        if (i < 3)
+            cacheScores[i] = 0.75f;
+        else
+            cacheScores[i] = powf(1.0f - (float)(i - 3) / (ForsythCacheSize - 3), 1.5f);
+    }
+
+    // Vertices with only a few triangles left get a boost
+    valenceScores[0] = 0;
+    for (int i = 1; i <= ForsythMaxValence; i++)
+        valenceScores[i] = 2.0f * powf((float)i, -0.5f);
+
+    scoresReady = true;
+}
+
+static float VertexScore(int cachePosition, unsigned int remaining)
+{
+    // no triangles left means this vertex never needs to be drawn again
+    if (remaining == 0)
+        return -1.0f;
+
+    float score = cachePosition >= 0 ? cacheScores[cachePosition] : 0.0f;
+    score += valenceScores[remaining < ForsythMaxValence ? remaining : ForsythMaxValence];
+    return score;
+}
+
+void OptimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0 || vertexCount == 0)
+        return;
+
+    BuildScoreTables();
+
+    // How many triangles each vertex is in, and then where each
+    // vertex's list of triangles starts in one big shared array
+    std::vector<unsigned int> remaining(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        remaining[indices[i]]++;
+
+    std::vector<unsigned int> firstTriangle(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+
+    std::vector<unsigned int> vertexTriangles(triangleCount * 3);
+    std::vector<unsigned int> filled(vertexCount, 0);
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            unsigned int v = indices[t * 3 + c];
+            vertexTriangles[firstTriangle[v] + filled[v]++] = (unsigned int)t;
+        }
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        vertexScore[v] = VertexScore(-1, remaining[v]);
+
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<bool> triangleDrawn(triangleCount, false);
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+    }
+
+    // Pretend LRU cache, with room for the three new vertices before the old ones get pushed out
+    unsigned int cache[ForsythCacheSize + 3];
+    int cacheCount = 0;
+
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+
+    // start with the best triangle in the whole mesh
+    int bestTriangle = 0;
+    for (size_t t = 1; t < triangleCount; t++)
+    {
+        if (triangleScore[t] > triangleScore[bestTriangle])
+            bestTriangle = (int)t;
+    }
+
+    // when nothing in the cache has triangles left, keep looking from here
+    size_t nextUnusedTriangle = 0;
+
+    for (size_t drawn = 0; drawn < triangleCount; drawn++)
+    {
+        if (bestTriangle < 0)
+        {
+            while (triangleDrawn[nextUnusedTriangle])
+                nextUnusedTriangle++;
+            bestTriangle = (int)nextUnusedTriangle;
+        }
+
+        unsigned int* triangle = &indices[bestTriangle * 3];
+        output.push_back(triangle[0]);
+        output.push_back(triangle[1]);
+        output.push_back(triangle[2]);
+        triangleDrawn[bestTriangle] = true;
+
+        // take this triangle out of each of its vertices' lists
+        for (int c = 0; c < 3; c++)
+        {
+            unsigned int v = triangle[c];
+            unsigned int* list = &vertexTriangles[firstTriangle[v]];
+            for (unsigned int i = 0; i < remaining[v]; i++)
+            {
+                if (list[i] == (unsigned int)bestTriangle)
+                {
+                    list[i] = list[remaining[v] - 1];
+                    break;
+                }
+            }
+            remaining[v]--;
+        }
+
+        // The triangle's vertices go to the front of the cache,
+        // and everything else moves back
+        unsigned int newCache[ForsythCacheSize + 3];
+        int newCount = 0;
+        for (int c = 0; c < 3; c++)
+            newCache[newCount++] = triangle[c];
+
+        for (int i = 0; i < cacheCount; i++)
+        {
+            unsigned int v = cache[i];
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                newCache[newCount++] = v;
+        }
+
+        // Update the scores of everything that was in, or is now in, the cache.
+        // Anything past ForsythCacheSize just fell out.
+        for (int i = 0; i < newCount; i++)
+        {
+            unsigned int v = newCache[i];
+            cachePosition[v] = i < ForsythCacheSize ? i : -1;
+            vertexScore[v] = VertexScore(cachePosition[v], remaining[v]);
+        }
+
+        // Only the triangles touching those vertices changed score,
+        // so the next best triangle is one of them
+        bestTriangle = -1;
+        float bestScore = -1.0f;
+        for (int i = 0; i < newCount; i++)
+        {
+            unsigned int v = newCache[i];
+            unsigned int* list = &vertexTriangles[firstTriangle[v]];
+            for (unsigned int j = 0; j < remaining[v]; j++)
+            {
+                unsigned int t = list[j];
+                unsigned int* other = &indices[t * 3];
+                float score = vertexScore[other[0]] + vertexScore[other[1]] + vertexScore[other[2]];
+                triangleScore[t] = score;
+
+                if (score > bestScore)
+                {
+                    bestScore = score;
+                    bestTriangle = (int)t;
+                }
+            }
+        }
+
+        cacheCount = newCount < ForsythCacheSize ? newCount : ForsythCacheSize;
+        for (int i = 0; i < cacheCount; i++)
+            cache[i] = newCache[i];
+    }
+
+    indices.swap(output);
+}
+
+void OptimizeVertexFetch(std::vector<Vertex3dUVNormal>& vertices, std::vector<unsigned int>& indices)
+{
+    // The new number for each old vertex, or unassigned if it hasn't been used yet
+    const unsigned int unassigned = 0xFFFFFFFF;
+    std::vector<unsigned int> remap(vertices.size(), unassigned);
+
+    std::vector<Vertex3dUVNormal> reordered;
+    reordered.reserve(vertices.size());
+
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        unsigned int v = indices[i];
+        if (remap[v] == unassigned)
+        {
+            remap[v] = (unsigned int)reordered.size();
+            reordered.push_back(vertices[v]);
+        }
+        indices[i] = remap[v];
+    }
+
+    vertices.swap(reordered);
+}
+
+// ============================================================
+// Overdraw.
+//
+// This follows "Fast Triangle Reordering for Vertex Locality and Reduced
+// Overdraw" (Sander, Nehab, Barczak). The cache optimized triangle list is cut
+// into clusters at places where the vertex cache would start over anyway, so
+// moving whole clusters around barely hurts the cache. Then the clusters are
+// sorted so the ones that face outward, away from the middle, come first.
+// ============================================================
+
+// A FIFO vertex cache that can be emptied instantly, by jumping the clock forward
+struct FifoCache
+{
+    std::vector<unsigned int> timeAdded;
+    unsigned int clock;
+    unsigned int size;
+
+    FifoCache(size_t vertexCount, unsigned int cacheSize) : timeAdded(vertexCount, 0), clock(cacheSize + 1), size(cacheSize)
+    {
+    }
+
+    void Reset()
+    {
+        clock += size + 1;
+    }
+
+    // returns how many of the triangle's vertices were not in the cache
+    unsigned int AddTriangle(const unsigned int* triangle)
+    {
+        unsigned int misses = 0;
+        for (int c = 0; c < 3; c++)
+        {
+            unsigned int v = triangle[c];
+            if (clock - timeAdded[v] > size)
+            {
+                timeAdded[v] = clock++;
+                misses++;
+            }
+        }
+        return misses;
+    }
+};
+
+void OptimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex3dUVNormal>& vertices, float threshold)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    FifoCache cache(vertices.size(), 16);
+
+    // Hard boundaries: a triangle that misses on all three vertices means
+    // the cache has nothing useful in it, so a new cluster can start there
+    std::vector<unsigned int> hardClusters;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        unsigned int misses = cache.AddTriangle(&indices[t * 3]);
+        if (t == 0 || misses == 3)
+            hardClusters.push_back((unsigned int)t);
+    }
+
+    // Soft boundaries: cut each hard cluster into smaller ones wherever the
+    // cache has done about as well as it does over the whole cluster
+    std::vector<unsigned int> clusters;
+    for (size_t c = 0; c < hardClusters.size(); c++)
+    {
+        unsigned int start = hardClusters[c];
+        unsigned int end = c + 1 < hardClusters.size() ? hardClusters[c + 1] : (unsigned int)triangleCount;
+
+        cache.Reset();
+        unsigned int clusterMisses = 0;
+        for (unsigned int t = start; t < end; t++)
+            clusterMisses += cache.AddTriangle(&indices[t * 3]);
+
+        float clusterThreshold = threshold * (float)clusterMisses / (end - start);
+
+        clusters.push_back(start);
+        cache.Reset();
+
+        unsigned int runningMisses = 0;
+        unsigned int runningTriangles = 0;
+        for (unsigned int t = start; t < end; t++)
+        {
+            runningMisses += cache.AddTriangle(&indices[t * 3]);
+            runningTriangles++;
+
+            if ((float)runningMisses / runningTriangles <= clusterThreshold)
+            {
+                // good enough, start a new cluster on the next triangle
+                clusters.push_back(t + 1);
+                cache.Reset();
+                runningMisses = 0;
+                runningTriangles = 0;
+            }
+        }
+
+        // The last cluster is whatever was left over, which usually has a
+        // bad ACMR on its own, so join it to the one before it
+        if (clusters.back() != start)
+            clusters.pop_back();
+    }
+
+    // The middle of the mesh
+    glm::vec3 meshCenter;
+    for (size_t v = 0; v < vertices.size(); v++)
+        meshCenter += vertices[v].m_position;
+    meshCenter /= (float)vertices.size();
+
+    // For each cluster, how much it faces away from the middle of the mesh.
+    // The center and normal are weighted by triangle area, so tiny triangles don't count for much.
+    std::vector<float> sortKey(clusters.size());
+    for (size_t c = 0; c < clusters.size(); c++)
+    {
+        unsigned int start = clusters[c];
+        unsigned int end = c + 1 < clusters.size() ? clusters[c + 1] : (unsigned int)triangleCount;
+
+        glm::vec3 center;
+        glm::vec3 normal;
+        float area = 0;
+
+        for (unsigned int t = start; t < end; t++)
+        {
+            glm::vec3 p0 = vertices[indices[t * 3 + 0]].m_position;
+            glm::vec3 p1 = vertices[indices[t * 3 + 1]].m_position;
+            glm::vec3 p2 = vertices[indices[t * 3 + 2]].m_position;
+
+            // the cross product's length is twice the triangle's area
+            glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+            float triangleArea = glm::length(n);
+
+            center += (p0 + p1 + p2) * (triangleArea / 3.0f);
+            normal += n;
+            area += triangleArea;
+        }
+
+        if (area > 0)
+            center /= area;
+
+        float normalLength = glm::length(normal);
+        if (normalLength > 0)
+            normal /= normalLength;
+
+        sortKey[c] = glm::dot(center - meshCenter, normal);
+    }
+
+    // Outward facing clusters first
+    std::vector<unsigned int> order(clusters.size());
+    for (size_t c = 0; c < order.size(); c++)
+        order[c] = (unsigned int)c;
+
+    std::stable_sort(order.begin(), order.end(), [&sortKey](unsigned int a, unsigned int b)
+    {
+        return sortKey[a] > sortKey[b];
+    });
+
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        unsigned int c = order[i];
+        unsigned int start = clusters[c];
+        unsigned int end = c + 1 < clusters.size() ? clusters[c + 1] : (unsigned int)triangleCount;
+        output.insert(output.end(), indices.begin() + start * 3, indices.begin() + end * 3);
+    }
+
+    indices.swap(output);
+}
+
+float EstimateOverdraw(const std::vector<unsigned int>& indices, const std::vector<Vertex3dUVNormal>& vertices, int viewCount, int resolution)
+{
+    if (indices.empty() || vertices.empty())
+        return 0;
+
+    // A sphere around the mesh, so every view fits the whole mesh on screen
+    glm::vec3 boundsMin = vertices[0].m_position;
+    glm::vec3 boundsMax = vertices[0].m_position;
+    for (size_t v = 1; v < vertices.size(); v++)
+    {
+        boundsMin = glm::min(boundsMin, vertices[v].m_position);
+        boundsMax = glm::max(boundsMax, vertices[v].m_position);
+    }
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    float radius = glm::length(boundsMax - center);
+    if (radius <= 0)
+        return 0;
+
+    std::vector<float> depth(resolution * resolution);
+    std::vector<glm::vec3> screen(vertices.size());
+
+    double shaded = 0;
+    double covered = 0;
+
+    for (int view = 0; view < viewCount; view++)
+    {
+        // Spread the view directions evenly over a sphere (a fibonacci spiral)
+        float y = 1.0f - 2.0f * (view + 0.5f) / viewCount;
+        float ring = sqrtf(1.0f - y * y);
+        float angle = view * 2.39996323f;
+        glm::vec3 forward(cosf(angle) * ring, y, sinf(angle) * ring);
+
+        glm::vec3 helper = fabsf(forward.y) < 0.99f ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0);
+        glm::vec3 right = glm::normalize(glm::cross(helper, forward));
+        glm::vec3 up = glm::cross(forward, right);
+
+        // Orthographic projection onto the screen, z is distance along the view direction
+        float scale = 0.5f * resolution / radius;
+        for (size_t v = 0; v < vertices.size(); v++)
+        {
+            glm::vec3 p = vertices[v].m_position - center;
+            screen[v] = glm::vec3(glm::dot(p, right) * scale + 0.5f * resolution,
+                                  glm::dot(p, up) * scale + 0.5f * resolution,
+                                  glm::dot(p, forward));
+        }
+
+        std::fill(depth.begin(), depth.end(), FLT_MAX);
+
+        for (size_t t = 0; t + 2 < indices.size(); t += 3)
+        {
+            glm::vec3 a = screen[indices[t]];
+            glm::vec3 b = screen[indices[t + 1]];
+            glm::vec3 c = screen[indices[t + 2]];
+
+            // Twice the area on screen, the scene draws without culling so either winding counts
+            float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+            if (area == 0)
+                continue;
+
+            int minX = std::max(0, (int)floorf(std::min(a.x, std::min(b.x, c.x))));
+            int maxX = std::min(resolution - 1, (int)ceilf(std::max(a.x, std::max(b.x, c.x))));
+            int minY = std::max(0, (int)floorf(std::min(a.y, std::min(b.y, c.y))));
+            int maxY = std::min(resolution - 1, (int)ceilf(std::max(a.y, std::max(b.y, c.y))));
+
+            float inverseArea = 1.0f / area;
+
+            for (int py = minY; py <= maxY; py++)
+            {
+                for (int px = minX; px <= maxX; px++)
+                {
+                    // sample at the pixel center, like the gpu does
+                    float x = px + 0.5f;
+                    float y = py + 0.5f;
+
+                    // barycentric weights, all three are positive inside the triangle
+                    float w0 = ((b.x - x) * (c.y - y) - (b.y - y) * (c.x - x)) * inverseArea;
+                    float w1 = ((c.x - x) * (a.y - y) - (c.y - y) * (a.x - x)) * inverseArea;
+                    float w2 = 1.0f - w0 - w1;
+                    if (w0 < 0 || w1 < 0 || w2 < 0)
+                        continue;
+
+                    float z = w0 * a.z + w1 * b.z + w2 * c.z;
+                    float& stored = depth[py * resolution + px];
+                    if (z < stored)
+                    {
+                        // this fragment would run the fragment shader
+                        stored = z;
+                        shaded++;
+                    }
+                }
+            }
+        }
+
+        for (size_t i = 0; i < depth.size(); i++)
+        {
+            if (depth[i] != FLT_MAX)
+                covered++;
+        }
+    }
+
+    return covered > 0 ? (float)(shaded / covered) : 0.0f;
+}
+
+void FindSharedPositions(const std::vector<Vertex3dUVNormal>& vertices, std::vector<unsigned int>& positionVertex)
+{
+    positionVertex.resize(vertices.size());
+
+    std::unordered_map<unsigned long long, unsigned int> seen;
+    seen.reserve(vertices.size());
+
+    for (unsigned int v = 0; v < vertices.size(); v++)
+    {
+        // Hash the bits of the position, exact matches are all we want
+        unsigned int bits[3];
+        memcpy(bits, &vertices[v].m_position, sizeof(bits));
+        unsigned long long key = bits[0] * 73856093ull ^ bits[1] * 19349663ull ^ (unsigned long long)bits[2] << 32;
+
+        // Two different positions can have the same key, those just don't get shared
+        auto found = seen.find(key);
+        if (found != seen.end() && vertices[found->second].m_position == vertices[v].m_position)
+            positionVertex[v] = found->second;
+        else
+            positionVertex[v] = seen[key] = v;
+    }
+}
+
+void BuildPositionStream(const std::vector<Vertex3dUVNormal>& vertices, const std::vector<unsigned int>& indices,
+                         std::vector<unsigned int>& sourceVertex, std::vector<unsigned int>& positionIndices)
+{
+    std::vector<unsigned int> positionVertex;
+    FindSharedPositions(vertices, positionVertex);
+
+    // Number the positions in the order they are first used, the same as OptimizeVertexFetch does
+    std::vector<unsigned int> newIndex(vertices.size(), 0xFFFFFFFF);
+    sourceVertex.clear();
+    positionIndices.resize(indices.size());
+
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        unsigned int shared = positionVertex[indices[i]];
+        if (newIndex[shared] == 0xFFFFFFFF)
+        {
+            newIndex[shared] = (unsigned int)sourceVertex.size();
+            sourceVertex.push_back(shared);
+        }
+        positionIndices[i] = newIndex[shared];
+    }
+}
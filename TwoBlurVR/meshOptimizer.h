@@ -0,0 +1,78 @@
+/*
+Title: Blur Optimization VR
+File Name: meshOptimizer.h
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "mesh.h"
+#include <vector>
+
+// How well an index buffer uses the gpu's post-transform vertex cache.
+// The gpu remembers the last few vertices it ran the vertex shader on,
+// and if a triangle uses one of those again it doesn't run the shader again.
+struct VertexCacheStats
+{
+    // Average Cache Miss Ratio: vertex shader runs per triangle.
+    // 3.0 is the worst, around 0.5 to 0.7 is about as good as it gets.
+    float acmr = 0;
+
+    // Average Transformed Vertex Ratio: vertex shader runs per vertex.
+    // 1.0 is perfect, every vertex only ran once.
+    float atvr = 0;
+};
+
+// Runs the index buffer through a pretend FIFO vertex cache of cacheSize entries.
+// No gpu needed, so we can check the optimizer actually helped.
+VertexCacheStats AnalyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, int cacheSize);
+
+// Reorders the triangles so that triangles sharing vertices are drawn close together.
+// This is Tom Forsyth's linear-speed vertex cache optimization.
+void OptimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount);
+
+// Renumbers the vertices in the order the index buffer first uses them, so
+// the gpu reads the vertex buffer front to back. Unused vertices are dropped.
+void OptimizeVertexFetch(std::vector<Vertex3dUVNormal>& vertices, std::vector<unsigned int>& indices);
+
+// Reorders an index buffer that already went through OptimizeVertexCache so that
+// triangles facing away from the middle of the mesh are drawn first. From most
+// directions those are the ones in front, so the depth test can throw away more
+// of what comes after (less overdraw). Triangles are moved in clusters, so the
+// vertex cache order inside each cluster is kept. threshold is how much worse
+// the ACMR is allowed to get, 1.05 means 5% worse.
+void OptimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex3dUVNormal>& vertices, float threshold);
+
+// Draws the mesh into a small depth buffer from viewCount directions around it, on the cpu.
+// Returns fragments that passed the depth test divided by pixels covered, 1.0 means no overdraw.
+float EstimateOverdraw(const std::vector<unsigned int>& indices, const std::vector<Vertex3dUVNormal>& vertices, int viewCount, int resolution);
+
+// Vertices at a uv seam or a hard edge are split into copies with the same position.
+// For every vertex, finds the first vertex with exactly the same position,
+// so code that cares about the shape (not the uvs or normals) can treat them as one.
+void FindSharedPositions(const std::vector<Vertex3dUVNormal>& vertices, std::vector<unsigned int>& positionVertex);
+
+// Depth only passes don't need uvs, normals or tangents, so those copies are wasted there.
+// Makes a second set of indices that point at one vertex per position: sourceVertex gets
+// the vertex each position comes from, in the order the indices first use them, and
+// positionIndices gets the indices rewritten to point into sourceVertex.
+// Triangles stay in the same order, so index ranges (like levels of detail) still line up.
+void BuildPositionStream(const std::vector<Vertex3dUVNormal>& vertices, const std::vector<unsigned int>& indices,
+                         std::vector<unsigned int>& sourceVertex, std::vector<unsigned int>& positionIndices);
@@ -0,0 +1,337 @@
+/*
+Title: Blur Optimization VR
+File Name: meshlet.cpp
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "meshlet.h"
+#include "mesh.h"
+#include "meshOptimizer.h"
+#include <cfloat>
+
+// A meshlet that no camera position can backface cull gets this cutoff.
+// The test compares it against a cosine, which is never more than 1
+#define NoConeCutoff 2.0f
+
+// Normals more than about 84 degrees away from the average
+// make the cone too wide to be worth testing
+#define MinConeDot 0.1f
+
+// Finds the sphere and cone for the triangles in meshlet, and fills them in
+static void ComputeMeshletBounds(Meshlet& meshlet, const std::vector<unsigned int>& indices, const std::vector<Vertex3dUVNormal>& vertices)
+{
+    unsigned int first = meshlet.firstIndex;
+    unsigned int end = first + meshlet.triangleCount * 3;
+
+    // Sphere around the center of the box. Not the smallest sphere,
+    // but close, and it only needs two passes over the corners
+    glm::vec3 boxMin = vertices[indices[first]].m_position;
+    glm::vec3 boxMax = boxMin;
+    for (unsigned int i = first; i < end; i++)
+    {
+        boxMin = glm::min(boxMin, vertices[indices[i]].m_position);
+        boxMax = glm::max(boxMax, vertices[indices[i]].m_position);
+    }
+
+    meshlet.center = (boxMin + boxMax) * 0.5f;
+    meshlet.radius = 0;
+    for (unsigned int i = first; i < end; i++)
+        meshlet.radius = glm::max(meshlet.radius, glm::length(vertices[indices[i]].m_position - meshlet.center));
+
+    // The cone axis is the average of the triangle normals.
+    // Normals come from the triangle itself, not the smoothed vertex normals,
+    // since it's the triangle's winding that decides if it gets culled
+    glm::vec3 normalSum(0);
+    for (unsigned int i = first; i < end; i += 3)
+    {
+        glm::vec3 p0 = vertices[indices[i]].m_position;
+        glm::vec3 p1 = vertices[indices[i + 1]].m_position;
+        glm::vec3 p2 = vertices[indices[i + 2]].m_position;
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(normal);
+        if (length > 0)
+            normalSum += normal / length;
+    }
+
+    meshlet.coneApex = meshlet.center;
+    meshlet.coneAxis = glm::vec3(0);
+    meshlet.coneCutoff = NoConeCutoff;
+
+    float axisLength = glm::length(normalSum);
+    if (axisLength <= 0)
+        return;
+    glm::vec3 axis = normalSum / axisLength;
+
+    // The widest triangle decides how wide the cone is
+    float minDot = 1;
+    for (unsigned int i = first; i < end; i += 3)
+    {
+        glm::vec3 p0 = vertices[indices[i]].m_position;
+        glm::vec3 normal = glm::cross(vertices[indices[i + 1]].m_position - p0, vertices[indices[i + 2]].m_position - p0);
+        float length = glm::length(normal);
+        if (length > 0)
+            minDot = glm::min(minDot, glm::dot(normal / length, axis));
+    }
+
+    if (minDot <= MinConeDot)
+        return;
+
+    // Move the apex back along the axis until every triangle's
+    // plane is in front of it. From anywhere inside the cone behind
+    // the apex, the camera is behind every one of those planes.
+    float maxDistance = 0;
+    for (unsigned int i = first; i < end; i += 3)
+    {
+        glm::vec3 p0 = vertices[indices[i]].m_position;
+        glm::vec3 normal = glm::cross(vertices[indices[i + 1]].m_position - p0, vertices[indices[i + 2]].m_position - p0);
+        float length = glm::length(normal);
+        if (length <= 0)
+            continue;
+        normal /= length;
+
+        float distance = glm::dot(meshlet.center - p0, normal) / glm::dot(axis, normal);
+        maxDistance = glm::max(maxDistance, distance);
+    }
+
+    meshlet.coneApex = meshlet.center - axis * maxDistance;
+    meshlet.coneAxis = axis;
+
+    // sin of the cone's half angle, or the cos of the angle a view direction has to be within
+    meshlet.coneCutoff = sqrtf(1 - minDot * minDot);
+}
+
+// Unit normal of a triangle, zero if it has no area
+static glm::vec3 TriangleNormal(const std::vector<unsigned int>& indices, unsigned int triangle, const std::vector<Vertex3dUVNormal>& vertices)
+{
+    glm::vec3 p0 = vertices[indices[triangle * 3]].m_position;
+    glm::vec3 normal = glm::cross(vertices[indices[triangle * 3 + 1]].m_position - p0, vertices[indices[triangle * 3 + 2]].m_position - p0);
+    float length = glm::length(normal);
+    return length > 0 ? normal / length : glm::vec3(0);
+}
+
+// How many of a triangle's vertices aren't in meshlet id yet
+static unsigned int CountNewVertices(const unsigned int* corners, const std::vector<unsigned int>& vertexMeshlet, unsigned int id)
+{
+    unsigned int count = 0;
+    for (unsigned int j = 0; j < 3; j++)
+    {
+        // A triangle can use the same vertex twice, only count it once
+        unsigned int v = corners[j];
+        bool repeated = (j > 0 && corners[0] == v) || (j > 1 && corners[1] == v);
+        if (vertexMeshlet[v] != id && !repeated)
+            count++;
+    }
+    return count;
+}
+
+void BuildMeshlets(std::vector<unsigned int>& indices, const std::vector<Vertex3dUVNormal>& vertices, std::vector<Meshlet>& meshlets)
+{
+    meshlets.clear();
+
+    unsigned int triangleCount = (unsigned int)(indices.size() / 3);
+    if (triangleCount == 0)
+        return;
+
+    // Vertices at a uv seam or hard edge are split into copies with the same position.
+    // Triangles on either side are still neighbors, so find neighbors by position:
+    // every vertex points to the first vertex that has its position.
+    std::vector<unsigned int> positionVertex;
+    FindSharedPositions(vertices, positionVertex);
+
+    // Which triangles touch each position, all in one array.
+    // The triangles touching vertex v's position are
+    // positionTriangles[firstTriangle[p]] up to firstTriangle[p + 1], where p = positionVertex[v]
+    std::vector<unsigned int> firstTriangle(vertices.size() + 1, 0);
+    for (unsigned int i = 0; i < triangleCount * 3; i++)
+        firstTriangle[positionVertex[indices[i]] + 1]++;
+    for (unsigned int v = 0; v < vertices.size(); v++)
+        firstTriangle[v + 1] += firstTriangle[v];
+
+    std::vector<unsigned int> positionTriangles(triangleCount * 3);
+    std::vector<unsigned int> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+    for (unsigned int i = 0; i < triangleCount * 3; i++)
+        positionTriangles[fill[positionVertex[indices[i]]]++] = i / 3;
+
+    std::vector<glm::vec3> normals(triangleCount);
+    for (unsigned int t = 0; t < triangleCount; t++)
+        normals[t] = TriangleNormal(indices, t, vertices);
+
+    // The last meshlet each vertex was added to, so we know if it's new to the current one
+    std::vector<unsigned int> vertexMeshlet(vertices.size(), 0xFFFFFFFF);
+    std::vector<bool> used(triangleCount, false);
+
+    // Triangles in the order they go into meshlets, this becomes the new index buffer
+    std::vector<unsigned int> ordered;
+    ordered.reserve(indices.size());
+
+    // Vertices in the meshlet being built, their triangles are the ones we can add next
+    std::vector<unsigned int> meshletVertices;
+    meshletVertices.reserve(MeshletMaxVertices);
+
+    // Seeds are taken in index buffer order, so the meshlets
+    // keep roughly the order the optimizer put the triangles in
+    unsigned int nextSeed = 0;
+
+    while (ordered.size() < indices.size())
+    {
+        Meshlet meshlet = {};
+        meshlet.firstIndex = (unsigned int)ordered.size();
+        unsigned int id = (unsigned int)meshlets.size();
+        glm::vec3 normalSum(0);
+        meshletVertices.clear();
+
+        while (used[nextSeed])
+            nextSeed++;
+        unsigned int next = nextSeed;
+
+        while (true)
+        {
+            // Add the triangle
+            const unsigned int* corners = &indices[next * 3];
+            meshlet.vertexCount += CountNewVertices(corners, vertexMeshlet, id);
+            for (int j = 0; j < 3; j++)
+            {
+                if (vertexMeshlet[corners[j]] != id)
+                {
+                    vertexMeshlet[corners[j]] = id;
+                    meshletVertices.push_back(corners[j]);
+                }
+                ordered.push_back(corners[j]);
+            }
+            used[next] = true;
+            normalSum += normals[next];
+            meshlet.triangleCount++;
+
+            if (meshlet.triangleCount == MeshletMaxTriangles)
+                break;
+
+            // Pick the neighbor that adds the fewest vertices, then the one
+            // that faces the same way as the meshlet, for a tighter cone
+            glm::vec3 averageNormal = glm::length(normalSum) > 0 ? glm::normalize(normalSum) : glm::vec3(0);
+            float bestScore = FLT_MAX;
+            unsigned int best = 0xFFFFFFFF;
+
+            for (unsigned int v : meshletVertices)
+            {
+                unsigned int p = positionVertex[v];
+                for (unsigned int k = firstTriangle[p]; k < firstTriangle[p + 1]; k++)
+                {
+                    unsigned int t = positionTriangles[k];
+                    if (used[t])
+                        continue;
+
+                    unsigned int newVertices = CountNewVertices(&indices[t * 3], vertexMeshlet, id);
+                    if (meshlet.vertexCount + newVertices > MeshletMaxVertices)
+                        continue;
+
+                    float score = newVertices + (1 - glm::dot(normals[t], averageNormal));
+                    if (score < bestScore)
+                    {
+                        bestScore = score;
+                        best = t;
+                    }
+                }
+            }
+
+            // Nothing touching the meshlet fits, which happens at the edge
+            // of a separate piece of the mesh. Take the next triangle
+            // in the index buffer, which the optimizer put close by.
+            if (best == 0xFFFFFFFF)
+            {
+                while (nextSeed < triangleCount && used[nextSeed])
+                    nextSeed++;
+                if (nextSeed < triangleCount && meshlet.vertexCount + CountNewVertices(&indices[nextSeed * 3], vertexMeshlet, id) <= MeshletMaxVertices)
+                    best = nextSeed;
+            }
+
+            // Nothing fits, this meshlet is done
+            if (best == 0xFFFFFFFF)
+                break;
+            next = best;
+        }
+
+        meshlets.push_back(meshlet);
+    }
+
+    indices.swap(ordered);
+
+    for (Meshlet& meshlet : meshlets)
+        ComputeMeshletBounds(meshlet, indices, vertices);
+}
+
+bool IsMeshletBackfacing(const Meshlet& meshlet, glm::vec3 cameraPosition)
+{
+    glm::vec3 toApex = meshlet.coneApex - cameraPosition;
+    float distance = glm::length(toApex);
+    return glm::dot(toApex, meshlet.coneAxis) >= meshlet.coneCutoff * distance;
+}
+
+MeshletStats AnalyzeMeshlets(const std::vector<Meshlet>& meshlets, glm::vec3 boundsMin, glm::vec3 boundsMax)
+{
+    MeshletStats stats;
+    stats.meshletCount = (int)meshlets.size();
+    if (meshlets.empty())
+        return stats;
+
+    double vertices = 0;
+    double triangles = 0;
+    double coneDegrees = 0;
+    int coneCount = 0;
+
+    for (const Meshlet& meshlet : meshlets)
+    {
+        vertices += meshlet.vertexCount;
+        triangles += meshlet.triangleCount;
+
+        if (meshlet.coneCutoff < NoConeCutoff)
+        {
+            coneDegrees += glm::degrees(asinf(glm::min(meshlet.coneCutoff, 1.0f)));
+            coneCount++;
+        }
+    }
+
+    stats.vertexFill = (float)(vertices / meshlets.size() / MeshletMaxVertices);
+    stats.triangleFill = (float)(triangles / meshlets.size() / MeshletMaxTriangles);
+    stats.coneFraction = (float)coneCount / meshlets.size();
+    stats.coneDegrees = coneCount > 0 ? (float)(coneDegrees / coneCount) : 0;
+
+    // Look at the mesh from each side, a few sizes away from it
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    float distance = glm::max(glm::length(boundsMax - boundsMin), 0.001f) * 2;
+    glm::vec3 directions[6] = {
+        glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0),
+        glm::vec3(0, 1, 0), glm::vec3(0, -1, 0),
+        glm::vec3(0, 0, 1), glm::vec3(0, 0, -1) };
+
+    int culled = 0;
+    for (int d = 0; d < 6; d++)
+    {
+        glm::vec3 camera = center + directions[d] * distance;
+        for (const Meshlet& meshlet : meshlets)
+        {
+            if (IsMeshletBackfacing(meshlet, camera))
+                culled++;
+        }
+    }
+    stats.culledFraction = (float)culled / (6.0f * meshlets.size());
+
+    return stats;
+}
@@ -0,0 +1,97 @@
+/*
+Title: Blur Optimization VR
+File Name: meshlet.h
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "glm/glm.hpp"
+#include <vector>
+
+// mesh.h includes this file, so it can keep a list of meshlets
+struct Vertex3dUVNormal;
+
+// The most vertices and triangles one meshlet can have. These are the sizes
+// mesh shader hardware likes, and they keep each cluster small enough
+// that its bounds say something useful about every triangle inside it.
+#define MeshletMaxVertices 64
+#define MeshletMaxTriangles 124
+
+// A meshlet (or cluster) is a small run of triangles that are close together.
+// Instead of testing every triangle, we test the cluster once: if its bounding
+// sphere is outside an eye's frustum, or every triangle in it faces away from
+// the eye, the whole cluster can be skipped for that eye.
+//
+// Meshlets are grown one triangle at a time from a starting triangle, always adding
+// the neighbor that brings in the fewest new vertices and faces the most like the rest.
+// The index buffer is then reordered so each meshlet is just a range of it,
+// which means the gpu can still draw the mesh with one call.
+struct Meshlet
+{
+    // This meshlet is triangleCount triangles, starting at indices[firstIndex]
+    unsigned int firstIndex;
+    unsigned int triangleCount;
+
+    // How many different vertices those triangles use
+    unsigned int vertexCount;
+
+    // Sphere around every vertex, in model space
+    glm::vec3 center;
+    float radius;
+
+    // Every triangle's normal is within a cone around coneAxis.
+    // If the camera is anywhere inside the cone behind coneApex,
+    // every triangle faces away from it, see IsMeshletBackfacing
+    glm::vec3 coneApex;
+    glm::vec3 coneAxis;
+    float coneCutoff;
+};
+
+// How well the meshlets turned out
+struct MeshletStats
+{
+    int meshletCount = 0;
+
+    // Average vertices and triangles per meshlet, divided by the max. 1.0 means every meshlet is full
+    float vertexFill = 0;
+    float triangleFill = 0;
+
+    // Fraction of meshlets whose normals are close enough together to ever be backface culled
+    float coneFraction = 0;
+
+    // Average angle between the cone axis and its edge, for meshlets with a cone. Smaller is tighter
+    float coneDegrees = 0;
+
+    // Average fraction of meshlets backface culled, looking at the mesh from 6 sides
+    float culledFraction = 0;
+};
+
+// Splits the triangles into meshlets, and finds each one's bounding sphere and normal cone.
+// Reorders the triangles in indices so each meshlet's triangles are together.
+// Starting triangles are taken in index buffer order, so run this after OptimizeVertexCache
+// and the meshlets (and the triangles inside them) mostly keep that order.
+void BuildMeshlets(std::vector<unsigned int>& indices, const std::vector<Vertex3dUVNormal>& vertices, std::vector<Meshlet>& meshlets);
+
+// True if every triangle in the meshlet faces away from a camera at cameraPosition (in model space)
+bool IsMeshletBackfacing(const Meshlet& meshlet, glm::vec3 cameraPosition);
+
+// Measures fill rate and cone tightness. The bounds are used to place the cameras for culledFraction
+MeshletStats AnalyzeMeshlets(const std::vector<Meshlet>& meshlets, glm::vec3 boundsMin, glm::vec3 boundsMax);
@@ -0,0 +1,1507 @@
+/*
+Title: Blur Optimization VR
+File Name: objLoader.cpp
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "objLoader.h"
+#include "mappedFile.h"
+#include <chrono>
+#include <cstdio>
+#include <cmath>
+#include <cstring>
+
+bool LoadObjGetline(std::string filePath, std::vector<Vertex3dUVNormal>& meshVertices, std::vector<unsigned int>& indices)
+{
+
+    // before we do anything, lets first check if the file even exists:
+    std::ifstream file(filePath);
+
+    if (!file.good())
+    {
+        // If we encounter an error, print a message and return.
+        std::cout << "Can't read file: " << filePath << std::endl;
+        return false;
+    }
+
+    // These are temporary, and will contain our vertex data while we read from the file
+    std::vector<glm::vec3> vertices;
+    std::vector<glm::vec2> uvs;
+    std::vector<glm::vec3> normals;
+
+
+    // Now we have to process the string . . .
+    std::string line;
+
+    // Loop over every line in the file, storing it in the string 'line'
+    while (std::getline(file, line))
+    {
+        /*
+
+        obj files have a ton of features, but we'll only be using the core set here
+
+        =================================================
+        Lines starting with just 'v' are vertex positions. They might look like this:
+        v 1.0 -2.5345 3.141
+        The positions are stored as floating point values seperated by spaces
+        =================================================
+        vt is for uvs aka texture coordinates:
+        vt 0.12 0.87
+        Remember they only have an x and y value
+        =================================================
+        vn is for our normals:
+        vn -0.473 0.1201 0.7778
+        =================================================
+        f indicates faces, they are the most complex and look something like this:
+        f 100/1/1 101/1/1 102/3/2 103/3/2
+
+        each set of values  here ex 100/1/1, is a vertex
+        the first (100) is the index of the vertex position in the list of vertices as they appear in the file
+        the second (1) is the index of the uv coordinates in the list of uvs the same way
+        and the third (1) is the index of our normals in the corresponding list of normals
+        
+        You'll notice that there are 4 of these groupings.
+        That is because those 4 vertices form a quad.
+        Some of them will also appear in groups of 3, as tris, so we'll have to account for both cases.
+
+        Also, since obj files are ordered differently than how we use them, we have to reorganize them.
+        */
+
+        
+        // Let's get started:
+
+
+        // check if it's a vertex position
+        // strncmp checks if the first n characters of these strings match (n is 2 here)
+        if (strncmp("v ", &line[0], 2) == 0) 
+        {
+            // strtok takes in a string and a delimiter, storing the string internally.
+            // it also returns a pointer to the first character of the first word (split by the character given, " ").
+            strtok(&line[0], " "); 
+            // every time after the first, strtok returns the next word (splitting with the given character) until it runs out of words.
+            float x = std::stof(strtok(NULL, " "));
+            float y = std::stof(strtok(NULL, " "));
+            float z = std::stof(strtok(NULL, " "));
+            vertices.push_back(glm::vec3(x, y, z)); // make a vector from the given values and store it.
+        }
+        // texture coordinates
+        else if (strncmp("vt", &line[0], 2) == 0)
+        {
+            // same as above, but only 2 floats per value
+            strtok(&line[0], " ");
+            float u = std::stof(strtok(NULL, " "));
+            float v = std::stof(strtok(NULL, " "));
+            uvs.push_back(glm::vec2(u, v));
+        }
+        // vertex normals
+        else if (strncmp("vn", &line[0], 2) == 0)
+        {
+            // one more time for normals!
+            strtok(&line[0], " ");
+            float x = std::stof(strtok(NULL, " "));
+            float y = std::stof(strtok(NULL, " "));
+            float z = std::stof(strtok(NULL, " "));
+            normals.push_back(glm::vec3(x, y, z));
+        }
+        // faces (these should be last in the file, so we can just interpret them immediately)
+        else if (strncmp("f", &line[0], 1) == 0)
+        {
+            // keep track of the indices from our vector/uv/normal buffer for this face
+            std::vector<unsigned int> faceIndices;
+
+            // this will store the vertices as we read over them.
+            char* token = strtok(&line[0], " ");
+
+            // loop over the vertices until we get NULL (what strtok returns at the end of the line)
+            while ((token = strtok(0, "/")) != NULL)
+            {
+                // split up index data (important, obj file indexing starts at 1, so we have to subtract 1 here or bad things will happen)
+                int i = std::stoi(token) - 1;
+                glm::vec3 vp = vertices[i];
+
+                token = strtok(0, "/");
+                int j = std::stoi(token) - 1;
+                glm::vec2 vt = uvs[j];
+
+                token = strtok(0, " ");
+                int k = std::stoi(token) - 1;
+                glm::vec3 vn = normals[k];
+
+                // Unfortunately obj files store vertex data in seperate groups.
+                // We could use the data that way, but we would repeat tons of vertices, and be unable to use an index buffer.
+                // Instead we're going to compare vertices to avoid redundant values.
+
+                // does this vertex exist already?
+                bool newVertex = false;
+
+                // (this search is O(n^2), which is why it is turned off.
+                // The fast loaders weld with a hash table instead, see ObjVertexTable)
+#if 0
+                // loop over all existing vertices
+                for (int i = 0; i < meshVertices.size(); i++)
+                {
+                    Vertex3dUVNormal other = meshVertices[i];
+                    // if match found...
+                    if (vp == other.m_position &&
+                        vt == other.m_texCoord &&
+                        vn == other.m_normal)
+                    {
+                        //...reuse the index for this face and stop iterating
+                        faceIndices.push_back(i);
+                        newVertex = true;
+                        break;
+                    }
+                }
+#endif
+
+                // if a new vertex, create and add it to the collection
+                if (!newVertex)
+                {
+                    // the index for this vertex will be at the end of the collection
+                    faceIndices.push_back(meshVertices.size());
+                    meshVertices.push_back(Vertex3dUVNormal(vp, vt, vn, glm::vec3()));
+                }
+            }
+
+            // now that our face is using the final indices, we need to add it to our index buffer
+
+            // add the first 3 indices of the face to our index collection to form a triangle
+            for (int i = 0; i < 3; i++)
+            {
+                indices.push_back(faceIndices[i]);
+            }
+            // the face is a quad, add 3 more vertices to form a triangle
+            if (faceIndices.size() == 4)
+            {
+                indices.push_back(faceIndices[0]);
+                indices.push_back(faceIndices[2]);
+                indices.push_back(faceIndices[3]);
+            }
+
+
+            // we're done here
+        }
+        // other line (comments, objects, smoothing groups), we don't use these
+        else 
+        {
+            continue;
+        }
+    }
+
+
+    // After all of that nonsense close the file
+    file.close();
+    return true;
+}
+
+// ============================================================
+// Everything below here is the fast loader.
+//
+// getline copies every line into a std::string, strtok writes into
+// that string, and stof/stoi go through the C locale machinery for
+// every number. None of that is needed, the whole file is already
+// in memory once it is mapped, so we just walk a pointer over it.
+// ============================================================
+
+// Exact powers of ten, every one of these can be stored in a double with no rounding
+static const double powersOfTen[] =
+{
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+    1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+    1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// spaces and tabs separate values, and windows files have a \r before each \n
+static inline bool IsBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline bool IsDigit(char c)
+{
+    return (unsigned char)(c - '0') < 10;
+}
+
+static inline const char* SkipBlanks(const char* p, const char* end)
+{
+    while (p < end && IsBlank(*p))
+        p++;
+    return p;
+}
+
+// returns a pointer to the first character of the next line
+static inline const char* SkipLine(const char* p, const char* end)
+{
+    while (p < end && *p != '\n')
+        p++;
+    return p < end ? p + 1 : end;
+}
+
+// Reads a number like -12.5e-3 and returns a pointer to the character after it,
+// or nullptr if there was no number there
+static const char* ParseFloat(const char* p, const char* end, float& out)
+{
+    p = SkipBlanks(p, end);
+
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = (*p == '-');
+        p++;
+    }
+
+    // All of the digits are collected into one big integer, and we remember
+    // where the decimal point was. 1.25 becomes 125 with an exponent of -2
+    unsigned long long mantissa = 0;
+    int exponent = 0;
+    int digits = 0;
+    bool anyDigits = false;
+
+    while (p < end && IsDigit(*p))
+    {
+        // a 64 bit integer holds 19 digits, after that the digits are too small to matter
+        if (digits < 19)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa != 0)
+                digits++;
+        }
+        else
+        {
+            exponent++;
+        }
+        anyDigits = true;
+        p++;
+    }
+
+    if (p < end && *p == '.')
+    {
+        p++;
+        while (p < end && IsDigit(*p))
+        {
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                exponent--;
+                if (mantissa != 0)
+                    digits++;
+            }
+            anyDigits = true;
+            p++;
+        }
+    }
+
+    if (!anyDigits)
+        return nullptr;
+
+    // optional exponent, like the e-3 in 1.0e-3
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        const char* e = p + 1;
+        bool negativeExponent = false;
+        if (e < end && (*e == '-' || *e == '+'))
+        {
+            negativeExponent = (*e == '-');
+            e++;
+        }
+        if (e < end && IsDigit(*e))
+        {
+            int value = 0;
+            while (e < end && IsDigit(*e))
+            {
+                if (value < 10000)
+                    value = value * 10 + (*e - '0');
+                e++;
+            }
+            exponent += negativeExponent ? -value : value;
+            p = e;
+        }
+    }
+
+    // When the exponent is small, one multiply or divide by an exact
+    // power of ten gives a correctly rounded double, which then rounds
+    // to the same float that stof would give us
+    double value = (double)mantissa;
+    if (exponent < 0 && exponent >= -22)
+        value /= powersOfTen[-exponent];
+    else if (exponent >= 0 && exponent <= 22)
+        value *= powersOfTen[exponent];
+    else
+        value *= pow(10.0, exponent);
+
+    out = (float)(negative ? -value : value);
+    return p;
+}
+
+// Reads a whole number, returns nullptr if there was no number there
+static const char* ParseInt(const char* p, const char* end, int& out)
+{
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = (*p == '-');
+        p++;
+    }
+
+    if (p >= end || !IsDigit(*p))
+        return nullptr;
+
+    int value = 0;
+    while (p < end && IsDigit(*p))
+    {
+        value = value * 10 + (*p - '0');
+        p++;
+    }
+
+    out = negative ? -value : value;
+    return p;
+}
+
+// obj indices start at 1, and negative indices count backwards from the
+// newest element. This turns both kinds into a normal 0 based index,
+// or -1 if the index does not point at anything
+static inline int ResolveIndex(int index, size_t count)
+{
+    int resolved = index > 0 ? index - 1 : (int)count + index;
+    return (resolved >= 0 && resolved < (int)count) ? resolved : -1;
+}
+
+// Reads one corner of a face, like 1/2/3, 1//3, 1/2 or 1.
+// Missing uv or normal indices are left at 0, which obj never uses.
+static const char* ParseFaceCorner(const char* p, const char* end, int& vi, int& ti, int& ni)
+{
+    if (!(p = ParseInt(p, end, vi)))
+        return nullptr;
+
+    if (p < end && *p == '/')
+    {
+        p++;
+        if (p < end && *p != '/')
+        {
+            if (!(p = ParseInt(p, end, ti)))
+                return nullptr;
+        }
+        if (p < end && *p == '/')
+        {
+            if (!(p = ParseInt(p + 1, end, ni)))
+                return nullptr;
+        }
+    }
+    return p;
+}
+
+// Which position, uv and normal one face corner uses, -1 if it has none
+struct ObjCorner
+{
+    int position;
+    int uv;
+    int normal;
+};
+
+// marks a slot in the vertex table that has nothing in it
+static const unsigned int emptySlot = 0xFFFFFFFF;
+
+// Finds corners that use the same position, uv and normal, so they can share one vertex.
+// The old loader searched every vertex for a match, which is O(n^2).
+// Here the three indices are hashed to pick a slot, and if the slot is taken
+// we try the next one (open addressing), so a lookup is O(1) on average.
+class ObjVertexTable
+{
+
+private:
+    std::vector<ObjCorner> m_keys;
+    std::vector<unsigned int> m_values;
+    size_t m_mask = 0;
+    size_t m_count = 0;
+
+    static size_t Hash(const ObjCorner& key)
+    {
+        // multiply each index by a different large odd number, and mix the bits
+        unsigned int h = (unsigned int)key.position * 0x9E3779B1u;
+        h ^= (unsigned int)key.uv * 0x85EBCA77u;
+        h ^= (unsigned int)key.normal * 0xC2B2AE3Du;
+        h ^= h >> 15;
+        h *= 0x2C1B3C6Du;
+        h ^= h >> 13;
+        return h;
+    }
+
+    void Resize(size_t slots)
+    {
+        std::vector<ObjCorner> oldKeys;
+        std::vector<unsigned int> oldValues;
+        oldKeys.swap(m_keys);
+        oldValues.swap(m_values);
+
+        m_keys.resize(slots);
+        m_values.assign(slots, emptySlot);
+        m_mask = slots - 1;
+
+        for (size_t i = 0; i < oldValues.size(); i++)
+        {
+            if (oldValues[i] == emptySlot)
+                continue;
+
+            size_t slot = Hash(oldKeys[i]) & m_mask;
+            while (m_values[slot] != emptySlot)
+                slot = (slot + 1) & m_mask;
+
+            m_keys[slot] = oldKeys[i];
+            m_values[slot] = oldValues[i];
+        }
+    }
+
+public:
+    // expected is roughly how many unique vertices there will be
+    ObjVertexTable(size_t expected)
+    {
+        // keep the table at most half full, and a power of two so we can mask instead of mod
+        size_t slots = 64;
+        while (slots < expected * 2)
+            slots *= 2;
+        Resize(slots);
+    }
+
+    // Returns the vertex that already uses this corner, or stores newVertex
+    // for it and returns that. inserted tells you which one happened.
+    unsigned int FindOrInsert(const ObjCorner& key, unsigned int newVertex, bool& inserted)
+    {
+        size_t slot = Hash(key) & m_mask;
+        while (m_values[slot] != emptySlot)
+        {
+            const ObjCorner& other = m_keys[slot];
+            if (other.position == key.position && other.uv == key.uv && other.normal == key.normal)
+            {
+                inserted = false;
+                return m_values[slot];
+            }
+            slot = (slot + 1) & m_mask;
+        }
+
+        m_keys[slot] = key;
+        m_values[slot] = newVertex;
+        inserted = true;
+
+        // grow before the table gets too full, or the probes get long
+        if (++m_count * 2 > m_values.size())
+            Resize(m_values.size() * 2);
+
+        return newVertex;
+    }
+};
+
+// Reads obj text that is already in memory, front to back on this thread
+static bool ParseObjSerial(const char* p, const char* end, std::string& filePath,
+                           std::vector<Vertex3dUVNormal>& meshVertices, std::vector<unsigned int>& indices,
+                           bool weld, ObjLoadStats* stats)
+{
+    size_t fileSize = end - p;
+    size_t firstVertex = meshVertices.size();
+    size_t corners = 0;
+
+    // only used when welding, sized for the guess below, it grows if it needs to
+    ObjVertexTable table(weld ? fileSize / 64 : 0);
+
+    // These are temporary, and will contain our vertex data while we read from the file
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> uvs;
+    std::vector<glm::vec3> normals;
+
+    // Guess how big everything will be, so the vectors don't
+    // keep growing. Lines in our files are about 25 to 35 bytes.
+    positions.reserve(fileSize / 96);
+    uvs.reserve(fileSize / 96);
+    normals.reserve(fileSize / 96);
+    meshVertices.reserve(meshVertices.size() + fileSize / 24);
+    indices.reserve(indices.size() + fileSize / 24);
+
+    // The same line types that LoadObjGetline explains, we only look
+    // at the first two characters of each line to decide what it is
+    while (p < end)
+    {
+        p = SkipBlanks(p, end);
+        if (p >= end)
+            break;
+
+        char second = (p + 1 < end) ? p[1] : '\n';
+
+        // vertex position
+        if (p[0] == 'v' && IsBlank(second))
+        {
+            glm::vec3 v;
+            if (!(p = ParseFloat(p + 1, end, v.x)) ||
+                !(p = ParseFloat(p, end, v.y)) ||
+                !(p = ParseFloat(p, end, v.z)))
+            {
+                std::cout << "Bad vertex position in: " << filePath << std::endl;
+                return false;
+            }
+            positions.push_back(v);
+        }
+
+        // texture coordinate
+        else if (p[0] == 'v' && second == 't')
+        {
+            glm::vec2 vt;
+            if (!(p = ParseFloat(p + 2, end, vt.x)) ||
+                !(p = ParseFloat(p, end, vt.y)))
+            {
+                std::cout << "Bad texture coordinate in: " << filePath << std::endl;
+                return false;
+            }
+            uvs.push_back(vt);
+        }
+
+        // vertex normal
+        else if (p[0] == 'v' && second == 'n')
+        {
+            glm::vec3 vn;
+            if (!(p = ParseFloat(p + 2, end, vn.x)) ||
+                !(p = ParseFloat(p, end, vn.y)) ||
+                !(p = ParseFloat(p, end, vn.z)))
+            {
+                std::cout << "Bad vertex normal in: " << filePath << std::endl;
+                return false;
+            }
+            normals.push_back(vn);
+        }
+
+        // face, a list of position/uv/normal groups
+        else if (p[0] == 'f' && IsBlank(second))
+        {
+            p++;
+
+            // the first and the most recent corner, faces are split into a fan
+            // of triangles, which is the same as the tri and quad split we had before
+            unsigned int first = 0;
+            unsigned int previous = 0;
+            int corner = 0;
+
+            while (true)
+            {
+                p = SkipBlanks(p, end);
+                if (p >= end || *p == '\n')
+                    break;
+
+                int vi = 0, ti = 0, ni = 0;
+                if (!(p = ParseFaceCorner(p, end, vi, ti, ni)))
+                {
+                    std::cout << "Bad face in: " << filePath << std::endl;
+                    return false;
+                }
+
+                int i = ResolveIndex(vi, positions.size());
+                int j = ti != 0 ? ResolveIndex(ti, uvs.size()) : -2;
+                int k = ni != 0 ? ResolveIndex(ni, normals.size()) : -2;
+
+                if (i < 0 || j == -1 || k == -1)
+                {
+                    std::cout << "Face index out of range in: " << filePath << std::endl;
+                    return false;
+                }
+
+                ObjCorner key;
+                key.position = i;
+                key.uv = j >= 0 ? j : -1;
+                key.normal = k >= 0 ? k : -1;
+                corners++;
+
+                // Without welding every corner becomes its own vertex, just like LoadObjGetline.
+                // With welding, corners that match one we have seen reuse its vertex.
+                unsigned int index = (unsigned int)meshVertices.size();
+                bool newVertex = true;
+                if (weld)
+                    index = table.FindOrInsert(key, index, newVertex);
+
+                if (newVertex)
+                {
+                    meshVertices.push_back(Vertex3dUVNormal(
+                        positions[i],
+                        j >= 0 ? uvs[j] : glm::vec2(),
+                        k >= 0 ? normals[k] : glm::vec3(),
+                        glm::vec3()));
+                }
+
+                if (corner == 0)
+                {
+                    first = index;
+                }
+                else if (corner >= 2)
+                {
+                    indices.push_back(first);
+                    indices.push_back(previous);
+                    indices.push_back(index);
+                }
+
+                previous = index;
+                corner++;
+            }
+        }
+
+        // anything else gets skipped (comments, objects, smoothing groups)
+        p = SkipLine(p, end);
+    }
+
+    if (stats != nullptr)
+    {
+        stats->cornerCount = corners;
+        stats->vertexCount = meshVertices.size() - firstVertex;
+    }
+
+    return true;
+}
+
+bool LoadObjMapped(std::string filePath, std::vector<Vertex3dUVNormal>& meshVertices, std::vector<unsigned int>& indices,
+                   bool weld, ObjLoadStats* stats)
+{
+    MappedFile file(filePath);
+
+    if (!file.IsOpen())
+    {
+        // If we encounter an error, print a message and return false.
+        std::cout << "Can't read file: " << filePath << std::endl;
+        return false;
+    }
+
+    return ParseObjSerial(file.GetData(), file.GetData() + file.GetSize(), filePath, meshVertices, indices, weld, stats);
+}
+
+// ============================================================
+// The parallel loader.
+//
+// The file is cut into chunks that each hold whole lines. Every chunk
+// is read twice on the thread pool:
+//   1. count how many positions, uvs, normals and face corners it has
+//   2. parse them straight into their final spot in the output arrays
+// Between the two, a prefix sum over the counts tells each chunk where
+// its first position, uv, normal, corner and index go. That way no two
+// threads ever write to the same place, and we never need a lock.
+// ============================================================
+
+// One piece of the file, which always starts and ends on a line boundary
+struct ObjChunk
+{
+    const char* begin;
+    const char* end;
+
+    // How many of each thing are in this chunk, filled in by the first pass
+    size_t positionCount = 0;
+    size_t uvCount = 0;
+    size_t normalCount = 0;
+    size_t cornerCount = 0;
+    size_t indexCount = 0;
+
+    // Where this chunk writes in the final arrays, from the prefix sum
+    size_t firstPosition = 0;
+    size_t firstUv = 0;
+    size_t firstNormal = 0;
+    size_t firstCorner = 0;
+    size_t firstIndex = 0;
+
+    // Set by the second pass if something could not be read
+    const char* error = nullptr;
+};
+
+// First pass, count everything in the chunk without parsing any numbers
+static void CountObjChunk(ObjChunk& chunk)
+{
+    const char* p = chunk.begin;
+    const char* end = chunk.end;
+
+    while (p < end)
+    {
+        p = SkipBlanks(p, end);
+        if (p >= end)
+            break;
+
+        char second = (p + 1 < end) ? p[1] : '\n';
+
+        if (p[0] == 'v' && IsBlank(second))
+        {
+            chunk.positionCount++;
+        }
+        else if (p[0] == 'v' && second == 't')
+        {
+            chunk.uvCount++;
+        }
+        else if (p[0] == 'v' && second == 'n')
+        {
+            chunk.normalCount++;
+        }
+        else if (p[0] == 'f' && IsBlank(second))
+        {
+            // count the groups of characters after the f
+            size_t corners = 0;
+            p++;
+            while (true)
+            {
+                p = SkipBlanks(p, end);
+                if (p >= end || *p == '\n')
+                    break;
+
+                corners++;
+                while (p < end && !IsBlank(*p) && *p != '\n')
+                    p++;
+            }
+
+            chunk.cornerCount += corners;
+            if (corners >= 3)
+                chunk.indexCount += 3 * (corners - 2);
+        }
+
+        p = SkipLine(p, end);
+    }
+}
+
+// Second pass, parse the chunk into the final arrays at the offsets from the prefix sum
+static void ParseObjChunk(ObjChunk& chunk, glm::vec3* positions, glm::vec2* uvs, glm::vec3* normals,
+                          ObjCorner* corners, unsigned int* indices, unsigned int firstVertex)
+{
+    const char* p = chunk.begin;
+    const char* end = chunk.end;
+
+    // These are global counts, so that negative face indices and
+    // range checks work exactly like they do in the serial loader
+    size_t position = chunk.firstPosition;
+    size_t uv = chunk.firstUv;
+    size_t normal = chunk.firstNormal;
+    size_t corner = chunk.firstCorner;
+    unsigned int* index = indices + chunk.firstIndex;
+
+    while (p < end)
+    {
+        p = SkipBlanks(p, end);
+        if (p >= end)
+            break;
+
+        char second = (p + 1 < end) ? p[1] : '\n';
+
+        if (p[0] == 'v' && IsBlank(second))
+        {
+            glm::vec3& v = positions[position++];
+            if (!(p = ParseFloat(p + 1, end, v.x)) ||
+                !(p = ParseFloat(p, end, v.y)) ||
+                !(p = ParseFloat(p, end, v.z)))
+            {
+                chunk.error = "Bad vertex position in: ";
+                return;
+            }
+        }
+        else if (p[0] == 'v' && second == 't')
+        {
+            glm::vec2& vt = uvs[uv++];
+            if (!(p = ParseFloat(p + 2, end, vt.x)) ||
+                !(p = ParseFloat(p, end, vt.y)))
+            {
+                chunk.error = "Bad texture coordinate in: ";
+                return;
+            }
+        }
+        else if (p[0] == 'v' && second == 'n')
+        {
+            glm::vec3& vn = normals[normal++];
+            if (!(p = ParseFloat(p + 2, end, vn.x)) ||
+                !(p = ParseFloat(p, end, vn.y)) ||
+                !(p = ParseFloat(p, end, vn.z)))
+            {
+                chunk.error = "Bad vertex normal in: ";
+                return;
+            }
+        }
+        else if (p[0] == 'f' && IsBlank(second))
+        {
+            p++;
+
+            unsigned int first = 0;
+            unsigned int previous = 0;
+            int faceCorner = 0;
+
+            while (true)
+            {
+                p = SkipBlanks(p, end);
+                if (p >= end || *p == '\n')
+                    break;
+
+                int vi = 0, ti = 0, ni = 0;
+                if (!(p = ParseFaceCorner(p, end, vi, ti, ni)))
+                {
+                    chunk.error = "Bad face in: ";
+                    return;
+                }
+
+                int i = ResolveIndex(vi, position);
+                int j = ti != 0 ? ResolveIndex(ti, uv) : -2;
+                int k = ni != 0 ? ResolveIndex(ni, normal) : -2;
+
+                if (i < 0 || j == -1 || k == -1)
+                {
+                    chunk.error = "Face index out of range in: ";
+                    return;
+                }
+
+                // Only remember which attributes this corner uses. The chunk that
+                // holds them may still be parsing, so we build the vertex later.
+                ObjCorner& c = corners[corner];
+                c.position = i;
+                c.uv = j >= 0 ? j : -1;
+                c.normal = k >= 0 ? k : -1;
+
+                unsigned int vertex = firstVertex + (unsigned int)corner;
+                corner++;
+
+                if (faceCorner == 0)
+                {
+                    first = vertex;
+                }
+                else if (faceCorner >= 2)
+                {
+                    *index++ = first;
+                    *index++ = previous;
+                    *index++ = vertex;
+                }
+
+                previous = vertex;
+                faceCorner++;
+            }
+        }
+
+        p = SkipLine(p, end);
+    }
+}
+
+bool LoadObjParallel(std::string filePath, std::vector<Vertex3dUVNormal>& meshVertices, std::vector<unsigned int>& indices,
+                     ThreadPool& pool, bool weld, ObjLoadStats* stats)
+{
+    MappedFile file(filePath);
+
+    if (!file.IsOpen())
+    {
+        // If we encounter an error, print a message and return false.
+        std::cout << "Can't read file: " << filePath << std::endl;
+        return false;
+    }
+
+    const char* data = file.GetData();
+    const char* end = data + file.GetSize();
+
+    // A few chunks per thread, so a thread that finishes early can pick up
+    // another one, but not so small that the per chunk work starts to matter
+    const size_t minimumChunkSize = 64 * 1024;
+    size_t chunkSize = file.GetSize() / (pool.GetThreadCount() * 4);
+    if (chunkSize < minimumChunkSize)
+        chunkSize = minimumChunkSize;
+
+    // Cut the file into chunks, moving each cut forward to the end of a line
+    std::vector<ObjChunk> chunks;
+    const char* begin = data;
+    while (begin < end)
+    {
+        const char* cut = (size_t)(end - begin) > chunkSize ? begin + chunkSize : end;
+        const char* newline = (const char*)memchr(cut, '\n', end - cut);
+        cut = newline ? newline + 1 : end;
+
+        ObjChunk chunk;
+        chunk.begin = begin;
+        chunk.end = cut;
+        chunks.push_back(chunk);
+
+        begin = cut;
+    }
+
+    // Small files fit in one chunk, and reading them in one pass is quicker
+    if (chunks.size() <= 1)
+        return ParseObjSerial(data, end, filePath, meshVertices, indices, weld, stats);
+
+    // First pass
+    pool.ParallelFor((int)chunks.size(), [&chunks](int i)
+    {
+        CountObjChunk(chunks[i]);
+    });
+
+    // Prefix sum, each chunk starts where the one before it stopped
+    size_t positionCount = 0, uvCount = 0, normalCount = 0, cornerCount = 0, indexCount = 0;
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        chunks[i].firstPosition = positionCount;
+        chunks[i].firstUv = uvCount;
+        chunks[i].firstNormal = normalCount;
+        chunks[i].firstCorner = cornerCount;
+        chunks[i].firstIndex = indexCount;
+
+        positionCount += chunks[i].positionCount;
+        uvCount += chunks[i].uvCount;
+        normalCount += chunks[i].normalCount;
+        cornerCount += chunks[i].cornerCount;
+        indexCount += chunks[i].indexCount;
+    }
+
+    // Now everything can be sized exactly, once
+    std::vector<glm::vec3> positions(positionCount);
+    std::vector<glm::vec2> uvs(uvCount);
+    std::vector<glm::vec3> normals(normalCount);
+    std::vector<ObjCorner> corners(cornerCount);
+
+    // new vertices and indices go after anything already in the mesh
+    unsigned int firstVertex = (unsigned int)meshVertices.size();
+    size_t firstIndex = indices.size();
+    indices.resize(firstIndex + indexCount);
+
+    // Second pass
+    pool.ParallelFor((int)chunks.size(), [&](int i)
+    {
+        ParseObjChunk(chunks[i], positions.data(), uvs.data(), normals.data(),
+            corners.data(), indices.data() + firstIndex, firstVertex);
+    });
+
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        if (chunks[i].error != nullptr)
+        {
+            std::cout << chunks[i].error << filePath << std::endl;
+            indices.resize(firstIndex);
+            return false;
+        }
+    }
+
+    // Every attribute is parsed now, so each corner can become a vertex.
+    // Without welding, every corner is its own vertex, just like the serial loader.
+    // With welding, we walk the corners in order on this thread, so vertices get
+    // numbered exactly the way the serial loader numbers them. The table is the
+    // only part that has to be in order, everything around it is split up again.
+    std::vector<unsigned int> uniqueCorners;
+    if (weld)
+    {
+        std::vector<unsigned int> remap(cornerCount);
+        ObjVertexTable table(cornerCount / 4);
+
+        for (size_t c = 0; c < cornerCount; c++)
+        {
+            bool inserted;
+            remap[c] = table.FindOrInsert(corners[c], (unsigned int)uniqueCorners.size(), inserted);
+            if (inserted)
+                uniqueCorners.push_back((unsigned int)c);
+        }
+
+        // point the indices at the welded vertices instead of the corners
+        unsigned int* indexOut = indices.data() + firstIndex;
+        const int batches = (int)chunks.size();
+        pool.ParallelFor(batches, [&](int batch)
+        {
+            size_t from = indexCount * batch / batches;
+            size_t to = indexCount * (batch + 1) / batches;
+            for (size_t i = from; i < to; i++)
+                indexOut[i] = firstVertex + remap[indexOut[i] - firstVertex];
+        });
+    }
+
+    size_t vertexCount = weld ? uniqueCorners.size() : cornerCount;
+    meshVertices.resize(firstVertex + vertexCount);
+    Vertex3dUVNormal* vertexOut = meshVertices.data() + firstVertex;
+
+    const int batches = (int)chunks.size();
+    pool.ParallelFor(batches, [&](int batch)
+    {
+        size_t from = vertexCount * batch / batches;
+        size_t to = vertexCount * (batch + 1) / batches;
+        for (size_t v = from; v < to; v++)
+        {
+            ObjCorner& corner = corners[weld ? uniqueCorners[v] : v];
+            Vertex3dUVNormal& vertex = vertexOut[v];
+            vertex.m_position = positions[corner.position];
+            vertex.m_texCoord = corner.uv >= 0 ? uvs[corner.uv] : glm::vec2();
+            vertex.m_normal = corner.normal >= 0 ? normals[corner.normal] : glm::vec3();
+        }
+    });
+
+    if (stats != nullptr)
+    {
+        stats->cornerCount = cornerCount;
+        stats->vertexCount = vertexCount;
+    }
+
+    return true;
+}
+
+// ============================================================
+// The streaming parser.
+// ============================================================
+
+ObjStreamParser::ObjStreamParser(ObjTriangleSink sink, size_t batchTriangles)
+{
+    m_sink = sink;
+    m_batchTriangles = batchTriangles > 0 ? batchTriangles : 1;
+    m_batch.reserve(m_batchTriangles * 3);
+}
+
+bool ObjStreamParser::Push(const char* data, size_t size)
+{
+    if (m_failed)
+        return false;
+
+    const char* end = data + size;
+
+    // Finish the line that was cut off last time, if there is one
+    if (!m_partialLine.empty())
+    {
+        const char* newline = (const char*)memchr(data, '\n', size);
+        if (newline == nullptr)
+        {
+            // still no end of line, keep collecting
+            m_partialLine.insert(m_partialLine.end(), data, end);
+            return true;
+        }
+
+        m_partialLine.insert(m_partialLine.end(), data, newline + 1);
+        if (!ParseLines(m_partialLine.data(), m_partialLine.data() + m_partialLine.size()))
+            return false;
+
+        m_partialLine.clear();
+        data = newline + 1;
+    }
+
+    // Everything up to the last newline is whole lines, and can be read right out of the buffer
+    const char* lastNewline = end;
+    while (lastNewline > data && lastNewline[-1] != '\n')
+        lastNewline--;
+
+    if (!ParseLines(data, lastNewline))
+        return false;
+
+    // save whatever is left for the next push
+    m_partialLine.insert(m_partialLine.end(), lastNewline, end);
+    return true;
+}
+
+bool ObjStreamParser::Finish()
+{
+    if (m_failed)
+        return false;
+
+    // the last line of a file doesn't always end in a newline
+    if (!m_partialLine.empty())
+    {
+        if (!ParseLines(m_partialLine.data(), m_partialLine.data() + m_partialLine.size()))
+            return false;
+        m_partialLine.clear();
+    }
+
+    Flush();
+    return true;
+}
+
+size_t ObjStreamParser::GetMemoryUsed()
+{
+    return m_positions.capacity() * sizeof(glm::vec3) +
+           m_uvs.capacity() * sizeof(glm::vec2) +
+           m_normals.capacity() * sizeof(glm::vec3) +
+           m_batch.capacity() * sizeof(Vertex3dUVNormal) +
+           m_partialLine.capacity();
+}
+
+void ObjStreamParser::Flush()
+{
+    if (m_batch.empty())
+        return;
+
+    m_sink(m_batch.data(), m_batch.size() / 3);
+    m_batch.clear();
+}
+
+bool ObjStreamParser::ParseLines(const char* p, const char* end)
+{
+    // The same lines as the other loaders, but faces turn into whole triangles right away
+    while (p < end)
+    {
+        p = SkipBlanks(p, end);
+        if (p >= end)
+            break;
+
+        char second = (p + 1 < end) ? p[1] : '\n';
+
+        if (p[0] == 'v' && IsBlank(second))
+        {
+            glm::vec3 v;
+            if (!(p = ParseFloat(p + 1, end, v.x)) ||
+                !(p = ParseFloat(p, end, v.y)) ||
+                !(p = ParseFloat(p, end, v.z)))
+            {
+                std::cout << "Bad vertex position in obj stream" << std::endl;
+                m_failed = true;
+                return false;
+            }
+            m_positions.push_back(v);
+        }
+        else if (p[0] == 'v' && second == 't')
+        {
+            glm::vec2 vt;
+            if (!(p = ParseFloat(p + 2, end, vt.x)) ||
+                !(p = ParseFloat(p, end, vt.y)))
+            {
+                std::cout << "Bad texture coordinate in obj stream" << std::endl;
+                m_failed = true;
+                return false;
+            }
+            m_uvs.push_back(vt);
+        }
+        else if (p[0] == 'v' && second == 'n')
+        {
+            glm::vec3 vn;
+            if (!(p = ParseFloat(p + 2, end, vn.x)) ||
+                !(p = ParseFloat(p, end, vn.y)) ||
+                !(p = ParseFloat(p, end, vn.z)))
+            {
+                std::cout << "Bad vertex normal in obj stream" << std::endl;
+                m_failed = true;
+                return false;
+            }
+            m_normals.push_back(vn);
+        }
+        else if (p[0] == 'f' && IsBlank(second))
+        {
+            p++;
+
+            // first and previous corner of the fan, kept by value
+            // because m_batch may be flushed in the middle of a face
+            Vertex3dUVNormal first;
+            Vertex3dUVNormal previous;
+            int corner = 0;
+
+            while (true)
+            {
+                p = SkipBlanks(p, end);
+                if (p >= end || *p == '\n')
+                    break;
+
+                int vi = 0, ti = 0, ni = 0;
+                if (!(p = ParseFaceCorner(p, end, vi, ti, ni)))
+                {
+                    std::cout << "Bad face in obj stream" << std::endl;
+                    m_failed = true;
+                    return false;
+                }
+
+                int i = ResolveIndex(vi, m_positions.size());
+                int j = ti != 0 ? ResolveIndex(ti, m_uvs.size()) : -2;
+                int k = ni != 0 ? ResolveIndex(ni, m_normals.size()) : -2;
+
+                if (i < 0 || j == -1 || k == -1)
+                {
+                    std::cout << "Face index out of range in obj stream" << std::endl;
+                    m_failed = true;
+                    return false;
+                }
+
+                Vertex3dUVNormal vertex(
+                    m_positions[i],
+                    j >= 0 ? m_uvs[j] : glm::vec2(),
+                    k >= 0 ? m_normals[k] : glm::vec3(),
+                    glm::vec3());
+
+                if (corner == 0)
+                {
+                    first = vertex;
+                }
+                else if (corner >= 2)
+                {
+                    m_batch.push_back(first);
+                    m_batch.push_back(previous);
+                    m_batch.push_back(vertex);
+
+                    if (m_batch.size() >= m_batchTriangles * 3)
+                        Flush();
+                }
+
+                previous = vertex;
+                corner++;
+            }
+        }
+
+        p = SkipLine(p, end);
+    }
+
+    return true;
+}
+
+bool LoadObjStreaming(std::string filePath, ObjTriangleSink sink, size_t bufferSize, size_t batchTriangles)
+{
+    FILE* file = fopen(filePath.c_str(), "rb");
+    if (file == nullptr)
+    {
+        std::cout << "Can't read file: " << filePath << std::endl;
+        return false;
+    }
+
+    // one buffer, reused for the whole file
+    std::vector<char> buffer(bufferSize);
+    ObjStreamParser parser(sink, batchTriangles);
+
+    bool ok = true;
+    size_t bytesRead;
+    while (ok && (bytesRead = fread(buffer.data(), 1, buffer.size(), file)) > 0)
+    {
+        ok = parser.Push(buffer.data(), bytesRead);
+    }
+
+    fclose(file);
+    return ok && parser.Finish();
+}
+
+// These are the same size on both loaders, compare them member by member
+static bool SameMesh(std::vector<Vertex3dUVNormal>& a, std::vector<unsigned int>& ai,
+                     std::vector<Vertex3dUVNormal>& b, std::vector<unsigned int>& bi)
+{
+    if (a.size() != b.size() || ai != bi)
+        return false;
+
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        if (a[i].m_position != b[i].m_position ||
+            a[i].m_texCoord != b[i].m_texCoord ||
+            a[i].m_normal != b[i].m_normal)
+            return false;
+    }
+    return true;
+}
+
+// Writes a big obj file, a grid of quads split into triangles,
+// so that we have something large enough to see the threads scale
+static bool WriteGeneratedObj(const char* path, int gridSize)
+{
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr)
+        return false;
+
+    for (int y = 0; y <= gridSize; y++)
+    {
+        for (int x = 0; x <= gridSize; x++)
+        {
+            float u = (float)x / gridSize;
+            float v = (float)y / gridSize;
+            fprintf(file, "v %f %f %f\n", u * 2 - 1, 0.1f * sinf(u * 20) * cosf(v * 20), v * 2 - 1);
+            fprintf(file, "vt %f %f\n", u, v);
+            fprintf(file, "vn %f %f %f\n", 0.0f, 1.0f, 0.0f);
+        }
+    }
+
+    for (int y = 0; y < gridSize; y++)
+    {
+        for (int x = 0; x < gridSize; x++)
+        {
+            int a = y * (gridSize + 1) + x + 1;
+            int b = a + 1;
+            int c = a + gridSize + 1;
+            int d = c + 1;
+            fprintf(file, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, c, c, c, b, b, b);
+            fprintf(file, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", b, b, b, c, c, c, d, d, d);
+        }
+    }
+
+    fclose(file);
+    return true;
+}
+
+void BenchmarkObjLoaders()
+{
+    const char* files[] =
+    {
+        "../Assets/Skybox.3Dobj",   "../Assets/bridge.3Dobj",   "../Assets/car.3Dobj",
+        "../Assets/cone.3Dobj",     "../Assets/cube.3Dobj",     "../Assets/cylinder.3Dobj",
+        "../Assets/dog.3Dobj",      "../Assets/dragon.3Dobj",   "../Assets/gun.3Dobj",
+        "../Assets/helix.3Dobj",    "../Assets/kitten.3Dobj",   "../Assets/sphere.3Dobj",
+        "../Assets/torus.3Dobj",    "../Assets/wheel.3Dobj",
+    };
+
+    // load each file a few times, so the disk cache is warm for both
+    // loaders, and we are only measuring the parsing
+    const int repeats = 5;
+
+    ThreadPool& pool = GetSharedThreadPool();
+
+    double totalBytes = 0;
+    double totalGetline = 0;
+    double totalMapped = 0;
+    double totalParallel = 0;
+
+    printf("\nOBJ loader benchmark (%d loads per file, %d threads)\n", repeats, pool.GetThreadCount());
+    printf("%-26s %9s %14s %14s %14s %8s\n", "file", "size KB", "getline MB/s", "mapped MB/s", "parallel MB/s", "speedup");
+
+    for (const char* path : files)
+    {
+        MappedFile sizeCheck(path);
+        if (!sizeCheck.IsOpen())
+        {
+            printf("%-26s missing\n", path);
+            continue;
+        }
+        double bytes = (double)sizeCheck.GetSize();
+
+        std::vector<Vertex3dUVNormal> slowVertices, fastVertices, parallelVertices;
+        std::vector<unsigned int> slowIndices, fastIndices, parallelIndices;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int r = 0; r < repeats; r++)
+        {
+            slowVertices.clear();
+            slowIndices.clear();
+            LoadObjGetline(path, slowVertices, slowIndices);
+        }
+        auto middle = std::chrono::high_resolution_clock::now();
+        for (int r = 0; r < repeats; r++)
+        {
+            fastVertices.clear();
+            fastIndices.clear();
+            LoadObjMapped(path, fastVertices, fastIndices, false, nullptr);
+        }
+        auto middle2 = std::chrono::high_resolution_clock::now();
+        for (int r = 0; r < repeats; r++)
+        {
+            parallelVertices.clear();
+            parallelIndices.clear();
+            LoadObjParallel(path, parallelVertices, parallelIndices, pool, false, nullptr);
+        }
+        auto stop = std::chrono::high_resolution_clock::now();
+
+        double slowSeconds = std::chrono::duration<double>(middle - start).count() / repeats;
+        double fastSeconds = std::chrono::duration<double>(middle2 - middle).count() / repeats;
+        double parallelSeconds = std::chrono::duration<double>(stop - middle2).count() / repeats;
+
+        totalBytes += bytes;
+        totalGetline += slowSeconds;
+        totalMapped += fastSeconds;
+        totalParallel += parallelSeconds;
+
+        bool match = SameMesh(slowVertices, slowIndices, fastVertices, fastIndices) &&
+                     SameMesh(slowVertices, slowIndices, parallelVertices, parallelIndices);
+
+        printf("%-26s %9.1f %14.1f %14.1f %14.1f %7.1fx %s\n", path, bytes / 1024.0,
+            bytes / slowSeconds / 1e6, bytes / fastSeconds / 1e6, bytes / parallelSeconds / 1e6,
+            slowSeconds / parallelSeconds, match ? "" : "MISMATCH");
+    }
+
+    printf("%-26s %9.1f %14.1f %14.1f %14.1f %7.1fx\n\n", "all files", totalBytes / 1024.0,
+        totalBytes / totalGetline / 1e6, totalBytes / totalMapped / 1e6,
+        totalBytes / totalParallel / 1e6, totalGetline / totalParallel);
+
+    // How much welding shrinks each model, and that both loaders weld the same way
+    printf("%-26s %9s %9s %7s %10s %10s\n", "welding", "corners", "vertices", "ratio", "VBO KB", "welded KB");
+    for (const char* path : files)
+    {
+        std::vector<Vertex3dUVNormal> serialVertices, parallelVertices;
+        std::vector<unsigned int> serialIndices, parallelIndices;
+        ObjLoadStats stats;
+
+        if (!LoadObjMapped(path, serialVertices, serialIndices, true, &stats))
+            continue;
+        LoadObjParallel(path, parallelVertices, parallelIndices, pool, true, nullptr);
+
+        printf("%-26s %9d %9d %6.1fx %10.1f %10.1f %s\n", path, (int)stats.cornerCount, (int)stats.vertexCount,
+            (double)stats.cornerCount / stats.vertexCount,
+            stats.cornerCount * sizeof(Vertex3dUVNormal) / 1024.0, stats.vertexCount * sizeof(Vertex3dUVNormal) / 1024.0,
+            SameMesh(serialVertices, serialIndices, parallelVertices, parallelIndices) ? "" : "MISMATCH");
+    }
+    printf("\n");
+
+    // The shipped models are small, so the thread scaling is measured on a generated one
+    const char* generatedPath = "generatedBenchmark.obj";
+    if (!WriteGeneratedObj(generatedPath, 700))
+        return;
+
+    std::vector<Vertex3dUVNormal> serialVertices, threadVertices;
+    std::vector<unsigned int> serialIndices, threadIndices;
+
+    MappedFile generated(generatedPath);
+    double bytes = (double)generated.GetSize();
+
+    auto start = std::chrono::high_resolution_clock::now();
+    LoadObjMapped(generatedPath, serialVertices, serialIndices, false, nullptr);
+    double serialSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+    printf("Generated %.1f MB obj, serial mapped loader: %.1f MB/s\n", bytes / 1e6, bytes / serialSeconds / 1e6);
+
+    for (int threads = 1; threads <= pool.GetThreadCount(); threads *= 2)
+    {
+        // a pool with threads - 1 workers, because the calling thread works too
+        ThreadPool scalingPool(threads - 1);
+
+        threadVertices.clear();
+        threadIndices.clear();
+
+        start = std::chrono::high_resolution_clock::now();
+        LoadObjParallel(generatedPath, threadVertices, threadIndices, scalingPool, false, nullptr);
+        double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        printf("  %2d threads: %8.1f MB/s  %5.2fx serial %s\n", threads, bytes / seconds / 1e6, serialSeconds / seconds,
+            SameMesh(serialVertices, serialIndices, threadVertices, threadIndices) ? "" : "MISMATCH");
+    }
+
+    // The streaming parser only holds the attributes, one batch, and one buffer.
+    // Compare what it holds on to with what the whole-file loader needs at once.
+    size_t streamedTriangles = 0;
+    size_t streamPeak = 0;
+    bool streamMatches = true;
+    const size_t bufferSize = 64 * 1024;
+
+    ObjStreamParser* parserForPeak = nullptr;
+    ObjTriangleSink sink = [&](const Vertex3dUVNormal* vertices, size_t triangleCount)
+    {
+        // check the triangles against the indexed mesh, corner by corner
+        for (size_t v = 0; v < triangleCount * 3 && streamMatches; v++)
+        {
+            const Vertex3dUVNormal& expected = serialVertices[serialIndices[streamedTriangles * 3 + v]];
+            streamMatches = vertices[v].m_position == expected.m_position &&
+                            vertices[v].m_texCoord == expected.m_texCoord &&
+                            vertices[v].m_normal == expected.m_normal;
+        }
+        streamedTriangles += triangleCount;
+        if (parserForPeak != nullptr && parserForPeak->GetMemoryUsed() > streamPeak)
+            streamPeak = parserForPeak->GetMemoryUsed();
+    };
+
+    start = std::chrono::high_resolution_clock::now();
+    {
+        FILE* file = fopen(generatedPath, "rb");
+        std::vector<char> buffer(bufferSize);
+        ObjStreamParser parser(sink, 4096);
+        parserForPeak = &parser;
+
+        size_t bytesRead;
+        while (file != nullptr && (bytesRead = fread(buffer.data(), 1, buffer.size(), file)) > 0)
+            parser.Push(buffer.data(), bytesRead);
+        parser.Finish();
+        parserForPeak = nullptr;
+
+        if (file != nullptr)
+            fclose(file);
+        streamPeak += bufferSize;
+    }
+    double streamSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+    // the whole-file loader holds at least the mapped file and the finished vertices and indices at once
+    size_t fullPeak = (size_t)bytes + serialVertices.capacity() * sizeof(Vertex3dUVNormal) +
+                      serialIndices.capacity() * sizeof(unsigned int);
+
+    printf("  streaming:  %8.1f MB/s  %d triangles, holds %.1f MB, whole-file loader holds about %.1f MB %s\n",
+        bytes / streamSeconds / 1e6, (int)streamedTriangles, streamPeak / 1e6, fullPeak / 1e6,
+        streamMatches && streamedTriangles * 3 == serialIndices.size() ? "" : "MISMATCH");
+    printf("\n");
+
+    remove(generatedPath);
+}
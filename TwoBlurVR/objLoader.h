@@ -0,0 +1,116 @@
+/*
+Title: Blur Optimization VR
+File Name: objLoader.h
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "mesh.h"
+#include "threadPool.h"
+#include <vector>
+#include <string>
+#include <functional>
+
+// Filled in by the loaders, so we can see how much welding saved
+struct ObjLoadStats
+{
+    // corners of every face in the file, which is how many vertices there would be without welding
+    size_t cornerCount = 0;
+    // vertices that were actually made
+    size_t vertexCount = 0;
+};
+
+// Reads an obj file the original way, one line at a time,
+// using getline, strtok, and stof. This is kept so that
+// the faster loaders have something to be compared against.
+bool LoadObjGetline(std::string filePath, std::vector<Vertex3dUVNormal>& meshVertices, std::vector<unsigned int>& indices);
+
+// Memory maps an obj file and reads it in one pass, with our own
+// number parsing. Without welding, gives exactly the same output as LoadObjGetline.
+// With welding, face corners that use the same position, uv and normal share one vertex.
+// stats can be nullptr.
+bool LoadObjMapped(std::string filePath, std::vector<Vertex3dUVNormal>& meshVertices, std::vector<unsigned int>& indices,
+                   bool weld, ObjLoadStats* stats);
+
+// Splits a memory mapped obj file into chunks of whole lines, and reads
+// the chunks on the thread pool. Gives exactly the same output as LoadObjMapped.
+bool LoadObjParallel(std::string filePath, std::vector<Vertex3dUVNormal>& meshVertices, std::vector<unsigned int>& indices,
+                     ThreadPool& pool, bool weld, ObjLoadStats* stats);
+
+// Receives finished triangles from ObjStreamParser. Every three vertices are one triangle.
+typedef std::function<void(const Vertex3dUVNormal* vertices, size_t triangleCount)> ObjTriangleSink;
+
+// A push style obj parser for files too big to hold in memory.
+// Instead of handing it a whole file, you push bytes in as you read them,
+// in buffers of any size, and lines can be cut anywhere between two pushes.
+// Finished triangles are handed to the sink in batches, so the sink can
+// start uploading to the gpu before the file is finished.
+//
+// Faces can point at any position, uv or normal above them in the file, so those
+// are kept. Nothing else grows with the file: no face corners, no mesh vertices,
+// no index buffer. Memory stays at the attributes, plus one batch, plus the longest line.
+class ObjStreamParser
+{
+
+private:
+    ObjTriangleSink m_sink;
+
+    // Attributes read so far, faces refer back to these
+    std::vector<glm::vec3> m_positions;
+    std::vector<glm::vec2> m_uvs;
+    std::vector<glm::vec3> m_normals;
+
+    // Triangles waiting to be handed to the sink
+    std::vector<Vertex3dUVNormal> m_batch;
+    size_t m_batchTriangles;
+
+    // The start of a line that was cut off at the end of the last push
+    std::vector<char> m_partialLine;
+
+    // Set once something could not be read, everything after that is ignored
+    bool m_failed = false;
+
+    // Reads lines that are all complete, end must be just after a newline or at the end of the file
+    bool ParseLines(const char* p, const char* end);
+
+    // Hands the waiting triangles to the sink
+    void Flush();
+
+public:
+    // batchTriangles is how many triangles the sink gets at a time
+    ObjStreamParser(ObjTriangleSink sink, size_t batchTriangles);
+
+    // Parses the next bytes of the file, returns false if something could not be read
+    bool Push(const char* data, size_t size);
+
+    // Call after the last push, reads the last line and sends the last batch
+    bool Finish();
+
+    // Bytes this parser is holding on to right now
+    size_t GetMemoryUsed();
+};
+
+// Reads an obj file bufferSize bytes at a time, and streams the triangles to the sink
+bool LoadObjStreaming(std::string filePath, ObjTriangleSink sink, size_t bufferSize, size_t batchTriangles);
+
+// Loads every .3Dobj file in Assets with both loaders,
+// prints the speed of each in MB/s, and checks they match
+void BenchmarkObjLoaders();
@@ -0,0 +1,651 @@
+/*
+Title: Blur Optimization VR
+File Name: occlusionCulling.cpp
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "occlusionCulling.h"
+#include "threadPool.h"
+#include "glm/gtc/matrix_transform.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define OcclusionUseSSE 1
+#else
+#define OcclusionUseSSE 0
+#endif
+
+// Objects each job tests when Cull has a pool to spread them across
+#define OcclusionTestChunk 1024u
+
+// Corners of a box are numbered by bits, 1 for max x, 2 for max y, 4 for max z.
+// These are its 12 triangles, two for each side
+static const unsigned int BoxIndices[36] =
+{
+    0, 2, 6, 0, 6, 4,
+    1, 5, 7, 1, 7, 3,
+    0, 4, 5, 0, 5, 1,
+    2, 3, 7, 2, 7, 6,
+    0, 1, 3, 0, 3, 2,
+    4, 6, 7, 4, 7, 5,
+};
+
+static glm::vec3 BoxCorner(const glm::vec3& boxMin, const glm::vec3& boxMax, int corner)
+{
+    return glm::vec3(corner & 1 ? boxMax.x : boxMin.x, corner & 2 ? boxMax.y : boxMin.y, corner & 4 ? boxMax.z : boxMin.z);
+}
+
+static double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// Clip space to pixels, with 1 / w as depth
+static glm::vec3 ToScreen(const glm::vec4& clip, int width, int height)
+{
+    float inverseW = 1.0f / clip.w;
+    return glm::vec3((clip.x * inverseW * 0.5f + 0.5f) * width, (clip.y * inverseW * 0.5f + 0.5f) * height, inverseW);
+}
+
+OcclusionCuller::OcclusionCuller(int width, int height)
+{
+    m_tilesX = (width + OcclusionTileSize - 1) / OcclusionTileSize;
+    m_tilesY = (height + OcclusionTileSize - 1) / OcclusionTileSize;
+    m_width = m_tilesX * OcclusionTileSize;
+    m_height = m_tilesY * OcclusionTileSize;
+
+    for (int eye = 0; eye < 2; eye++)
+    {
+        m_depth[eye].assign(m_width * m_height, 0.0f);
+        m_tileDepth[eye].assign(m_tilesX * m_tilesY, 0.0f);
+        m_viewProjection[eye] = glm::mat4();
+    }
+}
+
+OcclusionCuller::~OcclusionCuller()
+{
+    // The worker thread might still be using everything
+    FinishCulling();
+}
+
+unsigned int OcclusionCuller::AddOccluderMesh(const OccluderMesh& mesh)
+{
+    m_meshes.push_back(mesh);
+    return (unsigned int)m_meshes.size() - 1;
+}
+
+void OcclusionCuller::BeginFrame(const glm::mat4& viewProjection1, const glm::mat4& viewProjection2)
+{
+    FinishCulling();
+
+    m_viewProjection[0] = viewProjection1;
+    m_viewProjection[1] = viewProjection2;
+    m_occluderMeshes.clear();
+    m_occluderMatrices.clear();
+    m_boxMin.clear();
+    m_boxMax.clear();
+    m_visible.clear();
+}
+
+void OcclusionCuller::AddOccluder(unsigned int mesh, const glm::mat4& worldMatrix)
+{
+    m_occluderMeshes.push_back(mesh);
+    m_occluderMatrices.push_back(worldMatrix);
+}
+
+unsigned int OcclusionCuller::AddObject(const glm::vec3& boxMin, const glm::vec3& boxMax)
+{
+    m_boxMin.push_back(boxMin);
+    m_boxMax.push_back(boxMax);
+    return (unsigned int)m_boxMin.size() - 1;
+}
+
+unsigned int OcclusionCuller::RasterizeEye(int eye)
+{
+    std::fill(m_depth[eye].begin(), m_depth[eye].end(), 0.0f);
+
+    // Each occluder's vertices go to clip space once, then every triangle reuses them
+    std::vector<glm::vec4> clip;
+    unsigned int rasterized = 0;
+    for (size_t o = 0; o < m_occluderMeshes.size(); o++)
+    {
+        const OccluderMesh& mesh = m_meshes[m_occluderMeshes[o]];
+        glm::mat4 matrix = m_viewProjection[eye] * m_occluderMatrices[o];
+
+        clip.resize(mesh.positions.size());
+        for (size_t v = 0; v < mesh.positions.size(); v++)
+            clip[v] = matrix * glm::vec4(mesh.positions[v], 1);
+
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+            rasterized += RasterizeTriangle(eye, clip[mesh.indices[i]], clip[mesh.indices[i + 1]], clip[mesh.indices[i + 2]]);
+    }
+
+    UpdateTiles(eye);
+    return rasterized;
+}
+
+bool OcclusionCuller::RasterizeTriangle(int eye, const glm::vec4& clip0, const glm::vec4& clip1, const glm::vec4& clip2)
+{
+    // Triangles that reach behind the near plane would need clipping. Leaving
+    // them out only means less gets culled, so they're just skipped
+    if (clip0.w < OcclusionNearW || clip1.w < OcclusionNearW || clip2.w < OcclusionNearW)
+        return false;
+
+    glm::vec3 v[3] = { ToScreen(clip0, m_width, m_height), ToScreen(clip1, m_width, m_height), ToScreen(clip2, m_width, m_height) };
+
+    // Both sides of an occluder hide things, so turn clockwise triangles around
+    float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+    if (area < 0)
+    {
+        std::swap(v[1], v[2]);
+        area = -area;
+    }
+    if (area < 1e-6f)
+        return false;
+
+    int x0 = glm::max(0, (int)floor(glm::min(v[0].x, glm::min(v[1].x, v[2].x))));
+    int y0 = glm::max(0, (int)floor(glm::min(v[0].y, glm::min(v[1].y, v[2].y))));
+    int x1 = glm::min(m_width, (int)ceil(glm::max(v[0].x, glm::max(v[1].x, v[2].x))));
+    int y1 = glm::min(m_height, (int)ceil(glm::max(v[0].y, glm::max(v[1].y, v[2].y))));
+    if (x0 >= x1 || y0 >= y1)
+        return false;
+
+    // Edge functions, a * x + b * y + c >= 0 on the inside of each edge. A whole pixel is
+    // inside an edge if its center is at least threshold in, half a pixel each way
+    float a[3], b[3], c[3], threshold[3];
+    for (int e = 0; e < 3; e++)
+    {
+        const glm::vec3& from = v[e];
+        const glm::vec3& to = v[(e + 1) % 3];
+        a[e] = from.y - to.y;
+        b[e] = to.x - from.x;
+        c[e] = from.x * to.y - from.y * to.x;
+        threshold[e] = 0.5f * (fabs(a[e]) + fabs(b[e]));
+    }
+
+    // Depth is a plane across the screen. Each pixel gets the farthest
+    // depth in it, half a pixel each way from its center
+    float dzdx = ((v[1].z - v[0].z) * (v[2].y - v[0].y) - (v[2].z - v[0].z) * (v[1].y - v[0].y)) / area;
+    float dzdy = ((v[2].z - v[0].z) * (v[1].x - v[0].x) - (v[1].z - v[0].z) * (v[2].x - v[0].x)) / area;
+    float dzc = v[0].z - dzdx * v[0].x - dzdy * v[0].y - 0.5f * (fabs(dzdx) + fabs(dzdy));
+
+    float* depth = m_depth[eye].data();
+    for (int ty = y0 / OcclusionTileSize; ty <= (y1 - 1) / OcclusionTileSize; ty++)
+    {
+        for (int tx = x0 / OcclusionTileSize; tx <= (x1 - 1) / OcclusionTileSize; tx++)
+        {
+            int tileX = tx * OcclusionTileSize;
+            int tileY = ty * OcclusionTileSize;
+
+            // Skip the tile if even its best pixel center is outside an edge
+            bool missed = false;
+            for (int e = 0; e < 3; e++)
+            {
+                float x = tileX + (a[e] > 0 ? OcclusionTileSize - 0.5f : 0.5f);
+                float y = tileY + (b[e] > 0 ? OcclusionTileSize - 0.5f : 0.5f);
+                missed |= a[e] * x + b[e] * y + c[e] < threshold[e];
+            }
+            if (missed)
+                continue;
+
+#if OcclusionUseSSE
+            __m128 a0 = _mm_set1_ps(a[0]), a1 = _mm_set1_ps(a[1]), a2 = _mm_set1_ps(a[2]);
+            __m128 t0 = _mm_set1_ps(threshold[0]), t1 = _mm_set1_ps(threshold[1]), t2 = _mm_set1_ps(threshold[2]);
+            __m128 zx = _mm_set1_ps(dzdx);
+            for (int y = tileY; y < tileY + OcclusionTileSize; y++)
+            {
+                float yc = y + 0.5f;
+                __m128 row0 = _mm_set1_ps(b[0] * yc + c[0]);
+                __m128 row1 = _mm_set1_ps(b[1] * yc + c[1]);
+                __m128 row2 = _mm_set1_ps(b[2] * yc + c[2]);
+                __m128 rowZ = _mm_set1_ps(dzdy * yc + dzc);
+
+                for (int x = tileX; x < tileX + OcclusionTileSize; x += 4)
+                {
+                    __m128 xc = _mm_add_ps(_mm_set1_ps((float)x), _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f));
+
+                    // Covered where all three edges are far enough in
+                    __m128 inside = _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, xc), row0), t0),
+                                    _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, xc), row1), t1),
+                                               _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, xc), row2), t2)));
+                    if (_mm_movemask_ps(inside) == 0)
+                        continue;
+
+                    // Keep the closer of what's there and this triangle, only where it's covered
+                    float* pixels = depth + y * m_width + x;
+                    __m128 old = _mm_loadu_ps(pixels);
+                    __m128 closer = _mm_max_ps(old, _mm_add_ps(_mm_mul_ps(zx, xc), rowZ));
+                    _mm_storeu_ps(pixels, _mm_or_ps(_mm_and_ps(inside, closer), _mm_andnot_ps(inside, old)));
+                }
+            }
+#else
+            for (int y = tileY; y < tileY + OcclusionTileSize; y++)
+            {
+                float yc = y + 0.5f;
+                for (int x = tileX; x < tileX + OcclusionTileSize; x++)
+                {
+                    float xc = x + 0.5f;
+                    if (a[0] * xc + b[0] * yc + c[0] < threshold[0] ||
+                        a[1] * xc + b[1] * yc + c[1] < threshold[1] ||
+                        a[2] * xc + b[2] * yc + c[2] < threshold[2])
+                        continue;
+
+                    float& pixel = depth[y * m_width + x];
+                    pixel = glm::max(pixel, dzdx * xc + dzdy * yc + dzc);
+                }
+            }
+#endif
+        }
+    }
+
+    return true;
+}
+
+void OcclusionCuller::UpdateTiles(int eye)
+{
+    const float* depth = m_depth[eye].data();
+    for (int ty = 0; ty < m_tilesY; ty++)
+    {
+        for (int tx = 0; tx < m_tilesX; tx++)
+        {
+            const float* tile = depth + ty * OcclusionTileSize * m_width + tx * OcclusionTileSize;
+#if OcclusionUseSSE
+            __m128 farthest = _mm_set1_ps(FLT_MAX);
+            for (int y = 0; y < OcclusionTileSize; y++)
+            {
+                for (int x = 0; x < OcclusionTileSize; x += 4)
+                    farthest = _mm_min_ps(farthest, _mm_loadu_ps(tile + y * m_width + x));
+            }
+            farthest = _mm_min_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(1, 0, 3, 2)));
+            farthest = _mm_min_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(2, 3, 0, 1)));
+            m_tileDepth[eye][ty * m_tilesX + tx] = _mm_cvtss_f32(farthest);
+#else
+            float farthest = FLT_MAX;
+            for (int y = 0; y < OcclusionTileSize; y++)
+            {
+                for (int x = 0; x < OcclusionTileSize; x++)
+                    farthest = glm::min(farthest, tile[y * m_width + x]);
+            }
+            m_tileDepth[eye][ty * m_tilesX + tx] = farthest;
+#endif
+        }
+    }
+}
+
+bool OcclusionCuller::TestBox(int eye, const glm::vec3& boxMin, const glm::vec3& boxMax)
+{
+    // The screen rectangle around the box's corners, and the closest any of them gets
+    // Each corner is the min corner plus some of the box's edges, so only one goes through the matrix
+    const glm::mat4& matrix = m_viewProjection[eye];
+    glm::vec3 size = boxMax - boxMin;
+    glm::vec4 origin = matrix * glm::vec4(boxMin, 1);
+    glm::vec4 edges[3] = { matrix[0] * size.x, matrix[1] * size.y, matrix[2] * size.z };
+
+    glm::vec2 screenMin = glm::vec2(FLT_MAX);
+    glm::vec2 screenMax = glm::vec2(-FLT_MAX);
+    float closest = 0;
+    for (int corner = 0; corner < 8; corner++)
+    {
+        glm::vec4 clip = origin;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (corner & (1 << axis))
+                clip += edges[axis];
+        }
+
+        // Too close to project, so it can't be hidden
+        if (clip.w < OcclusionNearW)
+            return true;
+
+        glm::vec3 screen = ToScreen(clip, m_width, m_height);
+        screenMin = glm::min(screenMin, glm::vec2(screen));
+        screenMax = glm::max(screenMax, glm::vec2(screen));
+        closest = glm::max(closest, screen.z);
+    }
+
+    // Every pixel the rectangle touches
+    int x0 = glm::max(0, (int)floor(screenMin.x));
+    int y0 = glm::max(0, (int)floor(screenMin.y));
+    int x1 = glm::min(m_width, (int)ceil(screenMax.x));
+    int y1 = glm::min(m_height, (int)ceil(screenMax.y));
+    if (x0 >= x1 || y0 >= y1)
+        return false;
+
+    const float* depth = m_depth[eye].data();
+    for (int ty = y0 / OcclusionTileSize; ty <= (y1 - 1) / OcclusionTileSize; ty++)
+    {
+        for (int tx = x0 / OcclusionTileSize; tx <= (x1 - 1) / OcclusionTileSize; tx++)
+        {
+            // Every occluder in the tile is closer than the closest part of the box
+            if (m_tileDepth[eye][ty * m_tilesX + tx] > closest)
+                continue;
+
+            int pixelX1 = glm::min(x1, (tx + 1) * OcclusionTileSize);
+            int pixelY1 = glm::min(y1, (ty + 1) * OcclusionTileSize);
+            for (int y = glm::max(y0, ty * OcclusionTileSize); y < pixelY1; y++)
+            {
+                for (int x = glm::max(x0, tx * OcclusionTileSize); x < pixelX1; x++)
+                {
+                    if (depth[y * m_width + x] <= closest)
+                        return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+void OcclusionCuller::Cull(ThreadPool* pool)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    unsigned int rasterized[2] = { 0, 0 };
+    if (pool != nullptr)
+    {
+        pool->ParallelFor(2, [this, &rasterized](int eye) { rasterized[eye] = RasterizeEye(eye); });
+    }
+    else
+    {
+        for (int eye = 0; eye < 2; eye++)
+            rasterized[eye] = RasterizeEye(eye);
+    }
+
+    m_stats.rasterizeTime = MillisecondsSince(start);
+    start = std::chrono::high_resolution_clock::now();
+
+    // Hidden only if both eyes agree. The second eye is only asked if the first can't see it.
+    // With a pool, the objects are split into chunks across it
+    unsigned int count = (unsigned int)m_boxMin.size();
+    m_visible.resize(count);
+    auto testChunk = [this, count](int chunk)
+    {
+        unsigned int end = glm::min(count, (unsigned int)(chunk + 1) * OcclusionTestChunk);
+        for (unsigned int i = chunk * OcclusionTestChunk; i < end; i++)
+            m_visible[i] = TestBox(0, m_boxMin[i], m_boxMax[i]) || TestBox(1, m_boxMin[i], m_boxMax[i]);
+    };
+
+    int chunks = (int)((count + OcclusionTestChunk - 1) / OcclusionTestChunk);
+    if (pool != nullptr && chunks > 1)
+    {
+        pool->ParallelFor(chunks, testChunk);
+    }
+    else
+    {
+        for (int chunk = 0; chunk < chunks; chunk++)
+            testChunk(chunk);
+    }
+
+    unsigned int culled = 0;
+    for (unsigned int i = 0; i < count; i++)
+        culled += !m_visible[i];
+
+    m_stats.testTime = MillisecondsSince(start);
+    m_stats.occluderTriangles = 0;
+    for (unsigned int mesh : m_occluderMeshes)
+        m_stats.occluderTriangles += (unsigned int)m_meshes[mesh].indices.size() / 3;
+    m_stats.trianglesRasterized = rasterized[0] + rasterized[1];
+    m_stats.objectsTested = count;
+    m_stats.objectsCulled = culled;
+}
+
+void OcclusionCuller::StartCulling(ThreadPool& pool)
+{
+    FinishCulling();
+
+    ThreadPool* workers = &pool;
+    m_pending = pool.Submit([this, workers]() { Cull(workers); });
+    m_running = true;
+}
+
+void OcclusionCuller::FinishCulling()
+{
+    if (!m_running)
+        return;
+
+    m_pending.get();
+    m_running = false;
+}
+
+const std::vector<unsigned char>& OcclusionCuller::GetVisible() const
+{
+    return m_visible;
+}
+
+const std::vector<float>& OcclusionCuller::GetDepth(int eye) const
+{
+    return m_depth[eye];
+}
+
+int OcclusionCuller::GetWidth() const
+{
+    return m_width;
+}
+
+int OcclusionCuller::GetHeight() const
+{
+    return m_height;
+}
+
+const OcclusionStats& OcclusionCuller::GetStats() const
+{
+    return m_stats;
+}
+
+void OcclusionCuller::PrintStats() const
+{
+    printf("Occlusion culling: %d x %d per eye, %u of %u occluder triangles rasterized (both eyes) in %.3f ms\n",
+        m_width, m_height, m_stats.trianglesRasterized, m_stats.occluderTriangles * 2, m_stats.rasterizeTime);
+    printf("Occlusion culling: %u of %u objects hidden from both eyes, tested in %.3f ms\n",
+        m_stats.objectsCulled, m_stats.objectsTested, m_stats.testTime);
+}
+
+// Calls pixel(x, y, depth) for every pixel whose center is inside the triangle, with 1 / w at the
+// center. Nothing conservative about it, this is the plain rasterizer the benchmark compares with
+template <typename F>
+static void RasterizeReference(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2, int width, int height, F pixel)
+{
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+    if (area < 0)
+    {
+        std::swap(v1, v2);
+        area = -area;
+    }
+    if (area < 1e-9f)
+        return;
+
+    int x0 = glm::max(0, (int)floor(glm::min(v0.x, glm::min(v1.x, v2.x))));
+    int y0 = glm::max(0, (int)floor(glm::min(v0.y, glm::min(v1.y, v2.y))));
+    int x1 = glm::min(width, (int)ceil(glm::max(v0.x, glm::max(v1.x, v2.x))));
+    int y1 = glm::min(height, (int)ceil(glm::max(v0.y, glm::max(v1.y, v2.y))));
+
+    for (int y = y0; y < y1; y++)
+    {
+        for (int x = x0; x < x1; x++)
+        {
+            glm::vec2 p = glm::vec2(x + 0.5f, y + 0.5f);
+            float w0 = (v2.x - v1.x) * (p.y - v1.y) - (v2.y - v1.y) * (p.x - v1.x);
+            float w1 = (v0.x - v2.x) * (p.y - v2.y) - (v0.y - v2.y) * (p.x - v2.x);
+            float w2 = (v1.x - v0.x) * (p.y - v0.y) - (v1.y - v0.y) * (p.x - v0.x);
+            if (w0 < 0 || w1 < 0 || w2 < 0)
+                continue;
+            pixel(x, y, (w0 * v0.z + w1 * v1.z + w2 * v2.z) / area);
+        }
+    }
+}
+
+// Best time of repeats runs of work, in milliseconds
+template <typename F>
+static double TimeOcclusion(int repeats, F work)
+{
+    double best = 1e30;
+    for (int r = 0; r < repeats; r++)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        work();
+        best = glm::min(best, MillisecondsSince(start));
+    }
+    return best;
+}
+
+void BenchmarkOcclusionCulling()
+{
+    const unsigned int objectCount = 20000;
+    const int width = 128;
+    const int height = 144;
+    const int referenceScale = 8;
+    const int repeats = 20;
+
+    // Two eyes like main.cpp's
+    glm::mat4 projection = glm::perspective(0.9f, 0.5f * 1366.0f / 768.0f, 0.1f, 100.0f);
+    glm::mat4 viewProjection[2] =
+    {
+        projection * glm::lookAt(glm::vec3(-0.03f, 0, 0), glm::vec3(-0.03f, 0, -10), glm::vec3(0, 1, 0)),
+        projection * glm::lookAt(glm::vec3(0.03f, 0, 0), glm::vec3(0.03f, 0, -10), glm::vec3(0, 1, 0)),
+    };
+
+    // Walls, a floor, and a wall at the back, all made from one box
+    OccluderMesh box;
+    for (int corner = 0; corner < 8; corner++)
+        box.positions.push_back(BoxCorner(glm::vec3(-1), glm::vec3(1), corner));
+    box.indices.assign(BoxIndices, BoxIndices + 36);
+
+    glm::vec3 wallCenters[5] = { glm::vec3(-6, 0, -15), glm::vec3(1, -1, -12), glm::vec3(7, 1, -20), glm::vec3(0, -4, -30), glm::vec3(0, 0, -60) };
+    glm::vec3 wallSizes[5] = { glm::vec3(3, 3, 0.25f), glm::vec3(2.5f, 2, 0.25f), glm::vec3(3, 4, 0.25f), glm::vec3(30, 0.2f, 30), glm::vec3(25, 15, 0.5f) };
+
+    std::mt19937 random(12345);
+    std::uniform_real_distribution<float> positionX(-25.0f, 25.0f);
+    std::uniform_real_distribution<float> positionY(-10.0f, 10.0f);
+    std::uniform_real_distribution<float> positionZ(-80.0f, -5.0f);
+    std::uniform_real_distribution<float> size(0.1f, 1.0f);
+    std::vector<glm::vec3> boxMins, boxMaxs;
+    for (unsigned int i = 0; i < objectCount; i++)
+    {
+        glm::vec3 center = glm::vec3(positionX(random), positionY(random), positionZ(random));
+        glm::vec3 extent = glm::vec3(size(random), size(random), size(random));
+        boxMins.push_back(center - extent);
+        boxMaxs.push_back(center + extent);
+    }
+
+    OcclusionCuller culler(width, height);
+    unsigned int boxMesh = culler.AddOccluderMesh(box);
+    culler.BeginFrame(viewProjection[0], viewProjection[1]);
+    for (int w = 0; w < 5; w++)
+        culler.AddOccluder(boxMesh, glm::scale(glm::translate(glm::mat4(), wallCenters[w]), wallSizes[w]));
+    for (unsigned int i = 0; i < objectCount; i++)
+        culler.AddObject(boxMins[i], boxMaxs[i]);
+
+    double rasterizeMs = 1e30, testMs = 1e30;
+    for (int r = 0; r < repeats; r++)
+    {
+        culler.Cull();
+        rasterizeMs = glm::min(rasterizeMs, culler.GetStats().rasterizeTime);
+        testMs = glm::min(testMs, culler.GetStats().testTime);
+    }
+    ThreadPool& pool = GetSharedThreadPool();
+    double pooledMs = TimeOcclusion(repeats, [&]() { culler.Cull(&pool); });
+    double workerMs = TimeOcclusion(repeats, [&]() { culler.StartCulling(pool); culler.FinishCulling(); });
+    std::vector<unsigned char> visible = culler.GetVisible();
+
+    // The same scene at referenceScale times the resolution, sampling pixel centers
+    // with exact depth, and rasterizing every side of every box
+    int referenceWidth = culler.GetWidth() * referenceScale;
+    int referenceHeight = culler.GetHeight() * referenceScale;
+    std::vector<float> referenceDepth[2];
+    std::vector<unsigned char> referenceVisible(objectCount, 0);
+    for (int eye = 0; eye < 2; eye++)
+    {
+        std::vector<float>& depth = referenceDepth[eye];
+        depth.assign(referenceWidth * referenceHeight, 0.0f);
+        for (int w = 0; w < 5; w++)
+        {
+            glm::mat4 matrix = viewProjection[eye] * glm::scale(glm::translate(glm::mat4(), wallCenters[w]), wallSizes[w]);
+            for (int i = 0; i < 36; i += 3)
+            {
+                glm::vec4 clip[3];
+                bool tooClose = false;
+                for (int k = 0; k < 3; k++)
+                {
+                    clip[k] = matrix * glm::vec4(box.positions[BoxIndices[i + k]], 1);
+                    tooClose |= clip[k].w < OcclusionNearW;
+                }
+                if (tooClose)
+                    continue;
+                RasterizeReference(ToScreen(clip[0], referenceWidth, referenceHeight), ToScreen(clip[1], referenceWidth, referenceHeight),
+                    ToScreen(clip[2], referenceWidth, referenceHeight), referenceWidth, referenceHeight,
+                    [&](int x, int y, float z) { depth[y * referenceWidth + x] = glm::max(depth[y * referenceWidth + x], z); });
+            }
+        }
+
+        for (unsigned int o = 0; o < objectCount; o++)
+        {
+            if (referenceVisible[o])
+                continue;
+
+            glm::vec3 corners[8];
+            bool tooClose = false;
+            for (int corner = 0; corner < 8; corner++)
+            {
+                glm::vec4 clip = viewProjection[eye] * glm::vec4(BoxCorner(boxMins[o], boxMaxs[o], corner), 1);
+                tooClose |= clip.w < OcclusionNearW;
+                corners[corner] = ToScreen(clip, referenceWidth, referenceHeight);
+            }
+            if (tooClose)
+            {
+                referenceVisible[o] = 1;
+                continue;
+            }
+
+            bool seen = false;
+            for (int i = 0; i < 36 && !seen; i += 3)
+            {
+                RasterizeReference(corners[BoxIndices[i]], corners[BoxIndices[i + 1]], corners[BoxIndices[i + 2]], referenceWidth, referenceHeight,
+                    [&](int x, int y, float z) { seen |= z >= depth[y * referenceWidth + x]; });
+            }
+            referenceVisible[o] = seen;
+        }
+    }
+
+    // Culling something the reference can see is a mistake. Not culling something
+    // the reference can't see is just the price of a smaller buffer
+    unsigned int culled = 0, referenceHidden = 0, wronglyCulled = 0;
+    for (unsigned int o = 0; o < objectCount; o++)
+    {
+        culled += !visible[o];
+        referenceHidden += !referenceVisible[o];
+        wronglyCulled += !visible[o] && referenceVisible[o];
+    }
+
+    const OcclusionStats& stats = culler.GetStats();
+    printf("\nOcclusion culling benchmark (%u boxes, %u occluder triangles, %d x %d per eye, %s, best of %d)\n",
+        objectCount, stats.occluderTriangles, culler.GetWidth(), culler.GetHeight(), OcclusionUseSSE ? "SSE" : "no SIMD", repeats);
+    printf("rasterize both eyes                %8.3f ms\n", rasterizeMs);
+    printf("test every box                     %8.3f ms (%.1f ns a box)\n", testMs, testMs * 1e6 / objectCount);
+    printf("spread across the thread pool      %8.3f ms (%d threads)\n", pooledMs, pool.GetThreadCount());
+    printf("on a worker thread, waited for     %8.3f ms\n", workerMs);
+    printf("culled %u, the reference at %d x %d finds %u hidden (%.1f%% of them culled), %u wrongly culled\n",
+        culled, referenceWidth, referenceHeight, referenceHidden, referenceHidden ? 100.0 * culled / referenceHidden : 0.0, wronglyCulled);
+}
@@ -0,0 +1,153 @@
+/*
+Title: Blur Optimization VR
+File Name: occlusionCulling.h
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "glm/glm.hpp"
+#include <future>
+#include <vector>
+
+class ThreadPool;
+
+// Pixels in one side of a tile. Each eye's depth buffer is a grid of these tiles,
+// and every tile keeps the farthest depth in it, so most tests read one value per tile
+#define OcclusionTileSize 8
+
+// How close to the eye (clip space w) an occluder triangle or object box can get before
+// it's handled without projecting it. Occluders that close are skipped, objects are kept
+#define OcclusionNearW 0.05f
+
+// Timings and counts from the last Cull
+struct OcclusionStats
+{
+    unsigned int occluderTriangles = 0;
+    unsigned int trianglesRasterized = 0;
+    unsigned int objectsTested = 0;
+    unsigned int objectsCulled = 0;
+    double rasterizeTime = 0;
+    double testTime = 0;
+};
+
+// A triangle mesh the cpu rasterizes into depth, in model space.
+// Should be simple, and never bigger than the object it stands in for
+struct OccluderMesh
+{
+    std::vector<glm::vec3> positions;
+    std::vector<unsigned int> indices;
+};
+
+// Software occlusion culling. A few simple occluders are rasterized from both eyes into
+// small depth buffers on the cpu, and then the box of every object is tested against them.
+// Anything hidden from both eyes doesn't need to be drawn.
+//
+// Depth is stored as 1 / w, which is linear across the screen, so larger is closer and
+// an empty buffer is 0. Both sides of the test are conservative, so nothing that could be
+// seen is ever culled: an occluder only writes a pixel its triangle covers completely, with
+// the farthest depth the triangle has anywhere in that pixel, and an object tests every pixel
+// its box touches, at the closest depth of its box.
+//
+// Rasterizing goes a tile at a time, skipping tiles the triangle misses, and 4 pixels at a
+// time across each row of a tile with SSE. Testing first compares against each tile's farthest
+// depth, and only looks at single pixels in tiles where that doesn't settle it.
+//
+// Everything here is cpu only, so it runs without a gpu, and BenchmarkOcclusionCulling
+// checks it against a much higher resolution rasterizer.
+class OcclusionCuller
+{
+
+private:
+    // Size of each eye's buffer, in pixels, both multiples of OcclusionTileSize
+    int m_width;
+    int m_height;
+    int m_tilesX;
+    int m_tilesY;
+
+    // Per eye, 1 / w of the closest occluder in each pixel, and the farthest of those in each tile
+    std::vector<float> m_depth[2];
+    std::vector<float> m_tileDepth[2];
+
+    glm::mat4 m_viewProjection[2];
+
+    std::vector<OccluderMesh> m_meshes;
+
+    // This frame's occluders (mesh and world matrix), and the world space boxes to test
+    std::vector<unsigned int> m_occluderMeshes;
+    std::vector<glm::mat4> m_occluderMatrices;
+    std::vector<glm::vec3> m_boxMin;
+    std::vector<glm::vec3> m_boxMax;
+
+    // 1 if the object might be seen by either eye
+    std::vector<unsigned char> m_visible;
+
+    std::future<void> m_pending;
+    bool m_running = false;
+    OcclusionStats m_stats;
+
+    // Both return how many triangles were drawn, rather than skipped
+    unsigned int RasterizeEye(int eye);
+    bool RasterizeTriangle(int eye, const glm::vec4& clip0, const glm::vec4& clip1, const glm::vec4& clip2);
+    void UpdateTiles(int eye);
+    bool TestBox(int eye, const glm::vec3& boxMin, const glm::vec3& boxMax);
+
+public:
+    // width and height are the size of each eye's depth buffer,
+    // rounded up to whole tiles. A fraction of the real eye's size is plenty
+    OcclusionCuller(int width, int height);
+    ~OcclusionCuller();
+
+    // Adds a mesh that can be used as an occluder, returns its id for AddOccluder
+    unsigned int AddOccluderMesh(const OccluderMesh& mesh);
+
+    // Starts a frame, with each eye's camera (projection * view). Forgets last frame's occluders and objects
+    void BeginFrame(const glm::mat4& viewProjection1, const glm::mat4& viewProjection2);
+
+    // Something that hides what's behind it this frame
+    void AddOccluder(unsigned int mesh, const glm::mat4& worldMatrix);
+
+    // Something to test this frame, by its world space box. Returns its index in GetVisible
+    unsigned int AddObject(const glm::vec3& boxMin, const glm::vec3& boxMax);
+
+    // Rasterizes and tests everything added since BeginFrame. With a pool, each eye
+    // rasterizes on its own thread, and the objects are tested in chunks across it
+    void Cull(ThreadPool* pool = nullptr);
+
+    // Does the same as Cull on a worker thread of pool, so this thread can do something else.
+    // Nothing can be added until FinishCulling returns
+    void StartCulling(ThreadPool& pool);
+    void FinishCulling();
+
+    // One byte for every object added this frame, 1 if either eye might see it, 0 if it's hidden from both
+    const std::vector<unsigned char>& GetVisible() const;
+
+    // Each eye's depth buffer, for looking at
+    const std::vector<float>& GetDepth(int eye) const;
+    int GetWidth() const;
+    int GetHeight() const;
+
+    const OcclusionStats& GetStats() const;
+    void PrintStats() const;
+};
+
+// Rasterizes a made up scene of walls and 20k boxes, checks that nothing that can be
+// seen is culled against a rasterizer at 8 times the resolution, and prints how long it takes
+void BenchmarkOcclusionCulling();
@@ -0,0 +1,422 @@
+/*
+Title: Blur Optimization VR
+File Name: proceduralMesh.cpp
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "proceduralMesh.h"
+#include "vertexPacking.h"
+#include "indexPacking.h"
+#include "objLoader.h"
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+size_t ProceduralMesh::GetVertexCount() const
+{
+    size_t count = 0;
+    for (const ProceduralSurface& surface : surfaces)
+        count += (size_t)(surface.columns + 1) * (surface.rows + 1);
+    return count;
+}
+
+size_t ProceduralMesh::GetIndexCount() const
+{
+    size_t count = 0;
+    for (const ProceduralSurface& surface : surfaces)
+        count += (size_t)surface.columns * surface.rows * 6;
+    return count;
+}
+
+// ========== Shapes ==========
+
+ProceduralMesh MakePlane(float width, float depth, unsigned int columns, unsigned int rows)
+{
+    ProceduralMesh shape;
+    shape.surfaces.push_back({ columns, rows, [width, depth](float u, float v)
+    {
+        glm::vec3 position((u - 0.5f) * width, 0.0f, (0.5f - v) * depth);
+        return Vertex3dUVNormal(position, glm::vec2(u, v), glm::vec3(0, 1, 0), glm::vec3(1, 0, 0));
+    } });
+    shape.boundsMin = glm::vec3(-width / 2, 0.0f, -depth / 2);
+    shape.boundsMax = glm::vec3(width / 2, 0.0f, depth / 2);
+    return shape;
+}
+
+ProceduralMesh MakeCube(float size, unsigned int segments)
+{
+    // Each face's normal, and the way v goes across it. u goes the way of cross(v, normal),
+    // so cross(u, v) points out of the cube. The sides all have v going up
+    const glm::vec3 faces[6][2] =
+    {
+        { glm::vec3( 1, 0, 0), glm::vec3(0, 1, 0) },
+        { glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0) },
+        { glm::vec3( 0, 0, 1), glm::vec3(0, 1, 0) },
+        { glm::vec3( 0, 0,-1), glm::vec3(0, 1, 0) },
+        { glm::vec3( 0, 1, 0), glm::vec3(0, 0,-1) },
+        { glm::vec3( 0,-1, 0), glm::vec3(0, 0, 1) },
+    };
+
+    ProceduralMesh shape;
+    for (const auto& face : faces)
+    {
+        glm::vec3 normal = face[0];
+        glm::vec3 up = face[1];
+        glm::vec3 across = glm::cross(up, normal);
+        shape.surfaces.push_back({ segments, segments, [size, normal, up, across](float u, float v)
+        {
+            glm::vec3 position = (normal * 0.5f + across * (u - 0.5f) + up * (v - 0.5f)) * size;
+            return Vertex3dUVNormal(position, glm::vec2(u, v), normal, across);
+        } });
+    }
+    shape.boundsMin = glm::vec3(-size / 2);
+    shape.boundsMax = glm::vec3(size / 2);
+    return shape;
+}
+
+ProceduralMesh MakeSphere(float radius, unsigned int columns, unsigned int rows)
+{
+    // u goes around the y axis, v from the bottom pole to the top one
+    ProceduralMesh shape;
+    shape.surfaces.push_back({ columns, rows, [radius](float u, float v)
+    {
+        float around = glm::two_pi<float>() * u;
+        float up = glm::pi<float>() * v;
+        glm::vec3 normal(sinf(up) * cosf(around), -cosf(up), -sinf(up) * sinf(around));
+        glm::vec3 tangent(-sinf(around), 0.0f, -cosf(around));
+        return Vertex3dUVNormal(normal * radius, glm::vec2(u, v), normal, tangent);
+    } });
+    shape.boundsMin = glm::vec3(-radius);
+    shape.boundsMax = glm::vec3(radius);
+    return shape;
+}
+
+// A flat disc facing up or down, v goes from the rim to the middle on top, and the other way underneath
+static ProceduralSurface MakeDisc(float radius, float y, bool top, unsigned int columns)
+{
+    return { columns, 1, [radius, y, top](float u, float v)
+    {
+        float around = glm::two_pi<float>() * u;
+        float distance = (top ? 1.0f - v : v) * radius;
+        glm::vec3 position(distance * cosf(around), y, -distance * sinf(around));
+        glm::vec2 texCoord(0.5f + position.x / (2 * radius), 0.5f - position.z / (2 * radius));
+        return Vertex3dUVNormal(position, texCoord, glm::vec3(0, top ? 1.0f : -1.0f, 0), glm::vec3(1, 0, 0));
+    } };
+}
+
+ProceduralMesh MakeCylinder(float radius, float height, unsigned int columns, unsigned int rows)
+{
+    ProceduralMesh shape;
+    shape.surfaces.push_back({ columns, rows, [radius, height](float u, float v)
+    {
+        float around = glm::two_pi<float>() * u;
+        glm::vec3 normal(cosf(around), 0.0f, -sinf(around));
+        glm::vec3 position(normal.x * radius, (v - 0.5f) * height, normal.z * radius);
+        return Vertex3dUVNormal(position, glm::vec2(u, v), normal, glm::vec3(-sinf(around), 0.0f, -cosf(around)));
+    } });
+    shape.surfaces.push_back(MakeDisc(radius, height / 2, true, columns));
+    shape.surfaces.push_back(MakeDisc(radius, -height / 2, false, columns));
+    shape.boundsMin = glm::vec3(-radius, -height / 2, -radius);
+    shape.boundsMax = glm::vec3(radius, height / 2, radius);
+    return shape;
+}
+
+ProceduralMesh MakeCone(float radius, float height, unsigned int columns, unsigned int rows)
+{
+    // The side narrows from the base to the tip, its normal leans up by the slope
+    ProceduralMesh shape;
+    shape.surfaces.push_back({ columns, rows, [radius, height](float u, float v)
+    {
+        float around = glm::two_pi<float>() * u;
+        float distance = (1.0f - v) * radius;
+        glm::vec3 position(distance * cosf(around), (v - 0.5f) * height, -distance * sinf(around));
+        glm::vec3 normal = glm::normalize(glm::vec3(height * cosf(around), radius, -height * sinf(around)));
+        return Vertex3dUVNormal(position, glm::vec2(u, v), normal, glm::vec3(-sinf(around), 0.0f, -cosf(around)));
+    } });
+    shape.surfaces.push_back(MakeDisc(radius, -height / 2, false, columns));
+    shape.boundsMin = glm::vec3(-radius, -height / 2, -radius);
+    shape.boundsMax = glm::vec3(radius, height / 2, radius);
+    return shape;
+}
+
+ProceduralMesh MakeTorus(float majorRadius, float minorRadius, unsigned int columns, unsigned int rows)
+{
+    // u goes around the y axis, v around the tube
+    ProceduralMesh shape;
+    shape.surfaces.push_back({ columns, rows, [majorRadius, minorRadius](float u, float v)
+    {
+        float around = glm::two_pi<float>() * u;
+        float tube = glm::two_pi<float>() * v;
+        glm::vec3 center(majorRadius * cosf(around), 0.0f, -majorRadius * sinf(around));
+        glm::vec3 normal(cosf(tube) * cosf(around), sinf(tube), -cosf(tube) * sinf(around));
+        glm::vec3 tangent(-sinf(around), 0.0f, -cosf(around));
+        return Vertex3dUVNormal(center + normal * minorRadius, glm::vec2(u, v), normal, tangent);
+    } });
+    float outside = majorRadius + minorRadius;
+    shape.boundsMin = glm::vec3(-outside, -minorRadius, -outside);
+    shape.boundsMax = glm::vec3(outside, minorRadius, outside);
+    return shape;
+}
+
+ProceduralMesh MakeTerrain(float width, float depth, unsigned int columns, unsigned int rows,
+                           std::function<float(float x, float z)> height, float minHeight, float maxHeight)
+{
+    // The normal comes from the slope across one grid cell each way
+    float stepX = width / std::max(columns, 1u);
+    float stepZ = depth / std::max(rows, 1u);
+
+    ProceduralMesh shape;
+    shape.surfaces.push_back({ columns, rows, [width, depth, height, stepX, stepZ](float u, float v)
+    {
+        float x = (u - 0.5f) * width;
+        float z = (0.5f - v) * depth;
+        float slopeX = (height(x + stepX, z) - height(x - stepX, z)) / (2 * stepX);
+        float slopeZ = (height(x, z + stepZ) - height(x, z - stepZ)) / (2 * stepZ);
+        glm::vec3 normal = glm::normalize(glm::vec3(-slopeX, 1.0f, -slopeZ));
+        glm::vec3 tangent = glm::normalize(glm::vec3(1.0f, slopeX, 0.0f));
+        return Vertex3dUVNormal(glm::vec3(x, height(x, z), z), glm::vec2(u, v), normal, tangent);
+    } });
+    shape.boundsMin = glm::vec3(-width / 2, minHeight, -depth / 2);
+    shape.boundsMax = glm::vec3(width / 2, maxHeight, depth / 2);
+    return shape;
+}
+
+// ========== Generation ==========
+
+static void WriteIndex(unsigned char* indices, size_t i, unsigned int index, unsigned int indexSize)
+{
+    if (indexSize == 1)
+        indices[i] = (unsigned char)index;
+    else if (indexSize == 2)
+        ((unsigned short*)indices)[i] = (unsigned short)index;
+    else
+        ((unsigned int*)indices)[i] = index;
+}
+
+// A block of rows of one surface, and where that surface's vertices and indices start
+struct GridBlock
+{
+    const ProceduralSurface* surface;
+    size_t firstVertex;
+    size_t firstIndex;
+    unsigned int firstRow;
+    unsigned int endRow;
+};
+
+float GenerateMesh(const ProceduralMesh& shape, bool packed, void* vertices, void* indices, unsigned int indexSize, ThreadPool* pool)
+{
+    // Split every surface into blocks of whole rows. A block makes its rows of vertices,
+    // and the quads between each of them and the row above, which only need the index math
+    std::vector<GridBlock> blocks;
+    size_t firstVertex = 0;
+    size_t firstIndex = 0;
+    for (const ProceduralSurface& surface : shape.surfaces)
+    {
+        unsigned int rowsPerBlock = std::max(1u, ProceduralBlockVertices / (surface.columns + 1));
+        for (unsigned int row = 0; row <= surface.rows; row += rowsPerBlock)
+            blocks.push_back({ &surface, firstVertex, firstIndex, row, std::min(row + rowsPerBlock, surface.rows + 1) });
+
+        firstVertex += (size_t)(surface.columns + 1) * (surface.rows + 1);
+        firstIndex += (size_t)surface.columns * surface.rows * 6;
+    }
+
+    glm::vec3 center = (shape.boundsMin + shape.boundsMax) * 0.5f;
+    std::vector<float> radii(blocks.size(), 0.0f);
+
+    auto makeBlock = [&](int b)
+    {
+        const GridBlock& block = blocks[b];
+        const ProceduralSurface& surface = *block.surface;
+        unsigned int columns = surface.columns;
+        float farthest = 0;
+
+        for (unsigned int row = block.firstRow; row < block.endRow; row++)
+        {
+            float v = surface.rows > 0 ? (float)row / surface.rows : 0.0f;
+            size_t rowStart = block.firstVertex + (size_t)row * (columns + 1);
+            for (unsigned int column = 0; column <= columns; column++)
+            {
+                float u = columns > 0 ? (float)column / columns : 0.0f;
+                Vertex3dUVNormal vertex = surface.point(u, v);
+                farthest = std::max(farthest, glm::dot(vertex.m_position - center, vertex.m_position - center));
+
+                if (packed)
+                    ((PackedVertex*)vertices)[rowStart + column] = PackVertex(vertex, shape.boundsMin, shape.boundsMax);
+                else
+                    ((Vertex3dUVNormal*)vertices)[rowStart + column] = vertex;
+            }
+
+            if (row == surface.rows)
+                continue;
+
+            // a b on this row, d e on the next, both triangles turn the same way as u then v
+            size_t i = block.firstIndex + (size_t)row * columns * 6;
+            for (unsigned int column = 0; column < columns; column++)
+            {
+                unsigned int a = (unsigned int)(rowStart + column);
+                unsigned int b = a + 1;
+                unsigned int d = a + columns + 1;
+                unsigned int e = d + 1;
+                unsigned int quad[6] = { a, b, e, a, e, d };
+                for (unsigned int corner : quad)
+                    WriteIndex((unsigned char*)indices, i++, corner, indexSize);
+            }
+        }
+
+        radii[b] = farthest;
+    };
+
+    if (pool != nullptr && blocks.size() > 1)
+    {
+        pool->ParallelFor((int)blocks.size(), makeBlock);
+    }
+    else
+    {
+        for (int b = 0; b < (int)blocks.size(); b++)
+            makeBlock(b);
+    }
+
+    float farthest = 0;
+    for (float radius : radii)
+        farthest = std::max(farthest, radius);
+    return sqrtf(farthest);
+}
+
+// ========== Benchmark ==========
+
+// Checks indices are in range, every vertex is in the box, and every triangle with
+// any area faces the same way as its vertices' normals. Returns what was wrong, or nullptr
+static const char* CheckShape(const ProceduralMesh& shape, const std::vector<Vertex3dUVNormal>& vertices, const std::vector<unsigned int>& indices)
+{
+    glm::vec3 slack = (shape.boundsMax - shape.boundsMin) * 0.001f + glm::vec3(0.00001f);
+    for (const Vertex3dUVNormal& vertex : vertices)
+    {
+        if (glm::any(glm::lessThan(vertex.m_position, shape.boundsMin - slack)) ||
+            glm::any(glm::greaterThan(vertex.m_position, shape.boundsMax + slack)))
+            return "outside bounds";
+    }
+
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        if (indices[i] >= vertices.size() || indices[i + 1] >= vertices.size() || indices[i + 2] >= vertices.size())
+            return "index out of range";
+
+        const Vertex3dUVNormal& a = vertices[indices[i]];
+        const Vertex3dUVNormal& b = vertices[indices[i + 1]];
+        const Vertex3dUVNormal& c = vertices[indices[i + 2]];
+        glm::vec3 face = glm::cross(b.m_position - a.m_position, c.m_position - a.m_position);
+        if (glm::length(face) < 1e-8f)
+            continue;
+        if (glm::dot(face, a.m_normal + b.m_normal + c.m_normal) <= 0)
+            return "triangle facing the wrong way";
+    }
+    return nullptr;
+}
+
+static double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void BenchmarkProceduralMeshes()
+{
+    struct Case
+    {
+        const char* name;
+        ProceduralMesh shape;
+        const char* file;
+    };
+
+    // The obj files' shapes at about the same detail, then bigger versions to show threading
+    auto hills = [](float x, float z) { return 0.5f * sinf(x * 0.7f) * cosf(z * 0.9f) + 0.25f * sinf(x * 2.3f + z * 1.7f); };
+    Case cases[] =
+    {
+        { "plane",              MakePlane(2.0f, 2.0f, 1, 1),            "../Assets/plane.obj" },
+        { "cube",               MakeCube(1.0f, 1),                      "../Assets/cube.3Dobj" },
+        { "sphere",             MakeSphere(0.5f, 40, 20),               "../Assets/sphere.3Dobj" },
+        { "cylinder",           MakeCylinder(0.5f, 1.0f, 40, 1),        "../Assets/cylinder.3Dobj" },
+        { "cone",               MakeCone(0.5f, 1.0f, 20, 1),            "../Assets/cone.3Dobj" },
+        { "torus",              MakeTorus(0.5f, 0.2f, 20, 20),          "../Assets/torus.3Dobj" },
+        { "sphere 512x256",     MakeSphere(0.5f, 512, 256),             nullptr },
+        { "cube 128",           MakeCube(1.0f, 128),                    nullptr },
+        { "torus 1024x256",     MakeTorus(0.5f, 0.2f, 1024, 256),       nullptr },
+        { "terrain 1024x1024",  MakeTerrain(64.0f, 64.0f, 1024, 1024, hills, -0.75f, 0.75f), nullptr },
+    };
+
+    ThreadPool& pool = GetSharedThreadPool();
+    printf("\nProcedural mesh benchmark (%d threads in the pool, times are the best of 5)\n", (int)pool.GetThreadCount());
+    printf("%-20s %9s %9s %6s %10s %10s %10s %8s %10s %s\n",
+        "shape", "vertices", "triangles", "index", "1 thread", "pool", "packed", "speedup", "obj file", "check");
+
+    for (Case& test : cases)
+    {
+        size_t vertexCount = test.shape.GetVertexCount();
+        size_t indexCount = test.shape.GetIndexCount();
+        unsigned int indexSize = ChooseIndexSize(vertexCount);
+
+        std::vector<Vertex3dUVNormal> vertices(vertexCount);
+        std::vector<PackedVertex> packed(vertexCount);
+        std::vector<unsigned char> narrow(indexCount * indexSize + 4);
+
+        // Single thread, across the pool, and across the pool packing as it goes
+        double best[3] = { 1e30, 1e30, 1e30 };
+        for (int run = 0; run < 5; run++)
+        {
+            for (int mode = 0; mode < 3; mode++)
+            {
+                auto start = std::chrono::high_resolution_clock::now();
+                if (mode == 2)
+                    GenerateMesh(test.shape, true, packed.data(), narrow.data(), indexSize, &pool);
+                else
+                    GenerateMesh(test.shape, false, vertices.data(), narrow.data(), indexSize, mode == 1 ? &pool : nullptr);
+                best[mode] = std::min(best[mode], MillisecondsSince(start));
+            }
+        }
+
+        // Check full size indices, so the check can't be fooled by them wrapping around
+        std::vector<unsigned int> indices(indexCount);
+        GenerateMesh(test.shape, false, vertices.data(), indices.data(), 4, nullptr);
+        const char* problem = CheckShape(test.shape, vertices, indices);
+
+        std::vector<unsigned int> unpacked;
+        UnpackIndices(narrow.data(), indexCount, indexSize, unpacked);
+        if (problem == nullptr && unpacked != indices)
+            problem = "narrow indices differ";
+
+        char fileTime[32] = "";
+        if (test.file != nullptr)
+        {
+            std::vector<Vertex3dUVNormal> objVertices;
+            std::vector<unsigned int> objIndices;
+            auto start = std::chrono::high_resolution_clock::now();
+            if (LoadObjMapped(test.file, objVertices, objIndices, true, nullptr))
+                snprintf(fileTime, sizeof(fileTime), "%.3f", MillisecondsSince(start));
+            else
+                snprintf(fileTime, sizeof(fileTime), "missing");
+        }
+
+        printf("%-20s %9d %9d %6d %10.3f %10.3f %10.3f %7.2fx %10s %s\n",
+            test.name, (int)vertexCount, (int)(indexCount / 3), (int)indexSize, best[0], best[1], best[2],
+            best[0] / best[1], fileTime, problem != nullptr ? problem : "ok");
+    }
+}
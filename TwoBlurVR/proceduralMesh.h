@@ -0,0 +1,79 @@
+/*
+Title: Blur Optimization VR
+File Name: proceduralMesh.h
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "mesh.h"
+#include "threadPool.h"
+#include <functional>
+#include <vector>
+
+// Vertices a block of grid rows should have, so big grids split into
+// enough jobs for every core, and small ones don't split at all
+#define ProceduralBlockVertices 4096
+
+// A grid of quads laid over a surface, (columns + 1) x (rows + 1) vertices.
+// point makes the vertex at u, v, which each go from 0 to 1 across the grid.
+// Quads are wound so their front faces the way cross(dP/du, dP/dv) points,
+// so a surface should be laid out with that pointing the same way as its normal
+struct ProceduralSurface
+{
+    unsigned int columns;
+    unsigned int rows;
+    std::function<Vertex3dUVNormal(float u, float v)> point;
+};
+
+// A shape made of one or more surfaces, and the box around all of it.
+// Packed vertices are stored relative to the box, so it's decided before any vertex is made
+struct ProceduralMesh
+{
+    std::vector<ProceduralSurface> surfaces;
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+
+    size_t GetVertexCount() const;
+    size_t GetIndexCount() const;
+};
+
+// The shapes that used to be obj files in Assets, all centered on the origin
+// (the plane and terrain lie on y = 0, facing up, the torus lies flat)
+ProceduralMesh MakePlane(float width, float depth, unsigned int columns, unsigned int rows);
+ProceduralMesh MakeCube(float size, unsigned int segments);
+ProceduralMesh MakeSphere(float radius, unsigned int columns, unsigned int rows);
+ProceduralMesh MakeCylinder(float radius, float height, unsigned int columns, unsigned int rows);
+ProceduralMesh MakeCone(float radius, float height, unsigned int columns, unsigned int rows);
+ProceduralMesh MakeTorus(float majorRadius, float minorRadius, unsigned int columns, unsigned int rows);
+
+// A plane bent up and down by height(x, z), which has to stay between minHeight and maxHeight
+ProceduralMesh MakeTerrain(float width, float depth, unsigned int columns, unsigned int rows,
+                           std::function<float(float x, float z)> height, float minHeight, float maxHeight);
+
+// Makes every vertex and index of shape straight into vertices and indices: Vertex3dUVNormal,
+// or PackedVertex when packed, and indexSize bytes per index (see indexPacking.h). Each row of
+// each surface is made once, by one thread, blocks of rows are split across pool if it isn't nullptr.
+// Returns the radius of the sphere around the middle of the box that holds every vertex
+float GenerateMesh(const ProceduralMesh& shape, bool packed, void* vertices, void* indices, unsigned int indexSize, ThreadPool* pool);
+
+// Makes every shape at a few sizes, on one thread and across the pool, checks them,
+// and compares how long it takes against loading the obj files they replace
+void BenchmarkProceduralMeshes();
@@ -0,0 +1,340 @@
+/*
+Title: Blur Optimization VR
+File Name: renderState.cpp
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "renderState.h"
+#include "geometryArena.h"
+#include "mesh.h"
+#include "vertexPacking.h"
+#include <cstdio>
+#include <cstring>
+
+static const char* stateCallNames[StateCallCount] =
+{
+    "program", "active texture", "texture", "sampler", "framebuffer",
+    "viewport", "vertex array", "constant attribute", "uniform",
+};
+
+// This macro will help us make the attribute pointers
+// position, size, type, struct, element
+#define SetupAttribute(index, size, type, structure, element) \
+	glVertexAttribPointer(index, size, type, 0, sizeof(structure), (void*)offsetof(structure, element)); \
+
+// Same as above, for attributes where integers get turned into 0 to 1 (or -1 to 1) floats
+#define SetupNormalizedAttribute(index, size, type, structure, element) \
+	glVertexAttribPointer(index, size, type, 1, sizeof(structure), (void*)offsetof(structure, element)); \
+
+// Which of the two tracked texture targets
+static int TargetSlot(GLenum target)
+{
+    return target == GL_TEXTURE_2D_ARRAY ? 1 : 0;
+}
+
+RenderState::RenderState()
+{
+    Invalidate();
+    BeginFrame();
+
+    // Triangle lists never use the largest index of their size, so this only changes strips
+    if (PrimitiveRestartSupported())
+        glEnable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+}
+
+bool RenderState::PrimitiveRestartSupported()
+{
+    return GLEW_VERSION_4_3 || GLEW_ARB_ES3_compatibility;
+}
+
+void RenderState::UseProgram(GLuint program)
+{
+    if (m_known[StateProgram] && m_program == program)
+    {
+        m_skipped[StateProgram]++;
+        return;
+    }
+
+    glUseProgram(program);
+    m_program = program;
+    m_known[StateProgram] = true;
+    m_issued[StateProgram]++;
+}
+
+void RenderState::BindTexture(unsigned int unit, GLenum target, GLuint texture)
+{
+    int slot = TargetSlot(target);
+    if (unit < RenderStateTextureUnits && m_textureKnown[unit][slot] && m_textures[unit][slot] == texture)
+    {
+        m_skipped[StateTexture]++;
+        return;
+    }
+
+    // Only switch units when the bind actually happens
+    if (m_known[StateActiveTexture] && m_activeUnit == unit)
+        m_skipped[StateActiveTexture]++;
+    else
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        m_activeUnit = unit;
+        m_known[StateActiveTexture] = true;
+        m_issued[StateActiveTexture]++;
+    }
+
+    glBindTexture(target, texture);
+    m_issued[StateTexture]++;
+
+    if (unit < RenderStateTextureUnits)
+    {
+        m_textures[unit][slot] = texture;
+        m_textureKnown[unit][slot] = true;
+    }
+}
+
+void RenderState::BindSampler(unsigned int unit, GLuint sampler)
+{
+    if (unit < RenderStateTextureUnits && m_samplerKnown[unit] && m_samplers[unit] == sampler)
+    {
+        m_skipped[StateSampler]++;
+        return;
+    }
+
+    glBindSampler(unit, sampler);
+    m_issued[StateSampler]++;
+
+    if (unit < RenderStateTextureUnits)
+    {
+        m_samplers[unit] = sampler;
+        m_samplerKnown[unit] = true;
+    }
+}
+
+void RenderState::BindFramebuffer(GLuint framebuffer)
+{
+    if (m_known[StateFramebuffer] && m_framebuffer == framebuffer)
+    {
+        m_skipped[StateFramebuffer]++;
+        return;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    m_framebuffer = framebuffer;
+    m_known[StateFramebuffer] = true;
+    m_issued[StateFramebuffer]++;
+}
+
+void RenderState::SetViewport(float x, float y, float width, float height)
+{
+    float viewport[4] = { x, y, width, height };
+
+    bool same = true;
+    for (int i = 0; i < RenderStateViewports; i++)
+        same = same && m_viewportKnown[i] && memcmp(m_viewports[i], viewport, sizeof(viewport)) == 0;
+
+    if (same)
+    {
+        m_skipped[StateViewport]++;
+        return;
+    }
+
+    // glViewport sets every viewport, not just the first
+    glViewport((GLint)x, (GLint)y, (GLsizei)width, (GLsizei)height);
+    m_issued[StateViewport]++;
+
+    for (int i = 0; i < RenderStateViewports; i++)
+    {
+        memcpy(m_viewports[i], viewport, sizeof(viewport));
+        m_viewportKnown[i] = true;
+    }
+}
+
+void RenderState::SetViewportIndexed(unsigned int index, float x, float y, float width, float height)
+{
+    float viewport[4] = { x, y, width, height };
+    if (index < RenderStateViewports && m_viewportKnown[index] && memcmp(m_viewports[index], viewport, sizeof(viewport)) == 0)
+    {
+        m_skipped[StateViewport]++;
+        return;
+    }
+
+    glViewportIndexedf(index, x, y, width, height);
+    m_issued[StateViewport]++;
+
+    if (index < RenderStateViewports)
+    {
+        memcpy(m_viewports[index], viewport, sizeof(viewport));
+        m_viewportKnown[index] = true;
+    }
+}
+
+void RenderState::SetupFormat(VertexFormat format)
+{
+    GeometryArena& arena = GetGeometryArena();
+
+    if (m_formats[format] == 0)
+        glGenVertexArrays(1, &m_formats[format]);
+
+    // The element buffer and attribute pointers are saved in the vertex array object.
+    // Pointers start at offset 0, draws pick their mesh with a base vertex
+    glBindVertexArray(m_formats[format]);
+    glBindBuffer(GL_ARRAY_BUFFER, arena.GetVertexBuffer());
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena.GetIndexBuffer());
+
+    int attributeCount = 1;
+    switch (format)
+    {
+    case VertexFormatFull:
+        SetupAttribute(1, 2, GL_FLOAT, Vertex3dUVNormal, m_texCoord);
+        SetupAttribute(2, 3, GL_FLOAT, Vertex3dUVNormal, m_normal);
+        SetupAttribute(3, 3, GL_FLOAT, Vertex3dUVNormal, m_tangent);
+        attributeCount = 4;
+        // fall through, the position is the same as below
+    case VertexFormatFullPositions:
+        SetupAttribute(0, 3, GL_FLOAT, Vertex3dUVNormal, m_position);
+        break;
+
+    case VertexFormatPacked:
+        // The gpu unpacks these while reading them, the shader still gets floats
+        SetupAttribute(1, 2, GL_HALF_FLOAT, PackedVertex, m_texCoord);
+        SetupNormalizedAttribute(2, 4, GL_INT_2_10_10_10_REV, PackedVertex, m_normal);
+        SetupNormalizedAttribute(3, 4, GL_INT_2_10_10_10_REV, PackedVertex, m_tangent);
+        attributeCount = 4;
+        // fall through
+    case VertexFormatPackedPositions:
+        // Positions come out from 0 to 1 across the bounding box
+        SetupNormalizedAttribute(0, 3, GL_UNSIGNED_SHORT, PackedVertex, m_position);
+        break;
+
+    case VertexFormatPositionStream:
+        glVertexAttribPointer(0, 3, GL_FLOAT, 0, sizeof(glm::vec3), (void*)0);
+        break;
+
+    case VertexFormatPackedPositionStream:
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, 1, sizeof(PackedVertex::m_position), (void*)0);
+        break;
+
+    default:
+        break;
+    }
+
+    for (int i = 0; i < attributeCount; i++)
+        glEnableVertexAttribArray(i);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void RenderState::BindVertexFormat(VertexFormat format)
+{
+    // The arena made new buffers when it grew, every format has to point at the new ones
+    GeometryArena& arena = GetGeometryArena();
+    if (m_formatVertexBuffer != arena.GetVertexBuffer() || m_formatIndexBuffer != arena.GetIndexBuffer())
+    {
+        for (int i = 0; i < VertexFormatCount; i++)
+        {
+            if (m_formats[i] != 0)
+                SetupFormat((VertexFormat)i);
+        }
+        m_formatVertexBuffer = arena.GetVertexBuffer();
+        m_formatIndexBuffer = arena.GetIndexBuffer();
+        m_known[StateVertexArray] = false;
+    }
+
+    if (m_formats[format] == 0)
+    {
+        SetupFormat(format);
+        m_known[StateVertexArray] = false;
+    }
+
+    GLuint vertexArray = m_formats[format];
+    if (m_known[StateVertexArray] && m_vertexArray == vertexArray)
+    {
+        m_skipped[StateVertexArray]++;
+        return;
+    }
+
+    glBindVertexArray(vertexArray);
+    m_vertexArray = vertexArray;
+    m_known[StateVertexArray] = true;
+    m_issued[StateVertexArray]++;
+}
+
+void RenderState::SetConstantAttribute(unsigned int index, const glm::vec3& value)
+{
+    if (index < RenderStateConstantAttributes && m_attributeKnown[index] && m_constantAttributes[index] == value)
+    {
+        m_skipped[StateConstantAttribute]++;
+        return;
+    }
+
+    glVertexAttrib3f(index, value.x, value.y, value.z);
+    m_issued[StateConstantAttribute]++;
+
+    if (index < RenderStateConstantAttributes)
+    {
+        m_constantAttributes[index] = value;
+        m_attributeKnown[index] = true;
+    }
+}
+
+void RenderState::Count(RenderStateCall call, bool issued)
+{
+    if (issued)
+        m_issued[call]++;
+    else
+        m_skipped[call]++;
+}
+
+void RenderState::Invalidate()
+{
+    memset(m_known, 0, sizeof(m_known));
+    memset(m_textureKnown, 0, sizeof(m_textureKnown));
+    memset(m_samplerKnown, 0, sizeof(m_samplerKnown));
+    memset(m_viewportKnown, 0, sizeof(m_viewportKnown));
+    memset(m_attributeKnown, 0, sizeof(m_attributeKnown));
+}
+
+void RenderState::BeginFrame()
+{
+    memset(m_issued, 0, sizeof(m_issued));
+    memset(m_skipped, 0, sizeof(m_skipped));
+}
+
+void RenderState::PrintStats()
+{
+    unsigned int totalIssued = 0;
+    unsigned int totalSkipped = 0;
+
+    printf("%-20s %8s %8s\n", "state calls", "issued", "skipped");
+    for (int i = 0; i < StateCallCount; i++)
+    {
+        printf("%-20s %8u %8u\n", stateCallNames[i], m_issued[i], m_skipped[i]);
+        totalIssued += m_issued[i];
+        totalSkipped += m_skipped[i];
+    }
+    printf("%-20s %8u %8u (%.0f%% skipped)\n", "total", totalIssued, totalSkipped,
+        totalIssued + totalSkipped > 0 ? 100.0 * totalSkipped / (totalIssued + totalSkipped) : 0.0);
+}
+
+RenderState& GetRenderState()
+{
+    static RenderState state;
+    return state;
+}
@@ -0,0 +1,142 @@
+/*
+Title: Blur Optimization VR
+File Name: renderState.h
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "GL/glew.h"
+#include "glm/glm.hpp"
+
+// The kinds of gl calls RenderState keeps track of
+enum RenderStateCall
+{
+    StateProgram,           // glUseProgram
+    StateActiveTexture,     // glActiveTexture
+    StateTexture,           // glBindTexture
+    StateSampler,           // glBindSampler
+    StateFramebuffer,       // glBindFramebuffer
+    StateViewport,          // glViewport, glViewportIndexedf
+    StateVertexArray,       // glBindVertexArray
+    StateConstantAttribute, // glVertexAttrib3f
+    StateUniform,           // glUniform*, counted by Material
+    StateCallCount
+};
+
+// The ways vertices are laid out in the geometry arena, one vertex array object each
+enum VertexFormat
+{
+    VertexFormatFull,              // Vertex3dUVNormal, attributes 0 to 3
+    VertexFormatPacked,            // PackedVertex, attributes 0 to 3
+    VertexFormatFullPositions,     // Vertex3dUVNormal, only attribute 0
+    VertexFormatPackedPositions,   // PackedVertex, only attribute 0
+    VertexFormatPositionStream,    // 3 floats, only attribute 0
+    VertexFormatPackedPositionStream, // 4 unsigned shorts (the 4th unused), only attribute 0
+    VertexFormatCount
+};
+
+// Texture units and viewports that get tracked, anything past these goes straight to gl
+#define RenderStateTextureUnits 16
+#define RenderStateViewports 2
+#define RenderStateConstantAttributes 8
+
+// A thin layer over the gl calls that set state. It remembers what is bound,
+// and skips calls that wouldn't change anything. Every bind in the program
+// goes through here, so what it remembers is always what gl has.
+// If something does change gl state behind its back, call Invalidate.
+//
+// It also owns a vertex array object for every VertexFormat. Each one is set up
+// once, pointing at the geometry arena, so drawing a mesh is one VAO bind
+// (skipped when the format didn't change) instead of binding buffers,
+// four attribute pointers, and enabling and disabling four arrays.
+class RenderState
+{
+
+private:
+    GLuint m_program;
+    unsigned int m_activeUnit;
+    GLuint m_textures[RenderStateTextureUnits][2];
+    GLuint m_samplers[RenderStateTextureUnits];
+    GLuint m_framebuffer;
+    float m_viewports[RenderStateViewports][4];
+    GLuint m_vertexArray;
+    glm::vec3 m_constantAttributes[RenderStateConstantAttributes];
+
+    // Which of the above are known. Right after Invalidate, nothing is
+    bool m_known[StateCallCount];
+    bool m_textureKnown[RenderStateTextureUnits][2];
+    bool m_samplerKnown[RenderStateTextureUnits];
+    bool m_viewportKnown[RenderStateViewports];
+    bool m_attributeKnown[RenderStateConstantAttributes];
+
+    // The arrays, and the arena buffers they were set up with.
+    // If the arena grows its buffers change, and the arrays get set up again
+    GLuint m_formats[VertexFormatCount] = {};
+    GLuint m_formatVertexBuffer = 0;
+    GLuint m_formatIndexBuffer = 0;
+
+    // Calls made and skipped since BeginFrame
+    unsigned int m_issued[StateCallCount];
+    unsigned int m_skipped[StateCallCount];
+
+    // Sets up the vertex array object for a format, on the arena's buffers
+    void SetupFormat(VertexFormat format);
+
+public:
+    // Also turns on primitive restart at the largest index of each size, if the gpu
+    // has it, for meshes drawn as strips (see indexPacking.h)
+    RenderState();
+
+    // True if the gpu has GL_PRIMITIVE_RESTART_FIXED_INDEX (OpenGL 4.3 or ARB_ES3_compatibility)
+    static bool PrimitiveRestartSupported();
+
+    void UseProgram(GLuint program);
+
+    // Binds texture to unit. target is GL_TEXTURE_2D or GL_TEXTURE_2D_ARRAY
+    void BindTexture(unsigned int unit, GLenum target, GLuint texture);
+    void BindSampler(unsigned int unit, GLuint sampler);
+    void BindFramebuffer(GLuint framebuffer);
+
+    // Sets every viewport, like glViewport
+    void SetViewport(float x, float y, float width, float height);
+    void SetViewportIndexed(unsigned int index, float x, float y, float width, float height);
+
+    // Binds the vertex array object for a format, setting it up the first time
+    void BindVertexFormat(VertexFormat format);
+
+    // An attribute that isn't an array, every vertex reads the same value. See vertex.glsl
+    void SetConstantAttribute(unsigned int index, const glm::vec3& value);
+
+    // For calls RenderState doesn't make itself, but that should still be counted
+    void Count(RenderStateCall call, bool issued);
+
+    // Forgets everything, the next call of every kind goes to gl
+    void Invalidate();
+
+    // Starts counting calls again
+    void BeginFrame();
+
+    // Prints the calls made and skipped since BeginFrame
+    void PrintStats();
+};
+
+// One RenderState for the one gl context, created the first time it is asked for (after glewInit)
+RenderState& GetRenderState();
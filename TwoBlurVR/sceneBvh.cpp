@@ -0,0 +1,773 @@
+/*
+Title: Blur Optimization VR
+File Name: sceneBvh.cpp
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "sceneBvh.h"
+#include "glm/gtc/matrix_transform.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+// Build only tries splitting at the edges of this many equal slices of a node
+#define BvhBinCount 12
+
+// Leaves never hold more objects than this, even if the surface area heuristic would like them to
+#define BvhMaxLeafObjects 8
+
+// Cost of visiting a node, compared to testing one object's box
+#define BvhTraversalCost 1.0f
+
+// What a box test returns when the box is outside one of the planes
+#define BvhOutside 0x80u
+
+// A live eye in a query's plane masks, the low 6 bits are the planes that still need testing
+#define BvhEyeLive 0x40u
+
+static double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static float SurfaceArea(const glm::vec3& boxMin, const glm::vec3& boxMax)
+{
+    glm::vec3 size = boxMax - boxMin;
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+static float SurfaceArea(const BvhNode& node)
+{
+    return SurfaceArea(node.boundsMin, node.boundsMax);
+}
+
+// Tests a box against the planes of frustum set in planes. Returns the planes
+// the box still crosses, or BvhOutside if it's fully outside any of them
+static unsigned int TestBox(const CullFrustum& frustum, unsigned int planes, const glm::vec3& boxMin, const glm::vec3& boxMax)
+{
+    unsigned int crossing = planes;
+    for (int p = 0; p < 6; p++)
+    {
+        if ((planes & (1u << p)) == 0)
+            continue;
+
+        // The corners furthest along the plane's normal and furthest against it
+        glm::vec3 normal = glm::vec3(frustum.planes[p]);
+        glm::vec3 inner = glm::vec3(normal.x >= 0 ? boxMax.x : boxMin.x, normal.y >= 0 ? boxMax.y : boxMin.y, normal.z >= 0 ? boxMax.z : boxMin.z);
+        glm::vec3 outer = glm::vec3(normal.x >= 0 ? boxMin.x : boxMax.x, normal.y >= 0 ? boxMin.y : boxMax.y, normal.z >= 0 ? boxMin.z : boxMax.z);
+
+        if (glm::dot(normal, inner) + frustum.planes[p].w < 0)
+            return BvhOutside;
+        if (glm::dot(normal, outer) + frustum.planes[p].w >= 0)
+            crossing &= ~(1u << p);
+    }
+    return crossing;
+}
+
+// Tests a box against every live eye in masks (8 bits per eye), and returns the
+// masks the box's children should use. 0 means neither eye can see it
+static unsigned int TestEyes(const CullFrustum* frustums[2], unsigned int masks, const glm::vec3& boxMin, const glm::vec3& boxMax)
+{
+    unsigned int result = 0;
+    for (int eye = 0; eye < 2; eye++)
+    {
+        unsigned int mask = (masks >> (eye * 8)) & 0xFF;
+        if ((mask & BvhEyeLive) == 0)
+            continue;
+
+        // Boxes above this one were already fully inside this eye
+        if ((mask & 0x3F) != 0)
+        {
+            unsigned int crossing = TestBox(*frustums[eye], mask & 0x3F, boxMin, boxMax);
+            if (crossing == BvhOutside)
+                continue;
+            mask = BvhEyeLive | crossing;
+        }
+        result |= mask << (eye * 8);
+    }
+    return result;
+}
+
+void SceneBvh::Build(const std::vector<glm::vec3>& boxMins, const std::vector<glm::vec3>& boxMaxs)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    unsigned int count = (unsigned int)boxMins.size();
+    m_boxMin = boxMins;
+    m_boxMax = boxMaxs;
+    m_objectLeaf.assign(count, 0);
+    m_objects.resize(count);
+    for (unsigned int i = 0; i < count; i++)
+        m_objects[i] = i;
+
+    m_nodes.clear();
+    m_parents.clear();
+    if (count == 0)
+    {
+        m_dirty.clear();
+        return;
+    }
+
+    // A binary tree with a leaf per object has 2n - 1 nodes, so the list never has to grow
+    m_nodes.reserve(2 * count);
+    m_parents.reserve(2 * count);
+
+    BvhNode root;
+    root.first = 0;
+    root.count = count;
+    m_nodes.push_back(root);
+    m_parents.push_back(BvhNoParent);
+
+    std::vector<glm::vec3> centers(count);
+    for (unsigned int i = 0; i < count; i++)
+        centers[i] = (m_boxMin[i] + m_boxMax[i]) * 0.5f;
+
+    std::vector<unsigned int> stack;
+    stack.push_back(0);
+    while (!stack.empty())
+    {
+        unsigned int index = stack.back();
+        stack.pop_back();
+        Subdivide(index, centers, stack);
+    }
+
+    m_dirty.assign(m_nodes.size(), 0);
+    m_rotationCount = 0;
+    m_pendingUpdates = 0;
+    m_buildTime = MillisecondsSince(start);
+}
+
+void SceneBvh::Subdivide(unsigned int index, const std::vector<glm::vec3>& centers, std::vector<unsigned int>& stack)
+{
+    FitNode(index);
+
+    BvhNode& node = m_nodes[index];
+    unsigned int first = node.first;
+    unsigned int count = node.count;
+
+    for (unsigned int i = first; i < first + count; i++)
+        m_objectLeaf[m_objects[i]] = index;
+    if (count == 1)
+        return;
+
+    // Objects go into slices by the center of their box
+    glm::vec3 centerMin = glm::vec3(FLT_MAX);
+    glm::vec3 centerMax = glm::vec3(-FLT_MAX);
+    for (unsigned int i = first; i < first + count; i++)
+    {
+        centerMin = glm::min(centerMin, centers[m_objects[i]]);
+        centerMax = glm::max(centerMax, centers[m_objects[i]]);
+    }
+
+    // Small nodes don't need as many slices as they have objects, and most nodes are small
+    int binCount = (int)glm::min(count, (unsigned int)BvhBinCount);
+    glm::vec3 extent = centerMax - centerMin;
+    glm::vec3 scale;
+    for (int axis = 0; axis < 3; axis++)
+        scale[axis] = extent[axis] > 0 ? binCount / extent[axis] : 0;
+
+    // Fill the slices of all three axes in one pass, so each object's box is only read once
+    unsigned int binCounts[3][BvhBinCount] = {};
+    glm::vec3 binMin[3][BvhBinCount];
+    glm::vec3 binMax[3][BvhBinCount];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        for (int b = 0; b < binCount; b++)
+        {
+            binMin[axis][b] = glm::vec3(FLT_MAX);
+            binMax[axis][b] = glm::vec3(-FLT_MAX);
+        }
+    }
+
+    for (unsigned int i = first; i < first + count; i++)
+    {
+        unsigned int object = m_objects[i];
+        glm::vec3 boxMin = m_boxMin[object];
+        glm::vec3 boxMax = m_boxMax[object];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            int b = glm::min((int)((centers[object][axis] - centerMin[axis]) * scale[axis]), binCount - 1);
+            binCounts[axis][b]++;
+            binMin[axis][b] = glm::min(binMin[axis][b], boxMin);
+            binMax[axis][b] = glm::max(binMax[axis][b], boxMax);
+        }
+    }
+
+    int bestAxis = -1;
+    int bestSplit = 0;
+    float bestCost = FLT_MAX;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if (extent[axis] <= 0)
+            continue;
+
+        // Sweep from the right, then from the left, so every split's cost
+        // is the area of each side times how many objects it holds
+        float rightArea[BvhBinCount];
+        unsigned int rightCount[BvhBinCount];
+        glm::vec3 sweepMin = glm::vec3(FLT_MAX);
+        glm::vec3 sweepMax = glm::vec3(-FLT_MAX);
+        unsigned int sweepCount = 0;
+        for (int b = binCount - 1; b > 0; b--)
+        {
+            sweepCount += binCounts[axis][b];
+            sweepMin = glm::min(sweepMin, binMin[axis][b]);
+            sweepMax = glm::max(sweepMax, binMax[axis][b]);
+            rightCount[b] = sweepCount;
+            rightArea[b] = sweepCount > 0 ? SurfaceArea(sweepMin, sweepMax) : 0;
+        }
+
+        sweepMin = glm::vec3(FLT_MAX);
+        sweepMax = glm::vec3(-FLT_MAX);
+        sweepCount = 0;
+        for (int split = 1; split < binCount; split++)
+        {
+            sweepCount += binCounts[axis][split - 1];
+            sweepMin = glm::min(sweepMin, binMin[axis][split - 1]);
+            sweepMax = glm::max(sweepMax, binMax[axis][split - 1]);
+            if (sweepCount == 0 || rightCount[split] == 0)
+                continue;
+
+            float cost = SurfaceArea(sweepMin, sweepMax) * sweepCount + rightArea[split] * rightCount[split];
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = split;
+            }
+        }
+    }
+
+    unsigned int leftCount = 0;
+    if (bestAxis >= 0)
+    {
+        // Stay a leaf if testing every object is cheaper than splitting
+        float splitCost = BvhTraversalCost + bestCost / SurfaceArea(node);
+        if (splitCost >= count && count <= BvhMaxLeafObjects)
+            return;
+
+        float axisMin = centerMin[bestAxis];
+        float axisScale = scale[bestAxis];
+        unsigned int* middle = std::partition(&m_objects[first], &m_objects[first] + count, [&](unsigned int object)
+        {
+            return glm::min((int)((centers[object][bestAxis] - axisMin) * axisScale), binCount - 1) < bestSplit;
+        });
+        leftCount = (unsigned int)(middle - &m_objects[first]);
+    }
+    else
+    {
+        // Every center is in the same place, there's nowhere to split
+        if (count <= BvhMaxLeafObjects)
+            return;
+        leftCount = count / 2;
+    }
+
+    unsigned int left = (unsigned int)m_nodes.size();
+    BvhNode child;
+    child.first = first;
+    child.count = leftCount;
+    m_nodes.push_back(child);
+    child.first = first + leftCount;
+    child.count = count - leftCount;
+    m_nodes.push_back(child);
+    m_parents.push_back(index);
+    m_parents.push_back(index);
+
+    // The list was reserved, so node is still valid
+    node.first = left;
+    node.count = 0;
+
+    stack.push_back(left);
+    stack.push_back(left + 1);
+}
+
+void SceneBvh::FitNode(unsigned int index)
+{
+    BvhNode& node = m_nodes[index];
+    if (node.count > 0)
+    {
+        node.boundsMin = glm::vec3(FLT_MAX);
+        node.boundsMax = glm::vec3(-FLT_MAX);
+        for (unsigned int i = node.first; i < node.first + node.count; i++)
+        {
+            node.boundsMin = glm::min(node.boundsMin, m_boxMin[m_objects[i]]);
+            node.boundsMax = glm::max(node.boundsMax, m_boxMax[m_objects[i]]);
+        }
+    }
+    else
+    {
+        const BvhNode& left = m_nodes[node.first];
+        const BvhNode& right = m_nodes[node.first + 1];
+        node.boundsMin = glm::min(left.boundsMin, right.boundsMin);
+        node.boundsMax = glm::max(left.boundsMax, right.boundsMax);
+    }
+}
+
+void SceneBvh::UpdateObject(unsigned int object, const glm::vec3& boxMin, const glm::vec3& boxMax)
+{
+    m_boxMin[object] = boxMin;
+    m_boxMax[object] = boxMax;
+    m_pendingUpdates++;
+
+    // Mark the way up to the root, until it meets a path another update already marked
+    unsigned int index = m_objectLeaf[object];
+    while (index != BvhNoParent && !m_dirty[index])
+    {
+        m_dirty[index] = 1;
+        index = m_parents[index];
+    }
+}
+
+void SceneBvh::UpdateObject(unsigned int object, const glm::mat4& worldMatrix, const glm::vec3& boxMin, const glm::vec3& boxMax)
+{
+    glm::vec3 worldMin, worldMax;
+    TransformBox(worldMatrix, boxMin, boxMax, worldMin, worldMax);
+    UpdateObject(object, worldMin, worldMax);
+}
+
+void SceneBvh::Refit()
+{
+    if (m_nodes.empty() || !m_dirty[0])
+        return;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    RefitNode(0);
+    m_refitTime = MillisecondsSince(start);
+    m_refitUpdates = m_pendingUpdates;
+    m_pendingUpdates = 0;
+}
+
+void SceneBvh::RefitNode(unsigned int index)
+{
+    m_dirty[index] = 0;
+
+    // Children first, so this node's box is made from boxes that are already right
+    if (m_nodes[index].count == 0)
+    {
+        unsigned int left = m_nodes[index].first;
+        if (m_dirty[left])
+            RefitNode(left);
+        if (m_dirty[left + 1])
+            RefitNode(left + 1);
+    }
+
+    FitNode(index);
+    if (m_rotations && m_nodes[index].count == 0)
+        Rotate(index);
+}
+
+void SceneBvh::Rotate(unsigned int index)
+{
+    // Try swapping each child with each of its sibling's children. Everything under
+    // this node stays under it, so its box is the same, but the sibling's box changes
+    unsigned int children = m_nodes[index].first;
+    float bestSaving = 0;
+    unsigned int bestChild = 0, bestGrandchild = 0, bestSibling = 0;
+
+    for (unsigned int side = 0; side < 2; side++)
+    {
+        unsigned int child = children + side;
+        unsigned int sibling = children + 1 - side;
+        const BvhNode& siblingNode = m_nodes[sibling];
+        if (siblingNode.count > 0)
+            continue;
+
+        float before = SurfaceArea(siblingNode);
+        for (unsigned int g = 0; g < 2; g++)
+        {
+            // The sibling would hold child and the grandchild that isn't moving
+            const BvhNode& staying = m_nodes[siblingNode.first + 1 - g];
+            float after = SurfaceArea(glm::min(m_nodes[child].boundsMin, staying.boundsMin), glm::max(m_nodes[child].boundsMax, staying.boundsMax));
+            if (before - after > bestSaving)
+            {
+                bestSaving = before - after;
+                bestChild = child;
+                bestGrandchild = siblingNode.first + g;
+                bestSibling = sibling;
+            }
+        }
+    }
+
+    if (bestSaving <= 0)
+        return;
+
+    SwapNodes(bestChild, bestGrandchild);
+    FitNode(bestSibling);
+    m_rotationCount++;
+}
+
+void SceneBvh::SwapNodes(unsigned int a, unsigned int b)
+{
+    // Parents belong to a place in the list, not to a node, so they stay. Whatever
+    // points up at the two nodes that moved has to point at their new places
+    std::swap(m_nodes[a], m_nodes[b]);
+
+    unsigned int moved[2] = { a, b };
+    for (unsigned int index : moved)
+    {
+        const BvhNode& node = m_nodes[index];
+        if (node.count > 0)
+        {
+            for (unsigned int i = node.first; i < node.first + node.count; i++)
+                m_objectLeaf[m_objects[i]] = index;
+        }
+        else
+        {
+            m_parents[node.first] = index;
+            m_parents[node.first + 1] = index;
+        }
+    }
+}
+
+void SceneBvh::SetRotations(bool rotations)
+{
+    m_rotations = rotations;
+}
+
+unsigned int SceneBvh::Query(const CullFrustum& frustum1, const CullFrustum& frustum2,
+                             std::vector<unsigned int>& objects, std::vector<unsigned char>* eyes) const
+{
+    objects.clear();
+    if (eyes != nullptr)
+        eyes->clear();
+    if (m_nodes.empty())
+        return 0;
+
+    const CullFrustum* frustums[2] = { &frustum1, &frustum2 };
+
+    // Each entry is a node, and the planes its parent still crossed for each eye
+    struct Entry
+    {
+        unsigned int index;
+        unsigned int masks;
+    };
+    std::vector<Entry> stack;
+    stack.reserve(64);
+    stack.push_back({ 0, (BvhEyeLive | 0x3F) | ((BvhEyeLive | 0x3F) << 8) });
+
+    while (!stack.empty())
+    {
+        Entry entry = stack.back();
+        stack.pop_back();
+        const BvhNode& node = m_nodes[entry.index];
+
+        unsigned int masks = TestEyes(frustums, entry.masks, node.boundsMin, node.boundsMax);
+        if (masks == 0)
+            continue;
+
+        if (node.count == 0)
+        {
+            stack.push_back({ node.first + 1, masks });
+            stack.push_back({ node.first, masks });
+            continue;
+        }
+
+        for (unsigned int i = node.first; i < node.first + node.count; i++)
+        {
+            unsigned int object = m_objects[i];
+            unsigned int objectMasks = TestEyes(frustums, masks, m_boxMin[object], m_boxMax[object]);
+            if (objectMasks == 0)
+                continue;
+
+            objects.push_back(object);
+            if (eyes != nullptr)
+                eyes->push_back((unsigned char)(((objectMasks & BvhEyeLive) ? 1 : 0) | ((objectMasks & (BvhEyeLive << 8)) ? 2 : 0)));
+        }
+    }
+
+    return (unsigned int)objects.size();
+}
+
+// How far along the ray it enters the box (0 if it starts inside), or FLT_MAX if it misses
+static float RayBox(const glm::vec3& origin, const glm::vec3& inverseDirection, const glm::vec3& boxMin, const glm::vec3& boxMax)
+{
+    glm::vec3 t1 = (boxMin - origin) * inverseDirection;
+    glm::vec3 t2 = (boxMax - origin) * inverseDirection;
+    glm::vec3 tEnter = glm::min(t1, t2);
+    glm::vec3 tExit = glm::max(t1, t2);
+    float enter = glm::max(glm::max(tEnter.x, tEnter.y), glm::max(tEnter.z, 0.0f));
+    float exit = glm::min(glm::min(tExit.x, tExit.y), tExit.z);
+    return enter <= exit ? enter : FLT_MAX;
+}
+
+int SceneBvh::Pick(const glm::vec3& origin, const glm::vec3& direction, float& distance) const
+{
+    int picked = -1;
+    distance = FLT_MAX;
+    if (m_nodes.empty())
+        return picked;
+
+    glm::vec3 inverseDirection = 1.0f / direction;
+
+    // Nodes are visited nearest first, and skipped once something closer than them was hit
+    struct Entry
+    {
+        unsigned int index;
+        float enter;
+    };
+    std::vector<Entry> stack;
+    stack.reserve(64);
+
+    float rootEnter = RayBox(origin, inverseDirection, m_nodes[0].boundsMin, m_nodes[0].boundsMax);
+    if (rootEnter != FLT_MAX)
+        stack.push_back({ 0, rootEnter });
+
+    while (!stack.empty())
+    {
+        Entry entry = stack.back();
+        stack.pop_back();
+        if (entry.enter >= distance)
+            continue;
+
+        const BvhNode& node = m_nodes[entry.index];
+        if (node.count > 0)
+        {
+            for (unsigned int i = node.first; i < node.first + node.count; i++)
+            {
+                unsigned int object = m_objects[i];
+                float enter = RayBox(origin, inverseDirection, m_boxMin[object], m_boxMax[object]);
+                if (enter < distance)
+                {
+                    distance = enter;
+                    picked = (int)object;
+                }
+            }
+            continue;
+        }
+
+        Entry left = { node.first, RayBox(origin, inverseDirection, m_nodes[node.first].boundsMin, m_nodes[node.first].boundsMax) };
+        Entry right = { node.first + 1, RayBox(origin, inverseDirection, m_nodes[node.first + 1].boundsMin, m_nodes[node.first + 1].boundsMax) };
+        if (left.enter > right.enter)
+            std::swap(left, right);
+
+        if (right.enter < distance)
+            stack.push_back(right);
+        if (left.enter < distance)
+            stack.push_back(left);
+    }
+
+    return picked;
+}
+
+unsigned int SceneBvh::GetObjectCount() const
+{
+    return (unsigned int)m_objects.size();
+}
+
+unsigned int SceneBvh::GetNodeCount() const
+{
+    return (unsigned int)m_nodes.size();
+}
+
+unsigned int SceneBvh::GetRotationCount() const
+{
+    return m_rotationCount;
+}
+
+unsigned int SceneBvh::GetDepth() const
+{
+    if (m_nodes.empty())
+        return 0;
+
+    unsigned int depth = 0;
+    std::vector<std::pair<unsigned int, unsigned int>> stack(1, std::make_pair(0u, 1u));
+    while (!stack.empty())
+    {
+        std::pair<unsigned int, unsigned int> entry = stack.back();
+        stack.pop_back();
+        depth = glm::max(depth, entry.second);
+
+        const BvhNode& node = m_nodes[entry.first];
+        if (node.count == 0)
+        {
+            stack.push_back(std::make_pair(node.first, entry.second + 1));
+            stack.push_back(std::make_pair(node.first + 1, entry.second + 1));
+        }
+    }
+    return depth;
+}
+
+float SceneBvh::GetCost() const
+{
+    if (m_nodes.empty())
+        return 0;
+
+    // How likely a node is to be visited is its area over the root's area
+    float rootArea = SurfaceArea(m_nodes[0]);
+    float cost = 0;
+    for (const BvhNode& node : m_nodes)
+        cost += SurfaceArea(node) / rootArea * (node.count > 0 ? (float)node.count : BvhTraversalCost);
+    return cost;
+}
+
+void SceneBvh::PrintStats() const
+{
+    printf("Scene bvh: %u objects, %u nodes of %u bytes, depth %u, cost %.1f\n",
+        GetObjectCount(), GetNodeCount(), (unsigned int)sizeof(BvhNode), GetDepth(), GetCost());
+    printf("Scene bvh: built in %.3f ms, last refit %.3f ms for %u moved objects, %u rotations since the build\n",
+        m_buildTime, m_refitTime, m_refitUpdates, m_rotationCount);
+}
+
+// Best time of repeats runs of work, in milliseconds
+template <typename F>
+static double TimeBvh(int repeats, F work)
+{
+    double best = 1e30;
+    for (int r = 0; r < repeats; r++)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        work();
+        best = glm::min(best, MillisecondsSince(start));
+    }
+    return best;
+}
+
+void BenchmarkSceneBvh()
+{
+    const unsigned int objectCount = 100000;
+    const unsigned int movingCount = objectCount / 10;
+    const int frames = 100;
+    const int repeats = 10;
+
+    // The same eyes and objects as BenchmarkFrustumCulling
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 0.9f, 0.1f, 100.0f);
+    glm::mat4 view1 = glm::lookAt(glm::vec3(-0.03f, 0, 0), glm::vec3(0, 0, -10), glm::vec3(0, 1, 0));
+    glm::mat4 view2 = glm::lookAt(glm::vec3(0.03f, 0, 0), glm::vec3(0, 0, -10), glm::vec3(0, 1, 0));
+    CullFrustum eye1 = MakeFrustum(projection * view1);
+    CullFrustum eye2 = MakeFrustum(projection * view2);
+    CullFrustum stereo = MakeStereoFrustum(projection * view1, projection * view2);
+
+    std::mt19937 random(12345);
+    std::uniform_real_distribution<float> position(-120.0f, 120.0f);
+    std::uniform_real_distribution<float> size(0.2f, 4.0f);
+    std::uniform_real_distribution<float> fraction(0.2f, 0.57f);
+    std::uniform_real_distribution<float> speed(-1.0f, 1.0f);
+
+    CullBounds bounds;
+    std::vector<glm::vec3> boxMins, boxMaxs;
+    for (unsigned int i = 0; i < objectCount; i++)
+    {
+        glm::vec3 center = glm::vec3(position(random), position(random), position(random));
+        float radius = size(random);
+        glm::vec3 extent = glm::vec3(fraction(random), fraction(random), fraction(random)) * radius;
+        bounds.Add(center, radius, center - extent, center + extent);
+        boxMins.push_back(center - extent);
+        boxMaxs.push_back(center + extent);
+    }
+
+    SceneBvh bvh;
+    double buildMs = TimeBvh(repeats, [&]() { bvh.Build(boxMins, boxMaxs); });
+
+    // One walk for both eyes, against flat SIMD culling with the stereo frustum
+    std::vector<unsigned int> found;
+    std::vector<unsigned char> eyes;
+    std::vector<unsigned char> visible(objectCount), visible1(objectCount), visible2(objectCount);
+    double queryMs = TimeBvh(repeats, [&]() { bvh.Query(eye1, eye2, found, &eyes); });
+    double flatMs = TimeBvh(repeats, [&]() { CullObjects(stereo, bounds, visible.data()); });
+
+    // Nothing either eye can see may be missing from the query
+    CullObjectsScalar(eye1, bounds, visible1.data());
+    CullObjectsScalar(eye2, bounds, visible2.data());
+    std::vector<unsigned char> inQuery(objectCount, 0);
+    for (unsigned int object : found)
+        inQuery[object] = 1;
+    unsigned int missed = 0, eitherEye = 0;
+    for (unsigned int i = 0; i < objectCount; i++)
+    {
+        bool seen = visible1[i] || visible2[i];
+        eitherEye += seen;
+        missed += seen && !inQuery[i];
+    }
+
+    // Picking, against testing every box
+    const int rayCount = 1000;
+    std::vector<glm::vec3> rays;
+    for (int r = 0; r < rayCount; r++)
+        rays.push_back(glm::normalize(glm::vec3(speed(random), speed(random), speed(random))));
+    std::vector<float> pickDistances(rayCount), linearDistances(rayCount, FLT_MAX);
+    double pickMs = TimeBvh(repeats, [&]()
+    {
+        for (int r = 0; r < rayCount; r++)
+            bvh.Pick(glm::vec3(0), rays[r], pickDistances[r]);
+    });
+    double linearPickMs = TimeBvh(1, [&]()
+    {
+        for (int r = 0; r < rayCount; r++)
+        {
+            glm::vec3 inverseDirection = 1.0f / rays[r];
+            for (unsigned int i = 0; i < objectCount; i++)
+                linearDistances[r] = glm::min(linearDistances[r], RayBox(glm::vec3(0), inverseDirection, boxMins[i], boxMaxs[i]));
+        }
+    });
+    int pickMismatches = 0;
+    for (int r = 0; r < rayCount; r++)
+        pickMismatches += pickDistances[r] != linearDistances[r];
+
+    // A tenth of the objects drift for a while, refitting each frame with and without rotations
+    std::vector<glm::vec3> velocities;
+    for (unsigned int i = 0; i < movingCount; i++)
+        velocities.push_back(glm::vec3(speed(random), speed(random), speed(random)));
+
+    SceneBvh rotating = bvh;
+    SceneBvh refitOnly = bvh;
+    refitOnly.SetRotations(false);
+    float freshCost = bvh.GetCost();
+    double rotatingMs = 0, refitOnlyMs = 0;
+    for (int frame = 0; frame < frames; frame++)
+    {
+        for (unsigned int i = 0; i < movingCount; i++)
+        {
+            boxMins[i] += velocities[i];
+            boxMaxs[i] += velocities[i];
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (unsigned int i = 0; i < movingCount; i++)
+            rotating.UpdateObject(i, boxMins[i], boxMaxs[i]);
+        rotating.Refit();
+        rotatingMs += MillisecondsSince(start);
+
+        start = std::chrono::high_resolution_clock::now();
+        for (unsigned int i = 0; i < movingCount; i++)
+            refitOnly.UpdateObject(i, boxMins[i], boxMaxs[i]);
+        refitOnly.Refit();
+        refitOnlyMs += MillisecondsSince(start);
+    }
+
+    SceneBvh rebuilt;
+    rebuilt.Build(boxMins, boxMaxs);
+    double rotatingQueryMs = TimeBvh(repeats, [&]() { rotating.Query(eye1, eye2, found); });
+    double refitOnlyQueryMs = TimeBvh(repeats, [&]() { refitOnly.Query(eye1, eye2, found); });
+    double rebuiltQueryMs = TimeBvh(repeats, [&]() { rebuilt.Query(eye1, eye2, found); });
+
+    printf("\nScene bvh benchmark (%u objects, nodes of %u bytes, best of %d)\n", objectCount, (unsigned int)sizeof(BvhNode), repeats);
+    printf("build                              %10.3f ms, %u nodes, depth %u, cost %.1f\n", buildMs, bvh.GetNodeCount(), bvh.GetDepth(), freshCost);
+    printf("query both eyes, one walk          %10.3f ms, %u found (%u seen by an eye, %u missed)\n", queryMs, (unsigned int)eyes.size(), eitherEye, missed);
+    printf("flat SIMD stereo frustum           %10.3f ms\n", flatMs);
+    printf("%d picks                         %10.3f ms (%.3f ms testing every box, %d disagree)\n", rayCount, pickMs, linearPickMs, pickMismatches);
+    printf("\nAfter %u objects moved for %d frames\n", movingCount, frames);
+    printf("%-34s %10s %10s %10s\n", "", "refit ms", "query ms", "cost");
+    printf("%-34s %10.3f %10.3f %10.1f (%u rotations)\n", "refit with rotations", rotatingMs / frames, rotatingQueryMs, rotating.GetCost(), rotating.GetRotationCount());
+    printf("%-34s %10.3f %10.3f %10.1f\n", "refit only", refitOnlyMs / frames, refitOnlyQueryMs, refitOnly.GetCost());
+    printf("%-34s %10.3f %10.3f %10.1f\n", "rebuilt from scratch", buildMs, rebuiltQueryMs, rebuilt.GetCost());
+}
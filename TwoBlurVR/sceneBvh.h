@@ -0,0 +1,140 @@
+/*
+Title: Blur Optimization VR
+File Name: sceneBvh.h
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "glm/glm.hpp"
+#include "frustumCulling.h"
+#include <vector>
+
+// Parent of the root
+#define BvhNoParent 0xFFFFFFFFu
+
+// One node of the tree, 32 bytes, so two fit in a cache line.
+// The two children of a node are always next to each other in the node list,
+// so an interior node only needs to know where the first one is
+struct BvhNode
+{
+    glm::vec3 boundsMin;
+
+    // Interior nodes: the left child, the right child is first + 1.
+    // Leaves: the first of their objects in the object list
+    unsigned int first;
+
+    glm::vec3 boundsMax;
+
+    // How many objects a leaf holds, 0 for interior nodes
+    unsigned int count;
+};
+
+// A bounding volume hierarchy over the world space boxes of the scene's objects.
+//
+// Build splits objects where the surface area heuristic says it's cheapest,
+// only trying the edges of a few equal slices of each node (binned SAH).
+// The nodes live in one flat list, in the order they were made.
+//
+// Objects that move get a new box with UpdateObject, and Refit then only walks the
+// nodes above them, growing or shrinking their boxes. On the way back up, it also
+// swaps a node's child with a grandchild when that makes a smaller box (a tree rotation,
+// Kopta et al., "Fast, Effective BVH Updates for Animated Scenes"), so the tree doesn't
+// get worse and worse as things move away from where they were when it was built.
+//
+// Query finds what both eyes can see in one walk of the tree. Each eye keeps the planes
+// a node's box still crosses, and children only get tested against those, so once a box
+// is fully inside an eye's frustum nothing below it is tested again for that eye.
+class SceneBvh
+{
+
+private:
+    std::vector<BvhNode> m_nodes;
+    std::vector<unsigned int> m_parents;
+
+    // Object indices, in the order leaves hold them
+    std::vector<unsigned int> m_objects;
+
+    // World space box of each object, and the leaf it's in
+    std::vector<glm::vec3> m_boxMin;
+    std::vector<glm::vec3> m_boxMax;
+    std::vector<unsigned int> m_objectLeaf;
+
+    // Nodes above an object that moved, that Refit still has to fix
+    std::vector<unsigned char> m_dirty;
+
+    bool m_rotations = true;
+    unsigned int m_rotationCount = 0;
+
+    // Objects updated since the last Refit, and how many the last Refit fixed
+    unsigned int m_pendingUpdates = 0;
+    unsigned int m_refitUpdates = 0;
+    double m_buildTime = 0;
+    double m_refitTime = 0;
+
+    void Subdivide(unsigned int index, const std::vector<glm::vec3>& centers, std::vector<unsigned int>& stack);
+    void RefitNode(unsigned int index);
+    void Rotate(unsigned int index);
+    void SwapNodes(unsigned int a, unsigned int b);
+    void FitNode(unsigned int index);
+
+public:
+    // Builds the tree over every object's world space box, object i is boxMins[i] to boxMaxs[i]
+    void Build(const std::vector<glm::vec3>& boxMins, const std::vector<glm::vec3>& boxMaxs);
+
+    // Gives an object a new world space box. The tree doesn't change until Refit
+    void UpdateObject(unsigned int object, const glm::vec3& boxMin, const glm::vec3& boxMax);
+
+    // Same, from the object's model space box and its world matrix
+    void UpdateObject(unsigned int object, const glm::mat4& worldMatrix, const glm::vec3& boxMin, const glm::vec3& boxMax);
+
+    // Fixes the boxes of every node above an updated object, rotating as it goes
+    void Refit();
+
+    // Rotations are on by default, turning them off makes Refit only fix boxes
+    void SetRotations(bool rotations);
+
+    // Every object whose box might be inside either frustum, in one walk of the tree.
+    // If eyes isn't null, it gets a byte for each object, with bit 0 set if the first
+    // eye can see it, and bit 1 if the second can. Returns how many were found
+    unsigned int Query(const CullFrustum& frustum1, const CullFrustum& frustum2,
+                       std::vector<unsigned int>& objects, std::vector<unsigned char>* eyes = nullptr) const;
+
+    // The object whose box the ray enters first, or -1 if it misses them all.
+    // distance gets how far along direction that is
+    int Pick(const glm::vec3& origin, const glm::vec3& direction, float& distance) const;
+
+    unsigned int GetObjectCount() const;
+    unsigned int GetNodeCount() const;
+    unsigned int GetDepth() const;
+
+    // Rotations Refit has made since the tree was built
+    unsigned int GetRotationCount() const;
+
+    // Surface area heuristic cost of the whole tree, visiting a node costs the
+    // same as testing one object. Lower is better
+    float GetCost() const;
+
+    void PrintStats() const;
+};
+
+// Times building, refitting and querying a tree of 100k objects while
+// some of them move, with and without rotations, against flat culling
+void BenchmarkSceneBvh();
@@ -22,6 +22,7 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "shaderProgram.h"
+#include "renderState.h"
 
 ShaderProgram::ShaderProgram()
 {
@@ -38,6 +39,9 @@ ShaderProgram::~ShaderProgram()
 
     if (m_fragmentShader != nullptr)
         m_fragmentShader->DecRefCount();
+
+    if (m_computeShader != nullptr)
+        m_computeShader->DecRefCount();
 }
 
 GLuint ShaderProgram::GetGLShaderProgram()
@@ -57,6 +61,9 @@ void ShaderProgram::AttachShader(Shader* shader)
         case GL_FRAGMENT_SHADER:
             currentShader = &m_fragmentShader;
             break;
+        case GL_COMPUTE_SHADER:
+            currentShader = &m_computeShader;
+            break;
         default:
             return;
     }
@@ -93,12 +100,22 @@ void ShaderProgram::Bind()
         m_programBuilt = true;
     }
 
-    glUseProgram(m_shaderProgram);
+    GetRenderState().UseProgram(m_shaderProgram);
 }
 
 void ShaderProgram::Unbind()
 {
-    glUseProgram(0);
+    GetRenderState().UseProgram(0);
+}
+
+Material* ShaderProgram::GetUniformOwner()
+{
+    return m_uniformOwner;
+}
+
+void ShaderProgram::SetUniformOwner(Material* material)
+{
+    m_uniformOwner = material;
 }
 
 void ShaderProgram::IncRefCount()
@@ -25,6 +25,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "shader.h"
 #include <iostream>
 
+class Material;
+
 // Wraps opengl shader program functionality
 class ShaderProgram
 {
@@ -34,6 +36,9 @@ private:
     Shader* m_vertexShader = nullptr;
     Shader* m_fragmentShader = nullptr;
 
+    // Compute programs have only this one
+    Shader* m_computeShader = nullptr;
+
     // GL index for shader program
     GLuint m_shaderProgram;
 
@@ -43,6 +48,10 @@ private:
     // Reference Counter
     unsigned int m_refCount = 0;
 
+    // The material whose uniforms were last uploaded to this program.
+    // Uniforms stay in the program, so that material doesn't need to upload them again
+    Material* m_uniformOwner = nullptr;
+
 public:
     ShaderProgram();
     ~ShaderProgram();
@@ -50,6 +59,8 @@ public:
     void AttachShader(Shader* shader);
     void Bind();
     void Unbind();
+    Material* GetUniformOwner();
+    void SetUniformOwner(Material* material);
     void IncRefCount();
     void DecRefCount();
 };
\ No newline at end of file
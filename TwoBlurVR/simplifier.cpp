@@ -0,0 +1,437 @@
+/*
+Title: Blur Optimization VR
+File Name: simplifier.cpp
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "simplifier.h"
+#include "meshOptimizer.h"
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+// A position with no collapse pending
+#define NoCollapse 0xFFFFFFFF
+
+// The sum of squared distances to a set of planes, as a symmetric 4x4 matrix.
+// Only the upper half is stored. Doubles, since the values get very small
+// and big meshes add up thousands of planes.
+struct Quadric
+{
+    double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+    double a11 = 0, a12 = 0, a13 = 0;
+    double a22 = 0, a23 = 0;
+    double a33 = 0;
+
+    // Total area of the planes, so the error can be turned back into a distance
+    double weight = 0;
+};
+
+// Adds the plane through point with this unit normal, counting it weight times
+static void AddPlane(Quadric& q, glm::dvec3 normal, glm::dvec3 point, double weight)
+{
+    double d = -glm::dot(normal, point);
+
+    q.a00 += weight * normal.x * normal.x;
+    q.a01 += weight * normal.x * normal.y;
+    q.a02 += weight * normal.x * normal.z;
+    q.a03 += weight * normal.x * d;
+    q.a11 += weight * normal.y * normal.y;
+    q.a12 += weight * normal.y * normal.z;
+    q.a13 += weight * normal.y * d;
+    q.a22 += weight * normal.z * normal.z;
+    q.a23 += weight * normal.z * d;
+    q.a33 += weight * d * d;
+    q.weight += weight;
+}
+
+static void AddQuadric(Quadric& q, const Quadric& other)
+{
+    q.a00 += other.a00; q.a01 += other.a01; q.a02 += other.a02; q.a03 += other.a03;
+    q.a11 += other.a11; q.a12 += other.a12; q.a13 += other.a13;
+    q.a22 += other.a22; q.a23 += other.a23;
+    q.a33 += other.a33;
+    q.weight += other.weight;
+}
+
+// Weighted sum of squared distances from p to the planes
+static double EvaluateQuadric(const Quadric& q, glm::vec3 position)
+{
+    double x = position.x, y = position.y, z = position.z;
+
+    double result =
+        q.a00 * x * x + 2 * q.a01 * x * y + 2 * q.a02 * x * z + 2 * q.a03 * x +
+        q.a11 * y * y + 2 * q.a12 * y * z + 2 * q.a13 * y +
+        q.a22 * z * z + 2 * q.a23 * z +
+        q.a33;
+
+    // Rounding can make it slightly negative
+    return result > 0 ? result : 0;
+}
+
+// Moving the position "from" onto the position "to"
+struct Collapse
+{
+    unsigned int from;
+    unsigned int to;
+    double error;
+
+    bool operator<(const Collapse& other) const { return error < other.error; }
+};
+
+// A key for an edge between two positions, the same in both directions
+static unsigned long long EdgeKey(unsigned int a, unsigned int b)
+{
+    if (a > b)
+        std::swap(a, b);
+    return ((unsigned long long)a << 32) | b;
+}
+
+// Finds what each copy of "from" turns into when it moves onto "to", and writes it to remap.
+// Each uv at "from" has to be on a triangle with "to", and that has to give one uv at "to",
+// otherwise the collapse would stretch the texture across a seam and we return false.
+static bool MapCollapse(unsigned int from, unsigned int to,
+                        const std::vector<unsigned int>& indices, const std::vector<unsigned int>& positionVertex,
+                        const std::vector<unsigned int>& uvVertex,
+                        const unsigned int* triangles, unsigned int triangleCount,
+                        std::vector<unsigned int>& remap)
+{
+    // Small, so a list is faster than a map. Pairs of (uv at from, vertex at to)
+    unsigned int pairs[64][2];
+    unsigned int pairCount = 0;
+
+    for (unsigned int i = 0; i < triangleCount; i++)
+    {
+        const unsigned int* corners = &indices[triangles[i] * 3];
+        unsigned int fromVertex = NoCollapse;
+        unsigned int toVertex = NoCollapse;
+        for (int j = 0; j < 3; j++)
+        {
+            if (positionVertex[corners[j]] == from)
+                fromVertex = corners[j];
+            else if (positionVertex[corners[j]] == to)
+                toVertex = corners[j];
+        }
+
+        if (toVertex == NoCollapse)
+            continue;
+
+        unsigned int fromUV = uvVertex[fromVertex];
+        bool found = false;
+        for (unsigned int k = 0; k < pairCount; k++)
+        {
+            if (pairs[k][0] == fromUV)
+            {
+                // The same uv would have to go to two different places
+                if (uvVertex[pairs[k][1]] != uvVertex[toVertex])
+                    return false;
+                found = true;
+            }
+        }
+
+        if (!found)
+        {
+            if (pairCount == 64)
+                return false;
+            pairs[pairCount][0] = fromUV;
+            pairs[pairCount][1] = toVertex;
+            pairCount++;
+        }
+    }
+
+    // Every copy of "from" needs somewhere to go. Check them all
+    // before writing anything, remap is shared by the whole pass
+    for (int write = 0; write < 2; write++)
+    {
+        for (unsigned int i = 0; i < triangleCount; i++)
+        {
+            const unsigned int* corners = &indices[triangles[i] * 3];
+            for (int j = 0; j < 3; j++)
+            {
+                if (positionVertex[corners[j]] != from)
+                    continue;
+
+                unsigned int k = 0;
+                while (k < pairCount && pairs[k][0] != uvVertex[corners[j]])
+                    k++;
+                if (k == pairCount)
+                    return false;
+
+                if (write)
+                    remap[corners[j]] = pairs[k][1];
+            }
+        }
+    }
+
+    return true;
+}
+
+// True if moving "from" onto "to" turns any of its triangles over
+static bool CollapseFlips(unsigned int from, unsigned int to,
+                          const std::vector<Vertex3dUVNormal>& vertices, const std::vector<unsigned int>& indices,
+                          const std::vector<unsigned int>& positionVertex,
+                          const unsigned int* triangles, unsigned int triangleCount)
+{
+    glm::vec3 target = vertices[to].m_position;
+
+    for (unsigned int i = 0; i < triangleCount; i++)
+    {
+        const unsigned int* corners = &indices[triangles[i] * 3];
+        glm::vec3 before[3];
+        glm::vec3 after[3];
+        bool removed = false;
+
+        for (int j = 0; j < 3; j++)
+        {
+            unsigned int position = positionVertex[corners[j]];
+            before[j] = vertices[corners[j]].m_position;
+            after[j] = position == from ? target : before[j];
+            removed = removed || position == to;
+        }
+
+        // Triangles on the edge disappear, they can't flip
+        if (removed)
+            continue;
+
+        glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+        glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+        if (glm::dot(normalBefore, normalAfter) <= 0)
+            return true;
+    }
+
+    return false;
+}
+
+float SimplifyMesh(const std::vector<Vertex3dUVNormal>& vertices, const std::vector<unsigned int>& indices, size_t targetIndexCount, std::vector<unsigned int>& result)
+{
+    result = indices;
+
+    // Everything below works on positions, each one is named by the first vertex with it
+    std::vector<unsigned int> positionVertex;
+    FindSharedPositions(vertices, positionVertex);
+
+    // Vertices with the same position and the same uv are on the same side of any seam.
+    // Those are named by the first vertex with that position and uv.
+    std::vector<unsigned int> uvVertex(vertices.size());
+    {
+        std::unordered_map<unsigned long long, unsigned int> seen;
+        for (unsigned int v = 0; v < vertices.size(); v++)
+        {
+            unsigned int bits[2];
+            memcpy(bits, &vertices[v].m_texCoord, sizeof(bits));
+            unsigned long long key = ((unsigned long long)positionVertex[v] << 32) ^ bits[0] ^ ((unsigned long long)bits[1] << 16);
+
+            auto found = seen.find(key);
+            if (found != seen.end() && positionVertex[found->second] == positionVertex[v] && vertices[found->second].m_texCoord == vertices[v].m_texCoord)
+                uvVertex[v] = found->second;
+            else
+                uvVertex[v] = seen[key] = v;
+        }
+    }
+
+    // Some models have every triangle twice. Those edges look like
+    // surfaces crossing, which would lock everything, so drop the copies.
+    {
+        std::unordered_map<unsigned long long, unsigned int> seen;
+        size_t write = 0;
+        for (size_t i = 0; i + 2 < result.size(); i += 3)
+        {
+            // Start from the smallest position, so the same triangle
+            // always gives the same key, but a flipped one doesn't
+            unsigned int p[3] = { positionVertex[result[i]], positionVertex[result[i + 1]], positionVertex[result[i + 2]] };
+            int first = (p[0] < p[1] && p[0] < p[2]) ? 0 : (p[1] < p[2] ? 1 : 2);
+            unsigned long long a = p[first], b = p[(first + 1) % 3], c = p[(first + 2) % 3];
+            unsigned long long key = (a * 2654435761ull) ^ (b << 21) ^ (c << 42) ^ c;
+
+            auto found = seen.find(key);
+            if (found != seen.end())
+            {
+                const unsigned int* other = &result[found->second];
+                unsigned int q[3] = { positionVertex[other[0]], positionVertex[other[1]], positionVertex[other[2]] };
+                int otherFirst = (q[0] < q[1] && q[0] < q[2]) ? 0 : (q[1] < q[2] ? 1 : 2);
+                if (q[otherFirst] == a && q[(otherFirst + 1) % 3] == b && q[(otherFirst + 2) % 3] == c)
+                    continue;
+            }
+            else
+            {
+                seen[key] = (unsigned int)write;
+            }
+
+            result[write++] = result[i];
+            result[write++] = result[i + 1];
+            result[write++] = result[i + 2];
+        }
+        result.resize(write);
+    }
+
+    // Every position starts with the planes of the triangles around it
+    std::vector<Quadric> quadrics(vertices.size());
+    for (size_t i = 0; i + 2 < result.size(); i += 3)
+    {
+        glm::dvec3 p0 = glm::dvec3(vertices[result[i]].m_position);
+        glm::dvec3 p1 = glm::dvec3(vertices[result[i + 1]].m_position);
+        glm::dvec3 p2 = glm::dvec3(vertices[result[i + 2]].m_position);
+        glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+        double length = glm::length(normal);
+        if (length <= 0)
+            continue;
+
+        for (int j = 0; j < 3; j++)
+            AddPlane(quadrics[positionVertex[result[i + j]]], normal / length, p0, length * 0.5);
+    }
+
+    // Positions on an edge with only one triangle (a hole, or the edge of an open
+    // mesh) or more than two (where surfaces cross) are never moved
+    std::vector<bool> locked(vertices.size(), false);
+    {
+        std::unordered_map<unsigned long long, int> edgeTriangles;
+        for (size_t i = 0; i + 2 < result.size(); i += 3)
+        {
+            for (int j = 0; j < 3; j++)
+                edgeTriangles[EdgeKey(positionVertex[result[i + j]], positionVertex[result[i + (j + 1) % 3]])]++;
+        }
+
+        for (auto& edge : edgeTriangles)
+        {
+            if (edge.second != 2)
+            {
+                locked[edge.first >> 32] = true;
+                locked[edge.first & 0xFFFFFFFF] = true;
+            }
+        }
+    }
+
+    double maxError = 0;
+    std::vector<unsigned int> remap(vertices.size());
+    std::vector<bool> touched(vertices.size());
+    std::vector<unsigned int> firstTriangle(vertices.size() + 1);
+    std::vector<unsigned int> positionTriangles;
+    std::vector<Collapse> collapses;
+
+    // Every pass finds the cheapest collapses that don't touch each other, and does them all
+    while (result.size() > targetIndexCount)
+    {
+        unsigned int triangleCount = (unsigned int)(result.size() / 3);
+
+        // Which triangles touch each position.
+        // Position p's triangles are positionTriangles[firstTriangle[p]] up to firstTriangle[p + 1]
+        std::fill(firstTriangle.begin(), firstTriangle.end(), 0);
+        for (unsigned int i = 0; i < triangleCount * 3; i++)
+            firstTriangle[positionVertex[result[i]] + 1]++;
+        for (unsigned int v = 0; v < vertices.size(); v++)
+            firstTriangle[v + 1] += firstTriangle[v];
+
+        positionTriangles.resize(triangleCount * 3);
+        std::vector<unsigned int> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+        for (unsigned int i = 0; i < triangleCount * 3; i++)
+            positionTriangles[fill[positionVertex[result[i]]]++] = i / 3;
+
+        // Both directions of every edge, cheapest first
+        collapses.clear();
+        for (unsigned int i = 0; i < triangleCount * 3; i++)
+        {
+            unsigned int from = positionVertex[result[i]];
+            unsigned int to = positionVertex[result[i - i % 3 + (i + 1) % 3]];
+            if (from == to || locked[from])
+                continue;
+
+            Quadric q = quadrics[from];
+            AddQuadric(q, quadrics[to]);
+            double error = q.weight > 0 ? EvaluateQuadric(q, vertices[to].m_position) / q.weight : 0;
+
+            Collapse collapse = { from, to, error };
+            collapses.push_back(collapse);
+
+            // The other direction
+            if (!locked[to])
+            {
+                error = q.weight > 0 ? EvaluateQuadric(q, vertices[from].m_position) / q.weight : 0;
+                Collapse reverse = { to, from, error };
+                collapses.push_back(reverse);
+            }
+        }
+        std::sort(collapses.begin(), collapses.end());
+
+        for (unsigned int v = 0; v < vertices.size(); v++)
+            remap[v] = v;
+        std::fill(touched.begin(), touched.end(), false);
+
+        size_t remaining = result.size();
+        int collapseCount = 0;
+
+        for (const Collapse& collapse : collapses)
+        {
+            if (remaining <= targetIndexCount)
+                break;
+
+            // Triangles around this collapse already changed in this pass,
+            // the costs and the adjacency we have for them are out of date
+            if (touched[collapse.from] || touched[collapse.to])
+                continue;
+
+            const unsigned int* triangles = &positionTriangles[firstTriangle[collapse.from]];
+            unsigned int count = firstTriangle[collapse.from + 1] - firstTriangle[collapse.from];
+
+            if (CollapseFlips(collapse.from, collapse.to, vertices, result, positionVertex, triangles, count))
+                continue;
+
+            if (!MapCollapse(collapse.from, collapse.to, result, positionVertex, uvVertex, triangles, count, remap))
+                continue;
+
+            // Nothing around "from" can change again until the next pass
+            for (unsigned int i = 0; i < count; i++)
+            {
+                const unsigned int* corners = &result[triangles[i] * 3];
+                for (int j = 0; j < 3; j++)
+                {
+                    touched[positionVertex[corners[j]]] = true;
+                    if (positionVertex[corners[j]] == collapse.to)
+                        remaining -= 3;
+                }
+            }
+
+            AddQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+            maxError = std::max(maxError, collapse.error);
+            collapseCount++;
+        }
+
+        if (collapseCount == 0)
+            break;
+
+        // Move the vertices, and drop the triangles that have no area now
+        size_t write = 0;
+        for (size_t i = 0; i + 2 < result.size(); i += 3)
+        {
+            unsigned int a = remap[result[i]];
+            unsigned int b = remap[result[i + 1]];
+            unsigned int c = remap[result[i + 2]];
+            if (positionVertex[a] == positionVertex[b] || positionVertex[b] == positionVertex[c] || positionVertex[a] == positionVertex[c])
+                continue;
+
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+
+    return (float)sqrt(maxError);
+}
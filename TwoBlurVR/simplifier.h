@@ -0,0 +1,47 @@
+/*
+Title: Blur Optimization VR
+File Name: simplifier.h
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "mesh.h"
+#include <vector>
+
+// Makes a version of a mesh with fewer triangles, for drawing it far away.
+//
+// This is a quadric error metric simplifier (Garland and Heckbert). Every position
+// remembers the planes of the triangles around it. Moving a position off those planes
+// is what makes the mesh look different, so the cost of collapsing an edge (moving one
+// end onto the other) is the sum of squared distances to those planes.
+// The cheapest edges are collapsed first, until the mesh is small enough.
+//
+// Positions are only ever moved onto other existing vertices, so the vertex buffer
+// doesn't change and every level of detail can share it.
+//
+// Vertices at the same position with different uvs (a uv seam) can only collapse
+// along the seam, with every copy moving together. Otherwise the texture would
+// tear open along the seam. Vertices on the edge of an open mesh are never moved.
+//
+// Fills result with the new index buffer, and returns the largest distance any
+// surface moved, in model space units. It may not reach targetIndexCount if
+// the seams and edges don't leave enough to collapse.
+float SimplifyMesh(const std::vector<Vertex3dUVNormal>& vertices, const std::vector<unsigned int>& indices, size_t targetIndexCount, std::vector<unsigned int>& result);
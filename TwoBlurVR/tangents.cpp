@@ -0,0 +1,266 @@
+/*
+Title: Blur Optimization VR
+File Name: tangents.cpp
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tangents.h"
+#include "objLoader.h"
+#include <chrono>
+#include <cstdio>
+#include <cmath>
+#include <cfloat>
+#include <cstring>
+
+// A triangle whose uvs span less area than this has no tangent.
+// Dividing by anything smaller blows the tangent up past what a float can normalize.
+#define MinUVArea 1e-12f
+
+// Each thread gets at least this many triangles
+#define TrianglesPerThread 4096
+
+void CalculateTangentsScalar(std::vector<Vertex3dUVNormal>& vertices, const std::vector<unsigned int>& indices)
+{
+    // Tangents are calculated per face, so we loop over our vertices one face at a time...
+    for (unsigned int i = 0; i < indices.size(); i += 3)
+    {
+        Vertex3dUVNormal& v0 = vertices[indices[i]];
+        Vertex3dUVNormal& v1 = vertices[indices[i + 1]];
+        Vertex3dUVNormal& v2 = vertices[indices[i + 2]];
+
+        // Subtract to get the vector between our first vertex, and the other two
+        glm::vec3 edge1 = v1.m_position - v0.m_position;
+        glm::vec3 edge2 = v2.m_position - v0.m_position;
+
+        // calculate corresponding vectors in texture space
+        glm::vec2 tex1 = glm::vec2(v1.m_texCoord.x - v0.m_texCoord.x, v2.m_texCoord.x - v0.m_texCoord.x);
+        glm::vec2 tex2 = glm::vec2(v1.m_texCoord.y - v0.m_texCoord.y, v2.m_texCoord.y - v0.m_texCoord.y);
+
+        // calculate the inverse of the determinant of those two vectors as a matrix?
+        float f = 1.0f / (tex1.x * tex2.y - tex1.y * tex2.x);
+
+        glm::vec3 tangent;
+
+        // scale the components of our vectors to get a tangent vector
+        tangent.x = f * (tex2.y * edge1.x - tex2.x * edge2.x);
+        tangent.y = f * (tex2.y * edge1.y - tex2.x * edge2.y);
+        tangent.z = f * (tex2.y * edge1.z - tex2.x * edge2.z);
+
+        v0.m_tangent += tangent;
+        v1.m_tangent += tangent;
+        v2.m_tangent += tangent;
+    }
+
+    for (unsigned int i = 0; i < vertices.size(); i++)
+    {
+        vertices[i].m_tangent = glm::normalize(vertices[i].m_tangent);
+    }
+}
+
+// Adds the tangents of triangles first up to end into a running total per vertex.
+// Vertex v's total is the glm::vec3 at sums + v * stride bytes, so the totals can be
+// the vertices' own m_tangent values, or a separate array.
+static void AddTriangleTangents(const std::vector<Vertex3dUVNormal>& vertices, const std::vector<unsigned int>& indices,
+                                size_t first, size_t end, char* sums, size_t stride)
+{
+    for (size_t i = first; i < end; i++)
+    {
+        const unsigned int* corners = &indices[i * 3];
+        const Vertex3dUVNormal& v0 = vertices[corners[0]];
+        const Vertex3dUVNormal& v1 = vertices[corners[1]];
+        const Vertex3dUVNormal& v2 = vertices[corners[2]];
+
+        // calculate corresponding vectors in texture space, and
+        // the inverse of the determinant of those two vectors as a matrix
+        float tex1x = v1.m_texCoord.x - v0.m_texCoord.x;
+        float tex1y = v2.m_texCoord.x - v0.m_texCoord.x;
+        float tex2x = v1.m_texCoord.y - v0.m_texCoord.y;
+        float tex2y = v2.m_texCoord.y - v0.m_texCoord.y;
+        float determinant = tex1x * tex2y - tex1y * tex2x;
+
+        // No uv area, no tangent
+        if (!(fabsf(determinant) > MinUVArea))
+            continue;
+        float f = 1.0f / determinant;
+
+        glm::vec3 edge1 = v1.m_position - v0.m_position;
+        glm::vec3 edge2 = v2.m_position - v0.m_position;
+        glm::vec3 tangent = f * (tex2y * edge1 - tex2x * edge2);
+
+        *(glm::vec3*)(sums + corners[0] * stride) += tangent;
+        *(glm::vec3*)(sums + corners[1] * stride) += tangent;
+        *(glm::vec3*)(sums + corners[2] * stride) += tangent;
+    }
+}
+
+// Normalizes a summed tangent. If there's nothing to normalize (every triangle
+// had no uv area, or they cancelled out), any direction along the surface will do.
+static glm::vec3 FinishTangent(glm::vec3 sum, glm::vec3 normal)
+{
+    float lengthSquared = glm::dot(sum, sum);
+    if (lengthSquared > 0 && lengthSquared <= FLT_MAX)
+        return sum * glm::inversesqrt(lengthSquared);
+
+    // Cross the normal with whichever axis it is least like
+    glm::vec3 axis = fabsf(normal.x) < 0.9f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+    glm::vec3 tangent = glm::cross(normal, axis);
+    lengthSquared = glm::dot(tangent, tangent);
+    return lengthSquared > 0 ? tangent * glm::inversesqrt(lengthSquared) : glm::vec3(1, 0, 0);
+}
+
+void CalculateTangentsParallel(std::vector<Vertex3dUVNormal>& vertices, const std::vector<unsigned int>& indices, ThreadPool& pool)
+{
+    size_t triangleCount = indices.size() / 3;
+    size_t vertexCount = vertices.size();
+    if (vertexCount == 0)
+        return;
+
+    // Small meshes aren't worth waking the other threads for
+    int threads = (int)glm::max((size_t)1, glm::min((size_t)pool.GetThreadCount(), triangleCount / TrianglesPerThread));
+
+    // The first thread adds straight into the vertices,
+    // every other thread gets its own set of totals
+    std::vector<glm::vec3> sums(vertexCount * (threads - 1));
+
+    pool.ParallelFor(threads, [&](int thread)
+    {
+        size_t first = triangleCount * thread / threads;
+        size_t end = triangleCount * (thread + 1) / threads;
+
+        if (thread == 0)
+            AddTriangleTangents(vertices, indices, first, end, (char*)&vertices[0].m_tangent, sizeof(Vertex3dUVNormal));
+        else
+            AddTriangleTangents(vertices, indices, first, end, (char*)&sums[vertexCount * (thread - 1)], sizeof(glm::vec3));
+    });
+
+    // Add the sets together and normalize, each thread takes a slice of the vertices
+    pool.ParallelFor(threads, [&](int thread)
+    {
+        size_t first = vertexCount * thread / threads;
+        size_t end = vertexCount * (thread + 1) / threads;
+
+        for (size_t v = first; v < end; v++)
+        {
+            glm::vec3 sum = vertices[v].m_tangent;
+            for (int t = 0; t < threads - 1; t++)
+                sum += sums[vertexCount * t + v];
+
+            vertices[v].m_tangent = FinishTangent(sum, vertices[v].m_normal);
+        }
+    });
+}
+
+// Best time of a few runs, in milliseconds. Each run starts from the untouched vertices
+template <typename Function>
+static double TimeTangents(const std::vector<Vertex3dUVNormal>& original, std::vector<Vertex3dUVNormal>& result, int repeats, Function function)
+{
+    double best = 1e30;
+    for (int i = 0; i < repeats; i++)
+    {
+        result = original;
+        auto start = std::chrono::high_resolution_clock::now();
+        function(result);
+        double ms = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count() * 1000.0;
+        best = glm::min(best, ms);
+    }
+    return best;
+}
+
+// Makes a flat grid of quads, with the uvs squashed to nothing on every 50th row
+// so there are some triangles with no uv area
+static void MakeTangentGrid(int size, std::vector<Vertex3dUVNormal>& vertices, std::vector<unsigned int>& indices)
+{
+    vertices.clear();
+    indices.clear();
+
+    for (int y = 0; y <= size; y++)
+    {
+        for (int x = 0; x <= size; x++)
+        {
+            float v = (y % 50 == 0) ? 0.0f : (float)y / size;
+            vertices.push_back(Vertex3dUVNormal(glm::vec3(x, sinf(x * 0.1f), y), glm::vec2((float)x / size, v), glm::vec3(0, 1, 0), glm::vec3()));
+        }
+    }
+
+    for (int y = 0; y < size; y++)
+    {
+        for (int x = 0; x < size; x++)
+        {
+            unsigned int corner = y * (size + 1) + x;
+            unsigned int quad[6] = { corner, corner + size + 1, corner + 1, corner + 1, corner + size + 1, corner + size + 2 };
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+}
+
+void BenchmarkTangents()
+{
+    const char* files[] =
+    {
+        "../Assets/car.3Dobj",      "../Assets/dog.3Dobj",      "../Assets/dragon.3Dobj",
+        "../Assets/gun.3Dobj",      "../Assets/helix.3Dobj",    "../Assets/kitten.3Dobj",
+        "../Assets/sphere.3Dobj",   "../Assets/torus.3Dobj",    "generated grid",
+    };
+
+    ThreadPool& pool = GetSharedThreadPool();
+    const int repeats = 10;
+
+    printf("\nTangent benchmark (best of %d, %d threads)\n", repeats, pool.GetThreadCount());
+    // The new version on just this thread, to separate what the zero area checks cost from the threading gains
+    ThreadPool singleThread(0);
+
+    printf("%-26s %10s %10s %10s %10s %8s %10s %12s\n", "file", "triangles", "old ms", "1 thread", "all", "speedup", "NaN (old)", "max diff deg");
+
+    for (const char* file : files)
+    {
+        std::vector<Vertex3dUVNormal> vertices;
+        std::vector<unsigned int> indices;
+
+        if (strcmp(file, "generated grid") == 0)
+            MakeTangentGrid(1000, vertices, indices);
+        else if (!LoadObjMapped(file, vertices, indices, true, nullptr))
+            continue;
+
+        std::vector<Vertex3dUVNormal> oldResult, newResult;
+        double oldMs = TimeTangents(vertices, oldResult, repeats, [&](std::vector<Vertex3dUVNormal>& v) { CalculateTangentsScalar(v, indices); });
+        double singleMs = TimeTangents(vertices, newResult, repeats, [&](std::vector<Vertex3dUVNormal>& v) { CalculateTangentsParallel(v, indices, singleThread); });
+        double newMs = TimeTangents(vertices, newResult, repeats, [&](std::vector<Vertex3dUVNormal>& v) { CalculateTangentsParallel(v, indices, pool); });
+
+        // Compare wherever the old loop gave a real answer
+        int oldNaNs = 0;
+        float maxDegrees = 0;
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            glm::vec3 a = oldResult[i].m_tangent;
+            glm::vec3 b = newResult[i].m_tangent;
+            if (!std::isfinite(a.x) || !std::isfinite(a.y) || !std::isfinite(a.z))
+            {
+                oldNaNs++;
+                continue;
+            }
+
+            float cosine = glm::clamp(glm::dot(a, b), -1.0f, 1.0f);
+            maxDegrees = glm::max(maxDegrees, glm::degrees(acosf(cosine)));
+        }
+
+        printf("%-26s %10d %10.3f %10.3f %10.3f %7.2fx %10d %12.4f\n", file, (int)(indices.size() / 3), oldMs, singleMs, newMs, oldMs / newMs, oldNaNs, maxDegrees);
+    }
+}
@@ -0,0 +1,52 @@
+/*
+Title: Blur Optimization VR
+File Name: tangents.h
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "mesh.h"
+#include "threadPool.h"
+#include <vector>
+
+// Tangents point along the u direction of the texture, on the surface of the mesh.
+// The normal map's x axis is this direction, so it's needed to light normal maps.
+//
+// Each triangle's tangent comes from how its uvs change across its edges.
+// A vertex's tangent is the sum of the tangents of every triangle using it, normalized.
+//
+// The vertices' m_tangent values should start at zero.
+
+// The original loop from Mesh::CalculateTangents, one triangle at a time, kept to compare against.
+// Triangles with no uv area divide by zero, and give their vertices inf or NaN tangents.
+void CalculateTangentsScalar(std::vector<Vertex3dUVNormal>& vertices, const std::vector<unsigned int>& indices);
+
+// Same result, split across the thread pool. On one thread it's a little slower than
+// the original loop (the checks below aren't free), so any gain comes from the threads.
+// Every thread adds its triangles into its own copy of the tangents, then the copies
+// are added together (also in parallel), so no two threads ever write the same vertex.
+// Triangles with no uv area are skipped, and a vertex that ends up with no tangent
+// gets one perpendicular to its normal, so there are never NaNs.
+void CalculateTangentsParallel(std::vector<Vertex3dUVNormal>& vertices, const std::vector<unsigned int>& indices, ThreadPool& pool);
+
+// Times both versions on every model in Assets, and on a large generated grid,
+// and checks they give the same tangents
+void BenchmarkTangents();
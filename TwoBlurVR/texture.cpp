@@ -22,6 +22,7 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "texture.h"
+#include "renderState.h"
 
 // use the same sampler for every texture
 GLuint sampler;
@@ -41,10 +42,10 @@ Texture::Texture(char* filePath)
 		glGenSamplers(1, &sampler);
 
 	// Bind our texture.
-	glBindTexture(GL_TEXTURE_2D, m_texture);
+	GetRenderState().BindTexture(0, GL_TEXTURE_2D, m_texture);
 
 	// Bind our sampler.
-	glBindSampler(m_texture, sampler);
+	GetRenderState().BindSampler(m_texture, sampler);
 
 	// Fill our openGL side texture object.
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, FreeImage_GetWidth(bitmap32), FreeImage_GetHeight(bitmap32),
@@ -67,7 +68,7 @@ Texture::Texture(char* filePath)
 	glGenerateMipmap(GL_TEXTURE_2D);
 
 	// Unbind the texture.
-	glBindTexture(GL_TEXTURE_2D, 0);
+	GetRenderState().BindTexture(0, GL_TEXTURE_2D, 0);
 
 	// We can unload the images now that the texture data has been buffered with opengl
 	FreeImage_Unload(bitmap);
@@ -78,6 +79,9 @@ Texture::Texture(char* filePath)
 Texture::~Texture()
 {
     glDeleteTextures(1, &m_texture);
+
+    // Deleting a texture unbinds it everywhere, and its name can be handed out again
+    GetRenderState().Invalidate();
 }
 
 void Texture::IncRefCount()
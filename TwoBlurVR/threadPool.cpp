@@ -0,0 +1,169 @@
+/*
+Title: Blur Optimization VR
+File Name: threadPool.cpp
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "threadPool.h"
+#include <atomic>
+#include <memory>
+
+ThreadPool::ThreadPool(int workerCount)
+{
+    if (workerCount < 0)
+    {
+        // hardware_concurrency can return 0 if it doesn't know
+        int cores = (int)std::thread::hardware_concurrency();
+        workerCount = cores > 1 ? cores - 1 : 1;
+    }
+
+    for (int i = 0; i < workerCount; i++)
+        m_workers.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+    // Wake every worker up and tell them to quit
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wakeUp.notify_all();
+
+    for (size_t i = 0; i < m_workers.size(); i++)
+        m_workers[i].join();
+}
+
+int ThreadPool::GetThreadCount()
+{
+    return (int)m_workers.size() + 1;
+}
+
+void ThreadPool::WorkerLoop()
+{
+    while (true)
+    {
+        std::function<void()> job;
+
+        // sleep until there is a job, or we are told to stop
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeUp.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+
+            if (m_jobs.empty())
+                return;
+
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+
+        job();
+    }
+}
+
+bool ThreadPool::RunOneJob()
+{
+    std::function<void()> job;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_jobs.empty())
+            return false;
+
+        job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+    }
+
+    job();
+    return true;
+}
+
+void ThreadPool::ParallelFor(int count, std::function<void(int)> job)
+{
+    if (count <= 0)
+        return;
+
+    // With only one job there is nothing to share, just do it here
+    if (count == 1)
+    {
+        job(0);
+        return;
+    }
+
+    // Everything the jobs need to tell us when they are all finished
+    struct Batch
+    {
+        std::atomic<int> remaining;
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+    std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+    batch->remaining = count;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (int i = 0; i < count; i++)
+        {
+            m_jobs.push_back([batch, &job, i]
+            {
+                job(i);
+
+                // the last job to finish wakes up the thread that is waiting
+                if (--batch->remaining == 0)
+                {
+                    std::lock_guard<std::mutex> batchLock(batch->mutex);
+                    batch->done.notify_all();
+                }
+            });
+        }
+    }
+    m_wakeUp.notify_all();
+
+    // Help out until the queue is empty, then wait for the stragglers
+    while (batch->remaining > 0)
+    {
+        if (!RunOneJob())
+        {
+            std::unique_lock<std::mutex> lock(batch->mutex);
+            batch->done.wait(lock, [&batch] { return batch->remaining == 0; });
+        }
+    }
+}
+
+std::future<void> ThreadPool::Submit(std::function<void()> job)
+{
+    std::shared_ptr<std::packaged_task<void()>> task = std::make_shared<std::packaged_task<void()>>(job);
+    std::future<void> result = task->get_future();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push_back([task] { (*task)(); });
+    }
+    m_wakeUp.notify_one();
+
+    return result;
+}
+
+ThreadPool& GetSharedThreadPool()
+{
+    // C++11 makes sure this is only created once, even if two threads ask at the same time
+    static ThreadPool pool(-1);
+    return pool;
+}
@@ -0,0 +1,73 @@
+/*
+Title: Blur Optimization VR
+File Name: threadPool.h
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+
+// A small pool of worker threads.
+// Creating a thread is slow, so we make them once at startup,
+// and then hand them jobs whenever we have work that can be split up.
+class ThreadPool
+{
+
+private:
+    std::vector<std::thread> m_workers;
+
+    // Jobs waiting for a worker, protected by m_mutex
+    std::deque<std::function<void()>> m_jobs;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    bool m_stopping = false;
+
+    // What every worker thread runs until the pool is destroyed
+    void WorkerLoop();
+
+    // Takes one job off the queue and runs it on this thread, returns false if there were none
+    bool RunOneJob();
+
+public:
+    // Makes workerCount worker threads, on top of the thread that hands out the jobs.
+    // A negative count makes one worker for every core except the one we are on.
+    ThreadPool(int workerCount);
+    ~ThreadPool();
+
+    // Number of threads that can work at once, including the calling thread
+    int GetThreadCount();
+
+    // Runs job(0) through job(count - 1) across the pool, and returns once all of them finish.
+    // The calling thread helps out instead of sleeping, so this can be called from inside a job.
+    void ParallelFor(int count, std::function<void(int)> job);
+
+    // Runs one job in the background, the future can be waited on to know when it finishes
+    std::future<void> Submit(std::function<void()> job);
+};
+
+// One pool that the whole program shares, created the first time it is asked for
+ThreadPool& GetSharedThreadPool();
@@ -30,6 +30,7 @@ Transform3D::Transform3D()
     m_rotation = glm::vec3();
     m_position = glm::vec3();
     m_matrix = m_inverseMatrix = glm::mat4();
+    m_version = 0;
 }
 
 float Transform3D::Scale()
@@ -51,36 +52,42 @@ void Transform3D::SetScale(float s)
 {
     m_scale = s;
     m_matrixDirty = m_inverseDirty = true;
+    m_version++;
 }
 
 void Transform3D::SetRotation(glm::vec3 r)
 {
     m_rotation = r;
     m_matrixDirty = m_inverseDirty = true;
+    m_version++;
 }
 
 void Transform3D::SetPosition(glm::vec3 v)
 {
     m_position = v;
     m_matrixDirty = m_inverseDirty = true;
+    m_version++;
 }
 
 void Transform3D::RotateX(float r)
 {
     m_rotation.x += r;
     m_matrixDirty = m_inverseDirty = true;
+    m_version++;
 }
 
 void Transform3D::RotateY(float r)
 {
     m_rotation.y += r;
     m_matrixDirty = m_inverseDirty = true;
+    m_version++;
 }
 
 void Transform3D::RotateZ(float r)
 {
     m_rotation.z += r;
     m_matrixDirty = m_inverseDirty = true;
+    m_version++;
 }
 
 
@@ -88,6 +95,7 @@ void Transform3D::Translate(glm::vec3 v)
 {
     m_position += v;
     m_matrixDirty = m_inverseDirty = true;
+    m_version++;
 }
 
 glm::mat4 Transform3D::GetMatrix()
@@ -247,3 +255,8 @@ glm::vec3 Transform3D::GetRight()
 
     return glm::vec3(right);
 }
+
+unsigned int Transform3D::GetVersion()
+{
+    return m_version;
+}
@@ -36,6 +36,9 @@ private:
     bool m_matrixDirty;
     bool m_inverseDirty;
 
+    // Goes up every time the transform changes
+    unsigned int m_version;
+
     glm::mat4 m_rotationMatrix;
     glm::mat4 m_matrix;
     glm::mat4 m_inverseMatrix;
@@ -70,4 +73,8 @@ public:
     glm::vec3 GetUp();
     glm::vec3 GetForward();
     glm::vec3 GetRight();
+
+    // Changes every time the transform does, so anything that keeps
+    // something computed from it can tell if that's out of date
+    unsigned int GetVersion();
 };
\ No newline at end of file
@@ -0,0 +1,129 @@
+/*
+Title: Blur Optimization VR
+File Name: vertexPacking.cpp
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "vertexPacking.h"
+#include "glm/gtc/packing.hpp"
+
+// Largest value a 16 bit normalized integer can hold, the gpu divides by this
+#define PositionSteps 65535.0f
+
+// Angle between two vectors in degrees, 0 if either one is zero length
+static float AngleBetween(glm::vec3 a, glm::vec3 b)
+{
+    float lengths = glm::length(a) * glm::length(b);
+    if (lengths <= 0)
+        return 0;
+
+    float cosine = glm::clamp(glm::dot(a, b) / lengths, -1.0f, 1.0f);
+    return glm::degrees(acosf(cosine));
+}
+
+// Normalizes a vector before it gets packed, some of the tangents
+// from CalculateTangents can be zero length (triangles with no uv area)
+static glm::vec3 SafeNormalize(glm::vec3 v)
+{
+    float length = glm::length(v);
+    if (!(length > 0))
+        return glm::vec3(0);
+    return v / length;
+}
+
+// Position steps per model space unit on each axis, across the box from boundsMin to boundsMax.
+// A flat mesh (like the plane) has no size on one axis, every vertex on that axis just gets 0
+static glm::vec3 PositionScale(glm::vec3 boundsMin, glm::vec3 boundsMax)
+{
+    glm::vec3 extent = boundsMax - boundsMin;
+    glm::vec3 scale;
+    for (int i = 0; i < 3; i++)
+        scale[i] = extent[i] > 0 ? PositionSteps / extent[i] : 0;
+    return scale;
+}
+
+static PackedVertex PackWithScale(const Vertex3dUVNormal& v, glm::vec3 boundsMin, glm::vec3 scale)
+{
+    PackedVertex p;
+
+    glm::vec3 steps = glm::clamp((v.m_position - boundsMin) * scale, 0.0f, PositionSteps);
+    for (int j = 0; j < 3; j++)
+        p.m_position[j] = (unsigned short)(steps[j] + 0.5f);
+    p.m_position[3] = 0;
+
+    p.m_texCoord = glm::packHalf2x16(v.m_texCoord);
+    p.m_normal = glm::packSnorm3x10_1x2(glm::vec4(SafeNormalize(v.m_normal), 0));
+    p.m_tangent = glm::packSnorm3x10_1x2(glm::vec4(SafeNormalize(v.m_tangent), 0));
+    return p;
+}
+
+void PackVertices(const std::vector<Vertex3dUVNormal>& vertices, glm::vec3 boundsMin, glm::vec3 boundsMax, std::vector<PackedVertex>& packed)
+{
+    glm::vec3 scale = PositionScale(boundsMin, boundsMax);
+
+    packed.resize(vertices.size());
+    for (unsigned int i = 0; i < vertices.size(); i++)
+        packed[i] = PackWithScale(vertices[i], boundsMin, scale);
+}
+
+PackedVertex PackVertex(const Vertex3dUVNormal& vertex, glm::vec3 boundsMin, glm::vec3 boundsMax)
+{
+    return PackWithScale(vertex, boundsMin, PositionScale(boundsMin, boundsMax));
+}
+
+Vertex3dUVNormal UnpackVertex(const PackedVertex& packed, glm::vec3 boundsMin, glm::vec3 boundsMax)
+{
+    glm::vec3 steps(packed.m_position[0], packed.m_position[1], packed.m_position[2]);
+    glm::vec3 position = boundsMin + steps / PositionSteps * (boundsMax - boundsMin);
+
+    return Vertex3dUVNormal(
+        position,
+        glm::unpackHalf2x16(packed.m_texCoord),
+        glm::vec3(glm::unpackSnorm3x10_1x2(packed.m_normal)),
+        glm::vec3(glm::unpackSnorm3x10_1x2(packed.m_tangent)));
+}
+
+PackingError MeasurePackingError(const std::vector<Vertex3dUVNormal>& vertices, const std::vector<PackedVertex>& packed, glm::vec3 boundsMin, glm::vec3 boundsMax)
+{
+    PackingError error;
+    double positionErrorSum = 0;
+
+    for (unsigned int i = 0; i < vertices.size() && i < packed.size(); i++)
+    {
+        const Vertex3dUVNormal& original = vertices[i];
+        Vertex3dUVNormal unpacked = UnpackVertex(packed[i], boundsMin, boundsMax);
+
+        float positionError = glm::length(unpacked.m_position - original.m_position);
+        positionErrorSum += positionError;
+        error.maxPositionError = glm::max(error.maxPositionError, positionError);
+
+        glm::vec2 uvError = glm::abs(unpacked.m_texCoord - original.m_texCoord);
+        error.maxUVError = glm::max(error.maxUVError, glm::max(uvError.x, uvError.y));
+
+        error.maxNormalDegrees = glm::max(error.maxNormalDegrees, AngleBetween(unpacked.m_normal, original.m_normal));
+        error.maxTangentDegrees = glm::max(error.maxTangentDegrees, AngleBetween(unpacked.m_tangent, original.m_tangent));
+    }
+
+    if (!vertices.empty())
+        error.averagePositionError = (float)(positionErrorSum / vertices.size());
+
+    return error;
+}
@@ -0,0 +1,75 @@
+/*
+Title: Blur Optimization VR
+File Name: vertexPacking.h
+Copyright ? 2020
+Author: Niko Procopi
+Written under the supervision of David I. Schwartz, Ph.D., and
+supported by a professional development seed grant from the B. Thomas
+Golisano College of Computing & Information Sciences
+(https://www.rit.edu/gccis) at the Rochester Institute of Technology.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "mesh.h"
+#include <vector>
+
+// Vertex3dUVNormal is 44 bytes of floats, and every one of them gets read
+// twice per frame (once per eye). Most of that precision is never seen.
+// PackedVertex holds the same data in 20 bytes:
+//   position: 16 bits per axis, 0 to 65535 across the mesh's bounding box
+//   uv:       two half floats
+//   normal:   10 bits per axis, -1 to 1 (GL_INT_2_10_10_10_REV)
+//   tangent:  10 bits per axis, -1 to 1
+// The gpu turns all of these back into floats while fetching them,
+// the only extra work in the vertex shader is scaling the position back
+// out of the box, see Mesh::Draw and vertex.glsl
+struct PackedVertex
+{
+    // The 4th value is unused, it keeps the next member 4 byte aligned
+    unsigned short m_position[4];
+    unsigned int m_texCoord;
+    unsigned int m_normal;
+    unsigned int m_tangent;
+};
+
+// How far the packed vertices ended up from the originals
+struct PackingError
+{
+    // In model space units
+    float maxPositionError = 0;
+    float averagePositionError = 0;
+
+    // In uv units, 1.0 is the width of the texture
+    float maxUVError = 0;
+
+    // Angle between the original and packed vectors, in degrees
+    float maxNormalDegrees = 0;
+    float maxTangentDegrees = 0;
+};
+
+// Packs every vertex. Positions are stored relative to the box from boundsMin to boundsMax,
+// which has to contain every vertex
+void PackVertices(const std::vector<Vertex3dUVNormal>& vertices, glm::vec3 boundsMin, glm::vec3 boundsMax, std::vector<PackedVertex>& packed);
+
+// Packs one vertex, the same way PackVertices does. For code that makes vertices
+// one at a time, straight into gpu memory (see proceduralMesh.h)
+PackedVertex PackVertex(const Vertex3dUVNormal& vertex, glm::vec3 boundsMin, glm::vec3 boundsMax);
+
+// Turns a packed vertex back into floats, the same way the gpu does
+Vertex3dUVNormal UnpackVertex(const PackedVertex& packed, glm::vec3 boundsMin, glm::vec3 boundsMax);
+
+// Unpacks every vertex and compares it against the original
+PackingError MeasurePackingError(const std::vector<Vertex3dUVNormal>& vertices, const std::vector<PackedVertex>& packed, glm::vec3 boundsMin, glm::vec3 boundsMax);